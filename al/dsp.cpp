@@ -118,6 +118,17 @@ namespace AL {
 #endif
 #endif
 
+#if defined(__i386__) || defined(__x86_64__)
+		static const char* levelName[] = {"scalar", "SSE2", "AVX2", "AVX-512"};
+		int level = x86DspLevel();
+		if (level != DSP_SCALAR)
+		{
+			printf("Using %s optimized routines\n", levelName[level]);
+			dsp = createX86Dsp(level);
+			return;
+		}
+#endif
+
 #if defined(__i386__) && defined(USE_SSE)
 		unsigned long useSSE = 0;
 		if (debugMsg)
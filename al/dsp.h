@@ -45,6 +45,15 @@ static inline float f_max(float x, float a)
 //    hw acceleration
 //---------------------------------------------------------
 
+//---------------------------------------------------------
+//   DspLevel
+//    instruction sets of the x86 kernels, see dspx86.cpp
+//---------------------------------------------------------
+
+enum DspLevel {
+      DSP_SCALAR, DSP_SSE2, DSP_AVX2, DSP_AVX512
+      };
+
 class Dsp {
    public:
       Dsp() {}
@@ -67,6 +76,33 @@ class Dsp {
             for (unsigned i = 0; i < n; ++i)
                   dst[i] += src[i];
             }
+      virtual void cpyWithGain(float* dst, float* src, unsigned n, float gain) {
+            for (unsigned i = 0; i < n; ++i)
+                  dst[i] = src[i] * gain;
+            }
+      //  the WithPeak versions return the peak of src * gain,
+      //  or current if that is greater
+      virtual float cpyWithGainPeak(float* dst, float* src, unsigned n, float gain, float current) {
+            for (unsigned i = 0; i < n; ++i) {
+                  float val = src[i] * gain;
+                  dst[i] = val;
+                  current = f_max(current, fabsf(val));
+                  }
+            return current;
+            }
+      virtual float mixWithGainPeak(float* dst, float* src, unsigned n, float gain, float current) {
+            for (unsigned i = 0; i < n; ++i) {
+                  float val = src[i] * gain;
+                  dst[i] += val;
+                  current = f_max(current, fabsf(val));
+                  }
+            return current;
+            }
+      //  dst += src * scale * gain[i]
+      virtual void mixWithGainRamp(float* dst, float* src, float* gain, unsigned n, float scale) {
+            for (unsigned i = 0; i < n; ++i)
+                  dst[i] += src[i] * scale * gain[i];
+            }
       virtual void cpy(float* dst, float* src, unsigned n);
 /*      
       {
@@ -95,8 +131,33 @@ class Dsp {
             }
 */            
             
+      //  one channel of an interleaved buffer, scaled by a
+      //  per frame gain; stride is the number of channels
+      virtual void cpyInterleavedWithGain(float* dst, float* src, unsigned stride, float* gain, unsigned n) {
+            for (unsigned i = 0; i < n; ++i)
+                  dst[i] = gain[i] * src[i * stride];
+            }
+      virtual void mixInterleavedWithGain(float* dst, float* src, unsigned stride, float* gain, unsigned n) {
+            for (unsigned i = 0; i < n; ++i)
+                  dst[i] += gain[i] * src[i * stride];
+            }
+      //  sum of both channels of an interleaved stereo buffer
+      virtual void cpyStereoSumWithGain(float* dst, float* src, float* gain, unsigned n) {
+            for (unsigned i = 0; i < n; ++i)
+                  dst[i] = gain[i] * (src[i + i] + src[i + i + 1]);
+            }
+      virtual void mixStereoSumWithGain(float* dst, float* src, float* gain, unsigned n) {
+            for (unsigned i = 0; i < n; ++i)
+                  dst[i] += gain[i] * (src[i + i] + src[i + i + 1]);
+            }
       };
 
+#if defined(__i386__) || defined(__x86_64__)
+extern Dsp* createX86Dsp(int level);
+extern int x86DspLevel();
+extern int benchX86Dsp(unsigned frames);
+#endif
+
 extern void initDsp();
 extern void exitDsp();
 extern Dsp* dsp;
@@ -0,0 +1,309 @@
+//=============================================================================
+//  AL
+//  Audio Utility Library
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License version 2.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//=============================================================================
+
+#if defined(__i386__) || defined(__x86_64__)
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <immintrin.h>
+#include "dsp.h"
+
+//---------------------------------------------------------
+//   x86 dsp kernels
+//    Every instruction set is compiled with its own target
+//    pragma, so the file needs no special compiler flags
+//    and createX86Dsp() picks the widest one the cpu and
+//    the kernel support at run time. Contraction to fused
+//    multiply adds is turned off, avx512f implies fma.
+//---------------------------------------------------------
+
+namespace AL {
+
+#pragma GCC push_options
+#pragma GCC target("sse2")
+#pragma GCC optimize("fp-contract=off")
+
+#define DSP_CLASS       DspSSE2
+#define VEC             __m128
+#define VW              4
+#define V_LOAD(p)       _mm_load_ps(p)
+#define V_LOADU(p)      _mm_loadu_ps(p)
+#define V_STORE(p, v)   _mm_store_ps(p, v)
+#define V_STOREU(p, v)  _mm_storeu_ps(p, v)
+#define V_SET1(f)       _mm_set1_ps(f)
+#define V_ZERO()        _mm_setzero_ps()
+#define V_ADD(a, b)     _mm_add_ps(a, b)
+#define V_MUL(a, b)     _mm_mul_ps(a, b)
+#define V_MAX(a, b)     _mm_max_ps(a, b)
+#define V_ABS(a)        _mm_and_ps(a, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)))
+#include "dspx86kernels.h"
+#undef DSP_CLASS
+#undef VEC
+#undef VW
+#undef V_LOAD
+#undef V_LOADU
+#undef V_STORE
+#undef V_STOREU
+#undef V_SET1
+#undef V_ZERO
+#undef V_ADD
+#undef V_MUL
+#undef V_MAX
+#undef V_ABS
+
+#pragma GCC pop_options
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#pragma GCC optimize("fp-contract=off")
+
+#define DSP_CLASS       DspAVX2
+#define VEC             __m256
+#define VW              8
+#define V_LOAD(p)       _mm256_load_ps(p)
+#define V_LOADU(p)      _mm256_loadu_ps(p)
+#define V_STORE(p, v)   _mm256_store_ps(p, v)
+#define V_STOREU(p, v)  _mm256_storeu_ps(p, v)
+#define V_SET1(f)       _mm256_set1_ps(f)
+#define V_ZERO()        _mm256_setzero_ps()
+#define V_ADD(a, b)     _mm256_add_ps(a, b)
+#define V_MUL(a, b)     _mm256_mul_ps(a, b)
+#define V_MAX(a, b)     _mm256_max_ps(a, b)
+#define V_ABS(a)        _mm256_and_ps(a, _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff)))
+#include "dspx86kernels.h"
+#undef DSP_CLASS
+#undef VEC
+#undef VW
+#undef V_LOAD
+#undef V_LOADU
+#undef V_STORE
+#undef V_STOREU
+#undef V_SET1
+#undef V_ZERO
+#undef V_ADD
+#undef V_MUL
+#undef V_MAX
+#undef V_ABS
+
+#pragma GCC pop_options
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#pragma GCC optimize("fp-contract=off")
+
+#define DSP_CLASS       DspAVX512
+#define VEC             __m512
+#define VW              16
+#define V_LOAD(p)       _mm512_load_ps(p)
+#define V_LOADU(p)      _mm512_loadu_ps(p)
+#define V_STORE(p, v)   _mm512_store_ps(p, v)
+#define V_STOREU(p, v)  _mm512_storeu_ps(p, v)
+#define V_SET1(f)       _mm512_set1_ps(f)
+#define V_ZERO()        _mm512_setzero_ps()
+#define V_ADD(a, b)     _mm512_add_ps(a, b)
+#define V_MUL(a, b)     _mm512_mul_ps(a, b)
+#define V_MAX(a, b)     _mm512_max_ps(a, b)
+#define V_ABS(a)        _mm512_abs_ps(a)
+#include "dspx86kernels.h"
+#undef DSP_CLASS
+#undef VEC
+#undef VW
+#undef V_LOAD
+#undef V_LOADU
+#undef V_STORE
+#undef V_STOREU
+#undef V_SET1
+#undef V_ZERO
+#undef V_ADD
+#undef V_MUL
+#undef V_MAX
+#undef V_ABS
+
+#pragma GCC pop_options
+
+	//---------------------------------------------------------
+	//   x86DspLevel
+	//    widest instruction set the cpu supports
+	//---------------------------------------------------------
+
+	int x86DspLevel()
+	{
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f"))
+			return DSP_AVX512;
+		if (__builtin_cpu_supports("avx2"))
+			return DSP_AVX2;
+		if (__builtin_cpu_supports("sse2"))
+			return DSP_SSE2;
+		return DSP_SCALAR;
+	}
+
+	//---------------------------------------------------------
+	//   createX86Dsp
+	//    returns 0 for DSP_SCALAR or if the cpu does not
+	//    support the level
+	//---------------------------------------------------------
+
+	Dsp* createX86Dsp(int level)
+	{
+		if (level > x86DspLevel())
+			return 0;
+		switch (level)
+		{
+			case DSP_SSE2:
+				return new DspSSE2();
+			case DSP_AVX2:
+				return new DspAVX2();
+			case DSP_AVX512:
+				return new DspAVX512();
+		}
+		return 0;
+	}
+
+	//---------------------------------------------------------
+	//   exactPeak
+	//    the peak of src * gain the kernels have to return
+	//---------------------------------------------------------
+
+	static float exactPeak(const float* src, unsigned n, float gain)
+	{
+		float peak = 0.0;
+		for (unsigned i = 0; i < n; ++i)
+		{
+			float f = fabsf(src[i] * gain);
+			if (f > peak)
+				peak = f;
+		}
+		return peak;
+	}
+
+	static double seconds()
+	{
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec + ts.tv_nsec / 1e9;
+	}
+
+	//---------------------------------------------------------
+	//   benchX86Dsp
+	//    --bench-dsp: check every level the cpu supports
+	//    against the scalar Dsp on random lengths and
+	//    alignments, then time the mix with gain and peak of
+	//    the volume stage on periods of frames frames
+	//    returns 1 if a level does not match
+	//---------------------------------------------------------
+
+	int benchX86Dsp(unsigned frames)
+	{
+		static const char* levelName[] = {"scalar", "SSE2", "AVX2", "AVX-512"};
+		if (frames == 0)
+			frames = 1024;
+		const unsigned size = frames + 64;
+		float* src;
+		float* gain;
+		float* dst;
+		float* ref;
+		posix_memalign((void**) &src, 64, sizeof (float) * size);
+		posix_memalign((void**) &gain, 64, sizeof (float) * size);
+		posix_memalign((void**) &dst, 64, sizeof (float) * size);
+		posix_memalign((void**) &ref, 64, sizeof (float) * size);
+		srand(1);
+		for (unsigned i = 0; i < size; ++i)
+		{
+			src[i] = 2.0 * rand() / RAND_MAX - 1.0;
+			gain[i] = float(rand()) / RAND_MAX;
+		}
+
+		Dsp scalar;
+		Dsp* dsps[DSP_AVX512 + 1];
+		dsps[DSP_SCALAR] = &scalar;
+		int maxLevel = x86DspLevel();
+		int errors = 0;
+		for (int level = DSP_SSE2; level <= maxLevel; ++level)
+		{
+			Dsp* d = createX86Dsp(level);
+			dsps[level] = d;
+			int failed = 0;
+			for (int t = 0; t < 2000; ++t)
+			{
+				unsigned doff = rand() % 16;
+				unsigned soff = rand() % 16;
+				unsigned n = rand() % (frames + 1);
+				float g = float(rand()) / RAND_MAX * 2.0;
+				float* s = src + soff;
+				float peak = exactPeak(s, n, g);
+
+				for (unsigned i = 0; i < size; ++i)
+					dst[i] = ref[i] = src[size - 1 - i];
+				scalar.mixWithGainPeak(ref + doff, s, n, g, 0.0);
+				if (d->mixWithGainPeak(dst + doff, s, n, g, 0.0) != peak
+						|| memcmp(dst, ref, sizeof (float) * size))
+					++failed;
+
+				scalar.cpyWithGain(ref + doff, s, n, g);
+				if (d->cpyWithGainPeak(dst + doff, s, n, g, 0.0) != peak
+						|| memcmp(dst, ref, sizeof (float) * size))
+					++failed;
+
+				scalar.mixWithGainRamp(ref + doff, s, gain + soff, n, g);
+				d->mixWithGainRamp(dst + doff, s, gain + soff, n, g);
+				if (memcmp(dst, ref, sizeof (float) * size))
+					++failed;
+
+				if (d->peak(s, n, 0.0) != exactPeak(s, n, 1.0))
+					++failed;
+			}
+			if (failed)
+				printf("bench: %s: %d of 2000 runs differ from the scalar version\n", levelName[level], failed);
+			errors += failed;
+		}
+
+		// ten minutes of stereo audio at 48kHz per level
+		unsigned periods = 48000 * 600 * 2 / frames + 1;
+		double scalarTime = 0.0;
+		volatile float sink = 0.0;
+		for (int level = DSP_SCALAR; level <= maxLevel; ++level)
+		{
+			Dsp* d = dsps[level];
+			for (unsigned i = 0; i < frames; ++i)
+				dst[i] = 0.0;
+			double start = seconds();
+			for (unsigned k = 0; k < periods; ++k)
+				sink = d->mixWithGainPeak(dst, src, frames, 0.5, 0.0);
+			double elapsed = seconds() - start;
+			if (level == DSP_SCALAR)
+				scalarTime = elapsed;
+			printf("bench: %-8s mixWithGainPeak %u x %u frames %.3f s, %.2fx scalar\n", levelName[level],
+					periods, frames, elapsed, elapsed > 0.0 ? scalarTime / elapsed : 0.0);
+		}
+		(void) sink;
+
+		for (int level = DSP_SSE2; level <= maxLevel; ++level)
+			delete dsps[level];
+		free(src);
+		free(gain);
+		free(dst);
+		free(ref);
+		printf("bench: %d mismatches\n", errors);
+		return errors ? 1 : 0;
+	}
+
+} // namespace AL
+
+#endif
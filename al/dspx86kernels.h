@@ -0,0 +1,215 @@
+//=============================================================================
+//  AL
+//  Audio Utility Library
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License version 2.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program; if not, write to the Free Software
+//  Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+//=============================================================================
+
+//---------------------------------------------------------
+//   x86 dsp kernels
+//    Included by dspx86.cpp once for every instruction
+//    set, with the target enabled by a pragma and these
+//    macros defined:
+//
+//      DSP_CLASS     name of the class
+//      VEC, VW       vector type and its number of floats
+//      V_LOAD(p)     aligned load
+//      V_LOADU(p)    unaligned load
+//      V_STORE(p, v) aligned store
+//      V_STOREU(p, v)
+//      V_SET1(f)     all elements f
+//      V_ZERO()      all elements 0
+//      V_ADD, V_MUL, V_MAX, V_ABS
+//
+//    Frames up to the first vector aligned destination
+//    frame and the frames after the last full vector are
+//    done one by one, sources may have any alignment.
+//    Products are not fused, so the samples are the same
+//    as the ones of the scalar Dsp. Peaks are an exact max,
+//    f_max() of the scalar version can be off in the last
+//    bit.
+//---------------------------------------------------------
+
+class DSP_CLASS : public Dsp
+{
+	// frames before p is vector aligned
+	static unsigned head(const float* p, unsigned n)
+	{
+		const uintptr_t mask = VW * sizeof (float) - 1;
+		unsigned h = ((mask + 1 - ((uintptr_t) p & mask)) & mask) / sizeof (float);
+		return h < n ? h : n;
+	}
+
+	static float smax(float a, float b)
+	{
+		return b > a ? b : a;
+	}
+
+	static float hmax(VEC v, float current)
+	{
+		float t[VW];
+		V_STOREU(t, v);
+		for (int i = 0; i < VW; ++i)
+			current = smax(current, t[i]);
+		return current;
+	}
+
+public:
+
+	virtual float peak(float* buf, unsigned n, float current)
+	{
+		unsigned i = head(buf, n);
+		for (unsigned k = 0; k < i; ++k)
+			current = smax(current, fabsf(buf[k]));
+		// two accumulators hide the latency of the max, they
+		// start at 0 and current is taken in by hmax()
+		VEC m0 = V_ZERO();
+		VEC m1 = V_ZERO();
+		for (; i + 2 * VW <= n; i += 2 * VW)
+		{
+			m0 = V_MAX(m0, V_ABS(V_LOAD(buf + i)));
+			m1 = V_MAX(m1, V_ABS(V_LOAD(buf + i + VW)));
+		}
+		for (; i + VW <= n; i += VW)
+			m0 = V_MAX(m0, V_ABS(V_LOAD(buf + i)));
+		current = hmax(V_MAX(m0, m1), current);
+		for (; i < n; ++i)
+			current = smax(current, fabsf(buf[i]));
+		return current;
+	}
+
+	virtual void applyGainToBuffer(float* buf, unsigned n, float gain)
+	{
+		unsigned i = head(buf, n);
+		for (unsigned k = 0; k < i; ++k)
+			buf[k] *= gain;
+		VEC g = V_SET1(gain);
+		for (; i + VW <= n; i += VW)
+			V_STORE(buf + i, V_MUL(V_LOAD(buf + i), g));
+		for (; i < n; ++i)
+			buf[i] *= gain;
+	}
+
+	virtual void mixWithGain(float* dst, float* src, unsigned n, float gain)
+	{
+		unsigned i = head(dst, n);
+		for (unsigned k = 0; k < i; ++k)
+			dst[k] += src[k] * gain;
+		VEC g = V_SET1(gain);
+		for (; i + VW <= n; i += VW)
+			V_STORE(dst + i, V_ADD(V_LOAD(dst + i), V_MUL(V_LOADU(src + i), g)));
+		for (; i < n; ++i)
+			dst[i] += src[i] * gain;
+	}
+
+	virtual void mix(float* dst, float* src, unsigned n)
+	{
+		unsigned i = head(dst, n);
+		for (unsigned k = 0; k < i; ++k)
+			dst[k] += src[k];
+		for (; i + VW <= n; i += VW)
+			V_STORE(dst + i, V_ADD(V_LOAD(dst + i), V_LOADU(src + i)));
+		for (; i < n; ++i)
+			dst[i] += src[i];
+	}
+
+	virtual void cpy(float* dst, float* src, unsigned n)
+	{
+		unsigned i = head(dst, n);
+		for (unsigned k = 0; k < i; ++k)
+			dst[k] = src[k];
+		for (; i + VW <= n; i += VW)
+			V_STORE(dst + i, V_LOADU(src + i));
+		for (; i < n; ++i)
+			dst[i] = src[i];
+	}
+
+	virtual void cpyWithGain(float* dst, float* src, unsigned n, float gain)
+	{
+		unsigned i = head(dst, n);
+		for (unsigned k = 0; k < i; ++k)
+			dst[k] = src[k] * gain;
+		VEC g = V_SET1(gain);
+		for (; i + VW <= n; i += VW)
+			V_STORE(dst + i, V_MUL(V_LOADU(src + i), g));
+		for (; i < n; ++i)
+			dst[i] = src[i] * gain;
+	}
+
+	virtual float cpyWithGainPeak(float* dst, float* src, unsigned n, float gain, float current)
+	{
+		unsigned i = head(dst, n);
+		for (unsigned k = 0; k < i; ++k)
+		{
+			dst[k] = src[k] * gain;
+			current = smax(current, fabsf(dst[k]));
+		}
+		VEC g = V_SET1(gain);
+		VEC m = V_ZERO();
+		for (; i + VW <= n; i += VW)
+		{
+			VEC v = V_MUL(V_LOADU(src + i), g);
+			V_STORE(dst + i, v);
+			m = V_MAX(m, V_ABS(v));
+		}
+		current = hmax(m, current);
+		for (; i < n; ++i)
+		{
+			dst[i] = src[i] * gain;
+			current = smax(current, fabsf(dst[i]));
+		}
+		return current;
+	}
+
+	virtual float mixWithGainPeak(float* dst, float* src, unsigned n, float gain, float current)
+	{
+		unsigned i = head(dst, n);
+		for (unsigned k = 0; k < i; ++k)
+		{
+			float val = src[k] * gain;
+			dst[k] += val;
+			current = smax(current, fabsf(val));
+		}
+		VEC g = V_SET1(gain);
+		VEC m = V_ZERO();
+		for (; i + VW <= n; i += VW)
+		{
+			VEC v = V_MUL(V_LOADU(src + i), g);
+			V_STORE(dst + i, V_ADD(V_LOAD(dst + i), v));
+			m = V_MAX(m, V_ABS(v));
+		}
+		current = hmax(m, current);
+		for (; i < n; ++i)
+		{
+			float val = src[i] * gain;
+			dst[i] += val;
+			current = smax(current, fabsf(val));
+		}
+		return current;
+	}
+
+	virtual void mixWithGainRamp(float* dst, float* src, float* gain, unsigned n, float scale)
+	{
+		unsigned i = head(dst, n);
+		for (unsigned k = 0; k < i; ++k)
+			dst[k] += src[k] * scale * gain[k];
+		VEC s = V_SET1(scale);
+		for (; i + VW <= n; i += VW)
+			V_STORE(dst + i, V_ADD(V_LOAD(dst + i), V_MUL(V_MUL(V_LOADU(src + i), s), V_LOADU(gain + i))));
+		for (; i < n; ++i)
+			dst[i] += src[i] * scale * gain[i];
+	}
+};
+
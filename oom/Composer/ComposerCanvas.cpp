@@ -2480,7 +2480,10 @@ void ComposerCanvas::keyPress(QKeyEvent* event)/*{{{*/
     {
             Part* part = _curItem->part();
 			if(part->lenTick() > 200)
+			{
             	part->setLenTick(part->lenTick() - 200);
+				part->track()->partsChanged();
+			}
     }
 	else if (key == shortcuts[SHRT_SELECT_ALL_NODES].key)
 	{
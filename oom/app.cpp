@@ -33,6 +33,15 @@
 #include "audio.h"
 #include "audiodev.h"
 #include "audioprefetch.h"
+#include "diskwriter.h"
+#include "audiograph.h"
+#include "dspload.h"
+#include "peakbuilder.h"
+#include "waveoverlay.h"
+#include "srccache.h"
+#include "blockcache.h"
+#include "binxml.h"
+#include "projectloader.h"
 #include "apconfig.h"
 #include "bigtime.h"
 #include "cliplist/cliplist.h"
@@ -288,6 +297,10 @@ bool OOMidi::seqStart()
 	midiMonitor->start(monitorprio);
 
 	audioPrefetch->start(pfprio);
+	diskWriter->start(pfprio);
+
+	// Graph workers run at the same priority as the Jack client thread they help.
+	audioGraph->start(realTimeScheduling ? realTimePriority : 0);
 
 	audioPrefetch->msgSeek(0, true); // force
 
@@ -341,7 +354,9 @@ void OOMidi::seqStop()
 	midiMonitor->stop(true);
 	midiSeq->stop(true);
 	audio->stop(true);
+	audioGraph->stop();
 	audioPrefetch->stop(true);
+	diskWriter->stop(true);
     // close opened synths
     for (iMidiDevice i = midiDevices.begin(); i != midiDevices.end(); ++i)
     {
@@ -907,6 +922,11 @@ OOMidi::OOMidi(int argc, char** argv) : QMainWindow()
 	audioBounce2TrackAction = new QAction(QIcon(*audio_bounce_to_trackIcon), tr("Bounce to Track"), this);
 	audioBounce2FileAction = new QAction(QIcon(*audio_bounce_to_fileIcon), tr("Bounce to File"), this);
 	audioRestartAction = new QAction(QIcon(*audio_restartaudioIcon), tr("Restart Audio"), this);
+	audioDspLoadAction = new QAction(tr("DSP Load Profiler"), this);
+	audioDspLoadAction->setCheckable(true);
+	audioDspTraceAction = new QAction(tr("Export DSP Trace..."), this);
+	audioParallelAction = new QAction(tr("Parallel Track Processing"), this);
+	audioParallelAction->setCheckable(true);
 
 	//-------- Automation Actions
 	autoMixerAction = new QAction(QIcon(*automation_mixerIcon), tr("Mixer Automation"), this);
@@ -1051,6 +1071,9 @@ OOMidi::OOMidi(int argc, char** argv) : QMainWindow()
 	connect(audioBounce2TrackAction, SIGNAL(triggered()), SLOT(bounceToTrack()));
 	connect(audioBounce2FileAction, SIGNAL(triggered()), SLOT(bounceToFile()));
 	connect(audioRestartAction, SIGNAL(triggered()), SLOT(seqRestart()));
+	connect(audioDspLoadAction, SIGNAL(toggled(bool)), SLOT(toggleDspLoad(bool)));
+	connect(audioDspTraceAction, SIGNAL(triggered()), SLOT(exportDspTrace()));
+	connect(audioParallelAction, SIGNAL(toggled(bool)), SLOT(toggleParallelAudio(bool)));
 
 	//-------- Automation connections
 	connect(autoMixerAction, SIGNAL(triggered()), SLOT(switchMixerAutomation()));
@@ -1106,6 +1129,12 @@ OOMidi::OOMidi(int argc, char** argv) : QMainWindow()
 	midiSeq = new MidiSeq("Midi");
 	audio = new Audio();
 	audioPrefetch = new AudioPrefetch("Prefetch");
+	diskWriter = new DiskWriter("DiskWriter");
+	audioGraph = new AudioGraph();
+	peakBuilder = new PeakBuilder();
+	waveCompactor = new WaveCompactor();
+	srcCache = new SrcCache();
+	blockCache = new BlockCache(size_t(config.blockCacheSize) << 20);
 	//Define the MidiMonitor
 	midiMonitor = new MidiMonitor("MidiMonitor");
 
@@ -1217,6 +1246,10 @@ OOMidi::OOMidi(int argc, char** argv) : QMainWindow()
 	menu_audio->addAction(audioBounce2FileAction);
 	menu_audio->addSeparator();
 	menu_audio->addAction(audioRestartAction);
+	menu_audio->addSeparator();
+	menu_audio->addAction(audioDspLoadAction);
+	menu_audio->addAction(audioDspTraceAction);
+	menu_audio->addAction(audioParallelAction);
 
 
 	//-------------------------------------------------------------
@@ -1277,6 +1310,7 @@ OOMidi::OOMidi(int argc, char** argv) : QMainWindow()
 	connect(composer, SIGNAL(trackSelectionChanged(qint64)), m_mixerWidget, SLOT(scrollSelectedToView(qint64)));
 
 	connect(composer, SIGNAL(setUsedTool(int)), SLOT(setUsedTool(int)));
+	connect(peakBuilder, SIGNAL(peaksReady()), composer->getCanvas(), SLOT(redraw()));
 
 	//---------------------------------------------------
 	//  read list of "Recent Projects"
@@ -1734,7 +1768,28 @@ void OOMidi::loadProjectFile1(const QString& name, bool songTemplate, bool loadA
 	if ((mex == "gz") || (mex == "bz2"))
 		mex = ex.section('.', -2, -2);
 
-	if (ex.isEmpty() || mex == "oom")
+	// the snapshot written with the project is read without
+	// parsing xml, as long as the project was not changed
+	BinXml* snapshot = 0;
+	if ((ex.isEmpty() || mex == "oom") && config.projectSnapshot)
+		snapshot = openSnapshot(fi.filePath());
+
+	if (snapshot)
+	{
+		initGlobalInputPorts();
+		double t = curTime();
+		if (config.parallelProjectLoad)
+			projectLoader = new ProjectLoader(fi.filePath(), true);
+		Xml xml(snapshot);
+		read(xml, !loadAll);
+		delete projectLoader;
+		projectLoader = 0;
+		delete snapshot;
+		if (debugMsg)
+			printf("OOMidi::loadProjectFile1: %s read from its snapshot in %.0f ms\n",
+					fi.filePath().toLatin1().constData(), (curTime() - t) * 1000.0);
+	}
+	else if (ex.isEmpty() || mex == "oom")
 	{
 		//
 		//  read *.oom file
@@ -1754,6 +1809,11 @@ void OOMidi::loadProjectFile1(const QString& name, bool songTemplate, bool loadA
 		}
 		else
 		{
+			// the wave files and plugin libraries are loaded while
+			// the file is validated and read
+			if (config.parallelProjectLoad)
+				projectLoader = new ProjectLoader(fi.filePath(), false);
+
 	   		 // Load the .oom file into a QDomDocument.
 	   		 // the xml parser of QDomDocument then will be able to tell us
 	   		 // if the .oom file didn't get corrupted in some way, cause the
@@ -1778,6 +1838,8 @@ void OOMidi::loadProjectFile1(const QString& name, bool songTemplate, bool loadA
 	   		 			      .arg(file.fileName())
 	   		 			      .arg(errorMsg),
 	   		 			      "OK")) {
+	   		 		delete projectLoader;
+	   		 		projectLoader = 0;
 	   		 		setUntitledProject();
 	   		 		// is it save to return; here ?
 	   		 		return;
@@ -1790,12 +1852,15 @@ void OOMidi::loadProjectFile1(const QString& name, bool songTemplate, bool loadA
 			//TODO: Flush all ports at this point so each song loads with a fresh LS state
 
 			initGlobalInputPorts();
+			double t = curTime();
 			Xml xml(f);
 			if(debugMsg)
 				qDebug("OOMidi::loadProjectFile1 Before OOMidi::read()\n");
 			read(xml, !loadAll);
+			delete projectLoader;
+			projectLoader = 0;
 			if(debugMsg)
-				qDebug("OOMidi::loadProjectFile1 After OOMidi::read()\n");
+				qDebug("OOMidi::loadProjectFile1 After OOMidi::read(), %.0f ms\n", (curTime() - t) * 1000.0);
 			bool fileError = ferror(f);
 			popenFlag ? pclose(f) : fclose(f);
 			if (fileError)
@@ -1845,6 +1910,7 @@ void OOMidi::loadProjectFile1(const QString& name, bool songTemplate, bool loadA
 	punchinAction->setChecked(song->punchin());
 	punchoutAction->setChecked(song->punchout());
 	loopAction->setChecked(song->loop());
+	audioParallelAction->setChecked(song->parallelAudio());
 	song->update();
 	song->updatePos();
 	clipboardChanged(); // enable/disable "Paste"
@@ -2028,6 +2094,8 @@ bool OOMidi::save(const QString& name, bool overwriteWarn)
 	else
 	{
 		popenFlag ? pclose(f) : fclose(f);
+		if (config.projectSnapshot)
+			writeSnapshot(name);
 		//We should also use QDomDocument to parse the file like we do in openProject and verify after the fact that
 		//it did actually save a good file before returning true below
 		//Lets save config when the user saves to make sure everything is in sync on next launch
@@ -2459,10 +2527,24 @@ void OOMidi::closeEvent(QCloseEvent* event)
 
 	// p3.3.47
 	delete midiMonitor;
+	delete peakBuilder;
+	peakBuilder = 0;
+	delete waveCompactor;
+	waveCompactor = 0;
+	delete srcCache;
+	srcCache = 0;
+	if (debugMsg)
+	{
+		BlockCacheStats s = blockCache->stats();
+		printf("OOMidi: block cache %lu hits, %lu misses, %lu evictions\n", s.hits, s.misses, s.evictions);
+	}
 	delete audioPrefetch;
+	delete diskWriter;
 	delete audio;
 	delete midiSeq;
 	delete song;
+	delete blockCache;
+	blockCache = 0;
 
 	qApp->quit();
 }
@@ -4311,6 +4393,46 @@ void OOMidi::bounceToFile(AudioOutput* ao)
 	song->setPlay(true);
 }
 
+//---------------------------------------------------------
+//   toggleDspLoad
+//---------------------------------------------------------
+
+void OOMidi::toggleDspLoad(bool flag)
+{
+	dspLoad.setEnabled(flag);
+}
+
+//---------------------------------------------------------
+//   toggleParallelAudio
+//    the per song switch of the AudioGraph, new songs take
+//    config.parallelAudio
+//---------------------------------------------------------
+
+void OOMidi::toggleParallelAudio(bool flag)
+{
+	song->setParallelAudio(flag);
+}
+
+//---------------------------------------------------------
+//   exportDspTrace
+//    save the recent events of the dsp profiler for
+//    chrome://tracing or Perfetto
+//---------------------------------------------------------
+
+void OOMidi::exportDspTrace()
+{
+	QStringList pattern;
+	pattern << tr("Trace Files (*.json)") << tr("All Files (*)");
+	QString name = getSaveFileName(QString(""), pattern, this, tr("OOStudio: Export DSP Trace"));
+	if (name.isEmpty())
+		return;
+	if (dspLoad.exportTrace(name))
+	{
+		QMessageBox::critical(this, tr("OOStudio: Export DSP Trace"),
+				tr("Cannot write %1: %2").arg(name).arg(strerror(errno)));
+	}
+}
+
 #ifdef HAVE_LASH
 //---------------------------------------------------------
 //   lash_idle_cb
@@ -154,6 +154,7 @@ class OOMidi : public QMainWindow
 
     // Audio Menu Actions
     QAction *audioBounce2TrackAction, *audioBounce2FileAction, *audioRestartAction;
+    QAction *audioDspLoadAction, *audioDspTraceAction, *audioParallelAction;
 
     // Automation Menu Actions
     QAction *autoMixerAction, *autoSnapshotAction, *autoClearAction;
@@ -378,6 +379,9 @@ private slots:
     void copyRange();
     void cutEvents();
     void bounceToTrack();
+    void toggleDspLoad(bool);
+    void toggleParallelAudio(bool);
+    void exportDspTrace();
     void resetMidiDevices();
     void initMidiDevices();
     void localOff();
@@ -20,6 +20,7 @@
 #include "alsamidi.h"
 //#include "driver/alsamidi.h"   // p4.0.2
 #include "audioprefetch.h"
+#include "diskwriter.h"
 #include "plugin.h"
 #include "audio.h"
 #include "wave.h"
@@ -31,6 +32,8 @@
 #include "gconfig.h"
 #include "pos.h"
 #include "ticksynth.h"
+#include "audiograph.h"
+#include "dspload.h"
 
 extern double curTime();
 Audio* audio;
@@ -62,13 +65,18 @@ const char* seqMsgList[] = {
 	"SEQM_REMAP_PORT_DRUM_CTL_EVS",
 	"SEQM_CHANGE_ALL_PORT_DRUM_CTL_EVS",
 	"SEQM_SCAN_ALSA_MIDI_PORTS",
-	"SEQM_SET_AUX",
+	"SEQM_SWAP_AUX_SENDS",
+	"SEQM_SWAP_EVENT_STORES",
 	"SEQM_UPDATE_SOLO_STATES",
 	"MIDI_SHOW_INSTR_GUI",
 	"AUDIO_RECORD",
 	"AUDIO_ROUTEADD", "AUDIO_ROUTEREMOVE", "AUDIO_REMOVEROUTES",
 	"AUDIO_VOL", "AUDIO_PAN",
 	"AUDIO_ADDPLUGIN",
+	"AUDIO_ENABLEPLUGIN",
+	"AUDIO_SET_GRAPH",
+	"AUDIO_SET_PART_SCHEDULE",
+	"AUDIO_SWAP_LATENCY_DELAY",
 	"AUDIO_SET_SEG_SIZE",
 	"AUDIO_SET_PREFADER", "AUDIO_SET_CHANNELS",
 	"AUDIO_SET_PLUGIN_CTRL_VAL",
@@ -88,6 +96,60 @@ const char* audioStates[] = {
 	"STOP", "START_PLAY", "PLAY", "LOOP1", "LOOP2", "SYNC", "PRECOUNT"
 };
 
+//---------------------------------------------------------
+//   AudioMsgFifo
+//---------------------------------------------------------
+
+AudioMsgFifo::AudioMsgFifo()
+{
+	for (unsigned i = 0; i < AUDIO_MSG_FIFO_SIZE; ++i)
+	{
+		fifo[i].seq = i;
+		fifo[i].msg = 0;
+	}
+	rcount = 0;
+	oom_store_release(&wcount, 0);
+}
+
+//---------------------------------------------------------
+//   put
+//    return true on fifo overflow
+//---------------------------------------------------------
+
+bool AudioMsgFifo::put(AudioMsg* m)
+{
+	for (;;)
+	{
+		unsigned count = oom_load_acquire(&wcount);
+		Slot* s = &fifo[count % AUDIO_MSG_FIFO_SIZE];
+		int diff = int(oom_load_acquire(&s->seq) - count);
+		if (diff < 0)
+			return true; // the reader did not free the slot yet
+		if (diff == 0 && __sync_bool_compare_and_swap(&wcount, count, count + 1))
+		{
+			s->msg = m;
+			oom_store_release(&s->seq, count + 1);
+			return false;
+		}
+		// another writer was faster, try the next slot
+	}
+}
+
+//---------------------------------------------------------
+//   get
+//    only called from the audio thread
+//---------------------------------------------------------
+
+AudioMsg* AudioMsgFifo::get()
+{
+	Slot* s = &fifo[rcount % AUDIO_MSG_FIFO_SIZE];
+	if (oom_load_acquire(&s->seq) != rcount + 1)
+		return 0;
+	AudioMsg* m = s->msg;
+	oom_store_release(&s->seq, rcount + AUDIO_MSG_FIFO_SIZE);
+	++rcount;
+	return m;
+}
 
 //---------------------------------------------------------
 //   Audio
@@ -118,7 +180,7 @@ Audio::Audio()
 	frameOffset = 0;
 
 	state = STOP;
-	msg = 0;
+	_batchDepth = 0;
 
 	// Changed by Tim. p3.3.8
 	//startRecordPos.setType(Pos::TICKS);
@@ -134,17 +196,6 @@ Audio::Audio()
 	//---------------------------------------------------
 
 	int filedes[2]; // 0 - reading   1 - writing
-	if (pipe(filedes) == -1)
-	{
-		perror("creating pipe0");
-		exit(-1);
-	}
-	fromThreadFdw = filedes[1];
-	fromThreadFdr = filedes[0];
-	int rv = fcntl(fromThreadFdw, F_SETFL, O_NONBLOCK);
-	if (rv == -1)
-		perror("set pipe O_NONBLOCK");
-
 	if (pipe(filedes) == -1)
 	{
 		perror("creating pipe1");
@@ -319,17 +370,16 @@ void Audio::shutdown()
 void Audio::process(unsigned frames)
 {
 	if (!checkAudioDevice()) return;
-	if (msg)
+	dspLoad.nextCycle();
+	DspLoadScope load(DSP_LOAD_CYCLE, this);
+	// the rest of a long batch is left for the next cycles
+	for (int n = 0; n < AUDIO_MSGS_PER_CYCLE; ++n)
 	{
-		processMsg(msg);
-		int sn = msg->serialNo;
-		msg = 0; // dont process again
-		int rv = write(fromThreadFdw, &sn, sizeof (int));
-		if (rv != sizeof (int))
-		{
-			fprintf(stderr, "audio: write(%d) pipe failed: %s\n",
-					fromThreadFdw, strerror(errno));
-		}
+		AudioMsg* m = msgFifo.get();
+		if (m == 0)
+			break;
+		processMsg(m);
+		sem_post(m->done); // m may be gone after this
 	}
 
     OutputList* ol = song->outputs();
@@ -421,7 +471,11 @@ void Audio::process(unsigned frames)
 	if (isPlaying())
 	{
 		if (!freewheel())
+		{
 			audioPrefetch->msgTick();
+			if (recording)
+				diskWriter->msgTick();
+		}
 
 		if (_bounce && _pos >= song->rPos())
 		{
@@ -567,6 +621,14 @@ void Audio::process1(unsigned samplePos, unsigned offset, unsigned frames)
 	// Pre-process the metronome.
 	((AudioTrack*) metronome)->preProcessAlways();
 
+	// Run the plugin chains of all tracks on the graph workers first.
+	// The outputs below then only sum the cached results.
+	// Without the per-song switch everything stays on this thread, in route order,
+	// which is the reference for bit-exact comparisons.
+	bool parallel = false;
+	if (song->parallelAudio() && audioGraph)
+		parallel = audioGraph->process(samplePos, frames);
+
 	OutputList* ol = song->outputs();
 	for (ciAudioOutput i = ol->begin(); i != ol->end(); ++i)
 		(*i)->process(samplePos, offset, frames);
@@ -629,8 +691,11 @@ void Audio::processMsg(AudioMsg* msg)
 			msg->snode->setPan(msg->dval);
 			//TODO: hook this and send midi cc to bcf2000
 			break;
-		case SEQM_SET_AUX:
-			msg->snode->setAuxSend(msg->sid, msg->dval);
+		case SEQM_SWAP_AUX_SENDS:
+			song->swapAuxSends((AuxSendSwapList*) msg->p1);
+			break;
+		case SEQM_SWAP_EVENT_STORES:
+			song->swapEventStores((EventStoreSwapList*) msg->p1);
 			break;
 		case AUDIO_SET_PREFADER:
 			msg->snode->setPrefader(msg->ival);
@@ -641,6 +706,18 @@ void Audio::processMsg(AudioMsg* msg)
 		case AUDIO_IDLEPLUGIN:
 			msg->snode->idlePlugin(msg->plugin);
 			break;
+		case AUDIO_ENABLEPLUGIN:
+			msg->plugin->setEnabled(msg->ival);
+			break;
+		case AUDIO_SET_GRAPH:
+			audioGraph->setSchedule((GraphSchedule*) msg->p1);
+			break;
+		case AUDIO_SET_PART_SCHEDULE:
+			((WaveTrack*) msg->track)->setSchedule((PartSchedule*) msg->p1);
+			break;
+		case AUDIO_SWAP_LATENCY_DELAY:
+			msg->snode->swapLatencyDelay((LatencyDelay**) msg->p1);
+			break;
 		case AUDIO_ADDPLUGIN:
 			msg->snode->addPlugin(msg->plugin, msg->ival);
 			//TODO: Trigger song->update(SC_RACK);
@@ -847,29 +924,6 @@ void Audio::seek(const Pos& p)
 	write(sigFd, "G", 1); // signal seek to gui
 }
 
-//---------------------------------------------------------
-//   writeTick
-//    called from audio prefetch thread context
-//    write another buffer to soundfile
-//---------------------------------------------------------
-
-void Audio::writeTick()
-{
-	AudioOutput* ao = song->bounceOutput;
-	if (ao && song->outputs()->find(ao) != song->outputs()->end())
-	{
-		if (ao->recordFlag())
-			ao->record();
-	}
-	WaveTrackList* tl = song->waves();
-	for (iWaveTrack t = tl->begin(); t != tl->end(); ++t)
-	{
-		WaveTrack* track = *t;
-		if (track->recordFlag())
-			track->record();
-	}
-}
-
 //---------------------------------------------------------
 //   startRolling
 //---------------------------------------------------------
@@ -1066,6 +1120,9 @@ void Audio::recordStop()
 		printf("recordStop - startRecordPos=%d\n", startRecordPos.tick());
 	audio->msgIdle(true); // gain access to all data structures
 
+	// write what is still in the fifos and batches
+	diskWriter->flush();
+
 	song->startUndo();
 	WaveTrackList* wl = song->waves();
 
@@ -1074,6 +1131,9 @@ void Audio::recordStop()
 		WaveTrack* track = *it;
 		if (track->recordFlag() || song->bounceTrack == track)
 		{
+			if (track->recordOverruns())
+				printf("recordStop: track %s lost %u periods, disk too slow\n",
+						track->name().toLatin1().constData(), track->recordOverruns());
 			song->cmdAddRecordedWave(track, startRecordPos, endRecordPos);
 			// The track's _recFile pointer may have been kept and turned
 			//  into a SndFileR and added to a new part.
@@ -15,8 +15,16 @@
 #include "route.h"
 #include "event.h"
 #include <QList>
+#include <pthread.h>
+#include <semaphore.h>
 
 class SndFile;
+class AuxSendSwapList;
+class EventStoreSwapList;
+class LatencyDelay;
+struct GraphSchedule;
+class PartSchedule;
+class WaveTrack;
 class BasePlugin;
 class SynthI;
 class MidiDevice;
@@ -31,6 +39,8 @@ class MidiPort;
 class EventList;
 class MidiInstrument;
 class MidiTrack;
+class TempoCursor;
+class TempoIndex;
 
 //---------------------------------------------------------
 //   AudioMsgId
@@ -57,7 +67,8 @@ enum
     SEQM_REMAP_PORT_DRUM_CTL_EVS,
     SEQM_CHANGE_ALL_PORT_DRUM_CTL_EVS,
     SEQM_SCAN_ALSA_MIDI_PORTS,
-    SEQM_SET_AUX,
+    SEQM_SWAP_AUX_SENDS,
+    SEQM_SWAP_EVENT_STORES,
     SEQM_UPDATE_SOLO_STATES,
     MIDI_SHOW_INSTR_GUI,
     MIDI_SHOW_INSTR_NATIVE_GUI,
@@ -66,6 +77,10 @@ enum
     AUDIO_VOL, AUDIO_PAN,
     AUDIO_ADDPLUGIN,
     AUDIO_IDLEPLUGIN,
+    AUDIO_ENABLEPLUGIN,
+    AUDIO_SET_GRAPH,
+    AUDIO_SET_PART_SCHEDULE,
+    AUDIO_SWAP_LATENCY_DELAY,
     AUDIO_SET_SEG_SIZE,
     AUDIO_SET_PREFADER, AUDIO_SET_CHANNELS,
     AUDIO_SET_PLUGIN_CTRL_VAL,
@@ -89,7 +104,7 @@ extern const char* seqMsgList[]; // for debug
 
 struct AudioMsg : public ThreadMsg
 { // this should be an union
-    int serialNo;
+    sem_t* done; // posted by the audio thread after processing
 	qint64 sid;
     SndFile* downmix;
     AudioTrack* snode;
@@ -115,6 +130,38 @@ struct AudioMsg : public ThreadMsg
 	QList<void*> objectList;
 };
 
+#define AUDIO_MSG_FIFO_SIZE   1024  // power of two
+#define AUDIO_MSGS_PER_CYCLE  256   // processed in one audio cycle at most
+
+//---------------------------------------------------------
+//   AudioMsgFifo
+//    multiple producer / single consumer, lock free
+//    Every slot has a sequence number. A writer claims the
+//    slot of the write count with a compare and swap, fills
+//    it and publishes it by setting the sequence to count
+//    + 1. The reader frees it by setting count + size.
+//---------------------------------------------------------
+
+class AudioMsgFifo
+{
+    struct Slot
+    {
+        volatile unsigned seq;
+        AudioMsg* msg;
+    };
+    Slot fifo[AUDIO_MSG_FIFO_SIZE];
+    char _pad0[OOM_CACHE_LINE];
+    volatile unsigned wcount; // shared by the writers
+    char _pad1[OOM_CACHE_LINE];
+    unsigned rcount; // only touched by reader
+    char _pad2[OOM_CACHE_LINE];
+
+public:
+    AudioMsgFifo();
+    bool put(AudioMsg*); // returns true on fifo overflow
+    AudioMsg* get(); // returns 0 if empty
+};
+
 //---------------------------------------------------------
 //  Struct for controll preload processing
 //---------------------------------------------------------
@@ -166,8 +213,11 @@ private:
 
     State state;
 
-    AudioMsg* msg;
-    int fromThreadFdw, fromThreadFdr; // message pipe
+    AudioMsgFifo msgFifo;
+    // messages of the batch being collected
+    int _batchDepth;
+    pthread_t _batchThread;
+    QList<AudioMsg*> _batch;
 
     int sigFd; // pipe fd for messages to gui
 
@@ -187,8 +237,12 @@ private:
 
     void panic();
     void processMsg(AudioMsg* msg);
+    void sendTempoMessage(AudioMsg* msg, bool doUndo);
     void process1(unsigned samplePos, unsigned offset, unsigned samples);
 
+    template <class E>
+    void collectEvent(MidiTrack*, const E&, unsigned offset, int defaultPort, int& channel,
+            MPEventList* playEvents, MPEventList* stuckNotes, TempoCursor&);
     void collectEvents(MidiTrack*, unsigned int startTick, unsigned int endTick);
 
 public:
@@ -201,7 +255,6 @@ public:
     void process(unsigned frames);
     bool sync(int state, unsigned frame);
     void shutdown();
-    void writeTick();
 
     // transport:
     bool start();
@@ -228,6 +281,12 @@ public:
         return _running;
     }
 
+    // messages of this thread are collected for a batch
+    bool inBatch() const
+    {
+        return _batchDepth && pthread_equal(_batchThread, pthread_self());
+    }
+
     //-----------------------------------------
     //   message interface
     //-----------------------------------------
@@ -256,6 +315,9 @@ public:
     void msgSetTempo(int tick, int tempo, bool doUndoFlag = true);
     void msgUpdateSoloStates();
     void msgSetAux(AudioTrack*, qint64, double);
+    void msgSetAuxPrefader(AudioTrack*, qint64, bool);
+    void msgSwapAuxSends(AuxSendSwapList*);
+    void msgSwapEventStores(EventStoreSwapList*);
     void msgSetGlobalTempo(int val);
     void msgDeleteTempo(int tick, int tempo, bool doUndoFlag = true);
     void msgDeleteTempoRange(QList<void*> tempo, bool doUndoFlag = true);
@@ -266,6 +328,8 @@ public:
     void msgPanic();
     void sendMsg(AudioMsg*, bool waitRead = true);
     bool sendMessage(AudioMsg* m, bool doUndo, bool waitRead = true);
+    void startBatch();
+    void endBatch();
     void msgRemoveRoute(Route, Route);
     void msgRemoveRoute1(Route, Route);
     void msgRemoveRoutes(Route, Route); // p3.3.55
@@ -274,6 +338,10 @@ public:
     void msgAddRoute1(Route, Route);
     void msgAddPlugin(AudioTrack*, int idx, BasePlugin* plugin);
     void msgIdlePlugin(AudioTrack*, BasePlugin* plugin);
+    void msgEnablePlugin(BasePlugin* plugin, bool);
+    void msgSetGraph(GraphSchedule*);
+    void msgSetPartSchedule(WaveTrack*, PartSchedule*);
+    void msgSwapLatencyDelay(AudioTrack*, LatencyDelay**);
     void msgSetMute(AudioTrack*, bool val);
     void msgSetVolume(AudioTrack*, double val);
     void msgSetPan(AudioTrack*, double val);
@@ -284,8 +352,8 @@ public:
     void msgSetChannels(AudioTrack*, int);
     void msgSetOff(AudioTrack*, bool);
     void msgSetRecord(AudioTrack*, bool);
-    void msgUndo();
-    void msgRedo();
+    void msgUndo(AuxSendSwapList* sends = 0, TempoIndex** tempo = 0);
+    void msgRedo(AuxSendSwapList* sends = 0, TempoIndex** tempo = 0);
     void msgLocalOff();
     void msgInitMidiDevices();
     void msgResetMidiDevices();
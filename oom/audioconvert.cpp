@@ -449,7 +449,7 @@ off_t SRCAudioConverter::process(SndFileR& f, float** buffer, int channel, int n
 				// This can occasionally be radically different from the requested frames, or zero,
 				//  even when ample excess input frames are supplied.
 				// Move the src output pointer to a new position.
-				srcdata.data_out += srcdata.output_frames_gen * channel;
+				srcdata.data_out += srcdata.output_frames_gen * fchan;
 				// Set new number of maximum out frames.
 				outFrames -= srcdata.output_frames_gen;
 				// Calculate the new number of file input frames required.
@@ -484,8 +484,8 @@ off_t SRCAudioConverter::process(SndFileR& f, float** buffer, int channel, int n
 #endif
 
 		// Let's zero the rest of it.
-		long b = totalOutFrames * channel;
-		long e = n * channel;
+		long b = totalOutFrames * fchan;
+		long e = n * fchan;
 		for (long i = b; i < e; ++i)
 			outbuffer[i] = 0.0f;
 		//buffer[i] = 0.0f;
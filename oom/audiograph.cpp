@@ -0,0 +1,354 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <map>
+
+#include "audiograph.h"
+#include "audio.h"
+#include "globals.h"
+#include "lockfree.h"
+#include "song.h"
+#include "track.h"
+#include "route.h"
+
+// Uncomment to print the schedule whenever it is rebuilt.
+//#define AUDIOGRAPH_DEBUG
+
+// More threads than this do not pay off, the levels of
+// a typical song are not wide enough.
+static const int MAX_GRAPH_WORKERS = 16;
+
+AudioGraph* audioGraph;
+
+//---------------------------------------------------------
+//   graphWorker
+//---------------------------------------------------------
+
+static void* graphWorker(void* p)
+{
+	((AudioGraph*) p)->workerLoop();
+	return 0;
+}
+
+//---------------------------------------------------------
+//   AudioGraph
+//---------------------------------------------------------
+
+AudioGraph::AudioGraph()
+{
+	_schedule = 0;
+	_serial = 1;
+	_builtSerial = 0;
+	_nworkers = 0;
+	_threads = 0;
+	_running = false;
+	_nodes = 0;
+	_next = 0;
+	_levelEnd = 0;
+	_pos = 0;
+	_nframes = 0;
+	sem_init(&_wakeup, 0, 0);
+	sem_init(&_done, 0, 0);
+}
+
+AudioGraph::~AudioGraph()
+{
+	stop();
+	delete _schedule;
+	sem_destroy(&_wakeup);
+	sem_destroy(&_done);
+}
+
+//---------------------------------------------------------
+//   start
+//    start one worker per additional cpu core
+//---------------------------------------------------------
+
+void AudioGraph::start(int priority)
+{
+	if (_running)
+		return;
+
+	long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+	_nworkers = ncpu > 1 ? ncpu - 1 : 0;
+	if (_nworkers > MAX_GRAPH_WORKERS)
+		_nworkers = MAX_GRAPH_WORKERS;
+
+	_threads = new pthread_t[_nworkers];
+	_running = true;
+
+	pthread_attr_t* attributes = 0;
+	if (priority)
+	{
+		attributes = (pthread_attr_t*) malloc(sizeof (pthread_attr_t));
+		pthread_attr_init(attributes);
+
+		if (pthread_attr_setschedpolicy(attributes, SCHED_FIFO))
+			printf("AudioGraph: cannot set FIFO scheduling class for worker\n");
+		if (pthread_attr_setinheritsched(attributes, PTHREAD_EXPLICIT_SCHED))
+			printf("AudioGraph: cannot set setinheritsched for worker\n");
+
+		struct sched_param rt_param;
+		memset(&rt_param, 0, sizeof (rt_param));
+		rt_param.sched_priority = priority;
+		if (pthread_attr_setschedparam(attributes, &rt_param))
+			printf("AudioGraph: cannot set scheduling priority %d for worker\n", priority);
+	}
+
+	int started = 0;
+	for (int i = 0; i < _nworkers; ++i)
+	{
+		int rv = pthread_create(&_threads[i], attributes, graphWorker, this);
+		if (rv)
+		{
+			fprintf(stderr, "AudioGraph: creating worker thread failed: %s\n", strerror(rv));
+			break;
+		}
+		++started;
+	}
+	_nworkers = started;
+
+	if (attributes)
+	{
+		pthread_attr_destroy(attributes);
+		free(attributes);
+	}
+
+	if (debugMsg)
+		printf("AudioGraph: started %d worker threads\n", _nworkers);
+}
+
+//---------------------------------------------------------
+//   stop
+//---------------------------------------------------------
+
+void AudioGraph::stop()
+{
+	if (!_running)
+		return;
+	_running = false;
+	for (int i = 0; i < _nworkers; ++i)
+		sem_post(&_wakeup);
+	for (int i = 0; i < _nworkers; ++i)
+		pthread_join(_threads[i], 0);
+	delete[] _threads;
+	_threads = 0;
+	_nworkers = 0;
+}
+
+//---------------------------------------------------------
+//   workerLoop
+//---------------------------------------------------------
+
+void AudioGraph::workerLoop()
+{
+	for (;;)
+	{
+		while (sem_wait(&_wakeup) != 0)
+			;
+		if (!_running)
+			break;
+		while (processNext())
+			;
+		sem_post(&_done);
+	}
+}
+
+//---------------------------------------------------------
+//   processNext
+//    grab the next unprocessed node of the current level
+//    return false if the level is exhausted
+//---------------------------------------------------------
+
+bool AudioGraph::processNext()
+{
+	int idx = __sync_fetch_and_add(&_next, 1);
+	if (idx >= _levelEnd)
+		return false;
+	_nodes[idx]->prepareData(_pos, _nframes);
+	return true;
+}
+
+//---------------------------------------------------------
+//   build
+//    compute the level of every audio track from its
+//    input routes and aux sends
+//    called from the gui thread, the routing does not
+//    change while it runs
+//    returns 0 if the song has to use the serial path
+//---------------------------------------------------------
+
+GraphSchedule* AudioGraph::build(unsigned serial)
+{
+	std::vector<AudioTrack*> tracks;
+	std::map<Track*, int> level;
+	TrackList* tl = song->tracks();
+	for (ciTrack it = tl->begin(); it != tl->end(); ++it)
+	{
+		Track* t = *it;
+		if (t->isMidiTrack() || t->type() == Track::AUDIO_OUTPUT)
+			continue;
+		// A track fed by an audio output would pull the whole output
+		// chain from inside a worker. Leave such songs to the serial path.
+		const RouteList* rl = t->inRoutes();
+		for (ciRoute ir = rl->begin(); ir != rl->end(); ++ir)
+		{
+			if (ir->type == Route::TRACK_ROUTE && ir->track && ir->track->type() == Track::AUDIO_OUTPUT)
+			{
+				if (debugMsg)
+					printf("AudioGraph: %s is fed by an output, using serial processing\n",
+							t->name().toLatin1().constData());
+				return 0;
+			}
+		}
+		tracks.push_back((AudioTrack*) t);
+		level[t] = 0;
+	}
+
+	// A track sits one level above the highest track feeding it, either
+	// through a route or through an aux send. An acyclic graph settles
+	// after at most tracks.size() passes.
+	unsigned pass = 0;
+	bool changed = true;
+	while (changed)
+	{
+		if (++pass > tracks.size() + 1)
+		{
+			printf("AudioGraph: routing cycle detected, using serial processing\n");
+			return 0;
+		}
+		changed = false;
+		for (unsigned i = 0; i < tracks.size(); ++i)
+		{
+			AudioTrack* t = tracks[i];
+			int l = 0;
+			const RouteList* rl = t->inRoutes();
+			for (ciRoute ir = rl->begin(); ir != rl->end(); ++ir)
+			{
+				if (ir->type != Route::TRACK_ROUTE || !ir->track || ir->track->isMidiTrack())
+					continue;
+				std::map<Track*, int>::iterator il = level.find(ir->track);
+				if (il != level.end() && il->second >= l)
+					l = il->second + 1;
+			}
+			if (t->type() == Track::AUDIO_AUX)
+			{
+				for (unsigned k = 0; k < tracks.size(); ++k)
+				{
+					AudioTrack* s = tracks[k];
+					if (s->hasAuxSend() && s->auxSends()->contains(t->id()) && level[s] >= l)
+						l = level[s] + 1;
+				}
+			}
+			if (l != level[t])
+			{
+				level[t] = l;
+				changed = true;
+			}
+		}
+	}
+
+	GraphSchedule* s = new GraphSchedule;
+	s->serial = serial;
+	int maxLevel = -1;
+	for (unsigned i = 0; i < tracks.size(); ++i)
+	{
+		if (level[tracks[i]] > maxLevel)
+			maxLevel = level[tracks[i]];
+	}
+	for (int l = 0; l <= maxLevel; ++l)
+	{
+		s->levels.push_back(s->nodes.size());
+		for (unsigned i = 0; i < tracks.size(); ++i)
+		{
+			if (level[tracks[i]] == l)
+				s->nodes.push_back(tracks[i]);
+		}
+	}
+	s->levels.push_back(s->nodes.size());
+
+#ifdef AUDIOGRAPH_DEBUG
+	for (unsigned l = 0; l + 1 < s->levels.size(); ++l)
+	{
+		printf("AudioGraph: level %d:", l);
+		for (int i = s->levels[l]; i < s->levels[l + 1]; ++i)
+			printf(" %s", s->nodes[i]->name().toLatin1().constData());
+		printf("\n");
+	}
+#endif
+	return s;
+}
+
+//---------------------------------------------------------
+//   update
+//    gui thread, called by Song::beat(). Rebuild the
+//    schedule if the routing changed since the last one.
+//    The old schedule is deleted once the message which
+//    replaced it is done.
+//---------------------------------------------------------
+
+void AudioGraph::update()
+{
+	if (!song->parallelAudio())
+		return;
+	unsigned serial = oom_load_acquire(&_serial);
+	if (serial == _builtSerial)
+		return;
+	_builtSerial = serial;
+	GraphSchedule* old = _schedule;
+	GraphSchedule* s = build(serial);
+	if (s == 0 && old == 0)
+		return;
+	audio->msgSetGraph(s);
+	delete old;
+}
+
+//---------------------------------------------------------
+//   process
+//    run all levels, the audio thread works on every level
+//    together with the workers
+//    return false if the caller has to use the serial path,
+//    also while the schedule is older than the routing
+//---------------------------------------------------------
+
+bool AudioGraph::process(unsigned pos, unsigned nframes)
+{
+	GraphSchedule* s = _schedule;
+	if (!_running || s == 0 || s->serial != oom_load_acquire(&_serial))
+		return false;
+
+	_nodes = s->nodes.empty() ? 0 : &s->nodes[0];
+	_pos = pos;
+	_nframes = nframes;
+	for (unsigned l = 0; l + 1 < s->levels.size(); ++l)
+	{
+		int begin = s->levels[l];
+		int end = s->levels[l + 1];
+		_levelEnd = end;
+		_next = begin;
+
+		int helpers = end - begin - 1;
+		if (helpers > _nworkers)
+			helpers = _nworkers;
+		for (int i = 0; i < helpers; ++i)
+			sem_post(&_wakeup);
+
+		while (processNext())
+			;
+
+		for (int i = 0; i < helpers; ++i)
+		{
+			while (sem_wait(&_done) != 0)
+				;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,107 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#ifndef __AUDIOGRAPH_H__
+#define __AUDIOGRAPH_H__
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <vector>
+
+class AudioTrack;
+
+//---------------------------------------------------------
+//   GraphSchedule
+//    the levels of one routing, built by the gui
+//---------------------------------------------------------
+
+struct GraphSchedule
+{
+    unsigned serial; // of the routing it was built for
+    std::vector<AudioTrack*> nodes; // all scheduled tracks, sorted by level
+    std::vector<int> levels; // index of the first node of each level
+};
+
+//---------------------------------------------------------
+//   AudioGraph
+//    Runs the per cycle processing of all audio tracks
+//    (plugin chain, aux sends, metering) on a pool of
+//    realtime worker threads.
+//
+//    The tracks are sorted into levels by their routes:
+//    a track only depends on tracks of lower levels, so
+//    all tracks of one level can be processed in parallel.
+//    Audio outputs are not part of the plan. They are
+//    summed by the audio thread in Audio::process1 after
+//    all levels are done, using the data cached by
+//    AudioTrack::prepareData().
+//
+//    The gui builds the schedule in update() and publishes
+//    it with Audio::msgSetGraph(). invalidate() only bumps
+//    a serial, the audio thread takes the serial path until
+//    a schedule for the current serial is in place.
+//---------------------------------------------------------
+
+class AudioGraph
+{
+    GraphSchedule* _schedule; // swapped by the audio thread only
+    volatile unsigned _serial; // bumped whenever the routing changes
+    unsigned _builtSerial; // gui, serial of the last update()
+
+    int _nworkers;
+    pthread_t* _threads;
+    volatile bool _running;
+    sem_t _wakeup;
+    sem_t _done;
+
+    // current job, written by the audio thread before waking the workers
+    AudioTrack* const* _nodes;
+    volatile int _next;
+    int _levelEnd;
+    unsigned _pos;
+    unsigned _nframes;
+
+    GraphSchedule* build(unsigned serial);
+    bool processNext();
+
+public:
+    AudioGraph();
+    ~AudioGraph();
+
+    void start(int priority);
+    void stop();
+    void workerLoop();
+
+    bool isRunning() const
+    {
+        return _running;
+    }
+
+    int workers() const
+    {
+        return _nworkers;
+    }
+
+    //  called whenever tracks, routes or aux sends change,
+    //  from any thread
+    void invalidate()
+    {
+        __sync_add_and_fetch(&_serial, 1);
+    }
+
+    void update();
+    void setSchedule(GraphSchedule* s)
+    {
+        _schedule = s;
+    }
+    bool process(unsigned pos, unsigned nframes);
+};
+
+extern AudioGraph* audioGraph;
+
+#endif
+
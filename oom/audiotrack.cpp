@@ -25,6 +25,9 @@
 #include "mididev.h"
 #include "midiport.h"
 #include "midimonitor.h"
+#include "audiograph.h"
+#include "diskwriter.h"
+#include "lockfree.h"
 
 
 //---------------------------------------------------------
@@ -35,13 +38,19 @@ AudioTrack::AudioTrack(TrackType t)
 : Track(t)
 {
 	_processed = false;
+	_metered = false;
 	_haveData = false;
 	_sendMetronome = false;
 	_prefader = false;
 	_efxPipe = new Pipeline();
 	_recFile = 0;
+	_recBatch = 0;
+	_recordOverruns = 0;
 	_channels = 0;
 	_automationType = AUTO_OFF;
+	_auxTable = 0;
+	_latencyDelay = 0;
+	_latency = 0;
 	setChannels(2);
 	addController(new CtrlList(AC_VOLUME,"Volume", 0.001, 3.16 /* roughly 10 db */));
 	addController(new CtrlList(AC_PAN, "Pan", -1.0, 1.0));
@@ -65,11 +74,15 @@ AudioTrack::AudioTrack(const AudioTrack& t, bool cloneParts)
 {
 	_totalOutChannels = t._totalOutChannels; // Is either MAX_CHANNELS, or custom value (used by syntis).
 	_processed = false;
+	_metered = false;
 	_haveData = false;
 	_sendMetronome = t._sendMetronome;
 	_controller = t._controller;
 	_prefader = t._prefader;
 	_auxSend = t._auxSend;
+	_auxTable = 0; // made by Song::prepareAuxSends() when the track is inserted
+	_latencyDelay = 0;
+	_latency = 0;
 	_efxPipe = new Pipeline(*(t._efxPipe));
 	_automationType = t._automationType;
 	//FIXME:Update this to create new input/output tracks and connect them to the same routes
@@ -86,6 +99,8 @@ AudioTrack::AudioTrack(const AudioTrack& t, bool cloneParts)
 
 	bufferPos = MAXINT;
 	_recFile = t._recFile;
+	_recBatch = 0;
+	_recordOverruns = 0;
 }
 
 AudioTrack::~AudioTrack()
@@ -101,7 +116,9 @@ AudioTrack::~AudioTrack()
 			free(outBuffers[i]);
 	}
 	delete[] outBuffers;
-
+	delete _recBatch;
+	delete _auxTable;
+	delete _latencyDelay;
 }
 
 //---------------------------------------------------------
@@ -210,19 +227,114 @@ void AudioTrack::addPlugin(BasePlugin* plugin, int idx)/*{{{*/
 
 //---------------------------------------------------------
 //   addAuxSend
+//    add a send of gain 0 for each aux of the song the track
+//    has none for. The audio thread gets them with the next
+//    table swap, which inserting the track or
+//    Song::updateAuxSends() does.
 //---------------------------------------------------------
 
 void AudioTrack::addAuxSend()
 {
-	for(ciTrack it = song->auxs()->begin(); it != song->auxs()->end(); ++it)
+	if (audioGraph)
+		audioGraph->invalidate();
+	if (song == 0)
+		return;
+	AuxList* auxs = song->auxs();
+	for (ciAudioAux it = auxs->begin(); it != auxs->end(); ++it)
+	{
+		if (!_auxSend.contains((*it)->id()))
+			_auxSend[(*it)->id()] = AuxInfo(true, 0.0);
+	}
+}
+
+//---------------------------------------------------------
+//   auxSendTable
+//    build the table processAuxSends() mixes from for the
+//    auxes of auxs, a send of gain 0 is added for an aux
+//    the track has none for. Sends to other auxes are left
+//    out. Gui thread, the table is published by the audio
+//    thread (see Song::swapAuxSends()).
+//---------------------------------------------------------
+
+AuxSendTable* AudioTrack::auxSendTable(const AuxList& auxs)
+{
+	for (ciAudioAux it = auxs.begin(); it != auxs.end(); ++it)
 	{
-		if(_auxSend.isEmpty() || !_auxSend.contains((*it)->id()))
+		if (!_auxSend.contains((*it)->id()))
+			_auxSend[(*it)->id()] = AuxInfo(true, 0.0);
+	}
+	AuxSendTable* t = new AuxSendTable();
+	t->reserve(_auxSend.size());
+	for (QHash<qint64, AuxInfo>::const_iterator i = _auxSend.constBegin(); i != _auxSend.constEnd(); ++i)
+	{
+		AudioAux* aux = 0;
+		for (ciAudioAux it = auxs.begin(); it != auxs.end(); ++it)
 		{
-			//qDebug("Adding Aux send %s with ID: %lld", (*it)->name().toUtf8().constData(), (*it)->id());
-			AuxInfo info(true, 0.0);
-			_auxSend[(*it)->id()] = info;
+			if ((*it)->id() == i.key())
+			{
+				aux = *it;
+				break;
+			}
 		}
+		if (aux == 0)
+			continue;
+		AuxSendEntry e;
+		e.id = i.key();
+		e.aux = aux;
+		e.gain = i.value().second;
+		e.prefader = i.value().first;
+		t->push_back(e);
 	}
+	return t;
+}
+
+//---------------------------------------------------------
+//   swapAuxSendTable
+//    audio thread, while it executes a message. Returns the
+//    old table, the gui deletes it when the message is done.
+//---------------------------------------------------------
+
+AuxSendTable* AudioTrack::swapAuxSendTable(AuxSendTable* t)
+{
+	AuxSendTable* old = _auxTable;
+	oom_store_release(&_auxTable, t);
+	return old;
+}
+
+//---------------------------------------------------------
+//   setLatencyCompensation
+//    latency is the one of the track output including the
+//    delay, the output and the aux sends are delayed by
+//    mainDelay and sendDelay. The delay line is replaced
+//    when a length or the output channels change. Gui
+//    thread, the audio thread swaps the line in and the
+//    old one is deleted when the message is done.
+//---------------------------------------------------------
+
+void AudioTrack::setLatencyCompensation(unsigned latency, unsigned mainDelay, unsigned sendDelay)
+{
+	_latency = latency;
+	int chans = channels() == 1 ? 1 : totalOutChannels();
+	LatencyDelay* d = _latencyDelay;
+	if (d ? (d->mainFrames() == mainDelay && d->sendFrames() == sendDelay && d->channels() == chans)
+			: (mainDelay == 0 && sendDelay == 0))
+		return;
+	d = (mainDelay || sendDelay) ? new LatencyDelay(chans, mainDelay, sendDelay) : 0;
+	audio->msgSwapLatencyDelay(this, &d);
+	delete d;
+}
+
+//---------------------------------------------------------
+//   swapLatencyDelay
+//    audio thread, while it executes a message. *d is
+//    replaced by the old delay line.
+//---------------------------------------------------------
+
+void AudioTrack::swapLatencyDelay(LatencyDelay** d)
+{
+	LatencyDelay* old = _latencyDelay;
+	oom_store_release(&_latencyDelay, *d);
+	*d = old;
 }
 
 //---------------------------------------------------------
@@ -680,6 +792,53 @@ double AudioTrack::pan() const
 		return cl->second->curVal();
 }
 
+//---------------------------------------------------------
+//   volumeGain
+//    per frame gain of both output channels for the current
+//    cycle, rendered from the volume and pan automation so
+//    points take effect at their frame and moves ramp
+//    through the cycle instead of stepping once per period.
+//    Returns false if neither is automated, the caller uses
+//    the constant gain of volume() and pan() then.
+//    Audio thread, the cycle starts at audio->pos(), the
+//    gui position of song->cPos() lags behind it.
+//---------------------------------------------------------
+
+bool AudioTrack::volumeGain(unsigned nframes, float* gain0, float* gain1)
+{
+	bool volAuto = volFromAutomation();
+	bool panAuto = panFromAutomation();
+	if (!volAuto && !panAuto)
+		return false;
+
+	unsigned frame = audio->pos().frame();
+	if (volAuto)
+		_controller.find(AC_VOLUME)->second->render(frame, nframes, gain0);
+	else
+	{
+		float v = volume();
+		for (unsigned i = 0; i < nframes; ++i)
+			gain0[i] = v;
+	}
+	if (panAuto)
+		_controller.find(AC_PAN)->second->render(frame, nframes, gain1);
+	else
+	{
+		float p = pan();
+		for (unsigned i = 0; i < nframes; ++i)
+			gain1[i] = p;
+	}
+
+	for (unsigned i = 0; i < nframes; ++i)
+	{
+		float v = gain0[i];
+		float p = gain1[i];
+		gain0[i] = v * (1.0 - p);
+		gain1[i] = v * (1.0 + p);
+	}
+	return true;
+}
+
 //---------------------------------------------------------
 //   setPan
 //---------------------------------------------------------
@@ -716,6 +875,36 @@ double AudioTrack::pluginCtrlVal(int ctlID) const
 		return cl->second->curVal();
 }
 
+double AudioTrack::pluginCtrlVal(int ctlID, unsigned frame) const
+{
+	ciCtrlList cl = _controller.find(ctlID);
+	if (cl == _controller.end())
+		return 0.0;
+
+	if (automation && (automationType() != AUTO_OFF))
+		return cl->second->value(frame);
+	else
+		return cl->second->curVal();
+}
+
+//---------------------------------------------------------
+//   nextCtrlFrame
+//    frame of the next automation point of ctlID after
+//    frame, limit if there is none before it
+//---------------------------------------------------------
+
+unsigned AudioTrack::nextCtrlFrame(int ctlID, unsigned frame, unsigned limit) const
+{
+	ciCtrlList cl = _controller.find(ctlID);
+	if (cl == _controller.end() || !automation || automationType() == AUTO_OFF)
+		return limit;
+
+	int next = cl->second->nextFrame(frame);
+	if (next == -1 || (unsigned) next > limit)
+		return limit;
+	return next;
+}
+
 //---------------------------------------------------------
 //   setPluginCtrlVal
 //---------------------------------------------------------
@@ -1371,6 +1560,7 @@ void AudioAux::write(int level, Xml& xml) const
 AudioAux::AudioAux()
 : AudioTrack(AUDIO_AUX)
 {
+	sem_init(&_sendLock, 0, 1);
 	for (int i = 0; i < MAX_CHANNELS; ++i)
 	{
 		if (i < channels())
@@ -1380,8 +1570,16 @@ AudioAux::AudioAux()
 	}
 }
 
+AudioAux::AudioAux(const AudioAux& a)
+: AudioTrack(a)
+{
+	sem_init(&_sendLock, 0, 1);
+	for (int i = 0; i < MAX_CHANNELS; ++i)
+		buffer[i] = a.buffer[i];
+}
+
 //---------------------------------------------------------
-//   AudioAux
+//   ~AudioAux
 //---------------------------------------------------------
 
 AudioAux::~AudioAux()
@@ -1393,6 +1591,7 @@ AudioAux::~AudioAux()
 			free(buffer[i]);
 	}*/
 //	delete[] buffer;
+	sem_destroy(&_sendLock);
 }
 
 //---------------------------------------------------------
@@ -1550,6 +1749,10 @@ bool AudioTrack::prepareRecording()/*{{{*/
 		return false;
 
 	}
+	_recordOverruns = 0;
+	if (!_recBatch)
+		_recBatch = new RecordBatch();
+	diskWriter->prepare(_recBatch, _recFile);
 	return true;
 }/*}}}*/
 
@@ -1563,6 +1766,12 @@ double AudioTrack::auxSend(qint64 idx) const
 	return _auxSend[idx].second;
 }
 
+//---------------------------------------------------------
+//   setAuxSend
+//    gui thread, the audio thread mixes with the new gain
+//    once Audio::msgSetAux() swapped in a new table
+//---------------------------------------------------------
+
 void AudioTrack::setAuxSend(qint64 idx, double v, bool monitor)/*{{{*/
 {
 	if (_auxSend.isEmpty() || !_auxSend.contains(idx))
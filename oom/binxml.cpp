@@ -0,0 +1,998 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QList>
+#include <QLocale>
+#include <QPair>
+#include <QStringList>
+
+#include "binxml.h"
+#include "filedialog.h"
+#include "globals.h"
+#include "utils.h"
+#include "xml.h"
+
+//---------------------------------------------------------
+//   BinXml
+//---------------------------------------------------------
+
+BinXml::BinXml()
+{
+	_fd = -1;
+	_map = 0;
+	_size = 0;
+	_records = 0;
+	_sourceSize = 0;
+}
+
+BinXml::~BinXml()
+{
+	if (_map)
+		munmap(_map, _size);
+	if (_fd != -1)
+		::close(_fd);
+}
+
+//---------------------------------------------------------
+//   open
+//    map the snapshot and read its name table
+//    returns true on error
+//---------------------------------------------------------
+
+bool BinXml::open(const QString& path)
+{
+	_fd = ::open(path.toLatin1().constData(), O_RDONLY);
+	if (_fd == -1)
+		return true;
+	struct stat st;
+	if (fstat(_fd, &st) || st.st_size < BINXML_HEADER)
+		return true;
+	_size = st.st_size;
+	void* p = mmap(0, _size, PROT_READ, MAP_PRIVATE, _fd, 0);
+	if (p == MAP_FAILED)
+	{
+		printf("BinXml: cannot map %s: %s\n", path.toLatin1().constData(), strerror(errno));
+		return true;
+	}
+	_map = p;
+	// the whole file is read front to back
+	madvise(_map, _size, MADV_SEQUENTIAL);
+	madvise(_map, _size, MADV_WILLNEED);
+
+	const char* data = (const char*) _map;
+	unsigned head[4];
+	memcpy(head, data, sizeof (head));
+	if (head[0] != BINXML_MAGIC || head[1] != BINXML_VERSION)
+	{
+		if (debugMsg)
+			printf("BinXml: %s is not a version %d snapshot, ignored\n", path.toLatin1().constData(), BINXML_VERSION);
+		return true;
+	}
+	memcpy(&_sourceSize, data + 16, 8);
+	_sourceHash = QByteArray(data + 24, BINXML_HASH_SIZE);
+
+	const char* end = data + _size;
+	const char* np = data + BINXML_HEADER;
+	_names.reserve(head[2]);
+	for (unsigned i = 0; i < head[2]; ++i)
+	{
+		unsigned short n;
+		if (end - np < 2)
+			break;
+		memcpy(&n, np, 2);
+		np += 2;
+		if (end - np < n)
+			break;
+		_names.append(QString::fromLatin1(np, n));
+		np += n;
+	}
+	if ((unsigned) _names.size() != head[2])
+	{
+		printf("BinXml: %s is broken\n", path.toLatin1().constData());
+		return true;
+	}
+	_records = np;
+	return false;
+}
+
+//---------------------------------------------------------
+//   fileHash
+//    the md5 of the contents of path
+//    returns true on error
+//---------------------------------------------------------
+
+static bool fileHash(const QString& path, QByteArray* hash)
+{
+	QFile f(path);
+	if (!f.open(QIODevice::ReadOnly))
+		return true;
+	QCryptographicHash md5(QCryptographicHash::Md5);
+	char buffer[65536];
+	qint64 n;
+	while ((n = f.read(buffer, sizeof (buffer))) > 0)
+		md5.addData(buffer, n);
+	if (n < 0)
+		return true;
+	*hash = md5.result();
+	return false;
+}
+
+//---------------------------------------------------------
+//   isCurrent
+//    the snapshot was made from source as it is now. The
+//    contents are compared, a file saved twice within one
+//    second or copied with its time is told apart too.
+//---------------------------------------------------------
+
+bool BinXml::isCurrent(const QString& source) const
+{
+	QFileInfo fi(source);
+	if (!fi.exists() || fi.size() != _sourceSize)
+		return false;
+	QByteArray hash;
+	return !fileHash(source, &hash) && hash == _sourceHash;
+}
+
+//---------------------------------------------------------
+//   snapshotPath
+//    foo.oom, foo.oom.gz and foo.oom.bz2 have the
+//    snapshot foo.oomb
+//---------------------------------------------------------
+
+QString snapshotPath(const QString& project)
+{
+	QString s(project);
+	if (s.endsWith(".gz"))
+		s.chop(3);
+	else if (s.endsWith(".bz2"))
+		s.chop(4);
+	if (s.endsWith(".oom"))
+		s.chop(4);
+	return s + ".oomb";
+}
+
+//---------------------------------------------------------
+//   sourcePath
+//    the file fileOpen() reads for project
+//---------------------------------------------------------
+
+static QString sourcePath(const QString& project)
+{
+	if (QFileInfo(project).completeSuffix().isEmpty())
+		return project + ".oom";
+	return project;
+}
+
+//---------------------------------------------------------
+//   openSnapshot
+//    the snapshot of project if it is up to date, 0
+//    otherwise
+//---------------------------------------------------------
+
+BinXml* openSnapshot(const QString& project)
+{
+	BinXml* bin = new BinXml;
+	QString path = snapshotPath(project);
+	if (bin->open(path))
+	{
+		delete bin;
+		return 0;
+	}
+	if (!bin->isCurrent(sourcePath(project)))
+	{
+		if (debugMsg)
+			printf("BinXml: %s is older than the project, ignored\n", path.toLatin1().constData());
+		delete bin;
+		return 0;
+	}
+	return bin;
+}
+
+//---------------------------------------------------------
+//   CtrlPoint
+//---------------------------------------------------------
+
+struct CtrlPoint
+{
+	int frame;
+	double val;
+};
+
+//---------------------------------------------------------
+//   canonicalInt
+//    s is an int written by %d
+//---------------------------------------------------------
+
+static bool canonicalInt(const QString& s, int* v)
+{
+	bool ok;
+	*v = s.toInt(&ok);
+	return ok && QString::number(*v) == s;
+}
+
+//---------------------------------------------------------
+//   packCtrl
+//    split the text of a <controller> into its points,
+//    as CtrlList::read() does. Returns false if the text
+//    would not come back unchanged from the points, it is
+//    stored as text then.
+//---------------------------------------------------------
+
+static bool packCtrl(const QString& text, QVector<CtrlPoint>* points)
+{
+	QLocale loc = QLocale::c();
+	points->clear();
+	int len = text.length();
+	int i = 0;
+	for (;;)
+	{
+		while (i < len && (text[i] == ',' || text[i] == ' ' || text[i] == '\n'))
+			++i;
+		if (i == len)
+			break;
+		int k = i;
+		while (i < len && text[i] != ' ')
+			++i;
+		QString fs = text.mid(k, i - k);
+		while (i < len && (text[i] == ' ' || text[i] == '\n'))
+			++i;
+		k = i;
+		while (i < len && text[i] != ' ' && text[i] != ',')
+			++i;
+		QString vs = text.mid(k, i - k);
+
+		CtrlPoint p;
+		bool ok;
+		if (!canonicalInt(fs, &p.frame))
+			return false;
+		p.val = loc.toDouble(vs, &ok);
+		if (!ok || QString::number(p.val) != vs)
+			return false;
+		points->append(p);
+	}
+	return !points->isEmpty();
+}
+
+//---------------------------------------------------------
+//   packEvent
+//    an <event> with the attributes MidiEventBase::write()
+//    writes for an event without data. Returns false if
+//    it is stored as it is.
+//---------------------------------------------------------
+
+static bool packEvent(const QList<QPair<QString, QString> >& attrs, XmlEvent* e)
+{
+	if (attrs.size() < 2 || attrs[0].first != "tick" || !canonicalInt(attrs[0].second, &e->tick))
+		return false;
+	if (attrs[1].first == "len")
+	{
+		e->type = -1;
+		if (!canonicalInt(attrs[1].second, &e->len))
+			return false;
+	}
+	else if (attrs[1].first == "type")
+	{
+		e->len = 0;
+		// Note up to Meta, a Wave type would change the event
+		if (!canonicalInt(attrs[1].second, &e->type) || e->type < 0 || e->type > 5)
+			return false;
+	}
+	else
+		return false;
+
+	e->a = 0;
+	e->b = 0;
+	e->c = 0;
+	static const char* const abc[3] = { "a", "b", "c" };
+	int* vals[3] = { &e->a, &e->b, &e->c };
+	int k = 0;
+	for (int i = 2; i < attrs.size(); ++i)
+	{
+		while (k < 3 && attrs[i].first != abc[k])
+			++k;
+		// zero values are not written
+		if (k == 3 || !canonicalInt(attrs[i].second, vals[k]) || *vals[k] == 0)
+			return false;
+		++k;
+	}
+	return true;
+}
+
+//---------------------------------------------------------
+//   BinXmlWriter
+//    collects the records and the name table of a
+//    snapshot
+//---------------------------------------------------------
+
+class BinXmlWriter
+{
+	QByteArray _data;
+	QHash<QString, unsigned> _ids;
+	QList<QString> _names;
+	QStringList _tags; // the open elements
+	QVector<int> _lengths; // offsets of their section lengths
+	QVector<int> _children;
+
+	void put8(int v)
+	{
+		_data.append(char(v));
+	}
+
+	void put32(unsigned v)
+	{
+		_data.append((const char*) &v, 4);
+	}
+
+	void putString(const QString& s)
+	{
+		QByteArray ba = s.toLatin1();
+		put32(ba.size());
+		_data.append(ba);
+	}
+
+	unsigned id(const QString& name)
+	{
+		QHash<QString, unsigned>::const_iterator i = _ids.constFind(name);
+		if (i != _ids.constEnd())
+			return i.value();
+		unsigned n = _names.size();
+		_ids.insert(name, n);
+		_names.append(name);
+		return n;
+	}
+
+	void child()
+	{
+		if (!_children.isEmpty())
+			++_children.last();
+	}
+
+public:
+	int depth() const
+	{
+		return _tags.size();
+	}
+
+	// the element the next record belongs to
+	QString parent() const
+	{
+		return _tags.isEmpty() ? QString() : _tags.last();
+	}
+
+	int children() const
+	{
+		return _children.isEmpty() ? 0 : _children.last();
+	}
+
+	void tagStart(const QString& name)
+	{
+		child();
+		put8(BX_TAG_START);
+		put32(id(name));
+		_lengths.append(_data.size());
+		put32(0);
+		_tags.append(name);
+		_children.append(0);
+	}
+
+	// returns true if name is not the open element
+	bool tagEnd(const QString& name)
+	{
+		if (_tags.isEmpty() || _tags.last() != name)
+			return true;
+		put8(BX_TAG_END);
+		put32(id(name));
+		int at = _lengths.last();
+		unsigned len = _data.size() - (at + 4);
+		memcpy(_data.data() + at, &len, 4);
+		_tags.removeLast();
+		_lengths.resize(_lengths.size() - 1);
+		_children.resize(_children.size() - 1);
+		return false;
+	}
+
+	void flag(const QString& name)
+	{
+		child();
+		put8(BX_FLAG);
+		put32(id(name));
+	}
+
+	void proc(const QString& s)
+	{
+		put8(BX_PROC);
+		putString(s);
+	}
+
+	void text(const QString& s)
+	{
+		put8(BX_TEXT);
+		putString(s);
+	}
+
+	void attribut(const QString& name, const QString& val)
+	{
+		put8(BX_ATTRIBUT);
+		put32(id(name));
+		putString(val);
+	}
+
+	void ctrl(const QVector<CtrlPoint>& points)
+	{
+		put8(BX_CTRL);
+		put32(points.size());
+		for (int i = 0; i < points.size(); ++i)
+		{
+			_data.append((const char*) &points[i].frame, 4);
+			_data.append((const char*) &points[i].val, 8);
+		}
+	}
+
+	void events(const QVector<XmlEvent>& run)
+	{
+		if (run.isEmpty())
+			return;
+		child();
+		put8(BX_EVENTS);
+		put32(run.size());
+		for (int i = 0; i < run.size(); ++i)
+		{
+			const XmlEvent& e = run[i];
+			int v[6] = { e.tick, e.type, e.len, e.a, e.b, e.c };
+			_data.append((const char*) v, sizeof (v));
+		}
+	}
+
+	bool write(const QString& path, qint64 sourceSize, const QByteArray& sourceHash);
+};
+
+//---------------------------------------------------------
+//   write
+//    the snapshot is written to a temporary file which
+//    replaces path when it is complete
+//    returns true on error
+//---------------------------------------------------------
+
+bool BinXmlWriter::write(const QString& path, qint64 sourceSize, const QByteArray& sourceHash)
+{
+	QByteArray head;
+	unsigned h[4] = { BINXML_MAGIC, BINXML_VERSION, unsigned(_names.size()), 0 };
+	head.append((const char*) h, sizeof (h));
+	head.append((const char*) &sourceSize, 8);
+	head.append(sourceHash.leftJustified(BINXML_HASH_SIZE, 0, true));
+	foreach(const QString& name, _names)
+	{
+		QByteArray ba = name.toLatin1();
+		unsigned short n = ba.size();
+		head.append((const char*) &n, 2);
+		head.append(ba);
+	}
+
+	QString tmp = path + ".tmp";
+	FILE* f = fopen(tmp.toLatin1().constData(), "w");
+	if (f == 0)
+	{
+		printf("BinXml: cannot create %s: %s\n", tmp.toLatin1().constData(), strerror(errno));
+		return true;
+	}
+	bool error = fwrite(head.constData(), head.size(), 1, f) != 1
+			|| fwrite(_data.constData(), _data.size(), 1, f) != 1;
+	if (fclose(f))
+		error = true;
+	if (error || ::rename(tmp.toLatin1().constData(), path.toLatin1().constData()))
+	{
+		printf("BinXml: writing %s failed: %s\n", path.toLatin1().constData(), strerror(errno));
+		::remove(tmp.toLatin1().constData());
+		return true;
+	}
+	return false;
+}
+
+//---------------------------------------------------------
+//   xmlToBinXml
+//    write the tokens of xml as snapshot path. The text
+//    of controllers and runs of plain midi events are
+//    stored as numbers when they can be written back
+//    unchanged. Comments are not kept.
+//    returns true on error
+//---------------------------------------------------------
+
+bool xmlToBinXml(Xml& xml, const QString& path, qint64 sourceSize, const QByteArray& sourceHash)
+{
+	BinXmlWriter w;
+	QVector<XmlEvent> run;
+	QVector<CtrlPoint> points;
+	Xml::Token token = xml.parse();
+	for (;;)
+	{
+		const QString& tag = xml.s1();
+		// the events of a part follow its name, so the part
+		// exists when they are read
+		if (token == Xml::TagStart && tag == "event" && w.parent() == "part" && w.children())
+		{
+			QList<QPair<QString, QString> > attrs;
+			while ((token = xml.parse()) == Xml::Attribut)
+				attrs.append(qMakePair(xml.s1(), xml.s2()));
+			XmlEvent e;
+			if (token == Xml::TagEnd && xml.s1() == "event" && packEvent(attrs, &e))
+			{
+				run.append(e);
+				token = xml.parse();
+				continue;
+			}
+			w.events(run);
+			run.clear();
+			w.tagStart("event");
+			for (int i = 0; i < attrs.size(); ++i)
+				w.attribut(attrs[i].first, attrs[i].second);
+			// token is the first one after the attributes
+			continue;
+		}
+		w.events(run);
+		run.clear();
+
+		bool error = false;
+		switch (token)
+		{
+			case Xml::Error:
+			case Xml::End:
+				error = true;
+				break;
+			case Xml::TagStart:
+				w.tagStart(tag);
+				break;
+			case Xml::TagEnd:
+				error = w.tagEnd(tag);
+				break;
+			case Xml::Flag:
+				w.flag(tag);
+				break;
+			case Xml::Proc:
+				w.proc(tag);
+				break;
+			case Xml::Text:
+				if (w.parent() == "controller" && packCtrl(tag, &points))
+					w.ctrl(points);
+				else
+					w.text(tag);
+				break;
+			case Xml::Attribut:
+				w.attribut(tag, xml.s2());
+				break;
+		}
+		if (error)
+		{
+			printf("BinXml: cannot convert the project, <%s> at line %d\n", tag.toLatin1().constData(), xml.line() + 1);
+			return true;
+		}
+		// the root element is closed, the rest is not read
+		if (token == Xml::TagEnd && w.depth() == 0)
+			break;
+		token = xml.parse();
+	}
+	return w.write(path, sourceSize, sourceHash);
+}
+
+//---------------------------------------------------------
+//   putEscaped
+//    as Xml::strTag()
+//---------------------------------------------------------
+
+static void putEscaped(FILE* f, const QString& s)
+{
+	QByteArray ba = s.toLatin1();
+	for (const char* p = ba.constData(); *p; ++p)
+	{
+		switch (*p)
+		{
+			case '&': fputs("&amp;", f);
+				break;
+			case '<': fputs("&lt;", f);
+				break;
+			case '>': fputs("&gt;", f);
+				break;
+			case '\\': fputs("&apos;", f);
+				break;
+			case '"': fputs("&quot;", f);
+				break;
+			default: fputc(*p, f);
+				break;
+		}
+	}
+}
+
+static void putLevel(FILE* f, int level)
+{
+	for (int i = 0; i < level * 2; ++i)
+		fputc(' ', f);
+}
+
+//---------------------------------------------------------
+//   binXmlToXml
+//    write the snapshot as .oom file. Text is written
+//    where it was, the tokens read back are the same.
+//    returns true on error
+//---------------------------------------------------------
+
+bool binXmlToXml(const BinXml& bin, FILE* f)
+{
+	Xml xml(&bin);
+	int level = 0;
+	bool inTag = false; // the attributes of a tag are written
+	bool afterText = false; // white space would become part of the text
+	for (;;)
+	{
+		Xml::Token token = xml.parse();
+		const QString& tag = xml.s1();
+		switch (token)
+		{
+			case Xml::Error:
+				return true;
+			case Xml::End:
+				return ferror(f) != 0;
+			case Xml::TagStart:
+			case Xml::Flag:
+			case Xml::Proc:
+				if (inTag)
+					fputs(">\n", f);
+				if (!afterText)
+					putLevel(f, level);
+				if (token == Xml::TagStart)
+				{
+					fprintf(f, "<%s", tag.toLatin1().constData());
+					++level;
+				}
+				else if (token == Xml::Flag)
+					fprintf(f, "<%s/>\n", tag.toLatin1().constData());
+				else
+					fprintf(f, "<?%s?>\n", tag.toLatin1().constData());
+				inTag = token == Xml::TagStart;
+				afterText = false;
+				break;
+			case Xml::Attribut:
+				fprintf(f, " %s=\"", tag.toLatin1().constData());
+				putEscaped(f, xml.s2());
+				fputc('"', f);
+				break;
+			case Xml::TagEnd:
+				--level;
+				if (inTag)
+					fputs(" />\n", f);
+				else
+				{
+					if (!afterText)
+						putLevel(f, level);
+					fprintf(f, "</%s>\n", tag.toLatin1().constData());
+				}
+				inTag = false;
+				afterText = false;
+				break;
+			case Xml::Text:
+				if (xml.packed() == Xml::NotPacked)
+				{
+					if (inTag)
+						fputc('>', f);
+					putEscaped(f, tag);
+					inTag = false;
+					afterText = true;
+					break;
+				}
+				if (inTag)
+					fputs(">\n", f);
+				inTag = false;
+				if (xml.packed() == Xml::PackedCtrl)
+				{
+					// as AudioTrack::writeProperties()
+					for (unsigned i = 0; i < xml.packedCount(); ++i)
+					{
+						int frame;
+						double val;
+						xml.ctrlPoint(i, &frame, &val);
+						if (i % 4 == 0)
+							putLevel(f, level);
+						fprintf(f, "%d %s, ", frame, QString::number(val).toLatin1().constData());
+						if (i % 4 == 3 || i + 1 == xml.packedCount())
+							fputc('\n', f);
+					}
+				}
+				else
+				{
+					// as MidiEventBase::write()
+					for (unsigned i = 0; i < xml.packedCount(); ++i)
+					{
+						XmlEvent e;
+						xml.event(i, &e);
+						putLevel(f, level);
+						fprintf(f, "<event tick=\"%d\"", e.tick);
+						if (e.type == -1)
+							fprintf(f, " len=\"%d\"", e.len);
+						else
+							fprintf(f, " type=\"%d\"", e.type);
+						if (e.a)
+							fprintf(f, " a=\"%d\"", e.a);
+						if (e.b)
+							fprintf(f, " b=\"%d\"", e.b);
+						if (e.c)
+							fprintf(f, " c=\"%d\"", e.c);
+						fputs(" />\n", f);
+					}
+				}
+				break;
+		}
+	}
+}
+
+//---------------------------------------------------------
+//   convertFile
+//    convert the .oom file project to the snapshot path,
+//    stamped with the size and md5 of the .oom file
+//    returns true on error
+//---------------------------------------------------------
+
+static bool convertFile(const QString& project, const QString& path)
+{
+	QFileInfo fi(sourcePath(project));
+	QByteArray hash;
+	if (fileHash(fi.filePath(), &hash))
+	{
+		printf("BinXml: cannot read %s\n", fi.filePath().toLatin1().constData());
+		return true;
+	}
+	bool popenFlag;
+	FILE* f = fileOpen(0, project, QString(".oom"), "r", popenFlag, true);
+	if (f == 0)
+	{
+		printf("BinXml: cannot open %s: %s\n", project.toLatin1().constData(), strerror(errno));
+		return true;
+	}
+	Xml xml(f);
+	bool error = xmlToBinXml(xml, path, fi.size(), hash);
+	popenFlag ? pclose(f) : fclose(f);
+	return error;
+}
+
+//---------------------------------------------------------
+//   writeSnapshot
+//    called after project was saved
+//    returns true on error
+//---------------------------------------------------------
+
+bool writeSnapshot(const QString& project)
+{
+	QString path = snapshotPath(project);
+	double t = curTime();
+	if (convertFile(project, path))
+	{
+		// a stale snapshot is not used, but it is of no use either
+		::remove(path.toLatin1().constData());
+		return true;
+	}
+	if (debugMsg)
+		printf("BinXml: %s written in %.0f ms\n", path.toLatin1().constData(), (curTime() - t) * 1000.0);
+	return false;
+}
+
+//---------------------------------------------------------
+//   convertProject
+//    --convert: a .oomb file is written as .oom file,
+//    anything else as .oomb file
+//---------------------------------------------------------
+
+int convertProject(const QString& in, const QString& out)
+{
+	if (!in.endsWith(".oomb"))
+	{
+		if (convertFile(in, out))
+			return 1;
+		printf("%s converted to %s\n", in.toLatin1().constData(), out.toLatin1().constData());
+		return 0;
+	}
+	BinXml bin;
+	if (bin.open(in))
+	{
+		fprintf(stderr, "convert: cannot read %s\n", in.toLatin1().constData());
+		return 1;
+	}
+	bool popenFlag;
+	FILE* f = fileOpen(0, out, QString(".oom"), "w", popenFlag, true);
+	if (f == 0)
+	{
+		fprintf(stderr, "convert: cannot create %s: %s\n", out.toLatin1().constData(), strerror(errno));
+		return 1;
+	}
+	bool error = binXmlToXml(bin, f);
+	if ((popenFlag ? pclose(f) : fclose(f)) || error)
+	{
+		fprintf(stderr, "convert: writing %s failed\n", out.toLatin1().constData());
+		return 1;
+	}
+	printf("%s converted to %s\n", in.toLatin1().constData(), out.toLatin1().constData());
+	return 0;
+}
+
+//---------------------------------------------------------
+//   scanTokens
+//    read all tokens of the root element and the packed
+//    numbers. Returns the number of tokens, -1 on error.
+//---------------------------------------------------------
+
+static int scanTokens(Xml& xml, double* sum)
+{
+	int n = 0;
+	int level = 0;
+	for (;;)
+	{
+		Xml::Token token = xml.parse();
+		++n;
+		switch (token)
+		{
+			case Xml::Error:
+			case Xml::End:
+				return -1;
+			case Xml::TagStart:
+				++level;
+				break;
+			case Xml::TagEnd:
+				if (--level == 0)
+					return n;
+				break;
+			case Xml::Text:
+				for (unsigned i = 0; i < xml.packedCount() && xml.packed() == Xml::PackedCtrl; ++i)
+				{
+					int frame;
+					double val;
+					xml.ctrlPoint(i, &frame, &val);
+					*sum += val;
+				}
+				for (unsigned i = 0; i < xml.packedCount() && xml.packed() == Xml::PackedEvents; ++i)
+				{
+					XmlEvent e;
+					xml.event(i, &e);
+					*sum += e.tick;
+				}
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+static bool sameFile(const QString& a, const QString& b)
+{
+	QFile fa(a);
+	QFile fb(b);
+	if (!fa.open(QIODevice::ReadOnly) || !fb.open(QIODevice::ReadOnly))
+		return false;
+	return fa.readAll() == fb.readAll();
+}
+
+//---------------------------------------------------------
+//   benchProjectLoad
+//    --bench-load: time how long reading the tokens of
+//    project takes from the .oom file and from its
+//    snapshot, including the check of its stamp, and
+//    check that a snapshot written back as
+//    .oom file gives the same snapshot again.
+//    The whole load is timed by the -D output of
+//    OOMidi::loadProjectFile1().
+//---------------------------------------------------------
+
+int benchProjectLoad(const QString& project)
+{
+	const int runs = 5;
+	QString dir = QDir::tempPath();
+	QString bin1 = dir + "/oom-bench-1.oomb";
+	QString bin2 = dir + "/oom-bench-2.oomb";
+	QString back = dir + "/oom-bench.oom";
+
+	double xmlMin = 1e9, xmlSum = 0.0;
+	int tokens = 0;
+	double sum = 0.0;
+	for (int i = 0; i < runs; ++i)
+	{
+		bool popenFlag;
+		FILE* f = fileOpen(0, project, QString(".oom"), "r", popenFlag, true);
+		if (f == 0)
+		{
+			fprintf(stderr, "bench: cannot open %s: %s\n", project.toLatin1().constData(), strerror(errno));
+			return 1;
+		}
+		double t0 = curTime();
+		Xml xml(f);
+		tokens = scanTokens(xml, &sum);
+		double t = curTime() - t0;
+		popenFlag ? pclose(f) : fclose(f);
+		if (tokens < 0)
+		{
+			fprintf(stderr, "bench: %s is broken\n", project.toLatin1().constData());
+			return 1;
+		}
+		xmlMin = qMin(xmlMin, t);
+		xmlSum += t;
+	}
+
+	double t = curTime();
+	if (convertFile(project, bin1))
+		return 1;
+	double convert = curTime() - t;
+
+	double binMin = 1e9, binSum = 0.0;
+	int records = 0;
+	for (int i = 0; i < runs; ++i)
+	{
+		double t0 = curTime();
+		BinXml bin;
+		if (bin.open(bin1))
+			return 1;
+		// openSnapshot() checks the stamp before each load
+		if (!bin.isCurrent(sourcePath(project)))
+		{
+			fprintf(stderr, "bench: the snapshot of %s is not current\n", project.toLatin1().constData());
+			return 1;
+		}
+		Xml xml(&bin);
+		records = scanTokens(xml, &sum);
+		double t = curTime() - t0;
+		if (records < 0)
+			return 1;
+		binMin = qMin(binMin, t);
+		binSum += t;
+	}
+
+	// round trip
+	bool lossless = false;
+	{
+		BinXml bin;
+		FILE* f = fopen(back.toLatin1().constData(), "w");
+		if (!bin.open(bin1) && f && !binXmlToXml(bin, f))
+		{
+			fclose(f);
+			f = 0;
+			FILE* bf = fopen(back.toLatin1().constData(), "r");
+			if (bf)
+			{
+				Xml xml(bf);
+				QFileInfo fi(sourcePath(project));
+				QByteArray hash;
+				if (!fileHash(fi.filePath(), &hash) && !xmlToBinXml(xml, bin2, fi.size(), hash))
+					lossless = sameFile(bin1, bin2);
+				fclose(bf);
+			}
+		}
+		if (f)
+			fclose(f);
+	}
+
+	printf("%s: %lld bytes, %d tokens\n", project.toLatin1().constData(),
+			(long long) QFileInfo(sourcePath(project)).size(), tokens);
+	printf("  xml:      min %8.1f ms  avg %8.1f ms\n", xmlMin * 1000.0, xmlSum * 1000.0 / runs);
+	printf("  snapshot: min %8.1f ms  avg %8.1f ms  (%lld bytes, %d records)\n", binMin * 1000.0, binSum * 1000.0 / runs,
+			(long long) QFileInfo(bin1).size(), records);
+	printf("  convert:  %8.1f ms\n", convert * 1000.0);
+	printf("  speedup:  %.1fx\n", binMin > 0.0 ? xmlMin / binMin : 0.0);
+	printf("  round trip: %s\n", lossless ? "lossless" : "DIFFERS");
+
+	::remove(bin1.toLatin1().constData());
+	::remove(bin2.toLatin1().constData());
+	::remove(back.toLatin1().constData());
+	return lossless ? 0 : 1;
+}
+
@@ -0,0 +1,110 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#ifndef __BINXML_H__
+#define __BINXML_H__
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+class Xml;
+
+#define BINXML_MAGIC   0x424d4f4f // "OOMB"
+#define BINXML_VERSION 2
+
+//---------------------------------------------------------
+//   binary snapshot
+//
+//    header:  u32 magic, u32 version, u32 names, u32 0,
+//             i64 size and the md5 of the contents of the
+//             .oom file
+//    names:   u16 length + latin1 bytes each, the tag and
+//             attribute names
+//    records: u8 kind + data, in the order of the tokens
+//             of the .oom file. Numbers are in host byte
+//             order, a snapshot of another machine is not
+//             recognized and the .oom file is read instead.
+//---------------------------------------------------------
+
+enum BinXmlRecord
+{
+    BX_TAG_START = 1, // u32 name, u32 length of the section up to
+                      // and including its BX_TAG_END
+    BX_TAG_END,       // u32 name
+    BX_FLAG,          // u32 name
+    BX_PROC,          // u32 length, bytes
+    BX_TEXT,          // u32 length, bytes
+    BX_ATTRIBUT,      // u32 name, u32 length, bytes
+    BX_CTRL,          // u32 n, n * (i32 frame, f64 value)
+                      // the text of a <controller>
+    BX_EVENTS         // u32 n, n * 6 * i32, see XmlEvent
+                      // a run of plain <event>s of a <part>
+};
+
+#define BINXML_HEADER 40
+#define BINXML_HASH_SIZE 16
+#define BINXML_CTRL_SIZE  12
+#define BINXML_EVENT_SIZE 24
+
+//---------------------------------------------------------
+//   BinXml
+//    a binary snapshot mapped into memory, read with
+//    Xml(const BinXml*)
+//---------------------------------------------------------
+
+class BinXml
+{
+    int _fd;
+    void* _map;
+    size_t _size;
+    const char* _records;
+    qint64 _sourceSize;
+    QByteArray _sourceHash;
+    QVector<QString> _names;
+
+public:
+    BinXml();
+    ~BinXml();
+
+    bool open(const QString& path);
+    bool isCurrent(const QString& source) const;
+
+    const char* records() const
+    {
+        return _records;
+    }
+
+    const char* end() const
+    {
+        return (const char*) _map + _size;
+    }
+
+    unsigned names() const
+    {
+        return _names.size();
+    }
+
+    const QString& name(unsigned id) const
+    {
+        return _names.at(id);
+    }
+};
+
+extern QString snapshotPath(const QString& project);
+extern BinXml* openSnapshot(const QString& project);
+extern bool xmlToBinXml(Xml& xml, const QString& path, qint64 sourceSize, const QByteArray& sourceHash);
+extern bool binXmlToXml(const BinXml& bin, FILE* f);
+extern bool writeSnapshot(const QString& project);
+extern int convertProject(const QString& in, const QString& out);
+extern int benchProjectLoad(const QString& project);
+
+#endif
+
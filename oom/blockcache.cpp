@@ -0,0 +1,210 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#include <string.h>
+
+#include <QMutexLocker>
+
+#include "blockcache.h"
+
+BlockCache* blockCache;
+
+//---------------------------------------------------------
+//   BlockCache
+//---------------------------------------------------------
+
+BlockCache::BlockCache(size_t budget)
+{
+	_head = 0;
+	_tail = 0;
+	_used = 0;
+	_budget = budget;
+	_hits = 0;
+	_misses = 0;
+	_evictions = 0;
+}
+
+BlockCache::~BlockCache()
+{
+	while (_head)
+		remove(_head);
+}
+
+//---------------------------------------------------------
+//   unlink
+//   pushFront
+//   remove
+//    called with _lock held
+//---------------------------------------------------------
+
+void BlockCache::unlink(Block* b)
+{
+	if (b->prev)
+		b->prev->next = b->next;
+	else
+		_head = b->next;
+	if (b->next)
+		b->next->prev = b->prev;
+	else
+		_tail = b->prev;
+}
+
+void BlockCache::pushFront(Block* b)
+{
+	b->prev = 0;
+	b->next = _head;
+	if (_head)
+		_head->prev = b;
+	else
+		_tail = b;
+	_head = b;
+}
+
+void BlockCache::remove(Block* b)
+{
+	unlink(b);
+	_blocks.remove(b->key);
+	_used -= sizeof (float) * b->frames * b->channels;
+	delete[] b->data;
+	delete b;
+}
+
+//---------------------------------------------------------
+//   evict
+//    drop the least recently used blocks until the cache
+//    is within its budget
+//    called with _lock held
+//---------------------------------------------------------
+
+void BlockCache::evict()
+{
+	while (_used > _budget && _tail)
+	{
+		remove(_tail);
+		++_evictions;
+	}
+}
+
+//---------------------------------------------------------
+//   setBudget
+//---------------------------------------------------------
+
+void BlockCache::setBudget(size_t bytes)
+{
+	QMutexLocker locker(&_lock);
+	_budget = bytes;
+	evict();
+}
+
+//---------------------------------------------------------
+//   contains
+//    does not count as a hit or a miss
+//---------------------------------------------------------
+
+bool BlockCache::contains(unsigned file, unsigned index)
+{
+	QMutexLocker locker(&_lock);
+	return _blocks.contains(key(file, index));
+}
+
+//---------------------------------------------------------
+//   read
+//    copy the interleaved frames [offset, offset+frames)
+//    of a block to dst, *got is set to the frames the
+//    block has of them.
+//    returns false on a miss
+//---------------------------------------------------------
+
+bool BlockCache::read(unsigned file, unsigned index, unsigned offset, unsigned frames, float* dst, unsigned* got)
+{
+	QMutexLocker locker(&_lock);
+	QHash<quint64, Block*>::const_iterator i = _blocks.constFind(key(file, index));
+	if (i == _blocks.constEnd())
+	{
+		++_misses;
+		return false;
+	}
+	++_hits;
+	Block* b = i.value();
+	if (b != _head)
+	{
+		unlink(b);
+		pushFront(b);
+	}
+	unsigned n = 0;
+	if (offset < b->frames)
+		n = b->frames - offset < frames ? b->frames - offset : frames;
+	memcpy(dst, b->data + offset * b->channels, sizeof (float) * n * b->channels);
+	*got = n;
+	return true;
+}
+
+//---------------------------------------------------------
+//   insert
+//    the data is copied, the memory is allocated before
+//    the lock is taken
+//---------------------------------------------------------
+
+void BlockCache::insert(unsigned file, unsigned index, const float* data, unsigned frames, int channels)
+{
+	if (_budget == 0 || frames == 0)
+		return;
+	Block* b = new Block;
+	b->key = key(file, index);
+	b->frames = frames;
+	b->channels = channels;
+	b->data = new float[frames * channels];
+	memcpy(b->data, data, sizeof (float) * frames * channels);
+
+	QMutexLocker locker(&_lock);
+	QHash<quint64, Block*>::iterator i = _blocks.find(b->key);
+	if (i != _blocks.end())
+	{
+		// another reader was faster
+		delete[] b->data;
+		delete b;
+		return;
+	}
+	_blocks.insert(b->key, b);
+	pushFront(b);
+	_used += sizeof (float) * frames * channels;
+	evict();
+}
+
+//---------------------------------------------------------
+//   invalidate
+//    drop all blocks of a file, its contents have changed
+//    or it is closed
+//---------------------------------------------------------
+
+void BlockCache::invalidate(unsigned file)
+{
+	QMutexLocker locker(&_lock);
+	for (Block* b = _head; b;)
+	{
+		Block* next = b->next;
+		if (unsigned(b->key >> 32) == file)
+			remove(b);
+		b = next;
+	}
+}
+
+//---------------------------------------------------------
+//   stats
+//---------------------------------------------------------
+
+BlockCacheStats BlockCache::stats()
+{
+	QMutexLocker locker(&_lock);
+	BlockCacheStats s;
+	s.hits = _hits;
+	s.misses = _misses;
+	s.evictions = _evictions;
+	s.used = _used;
+	s.budget = _budget;
+	return s;
+}
@@ -0,0 +1,89 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#ifndef __BLOCKCACHE_H__
+#define __BLOCKCACHE_H__
+
+#include <stddef.h>
+
+#include <QHash>
+#include <QMutex>
+
+#define BLOCK_CACHE_FRAMES    16384 // frames per block
+#define BLOCK_CACHE_READAHEAD 4     // blocks decoded in a row on a miss
+
+//---------------------------------------------------------
+//   BlockCacheStats
+//---------------------------------------------------------
+
+struct BlockCacheStats
+{
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+    size_t used; // bytes
+    size_t budget;
+};
+
+//---------------------------------------------------------
+//   BlockCache
+//    Decoded interleaved frames of compressed wave files,
+//    shared by all readers and bounded by a memory budget.
+//    Blocks are keyed by the serial of the SndFile and
+//    their index, the least recently used block goes
+//    first. Seeking into FLAC or Ogg restarts the decoder,
+//    with the cache loops and scrubbing decode a region
+//    once.
+//---------------------------------------------------------
+
+class BlockCache
+{
+    struct Block
+    {
+        quint64 key;
+        unsigned frames;
+        int channels;
+        float* data;
+        Block* prev; // more recently used
+        Block* next;
+    };
+
+    QMutex _lock;
+    QHash<quint64, Block*> _blocks;
+    Block* _head; // most recently used
+    Block* _tail;
+    size_t _used;
+    size_t _budget;
+    unsigned long _hits;
+    unsigned long _misses;
+    unsigned long _evictions;
+
+    static quint64 key(unsigned file, unsigned index)
+    {
+        return (quint64(file) << 32) | index;
+    }
+    void unlink(Block*);
+    void pushFront(Block*);
+    void remove(Block*);
+    void evict();
+
+public:
+    BlockCache(size_t budget);
+    ~BlockCache();
+
+    void setBudget(size_t bytes);
+    bool contains(unsigned file, unsigned index);
+    bool read(unsigned file, unsigned index, unsigned offset, unsigned frames, float* dst, unsigned* got);
+    void insert(unsigned file, unsigned index, const float* data, unsigned frames, int channels);
+    void invalidate(unsigned file);
+    BlockCacheStats stats();
+};
+
+extern BlockCache* blockCache;
+
+#endif
+
@@ -38,6 +38,7 @@
 #include "plugin.h"
 #include "sync.h"
 #include "wave.h"
+#include "blockcache.h"
 #include "midiseq.h"
 #include "AudioMixer.h"
 #include "TrackManager.h"
@@ -894,6 +895,22 @@ void readConfiguration(Xml& xml, bool readOnlySequencer)/*{{{*/
 					config.useProjectSaveDialog = xml.parseInt();
 				else if (tag == "useAutoCrossFades")
 					config.useAutoCrossFades = xml.parseInt();
+				else if (tag == "automationBlockSize")
+					config.automationBlockSize = xml.parseInt();
+				else if (tag == "preallocateRecordFiles")
+					config.preallocateRecordFiles = xml.parseInt();
+				else if (tag == "blockCacheSize")
+				{
+					config.blockCacheSize = xml.parseInt();
+					if (blockCache)
+						blockCache->setBudget(size_t(config.blockCacheSize) << 20);
+				}
+				else if (tag == "projectSnapshot")
+					config.projectSnapshot = xml.parseInt();
+				else if (tag == "parallelProjectLoad")
+					config.parallelProjectLoad = xml.parseInt();
+				else if (tag == "parallelAudio")
+					config.parallelAudio = xml.parseInt();
 				else if(tag == "lsClientHost")
 				{
 					config.lsClientHost = xml.parse1();
@@ -1246,6 +1263,12 @@ void OOMidi::writeGlobalConfiguration(int level, Xml& xml) const
 	xml.intTag(level, "projectStoreInFolder", config.projectStoreInFolder);
 	xml.intTag(level, "useProjectSaveDialog", config.useProjectSaveDialog);
 	xml.intTag(level, "useAutoCrossFades", config.useAutoCrossFades);
+	xml.intTag(level, "automationBlockSize", config.automationBlockSize);
+	xml.intTag(level, "preallocateRecordFiles", config.preallocateRecordFiles);
+	xml.intTag(level, "blockCacheSize", config.blockCacheSize);
+	xml.intTag(level, "projectSnapshot", config.projectSnapshot);
+	xml.intTag(level, "parallelProjectLoad", config.parallelProjectLoad);
+	xml.intTag(level, "parallelAudio", config.parallelAudio);
 	xml.intTag(level, "midiInputDevice", midiInputPorts);
 	xml.intTag(level, "midiInputChannel", midiInputChannel);
 	xml.intTag(level, "midiRecordType", midiRecordType);
@@ -195,6 +195,56 @@ const CtrlVal CtrlList::cvalue(int frame)/*{{{*/
 	return CtrlVal(-1, -1);
 }/*}}}*/
 
+//---------------------------------------------------------
+//   render
+//    value() of the n frames starting at frame. The cycle is
+//    split at the points of the list, the values between two
+//    points are a straight line (or constant in DISCRETE
+//    mode), so only the ends of each piece are looked up.
+//---------------------------------------------------------
+
+void CtrlList::render(int frame, unsigned n, float* buf)
+{
+	unsigned k = 0;
+	while (k < n)
+	{
+		unsigned end = n;
+		int next = nextFrame(frame + k);
+		if (next != -1 && (unsigned) (next - frame) < n)
+			end = next - frame;
+
+		double v1 = value(frame + k);
+		if (_mode == DISCRETE)
+		{
+			for (; k < end; ++k)
+				buf[k] = v1;
+		}
+		else
+		{
+			double v2 = value(frame + end);
+			double step = (v2 - v1) / (end - k);
+			for (unsigned i = 0; k < end; ++k, ++i)
+				buf[k] = v1 + step * i;
+		}
+	}
+}
+
+//---------------------------------------------------------
+//   nextFrame
+//    frame of the first point after frame, -1 if there is
+//    none
+//---------------------------------------------------------
+
+int CtrlList::nextFrame(int frame) const
+{
+	if (!automation || empty())
+		return -1;
+	ciCtrl i = upper_bound(frame);
+	if (i == end())
+		return -1;
+	return i->second.getFrame();
+}
+
 //---------------------------------------------------------
 //   setCurVal
 //---------------------------------------------------------
@@ -304,6 +354,18 @@ void CtrlList::read(Xml& xml)
 				int frame;
 				double val;
 
+				if (xml.packed() == Xml::PackedCtrl)
+				{
+					// the points of a binary snapshot, in order
+					for (unsigned k = 0; k < xml.packedCount(); ++k)
+					{
+						xml.ctrlPoint(k, &frame, &val);
+						iCtrl e = insert(end(), std::pair<const int, CtrlVal > (frame, CtrlVal(frame, val)));
+						e->second.val = val;
+					}
+					break;
+				}
+
 				int i = 0;
 				for (;;)
 				{
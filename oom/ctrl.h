@@ -237,6 +237,8 @@ public:
 
 	const CtrlVal cvalue(int frame);
     double value(int frame);
+    void render(int frame, unsigned n, float* buf);
+    int nextFrame(int frame) const;
     void add(int tick, double value);
     void del(int tick);
     void read(Xml& xml);
@@ -0,0 +1,291 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <QMutexLocker>
+
+#include "diskwriter.h"
+#include "globals.h"
+#include "gconfig.h"
+#include "track.h"
+#include "song.h"
+#include "wave.h"
+
+enum
+{
+	DISKWRITER_TICK
+};
+
+//---------------------------------------------------------
+//   DiskWriterMsg
+//---------------------------------------------------------
+
+struct DiskWriterMsg : public ThreadMsg
+{
+};
+
+DiskWriter* diskWriter;
+
+//---------------------------------------------------------
+//   RecordBatch
+//---------------------------------------------------------
+
+RecordBatch::RecordBatch()
+{
+	_buffer = 0;
+	_channels = 0;
+	_frames = 0;
+	_pos = 0;
+	_file = 0;
+	_reserved = 0;
+}
+
+RecordBatch::~RecordBatch()
+{
+	free(_buffer);
+}
+
+//---------------------------------------------------------
+//   alloc
+//---------------------------------------------------------
+
+void RecordBatch::alloc(unsigned channels)
+{
+	if (_buffer && channels == _channels)
+		return;
+	free(_buffer);
+	_buffer = 0;
+	posix_memalign((void**) &_buffer, 16, sizeof (float) * RECORD_BATCH_FRAMES * channels);
+	_channels = channels;
+}
+
+//---------------------------------------------------------
+//   prepare
+//    start collecting for a new file, allocates the buffer
+//    so the disk writer does not have to
+//---------------------------------------------------------
+
+void RecordBatch::prepare(SndFile* sf)
+{
+	_file = sf;
+	_frames = 0;
+	_pos = 0;
+	_reserved = 0;
+	if (sf)
+		alloc(sf->channels());
+}
+
+//---------------------------------------------------------
+//   add
+//    append n frames which go to the file frame pos
+//---------------------------------------------------------
+
+void RecordBatch::add(SndFile* sf, unsigned pos, int srcChannels, float** src, unsigned n)
+{
+	if (sf != _file)
+	{
+		// the track got a new file, what is left belongs to the old one
+		prepare(sf);
+	}
+	if (_frames && (pos != _pos + _frames || _frames + n > RECORD_BATCH_FRAMES))
+		flush();
+	if (n > RECORD_BATCH_FRAMES)
+	{
+		_file->seek(pos, 0);
+		_file->write(srcChannels, src, n);
+		return;
+	}
+	if (_frames == 0)
+		_pos = pos;
+	if (_file->convert(_buffer + _frames * _channels, srcChannels, src, n))
+		return;
+	_frames += n;
+	if (_frames == RECORD_BATCH_FRAMES)
+		flush();
+}
+
+//---------------------------------------------------------
+//   flush
+//    write the collected frames
+//---------------------------------------------------------
+
+void RecordBatch::flush()
+{
+	if (_frames == 0 || !_file)
+		return;
+	unsigned end = _pos + _frames;
+	if (config.preallocateRecordFiles && end > _reserved)
+	{
+		// reserve the next minute at once
+		unsigned frames = end + 60 * sampleRate;
+		if (_file->reserve(frames))
+			_reserved = ~0;
+		else
+			_reserved = frames;
+	}
+	_file->seek(_pos, 0);
+	if (_file->writeDirect(_buffer, _frames) != _frames)
+		printf("RecordBatch: write to %s failed: %s\n",
+				_file->path().toLatin1().constData(), _file->strerror().toLatin1().constData());
+	_frames = 0;
+}
+
+//---------------------------------------------------------
+//   finish
+//    write what is left and give back the unused space
+//---------------------------------------------------------
+
+void RecordBatch::finish()
+{
+	flush();
+	if (_file && _reserved && _reserved != (unsigned) ~0 && _file->release())
+		printf("RecordBatch: cannot release the space reserved for %s: %s\n",
+				_file->path().toLatin1().constData(), strerror(errno));
+	_reserved = 0;
+}
+
+//---------------------------------------------------------
+//   DiskWriter
+//---------------------------------------------------------
+
+DiskWriter::DiskWriter(const char* name)
+: Thread(name)
+{
+	_tickPending = false;
+}
+
+DiskWriter::~DiskWriter()
+{
+}
+
+//---------------------------------------------------------
+//   readMsg
+//---------------------------------------------------------
+
+static void readMsgD(void* p, void*)
+{
+	DiskWriter* dw = (DiskWriter*) p;
+	dw->readMsg1(sizeof (DiskWriterMsg));
+}
+
+//---------------------------------------------------------
+//   start
+//---------------------------------------------------------
+
+void DiskWriter::start(int priority)
+{
+	clearPollFd();
+	addPollFd(toThreadFdr, POLLIN, ::readMsgD, this, 0);
+	Thread::start(priority);
+}
+
+//---------------------------------------------------------
+//   processMsg1
+//---------------------------------------------------------
+
+void DiskWriter::processMsg1(const void* m)
+{
+	const DiskWriterMsg* msg = (DiskWriterMsg*) m;
+	switch (msg->id)
+	{
+		case DISKWRITER_TICK:
+		{
+			_tickPending = false;
+			QMutexLocker locker(&_lock);
+			write();
+			break;
+		}
+		default:
+			printf("DiskWriter::processMsg1: unknown message\n");
+	}
+}
+
+//---------------------------------------------------------
+//   msgTick
+//    called from audio RT context, a tick which is still
+//    pending already covers this period
+//---------------------------------------------------------
+
+void DiskWriter::msgTick()
+{
+	if (_tickPending)
+		return;
+	_tickPending = true;
+	DiskWriterMsg msg;
+	msg.id = DISKWRITER_TICK;
+	if (sendMsg1(&msg, sizeof (msg)))
+	{
+		printf("DiskWriter::msgTick(): send failed!\n");
+		_tickPending = false;
+	}
+}
+
+//---------------------------------------------------------
+//   write
+//    move the recorded periods of all tracks from their
+//    fifos into their batches
+//---------------------------------------------------------
+
+void DiskWriter::write()
+{
+	AudioOutput* ao = song->bounceOutput;
+	if (ao && song->outputs()->find(ao) != song->outputs()->end())
+	{
+		if (ao->recordFlag())
+			ao->record();
+	}
+	WaveTrackList* tl = song->waves();
+	for (iWaveTrack t = tl->begin(); t != tl->end(); ++t)
+	{
+		WaveTrack* track = *t;
+		if (track->recordFlag())
+			track->record();
+	}
+}
+
+//---------------------------------------------------------
+//   prepare
+//    execution environment: gui thread
+//---------------------------------------------------------
+
+void DiskWriter::prepare(RecordBatch* batch, SndFile* sf)
+{
+	QMutexLocker locker(&_lock);
+	batch->prepare(sf);
+}
+
+//---------------------------------------------------------
+//   flush
+//    write everything recorded so far, called when
+//    recording stops before the files are closed
+//    execution environment: gui thread, audio idle
+//---------------------------------------------------------
+
+void DiskWriter::flush()
+{
+	QMutexLocker locker(&_lock);
+	write();
+	AudioOutput* ao = song->bounceOutput;
+	if (ao && song->outputs()->find(ao) != song->outputs()->end())
+	{
+		if (ao->recordFlag())
+			ao->finishRecord();
+	}
+	WaveTrackList* tl = song->waves();
+	for (iWaveTrack t = tl->begin(); t != tl->end(); ++t)
+	{
+		WaveTrack* track = *t;
+		if (track->recordFlag())
+			track->finishRecord();
+	}
+}
+
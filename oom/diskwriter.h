@@ -0,0 +1,80 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#ifndef __DISKWRITER_H__
+#define __DISKWRITER_H__
+
+#include <sys/types.h>
+#include <QMutex>
+
+#include "thread.h"
+
+class SndFile;
+
+// frames collected per track before they are written
+#define RECORD_BATCH_FRAMES 32768
+
+//---------------------------------------------------------
+//   RecordBatch
+//    Clipped, interleaved frames of one recording track
+//    waiting to be written. Consecutive periods are
+//    collected and written with one seek and one
+//    sf_writef_float(), a jump in the file position writes
+//    out what was collected before.
+//---------------------------------------------------------
+
+class RecordBatch
+{
+    float* _buffer;
+    unsigned _channels; // file channels the buffer was made for
+    unsigned _frames; // frames in the buffer
+    unsigned _pos; // file frame of the first buffered frame
+    SndFile* _file;
+    unsigned _reserved; // file frames preallocated on disk
+
+    void alloc(unsigned channels);
+
+public:
+    RecordBatch();
+    ~RecordBatch();
+
+    void prepare(SndFile*);
+    void add(SndFile*, unsigned pos, int srcChannels, float** src, unsigned n);
+    void flush();
+    void finish();
+};
+
+//---------------------------------------------------------
+//   DiskWriter
+//    Drains the record fifos of all recording tracks into
+//    their batches. Runs in its own thread, so a busy
+//    disk does not hold up the playback prefetch and
+//    vice versa.
+//---------------------------------------------------------
+
+class DiskWriter : public Thread
+{
+    QMutex _lock; // held while the fifos are drained
+    volatile bool _tickPending;
+
+    virtual void processMsg1(const void*);
+    void write();
+
+public:
+    DiskWriter(const char* name);
+    ~DiskWriter();
+    virtual void start(int);
+
+    void msgTick();
+    void prepare(RecordBatch*, SndFile*);
+    void flush();
+};
+
+extern DiskWriter* diskWriter;
+
+#endif
+
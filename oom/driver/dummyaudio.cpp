@@ -51,8 +51,11 @@ class DummyAudioDevice : public AudioDevice
 	// Changed by Tim. p3.3.15
 	//float buffer[1024];
 	float* buffer;
+	std::list<float*> portBuffers;
 	int _realTimePriority;
 
+	float* portBuffer();
+
 public:
 	std::list<Msg> cmdQueue;
 	Audio::State state;
@@ -66,8 +69,13 @@ public:
 	{
 		// Added by Tim. p3.3.15
 		free(buffer);
+		for (std::list<float*>::iterator i = portBuffers.begin(); i != portBuffers.end(); ++i)
+			free(*i);
 	}
 
+	void processCommands();
+	void processCycle();
+
 	virtual inline int deviceType()
 	{
 		return DUMMY_AUDIO;
@@ -85,7 +93,7 @@ public:
 		return _framePos;
 	}
 
-	virtual float* getBuffer(void* /*port*/, unsigned long nframes)
+	virtual float* getBuffer(void* port, unsigned long nframes)
 	{
 		// p3.3.30
 		//if (nframes > dummyFrames) {
@@ -96,7 +104,7 @@ public:
 
 			exit(-1);
 		}
-		return buffer;
+		return port ? (float*) port : buffer;
 	}
 
 	virtual std::list<QString> outputPorts(bool midi = false, int aliases = -1);
@@ -115,17 +123,28 @@ public:
 
 	virtual void* registerOutPort(const char*, bool)
 	{
-		return (void*) 1;
+		return portBuffer();
 	}
 	//virtual void* registerInPort(const char*) {
 
 	virtual void* registerInPort(const char*, bool)
 	{
-		return (void*) 2;
+		return portBuffer();
 	}
 
-	virtual void unregisterPort(void*)
+	// copied tracks share their ports, a buffer is freed
+	// the first time it is unregistered
+	virtual void unregisterPort(void* port)
 	{
+		for (std::list<float*>::iterator i = portBuffers.begin(); i != portBuffers.end(); ++i)
+		{
+			if (*i == port)
+			{
+				free(*i);
+				portBuffers.erase(i);
+				break;
+			}
+		}
 	}
 
 	virtual void connect(void*, void*)
@@ -265,6 +284,21 @@ DummyAudioDevice::DummyAudioDevice()
 	cmdQueue.clear();
 }
 
+//---------------------------------------------------------
+//   portBuffer
+//    every port gets its own buffer, so the channels of
+//    an output do not overwrite each other
+//---------------------------------------------------------
+
+float* DummyAudioDevice::portBuffer()
+{
+	float* b;
+	posix_memalign((void**) &b, 16, sizeof (float) * config.dummyAudioBufSize);
+	memset(b, 0, sizeof (float) * config.dummyAudioBufSize);
+	portBuffers.push_back(b);
+	return b;
+}
+
 //---------------------------------------------------------
 //   exitDummyAudio
 //---------------------------------------------------------
@@ -288,6 +322,75 @@ bool initDummyAudio()
 	return false;
 }
 
+//---------------------------------------------------------
+//   dummyAudioCycle
+//    run one period without the timer thread, used by
+//    the offline renderer to drive the audio engine as
+//    fast as it can
+//---------------------------------------------------------
+
+void dummyAudioCycle()
+{
+	if (!dummyAudio)
+		return;
+	dummyAudio->processCommands();
+	dummyAudio->processCycle();
+}
+
+//---------------------------------------------------------
+//   processCommands
+//    transport commands queued by the gui
+//---------------------------------------------------------
+
+void DummyAudioDevice::processCommands()
+{
+	while (cmdQueue.size())
+	{
+		Msg msg = cmdQueue.back();
+		cmdQueue.pop_back();
+		switch (msg.cmd)
+		{
+			case trSeek:
+			{
+				//printf("trSeek\n");
+				playPos = msg.arg;
+				Audio::State tempState = state;
+				state = Audio::START_PLAY;
+				audio->sync(state, msg.arg);
+				state = tempState;
+			}
+				break;
+			case trStart:
+			{
+				//printf("trStart\n");
+				state = Audio::START_PLAY;
+				audio->sync(state, msg.arg);
+				state = Audio::PLAY;
+			}
+				break;
+			case trStop:
+				break;
+			default:
+				printf("dummyLoop: Unknown command!\n");
+		}
+	}
+}
+
+//---------------------------------------------------------
+//   processCycle
+//---------------------------------------------------------
+
+void DummyAudioDevice::processCycle()
+{
+	audio->process(segmentSize);
+	int increment = segmentSize; // 1 //tickRate / sampleRate * segmentSize;
+	_framePos += increment;
+	if (state == Audio::PLAY)
+	{
+		playPos += increment;
+	}
+}
+
 //---------------------------------------------------------
 //   outputPorts
 //---------------------------------------------------------
@@ -400,44 +503,9 @@ static void* dummyLoop(void* ptr)
 		{
 			/*int n = */ poll(&myPollFd, 1 /* npfd */, _pollWait);
 			count += timer.getTimerTicks();
-			while (drvPtr->cmdQueue.size())
-			{
-				Msg &msg = drvPtr->cmdQueue.back();
-				drvPtr->cmdQueue.pop_back();
-				switch (msg.cmd)
-				{
-					case trSeek:
-					{
-						//printf("trSeek\n");
-						drvPtr->playPos = msg.arg;
-						Audio::State tempState = drvPtr->state;
-						drvPtr->state = Audio::START_PLAY;
-						audio->sync(drvPtr->state, msg.arg);
-						drvPtr->state = tempState;
-					}
-						break;
-					case trStart:
-					{
-						//printf("trStart\n");
-						drvPtr->state = Audio::START_PLAY;
-						audio->sync(drvPtr->state, msg.arg);
-						drvPtr->state = Audio::PLAY;
-					}
-						break;
-					case trStop:
-						break;
-					default:
-						printf("dummyLoop: Unknown command!\n");
-				}
-			}
-		}
-		audio->process(segmentSize);
-		int increment = segmentSize; // 1 //tickRate / sampleRate * segmentSize;
-		drvPtr->_framePos += increment;
-		if (drvPtr->state == Audio::PLAY)
-		{
-			drvPtr->playPos += increment;
+			drvPtr->processCommands();
 		}
+		drvPtr->processCycle();
 	}
 	timer.stopTimer();
 	pthread_exit(0);
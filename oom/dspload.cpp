@@ -0,0 +1,421 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#include <stdio.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "dspload.h"
+#include "globals.h"
+#include "plugin.h"
+#include "song.h"
+#include "track.h"
+
+DspLoad dspLoad;
+
+static __thread DspLoadRing* tlsRing;
+static __thread DspLoadScope* tlsScope;
+static __thread bool tlsNoRing;
+static pthread_key_t ringKey;
+
+static const char* kindNames[] = {
+	"cycle", "midi", "track", "wave", "synth", "plugin"
+};
+
+//---------------------------------------------------------
+//   releaseRing
+//    the thread which owned the ring has ended
+//---------------------------------------------------------
+
+static void releaseRing(void* ring)
+{
+	((DspLoadRing*) ring)->release();
+}
+
+//---------------------------------------------------------
+//   DspLoadRing
+//---------------------------------------------------------
+
+DspLoadRing::DspLoadRing()
+{
+	wcount = 0;
+	rcount = 0;
+	_used = 0;
+	_dropped = 0;
+}
+
+//---------------------------------------------------------
+//   put
+//    return true on overflow
+//---------------------------------------------------------
+
+bool DspLoadRing::put(const DspLoadEvent& ev)
+{
+	unsigned w = wcount;
+	if (w - oom_load_acquire(&rcount) >= DSP_LOAD_RING_SIZE)
+	{
+		++_dropped;
+		return true;
+	}
+	ring[w % DSP_LOAD_RING_SIZE] = ev;
+	oom_store_release(&wcount, w + 1);
+	return false;
+}
+
+//---------------------------------------------------------
+//   get
+//---------------------------------------------------------
+
+bool DspLoadRing::get(DspLoadEvent* ev)
+{
+	unsigned r = rcount;
+	if (r == oom_load_acquire(&wcount))
+		return false;
+	*ev = ring[r % DSP_LOAD_RING_SIZE];
+	oom_store_release(&rcount, r + 1);
+	return true;
+}
+
+//---------------------------------------------------------
+//   claim
+//   release
+//---------------------------------------------------------
+
+bool DspLoadRing::claim()
+{
+	return __sync_bool_compare_and_swap(&_used, 0, 1);
+}
+
+void DspLoadRing::release()
+{
+	oom_store_release(&_used, 0);
+}
+
+//---------------------------------------------------------
+//   DspLoad
+//---------------------------------------------------------
+
+DspLoad::DspLoad()
+{
+	_enabled = 0;
+	_cycle = 0;
+	_rings = 0;
+	_windowCycle = 0;
+	_traceCount = 0;
+	pthread_key_create(&ringKey, releaseRing);
+}
+
+//---------------------------------------------------------
+//   setEnabled
+//    the rings stay when disabled, a thread may still be
+//    recording into one
+//---------------------------------------------------------
+
+void DspLoad::setEnabled(bool flag)
+{
+	if (flag && _rings == 0)
+	{
+		_rings = new DspLoadRing[DSP_LOAD_THREADS];
+		_trace.resize(DSP_LOAD_TRACE_SIZE);
+	}
+	if (flag)
+		_windowCycle = _cycle;
+	oom_store_release(&_enabled, flag);
+}
+
+//---------------------------------------------------------
+//   now
+//    nanoseconds of a monotonic clock
+//---------------------------------------------------------
+
+unsigned long long DspLoad::now()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//---------------------------------------------------------
+//   threadRing
+//    the ring of the calling thread, a free one is claimed
+//    on the first call. Returns 0 if all are taken.
+//---------------------------------------------------------
+
+DspLoadRing* DspLoad::threadRing()
+{
+	if (tlsRing || tlsNoRing)
+		return tlsRing;
+	for (int i = 0; i < DSP_LOAD_THREADS; ++i)
+	{
+		if (_rings[i].claim())
+		{
+			tlsRing = &_rings[i];
+			pthread_setspecific(ringKey, tlsRing);
+			return tlsRing;
+		}
+	}
+	tlsNoRing = true;
+	return 0;
+}
+
+//---------------------------------------------------------
+//   begin
+//   end
+//---------------------------------------------------------
+
+void DspLoadScope::begin()
+{
+	_parent = tlsScope;
+	tlsScope = this;
+	_nested = 0;
+	_start = DspLoad::now();
+}
+
+void DspLoadScope::end()
+{
+	unsigned long long dur = DspLoad::now() - _start;
+	tlsScope = _parent;
+	if (_parent)
+		_parent->_nested += dur;
+
+	DspLoadRing* ring = dspLoad.threadRing();
+	if (ring == 0)
+		return;
+	DspLoadEvent ev;
+	ev.node = _node;
+	ev.start = _start;
+	ev.dur = dur;
+	ev.self = dur - _nested;
+	ev.cycle = dspLoad.cycle();
+	ev.kind = _kind;
+	ring->put(ev);
+}
+
+//---------------------------------------------------------
+//   nameIndex
+//---------------------------------------------------------
+
+int DspLoad::nameIndex(const QString& name)
+{
+	QHash<QString, int>::const_iterator i = _traceNameIdx.constFind(name);
+	if (i != _traceNameIdx.constEnd())
+		return i.value();
+	int idx = _traceNames.size();
+	_traceNames.append(name);
+	_traceNameIdx.insert(name, idx);
+	return idx;
+}
+
+//---------------------------------------------------------
+//   updateNames
+//    names and owners of the nodes which are in the song
+//    now, nodes which are not are never dereferenced
+//---------------------------------------------------------
+
+void DspLoad::updateNames()
+{
+	_nameIdx.clear();
+	_owner.clear();
+	TrackList* tl = song->tracks();
+	for (ciTrack it = tl->begin(); it != tl->end(); ++it)
+	{
+		AudioTrack* t = 0;
+		if ((*it)->isMidiTrack())
+		{
+			if ((*it)->wantsAutomation())
+				t = ((MidiTrack*) *it)->getAutomationTrack();
+		}
+		else
+			t = (AudioTrack*) *it;
+		if (t == 0)
+			continue;
+		_nameIdx.insert(t, nameIndex((*it)->name()));
+		Pipeline* pipe = t->efxPipe();
+		if (pipe == 0)
+			continue;
+		for (iPluginI ip = pipe->begin(); ip != pipe->end(); ++ip)
+		{
+			BasePlugin* p = *ip;
+			if (p == 0)
+				continue;
+			_nameIdx.insert(p, nameIndex((*it)->name() + ": " + p->name()));
+			_owner.insert(p, t);
+		}
+	}
+}
+
+//---------------------------------------------------------
+//   addLoad
+//---------------------------------------------------------
+
+void DspLoad::addLoad(const void* node, const DspLoadEvent& ev)
+{
+	QHash<const void*, NodeLoad>::iterator i = _nodes.find(node);
+	if (i == _nodes.end())
+	{
+		NodeLoad n;
+		n.sum = n.cur = n.worst = 0.0;
+		n.curCycle = ev.cycle;
+		n.stat.avg = n.stat.worst = 0.0;
+		i = _nodes.insert(node, n);
+	}
+	NodeLoad& n = i.value();
+	if (n.curCycle != ev.cycle)
+	{
+		if (n.cur > n.worst)
+			n.worst = n.cur;
+		n.cur = 0.0;
+		n.curCycle = ev.cycle;
+	}
+	n.cur += ev.self;
+	n.sum += ev.self;
+}
+
+//---------------------------------------------------------
+//   collect
+//    drain the rings, called from the gui heartbeat. The
+//    load of plugins is added to their track as well, the
+//    averages are updated once per second.
+//---------------------------------------------------------
+
+void DspLoad::collect()
+{
+	if (_rings == 0)
+		return;
+	updateNames();
+	for (int t = 0; t < DSP_LOAD_THREADS; ++t)
+	{
+		DspLoadEvent ev;
+		while (_rings[t].get(&ev))
+		{
+			addLoad(ev.node, ev);
+			const void* owner = _owner.value(ev.node);
+			if (owner)
+				addLoad(owner, ev);
+
+			TraceEvent& te = _trace[_traceCount++ % DSP_LOAD_TRACE_SIZE];
+			te.start = ev.start;
+			te.dur = ev.dur;
+			te.cycle = ev.cycle;
+			te.thread = t;
+			te.kind = ev.kind;
+			if (ev.kind == DSP_LOAD_CYCLE)
+				te.name = nameIndex("Audio cycle");
+			else if (ev.kind == DSP_LOAD_MIDI)
+				te.name = nameIndex("Midi");
+			else if (_nameIdx.contains(ev.node))
+				te.name = _nameIdx.value(ev.node);
+			else
+				te.name = nameIndex(QString("removed ") + kindNames[ev.kind]);
+		}
+	}
+
+	unsigned cycle = oom_load_acquire(&_cycle);
+	unsigned cycles = cycle - _windowCycle;
+	if (cycles == 0 || cycles < sampleRate / segmentSize)
+		return;
+	for (QHash<const void*, NodeLoad>::iterator i = _nodes.begin(); i != _nodes.end();)
+	{
+		NodeLoad& n = i.value();
+		if (n.sum == 0.0)
+		{
+			i = _nodes.erase(i);
+			continue;
+		}
+		if (n.cur > n.worst)
+			n.worst = n.cur;
+		n.stat.avg = n.sum / cycles / 1000.0;
+		n.stat.worst = n.worst / 1000.0;
+		n.sum = n.cur = n.worst = 0.0;
+		++i;
+	}
+	_windowCycle = cycle;
+}
+
+//---------------------------------------------------------
+//   load
+//    average and worst microseconds per cycle of a node
+//    over the last second, returns false if it had none
+//---------------------------------------------------------
+
+bool DspLoad::load(const void* node, DspLoadStat* stat) const
+{
+	QHash<const void*, NodeLoad>::const_iterator i = _nodes.constFind(node);
+	if (i == _nodes.constEnd())
+		return false;
+	*stat = i.value().stat;
+	return true;
+}
+
+//---------------------------------------------------------
+//   writeJsonString
+//---------------------------------------------------------
+
+static void writeJsonString(FILE* f, const QString& s)
+{
+	QByteArray ba = s.toUtf8();
+	fputc('"', f);
+	for (const char* p = ba.constData(); *p; ++p)
+	{
+		unsigned char c = *p;
+		if (c == '"' || c == '\\')
+			fprintf(f, "\\%c", c);
+		else if (c < 0x20)
+			fprintf(f, "\\u%04x", c);
+		else
+			fputc(c, f);
+	}
+	fputc('"', f);
+}
+
+//---------------------------------------------------------
+//   exportTrace
+//    write the kept events in the Chrome trace event
+//    format, which Perfetto and chrome://tracing load.
+//    returns true on error
+//---------------------------------------------------------
+
+bool DspLoad::exportTrace(const QString& path) const
+{
+	FILE* f = fopen(path.toLocal8Bit().constData(), "w");
+	if (f == 0)
+		return true;
+
+	unsigned n = _traceCount < DSP_LOAD_TRACE_SIZE ? _traceCount : DSP_LOAD_TRACE_SIZE;
+	unsigned first = _traceCount - n;
+	unsigned long long t0 = ~0ULL;
+	for (unsigned i = first; i != _traceCount; ++i)
+	{
+		const TraceEvent& te = _trace[i % DSP_LOAD_TRACE_SIZE];
+		if (te.start < t0)
+			t0 = te.start;
+	}
+
+	unsigned dropped = 0;
+	fprintf(f, "{\"traceEvents\":[\n");
+	for (int t = 0; _rings && t < DSP_LOAD_THREADS; ++t)
+	{
+		dropped += _rings[t].dropped();
+		fprintf(f, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"dsp %d\"}},\n", t, t);
+	}
+	for (unsigned i = first; i != _traceCount; ++i)
+	{
+		const TraceEvent& te = _trace[i % DSP_LOAD_TRACE_SIZE];
+		fprintf(f, "{\"name\":");
+		writeJsonString(f, _traceNames[te.name]);
+		fprintf(f, ",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"cycle\":%u}},\n",
+				kindNames[te.kind], (te.start - t0) / 1000.0, te.dur / 1000.0, te.thread, te.cycle);
+	}
+	fprintf(f, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"OOStudio dsp\"}}\n");
+	fprintf(f, "],\"displayTimeUnit\":\"ns\",\"otherData\":{\"droppedEvents\":%u}}\n", dropped);
+
+	bool error = ferror(f);
+	if (fclose(f))
+		error = true;
+	return error;
+}
+
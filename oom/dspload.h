@@ -0,0 +1,198 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#ifndef __DSPLOAD_H__
+#define __DSPLOAD_H__
+
+#include <vector>
+
+#include <QHash>
+#include <QString>
+#include <QStringList>
+
+#include "lockfree.h"
+
+#define DSP_LOAD_THREADS    16     // threads which can record
+#define DSP_LOAD_RING_SIZE  4096   // power of two
+#define DSP_LOAD_TRACE_SIZE 262144 // events kept for exportTrace()
+
+enum DspLoadKind {
+    DSP_LOAD_CYCLE, DSP_LOAD_MIDI, DSP_LOAD_TRACK, DSP_LOAD_WAVE,
+    DSP_LOAD_SYNTH, DSP_LOAD_PLUGIN
+};
+
+//---------------------------------------------------------
+//   DspLoadEvent
+//    one measured scope, times in nanoseconds
+//---------------------------------------------------------
+
+struct DspLoadEvent
+{
+    const void* node; // track, plugin or Audio
+    unsigned long long start;
+    unsigned dur;
+    unsigned self; // dur without the scopes nested in it
+    unsigned cycle;
+    int kind;
+};
+
+//---------------------------------------------------------
+//   DspLoadRing
+//    single producer / single consumer ring of the events
+//    of one thread, full means the event is dropped
+//---------------------------------------------------------
+
+class DspLoadRing
+{
+    DspLoadEvent ring[DSP_LOAD_RING_SIZE];
+    char _pad0[OOM_CACHE_LINE];
+    volatile unsigned wcount;
+    unsigned _dropped;
+    char _pad1[OOM_CACHE_LINE];
+    volatile unsigned rcount;
+    char _pad2[OOM_CACHE_LINE];
+    volatile unsigned _used; // owned by a thread
+
+public:
+    DspLoadRing();
+    bool put(const DspLoadEvent&); // returns true on overflow
+    bool get(DspLoadEvent*); // returns false if empty
+    bool claim(); // returns true if the ring was free
+    void release();
+
+    unsigned dropped() const
+    {
+        return _dropped;
+    }
+};
+
+//---------------------------------------------------------
+//   DspLoadStat
+//    microseconds per audio cycle
+//---------------------------------------------------------
+
+struct DspLoadStat
+{
+    double avg;
+    double worst;
+};
+
+//---------------------------------------------------------
+//   DspLoad
+//    Profiler for the audio processing. The audio thread and
+//    the graph workers time their tracks, plugins and synths
+//    with DspLoadScope and put the results into a ring of
+//    their own. The gui drains the rings in collect() and
+//    keeps the load of every node over the last second and
+//    the most recent events for exportTrace().
+//    Recording costs one flag test while disabled.
+//---------------------------------------------------------
+
+class DspLoad
+{
+    struct NodeLoad
+    {
+        double sum; // ns in this window
+        double cur; // ns in cycle curCycle
+        double worst;
+        unsigned curCycle;
+        DspLoadStat stat; // of the last window
+    };
+
+    struct TraceEvent
+    {
+        unsigned long long start;
+        unsigned dur;
+        unsigned cycle;
+        short thread;
+        short kind;
+        int name; // index into _traceNames
+    };
+
+    volatile unsigned _enabled;
+    volatile unsigned _cycle; // counted by the audio thread
+    DspLoadRing* _rings;
+
+    // gui side
+    QHash<const void*, NodeLoad> _nodes;
+    QHash<const void*, int> _nameIdx; // node names of this collect()
+    QHash<const void*, const void*> _owner; // plugin -> its track
+    unsigned _windowCycle;
+    std::vector<TraceEvent> _trace;
+    unsigned _traceCount;
+    QStringList _traceNames;
+    QHash<QString, int> _traceNameIdx;
+
+    int nameIndex(const QString&);
+    void updateNames();
+    void addLoad(const void* node, const DspLoadEvent&);
+
+public:
+    DspLoad();
+
+    bool enabled() const
+    {
+        return oom_load_acquire(&_enabled);
+    }
+    void setEnabled(bool);
+
+    // audio side
+    void nextCycle()
+    {
+        oom_store_release(&_cycle, _cycle + 1);
+    }
+    unsigned cycle() const
+    {
+        return _cycle;
+    }
+    DspLoadRing* threadRing();
+    static unsigned long long now();
+
+    // gui side
+    void collect();
+    bool load(const void* node, DspLoadStat*) const;
+    bool exportTrace(const QString& path) const;
+};
+
+extern DspLoad dspLoad;
+
+//---------------------------------------------------------
+//   DspLoadScope
+//    times its own lifetime for dspLoad
+//---------------------------------------------------------
+
+class DspLoadScope
+{
+    DspLoadScope* _parent;
+    const void* _node;
+    unsigned long long _start;
+    unsigned long long _nested;
+    DspLoadKind _kind;
+    bool _on;
+
+    void begin();
+    void end();
+
+public:
+    DspLoadScope(DspLoadKind kind, const void* node)
+    {
+        _kind = kind;
+        _node = node;
+        _on = dspLoad.enabled();
+        if (_on)
+            begin();
+    }
+
+    ~DspLoadScope()
+    {
+        if (_on)
+            end();
+    }
+};
+
+#endif
+
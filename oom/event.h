@@ -10,6 +10,7 @@
 #define __EVENT_H__
 
 #include <map>
+#include <vector>
 //#include <samplerate.h>
 #include <sys/types.h>
 
@@ -26,6 +27,7 @@ class QString;
 
 class Xml;
 class EventBase;
+class MidiEventStore;
 //class AudioConverter;
 class WavePart;
 
@@ -132,24 +134,91 @@ typedef std::pair <iEvent, iEvent> EventRange;
 //---------------------------------------------------------
 //   EventList
 //    tick sorted list of events
+//    Every change bumps the serial, pack() makes a new
+//    MidiEventStore for playback when the serial moved on.
+//    The song remembers the serial it last told the gui
+//    about to find the parts an update has touched.
 //---------------------------------------------------------
 
 class EventList : public EL
 {
     int ref; // number of references to this EventList
     int aref; // number of active references (exclude undo list)
+    volatile unsigned _serial;
+    unsigned _notifiedSerial;
+    MidiEventStore* volatile _store;
     void deselect();
 
+    void changed()
+    {
+        __sync_fetch_and_add(&_serial, 1);
+    }
+
 public:
 
     EventList()
     {
         ref = 0;
         aref = 0;
+        _serial = 0;
+        _notifiedSerial = 0;
+        _store = 0;
+    }
+
+    EventList(const EventList& el)
+    : EL(el)
+    {
+        ref = 0;
+        aref = 0;
+        _serial = 0;
+        _notifiedSerial = 0;
+        _store = 0;
     }
 
-    ~EventList()
+    ~EventList();
+
+    EventList& operator=(const EventList& el)
     {
+        EL::operator=(el);
+        changed();
+        return *this;
+    }
+
+    unsigned serial() const
+    {
+        return _serial;
+    }
+
+    bool changedSinceNotify() const
+    {
+        return _serial != _notifiedSerial;
+    }
+
+    void setNotified()
+    {
+        _notifiedSerial = _serial;
+    }
+
+    MidiEventStore* pack() const;
+    MidiEventStore* swapStore(MidiEventStore*);
+    const MidiEventStore* store() const;
+
+    void erase(iEvent i)
+    {
+        changed();
+        EL::erase(i);
+    }
+
+    void erase(iEvent from, iEvent to)
+    {
+        changed();
+        EL::erase(from, to);
+    }
+
+    void clear()
+    {
+        changed();
+        EL::clear();
     }
 
     void incRef(int n)
@@ -174,10 +243,28 @@ public:
 
     iEvent find(const Event&);
     iEvent add(Event& event);
+    iEvent add(Event& event, iEvent hint);
     void move(Event& event, unsigned tick);
     void dump() const;
     void read(Xml& xml, const char* name, bool midi);
 };
 
+//---------------------------------------------------------
+//   EventStoreSwap
+//    a store made by EventList::pack(), after the audio
+//    thread swapped it in it holds the old store of the
+//    list for the gui to delete
+//---------------------------------------------------------
+
+struct EventStoreSwap
+{
+    EventList* list;
+    MidiEventStore* store;
+};
+
+class EventStoreSwapList : public std::vector<EventStoreSwap>
+{
+};
+
 #endif
 
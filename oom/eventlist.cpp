@@ -8,8 +8,19 @@
 
 #include "tempo.h"
 #include "event.h"
+#include "lockfree.h"
+#include "midieventstore.h"
 #include "xml.h"
 
+//---------------------------------------------------------
+//   ~EventList
+//---------------------------------------------------------
+
+EventList::~EventList()
+{
+	delete _store;
+}
+
 //---------------------------------------------------------
 //   readEventList
 //---------------------------------------------------------
@@ -60,6 +71,7 @@ iEvent EventList::add(Event& event)
 	// Note that in a oom file, the tempo list is loaded AFTER all the tracks.
 	// There was a bug that all the wave events' tick values were not correct,
 	// since they were computed BEFORE the tempo map was loaded.
+	changed();
 	if (event.type() == Wave)
 		return std::multimap<unsigned, Event, std::less<unsigned> >::insert(std::pair<const unsigned, Event > (event.frame(), event));
 	else
@@ -67,6 +79,19 @@ iEvent EventList::add(Event& event)
 		return std::multimap<unsigned, Event, std::less<unsigned> >::insert(std::pair<const unsigned, Event > (event.tick(), event));
 }
 
+//---------------------------------------------------------
+//   add
+//    with the position the event goes to or after, for
+//    events which are added in order
+//---------------------------------------------------------
+
+iEvent EventList::add(Event& event, iEvent hint)
+{
+	changed();
+	unsigned key = event.type() == Wave ? event.frame() : event.tick();
+	return std::multimap<unsigned, Event, std::less<unsigned> >::insert(hint, std::pair<const unsigned, Event > (key, event));
+}
+
 //---------------------------------------------------------
 //   move
 //---------------------------------------------------------
@@ -114,3 +139,46 @@ void EventList::dump() const
 		i->second.dump();
 }
 
+//---------------------------------------------------------
+//   pack
+//    make a new playback store if the list changed since
+//    the last one, 0 if it did not. Called from the gui
+//    thread after the audio thread has executed a change,
+//    so the list does not change while it is copied. The
+//    store is published by Song::packMidiEvents().
+//---------------------------------------------------------
+
+MidiEventStore* EventList::pack() const
+{
+	unsigned serial = _serial;
+	MidiEventStore* s = _store;
+	if (s && s->serial() == serial)
+		return 0;
+	return new MidiEventStore(this, serial);
+}
+
+//---------------------------------------------------------
+//   swapStore
+//    audio thread, while it executes a message. Returns the
+//    old store, the gui deletes it when the message is done.
+//---------------------------------------------------------
+
+MidiEventStore* EventList::swapStore(MidiEventStore* s)
+{
+	MidiEventStore* old = _store;
+	oom_store_release(&_store, s);
+	return old;
+}
+
+//---------------------------------------------------------
+//   store
+//    the playback store, 0 while it is older than the list
+//---------------------------------------------------------
+
+const MidiEventStore* EventList::store() const
+{
+	const MidiEventStore* s = oom_load_acquire(&_store);
+	if (s && s->serial() == oom_load_acquire(&_serial))
+		return s;
+	return 0;
+}
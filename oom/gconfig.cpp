@@ -722,6 +722,12 @@ GlobalConfigValues config = {
 	QString(QString("/usr/local/lib64/vst:/usr/lib64/vst:/usr/local/lib/vst:/usr/lib/vst:").append(QDir::homePath()).append(QDir::separator()).append(".vst")),
 	0, //Default audio raster index
 	1, //Default midi raster index
-	true //Use auto crossfades
+	true, //Use auto crossfades
+	64, //Plugin automation sub-block size
+	true, //Preallocate record files
+	256, //MB of decoded audio in the block cache
+	true, //Write a binary snapshot next to saved projects
+	true, //Open project files on worker threads while loading
+	false //Process the audio tracks of new songs in parallel
 };
 
@@ -166,6 +166,12 @@ struct GlobalConfigValues
 	int audioRaster;
 	int midiRaster;
 	bool useAutoCrossFades;
+	int automationBlockSize; // max frames between plugin automation updates
+	bool preallocateRecordFiles; // reserve disk space for wave files while recording
+	int blockCacheSize; // MB of decoded compressed audio kept in memory
+	bool projectSnapshot; // write and load a .oomb snapshot of the project
+	bool parallelProjectLoad; // open wave files and plugin libraries ahead while a project is read
+	bool parallelAudio; // new songs process their audio tracks on the AudioGraph workers
 };
 
 extern GlobalConfigValues config;
@@ -106,6 +106,7 @@ bool loadVST = true;
 bool loadDSSI = true;
 bool usePythonBridge = false;
 bool useLASH = true;
+bool offlineRender = false;
 
 const QStringList midi_file_pattern =  
       QT_TRANSLATE_NOOP("@default", 
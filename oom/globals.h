@@ -77,6 +77,7 @@ extern bool loadVST;
 extern bool loadDSSI;
 extern bool usePythonBridge;
 extern bool useLASH;
+extern bool offlineRender; // --render, no gui and no peak files
 
 extern bool realTimeScheduling;
 extern int realTimePriority;
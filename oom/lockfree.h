@@ -0,0 +1,78 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#ifndef __LOCKFREE_H__
+#define __LOCKFREE_H__
+
+// Reader and writer data of a fifo are kept this far apart
+// so the two threads do not bounce one cache line.
+#define OOM_CACHE_LINE 64
+
+//---------------------------------------------------------
+//   oom_load_acquire
+//   oom_store_release
+//    index access for single producer / single consumer
+//    ring buffers. Each index is written by one thread only.
+//    The writer fills a slot and then publishes it with a
+//    release store, the reader sees the complete slot after
+//    an acquire load of the index (and vice versa for
+//    freeing a slot).
+//---------------------------------------------------------
+
+static inline unsigned oom_load_acquire(const volatile unsigned* p)
+{
+#ifdef __ATOMIC_ACQUIRE
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#else
+    unsigned v = *p;
+    __sync_synchronize();
+    return v;
+#endif
+}
+
+static inline void oom_store_release(volatile unsigned* p, unsigned v)
+{
+#ifdef __ATOMIC_RELEASE
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+#else
+    __sync_synchronize();
+    *p = v;
+#endif
+}
+
+//---------------------------------------------------------
+//   oom_load_acquire
+//   oom_store_release
+//    the same for publishing an object built by one thread
+//    to others through a pointer
+//---------------------------------------------------------
+
+template <class T>
+static inline T* oom_load_acquire(T* const volatile* p)
+{
+#ifdef __ATOMIC_ACQUIRE
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#else
+    T* v = *p;
+    __sync_synchronize();
+    return v;
+#endif
+}
+
+template <class T>
+static inline void oom_store_release(T* volatile* p, T* v)
+{
+#ifdef __ATOMIC_RELEASE
+    __atomic_store_n(p, v, __ATOMIC_RELEASE);
+#else
+    __sync_synchronize();
+    *p = v;
+#endif
+}
+
+#endif
+
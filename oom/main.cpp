@@ -15,6 +15,7 @@
 #include <QTimer>
 #include <QTranslator>
 
+#include <getopt.h>
 #include <signal.h>
 #include <sys/mman.h>
 #include <alsa/asoundlib.h>
@@ -26,7 +27,11 @@
 #include "gconfig.h"
 #include "globals.h"
 #include "icons.h"
+#include "node.h"
+#include "offlinerender.h"
+#include "binxml.h"
 #include "sync.h"
+#include "tempo.h"
 #include "network/LSThread.h"
 
 extern bool initDummyAudio();
@@ -124,8 +129,8 @@ class OOMidiApplication : public QApplication
 
 public:
 
-	OOMidiApplication(int& argc, char** argv)
-	: QApplication(argc, argv)
+	OOMidiApplication(int& argc, char** argv, bool gui = true)
+	: QApplication(argc, argv, gui)
 	{
 		oom = 0;
 	}
@@ -258,6 +263,17 @@ static void usage(const char* prog, const char* txt)
 	fprintf(stderr, "   -L       don't use LASH\n");
 #endif
 	fprintf(stderr, "   -l  xx   force locale to the given language/country code (xx = %s)\n", localeList().toLatin1().constData());
+	fprintf(stderr, "   --render project   mix the project into a wav file without the gui\n");
+	fprintf(stderr, "   -o, --output file  file written by --render or --convert\n");
+	fprintf(stderr, "   --range from:to    part rendered, l, r, start, end or a frame (default start:end)\n");
+	fprintf(stderr, "   --convert file     write a project as binary snapshot (.oomb) or a snapshot as project\n");
+	fprintf(stderr, "   --bench-load project  time reading the project and its snapshot\n");
+	fprintf(stderr, "   --bench-graph project time rendering --range serially and on the audio graph workers\n");
+	fprintf(stderr, "   --bench-fades project check and time the fade envelopes of the wave parts\n");
+	fprintf(stderr, "   --bench-fifo seconds  stress the prefetch fifo with a writer that clears it\n");
+	fprintf(stderr, "   --bench-dsp frames    check and time the x86 dsp kernels on periods of frames\n");
+	fprintf(stderr, "   --bench-tempo events  check and time tick and frame conversions on a tempo list\n");
+	fprintf(stderr, "   --bench-synth cycles  check the midi events a stub synth plugin gets per cycle\n");
 }
 
 //---------------------------------------------------------
@@ -275,6 +291,27 @@ int main(int argc, char* argv[])
 	getCapabilities();
 	int noAudio = false;
 
+	// rendering and the project tools need neither a display
+	// nor the gui
+	bool batchMode = false;
+	for (int k = 1; k < argc; ++k)
+	{
+		if (strncmp(argv[k], "--render", 8) == 0 || strncmp(argv[k], "--convert", 9) == 0
+				|| strncmp(argv[k], "--bench-", 8) == 0)
+			batchMode = true;
+	}
+	QString renderProjectFile;
+	QString outputFile;
+	QString renderRange;
+	QString convertFile;
+	QString benchFile;
+	QString benchGraphFile;
+	QString benchFadesFile;
+	int benchFifoSeconds = 0;
+	int benchDspFrames = 0;
+	int benchTempoEvents = 0;
+	int benchSynthCycles = 0;
+
 	oomUser = QDir::homePath();//QString(getenv("HOME"));
 	oomGlobalLib = QString(LIBDIR);
 	oomGlobalShare = QString(SHAREDIR);
@@ -304,11 +341,14 @@ int main(int argc, char* argv[])
 	srand(time(0)); // initialize random number generator
 	initMidiController();
 	QApplication::setColorSpec(QApplication::ManyColor);
-	OOMidiApplication app(argc, argv);
-	app.setStyleSheet("QMessageBox{background-color: #595966;} QPushButton{border-radius: 3px; padding: 5px; background: qlineargradient(x1: 0, y1: 0, x2: 0, y2: 1,stop: 0 #626272, stop:0.1 #5b5b6b, stop: 1.0 #4d4d5b); border: 1px solid #393941; font-family: fixed-width;	font-weight: bold; font-size: 11px; color: #d0d4d0; } QPushButton:pressed, QPushButton::checked, QPushButton::hover { color: #e2e5e5; border-radius: 3px; padding: 3px; border: 1px solid #181819; background-color: #393941; }");
-	QPalette p = QApplication::palette();
-	p.setColor(QPalette::Disabled, QPalette::Light, QColor(89,89,102));
-	QApplication::setPalette(p);
+	OOMidiApplication app(argc, argv, !batchMode);
+	if (!batchMode)
+	{
+		app.setStyleSheet("QMessageBox{background-color: #595966;} QPushButton{border-radius: 3px; padding: 5px; background: qlineargradient(x1: 0, y1: 0, x2: 0, y2: 1,stop: 0 #626272, stop:0.1 #5b5b6b, stop: 1.0 #4d4d5b); border: 1px solid #393941; font-family: fixed-width;	font-weight: bold; font-size: 11px; color: #d0d4d0; } QPushButton:pressed, QPushButton::checked, QPushButton::hover { color: #e2e5e5; border-radius: 3px; padding: 3px; border: 1px solid #181819; background-color: #393941; }");
+		QPalette p = QApplication::palette();
+		p.setColor(QPalette::Disabled, QPalette::Light, QColor(89,89,102));
+		QApplication::setPalette(p);
+	}
 
 	initShortCuts();
 	readConfiguration();
@@ -318,7 +358,7 @@ int main(int argc, char* argv[])
 	if (config.useDenormalBias)
 		printf("Denormal protection enabled.\n");
 	// SHOW SPLASH SCREEN
-	if (config.showSplashScreen)
+	if (config.showSplashScreen && !batchMode)
 	{
 		QPixmap splsh(oomGlobalShare + "/splash.png");
 
@@ -336,7 +376,7 @@ int main(int argc, char* argv[])
 	}
 	
 	//Start Linuxsampler
-	if(config.lsClientStartLS)
+	if(config.lsClientStartLS && !batchMode)
 	{
 		gLSThread = new LSThread();
 		gLSThread->start();
@@ -344,7 +384,7 @@ int main(int argc, char* argv[])
 
 	int i;
 
-	QString optstr("ahvdDmMsP:Y:l:py");
+	QString optstr("ahvdDmMsP:Y:l:pyo:");
 #ifdef HAVE_LASH
 	optstr += QString("L");
 #endif
@@ -352,7 +392,22 @@ int main(int argc, char* argv[])
 	optstr += QString("U");
 #endif
 
-	while ((i = getopt(argc, argv, optstr.toLatin1().constData())) != EOF)
+	static struct option longOptions[] = {
+		{"render", required_argument, 0, 'R'},
+		{"output", required_argument, 0, 'o'},
+		{"range", required_argument, 0, 'r'},
+		{"convert", required_argument, 0, 'C'},
+		{"bench-load", required_argument, 0, 'B'},
+		{"bench-graph", required_argument, 0, 'G'},
+		{"bench-fades", required_argument, 0, 'W'},
+		{"bench-fifo", required_argument, 0, 'F'},
+		{"bench-dsp", required_argument, 0, 'K'},
+		{"bench-tempo", required_argument, 0, 'E'},
+		{"bench-synth", required_argument, 0, 'N'},
+		{0, 0, 0, 0}
+	};
+
+	while ((i = getopt_long(argc, argv, optstr.toLatin1().constData(), longOptions, 0)) != EOF)
 	{
 		char c = (char) i;
 		switch (c)
@@ -388,6 +443,28 @@ int main(int argc, char* argv[])
 				break;
 			case 'U': gJackSessionUUID = QString(optarg);
 				break;
+			case 'R': renderProjectFile = QString(optarg);
+				break;
+			case 'o': outputFile = QString(optarg);
+				break;
+			case 'r': renderRange = QString(optarg);
+				break;
+			case 'C': convertFile = QString(optarg);
+				break;
+			case 'B': benchFile = QString(optarg);
+				break;
+			case 'G': benchGraphFile = QString(optarg);
+				break;
+			case 'W': benchFadesFile = QString(optarg);
+				break;
+			case 'F': benchFifoSeconds = atoi(optarg);
+				break;
+			case 'K': benchDspFrames = atoi(optarg);
+				break;
+			case 'E': benchTempoEvents = atoi(optarg);
+				break;
+			case 'N': benchSynthCycles = atoi(optarg);
+				break;
 			case 'h': usage(argv[0], argv[1]);
 				return -1;
 			default: usage(argv[0], "bad argument");
@@ -395,8 +472,54 @@ int main(int argc, char* argv[])
 		}
 	}
 
+	if (!convertFile.isEmpty())
+	{
+		if (outputFile.isEmpty())
+		{
+			usage(argv[0], "--convert needs an output file");
+			return -1;
+		}
+		return convertProject(convertFile, outputFile);
+	}
+	if (!benchFile.isEmpty())
+		return benchProjectLoad(benchFile);
+
 	AL::initDsp();
 
+	if (benchFifoSeconds > 0)
+		return benchFifo(benchFifoSeconds);
+	if (benchTempoEvents > 0)
+		return benchTempoMap(benchTempoEvents);
+#if defined(__i386__) || defined(__x86_64__)
+	if (benchDspFrames > 0)
+		return AL::benchX86Dsp(benchDspFrames);
+#endif
+
+	if (batchMode)
+	{
+		if (outputFile.isEmpty() && benchGraphFile.isEmpty() && benchFadesFile.isEmpty() && benchSynthCycles <= 0)
+		{
+			usage(argv[0], "--render needs an output file");
+			return -1;
+		}
+		// the dummy driver is clocked by the renderer, not by a timer
+		sampleRate = config.dummyAudioSampleRate;
+		segmentSize = config.dummyAudioBufSize;
+		initDummyAudio();
+		realTimeScheduling = false;
+		fifoLength = 131072 / segmentSize;
+		if (loadPlugins)
+			initPlugins(config.loadLADSPA, config.loadLV2, config.loadVST);
+		initMetronome();
+		if (!benchGraphFile.isEmpty())
+			return benchAudioGraph(benchGraphFile, renderRange);
+		if (!benchFadesFile.isEmpty())
+			return benchWaveFades(benchFadesFile);
+		if (benchSynthCycles > 0)
+			return benchSynthEvents(benchSynthCycles);
+		return renderProject(renderProjectFile, outputFile, renderRange);
+	}
+
 	if (debugMsg)
 		printf("Start euid: %d ruid: %d, Now euid %d\n",
 			euid, ruid, geteuid());
@@ -17,6 +17,7 @@
 //#include "midiedit/drummap.h"  // p4.0.2
 #include "event.h"
 #include "globals.h"
+#include "midieventstore.h"
 #include "midictrl.h"
 #include "marker/marker.h"
 #include "midiport.h"
@@ -31,6 +32,7 @@
 #include "midiseq.h"
 #include "gconfig.h"
 #include "ticksynth.h"
+#include "dspload.h"
 
 extern void dump(const unsigned char* p, int n);
 
@@ -258,6 +260,7 @@ void buildMidiEventList(EventList* del, const MPEventList* el, MidiTrack* track,
 	int datah = 0;
 	int datal = 0;
 	int dataType = 0; // 0 : disabled, 0x20000 : rpn, 0x30000 : nrpn
+	bool tempoChanged = false;
 
 	EventList mel;
 
@@ -512,6 +515,7 @@ void buildMidiEventList(EventList* del, const MPEventList* el, MidiTrack* track,
 						unsigned ltick = CALC_TICK(tick); // (unsigned(tick) * unsigned(config.division) + unsigned(div/2)) / unsigned(div);
 						// After ca 10 mins 32 bits will not be enough... This expression has to be changed/factorized or so in some "sane" way...
 						tempomap.addTempo(ltick, tempo);
+						tempoChanged = true;
 					}
 						break;
 					case 0x58: // Time Signature
@@ -669,6 +673,8 @@ void buildMidiEventList(EventList* del, const MPEventList* el, MidiTrack* track,
 		ev.setTick(tick);
 		del->add(ev);
 	}
+	if (tempoChanged)
+		tempomap.update();
 }
 
 //---------------------------------------------------------
@@ -848,6 +854,158 @@ void Audio::initDevices()
 	}
 }
 
+//---------------------------------------------------------
+//   collectEvent
+//    queue one event of a part, E is an Event or, when
+//    the part has an up to date playback store, a
+//    PackedEvent
+//---------------------------------------------------------
+
+template <class E>
+void Audio::collectEvent(MidiTrack* track, const E& ev, unsigned offset, int defaultPort, int& channel,
+		MPEventList* playEvents, MPEventList* stuckNotes, TempoCursor& tempo)
+{
+	int port = defaultPort;
+	//
+	//  dont play any meta events
+	//
+	if (ev.type() == Meta)
+		return;
+	if (track->type() == Track::DRUM)
+	{
+		int instr = ev.pitch();
+		// ignore muted drums
+		if (ev.isNote() && drumMap[instr].mute)
+			return;
+	}
+	unsigned tick = ev.tick() + offset;
+	unsigned frame = tempo.tick2frame(tick) + frameOffset;
+	switch (ev.type())
+	{
+		case Note:
+		{
+			int len = ev.lenTick();
+			int pitch = ev.pitch();
+			int velo = ev.velo();
+			if (track->type() == Track::DRUM)
+			{
+				//
+				// Map drum-notes to the drum-map values
+				//
+				int instr = ev.pitch();
+				pitch = drumMap[instr].anote;
+				port = drumMap[instr].port; //This changes to non-default port
+				channel = drumMap[instr].channel;
+				velo = int(double(velo) * (double(drumMap[instr].vol) / 100.0));
+			}
+			else
+			{
+				//
+				// transpose non drum notes
+				//
+				pitch += /*(track->getTransposition() +*/ song->globalPitchShift();
+			}
+
+			if (pitch > 127)
+				pitch = 127;
+			if (pitch < 0)
+				pitch = 0;
+			velo += track->velocity;
+			velo = (velo * track->compression) / 100;
+			if (velo > 127)
+				velo = 127;
+			if (velo < 1) // no off event
+				velo = 1;
+			len = (len * track->len) / 100;
+			if (len <= 0) // dont allow zero length
+				len = 1;
+			int veloOff = ev.veloOff();
+
+			if (port == defaultPort)
+			{
+				//printf("Adding event normally: frame=%d port=%d channel=%d pitch=%d velo=%d\n",frame, port, channel, pitch, velo);
+
+				// p3.3.25
+				// If syncing to external midi sync, we cannot use the tempo map.
+				// Therefore we cannot get sub-tick resolution. Just use ticks instead of frames.
+				if (extSyncFlag.value())
+					playEvents->add(MidiPlayEvent(tick, port, channel, 0x90, pitch, velo, (Track*)track));
+				else
+					playEvents->add(MidiPlayEvent(frame, port, channel, 0x90, pitch, velo, (Track*)track));
+
+				stuckNotes->add(MidiPlayEvent(tick + len, port, channel, veloOff ? 0x80 : 0x90, pitch, veloOff, (Track*)track));
+			}
+			else
+			{ //Handle events to different port than standard.
+				MidiDevice* mdAlt = midiPorts[port].device();
+				if (mdAlt)
+				{
+					if (extSyncFlag.value())
+						mdAlt->playEvents()->add(MidiPlayEvent(tick, port, channel, 0x90, pitch, velo, (Track*)track));
+					else
+						mdAlt->playEvents()->add(MidiPlayEvent(frame, port, channel, 0x90, pitch, velo, (Track*)track));
+
+					mdAlt->stuckNotes()->add(MidiPlayEvent(tick + len, port, channel, veloOff ? 0x80 : 0x90, pitch, veloOff, (Track*)track));
+				}
+			}
+
+			if (velo > track->activity())
+				track->setActivity(velo);
+		}
+			break;
+
+			// Added by T356.
+		case Controller:
+		{
+			//int len   = ev.lenTick();
+			//int pitch = ev.pitch();
+			if (track->type() == Track::DRUM)
+			{
+				int ctl = ev.dataA();
+				// Is it a drum controller event, according to the track port's instrument?
+				MidiController *mc = midiPorts[defaultPort].drumController(ctl);
+				if (mc)
+				{
+					int instr = ctl & 0x7f;
+					ctl &= ~0xff;
+					int pitch = drumMap[instr].anote & 0x7f;
+					port = drumMap[instr].port; //This changes to non-default port
+					channel = drumMap[instr].channel;
+					MidiDevice* mdAlt = midiPorts[port].device();
+					if (mdAlt)
+					{
+						// p3.3.25
+						// If syncing to external midi sync, we cannot use the tempo map.
+						// Therefore we cannot get sub-tick resolution. Just use ticks instead of frames.
+						if (extSyncFlag.value())
+							mdAlt->playEvents()->add(MidiPlayEvent(tick, port, channel, ME_CONTROLLER, ctl | pitch, ev.dataB(), (Track*)track));
+						else
+
+							mdAlt->playEvents()->add(MidiPlayEvent(frame, port, channel, ME_CONTROLLER, ctl | pitch, ev.dataB(), (Track*)track));
+
+					}
+					break;
+				}
+			}
+			// p3.3.25
+			if (extSyncFlag.value())
+				playEvents->add(MidiPlayEvent(tick, port, channel, ev, (Track*)track));
+			else
+				playEvents->add(MidiPlayEvent(frame, port, channel, ev, (Track*)track));
+		}
+			break;
+
+
+		default:
+			if (extSyncFlag.value())
+				playEvents->add(MidiPlayEvent(tick, port, channel, ev, (Track*)track));
+			else
+				playEvents->add(MidiPlayEvent(frame, port, channel, ev, (Track*)track));
+
+			break;
+	}
+}
+
 //---------------------------------------------------------
 //   collectEvents
 //    collect events for next audio segment
@@ -863,6 +1021,9 @@ void Audio::collectEvents(MidiTrack* track, unsigned int cts, unsigned int nts)
 	MPEventList* playEvents = md->playEvents();
 	MPEventList* stuckNotes = md->stuckNotes();
 
+	// the events of a part are sorted, most lookups stay in one tempo segment
+	TempoCursor tempo(&tempomap);
+
 	PartList* pl = track->parts();
 	for (iPart p = pl->begin(); p != pl->end(); ++p)
 	{
@@ -890,151 +1051,22 @@ void Audio::collectEvents(MidiTrack* track, unsigned int cts, unsigned int nts)
 		if (etick > partLen)
 			continue;
 
-		iEvent ie = events->lower_bound(stick);
-		iEvent iend = events->lower_bound(etick);
-
-		for (; ie != iend; ++ie)
+		const MidiEventStore* store = events->store();
+		if (store)
 		{
-			Event ev = ie->second;
-			port = defaultPort; //Reset each loop
-			//
-			//  dont play any meta events
-			//
-			if (ev.type() == Meta)
-				continue;
-			if (track->type() == Track::DRUM)
-			{
-				int instr = ev.pitch();
-				// ignore muted drums
-				if (ev.isNote() && drumMap[instr].mute)
-					continue;
-			}
-			unsigned tick = ev.tick() + offset;
-			unsigned frame = tempomap.tick2frame(tick) + frameOffset;
-			switch (ev.type())
-			{
-				case Note:
-				{
-					int len = ev.lenTick();
-					int pitch = ev.pitch();
-					int velo = ev.velo();
-					if (track->type() == Track::DRUM)
-					{
-						//
-						// Map drum-notes to the drum-map values
-						//
-						int instr = ev.pitch();
-						pitch = drumMap[instr].anote;
-						port = drumMap[instr].port; //This changes to non-default port
-						channel = drumMap[instr].channel;
-						velo = int(double(velo) * (double(drumMap[instr].vol) / 100.0));
-					}
-					else
-					{
-						//
-						// transpose non drum notes
-						//
-						pitch += /*(track->getTransposition() +*/ song->globalPitchShift();
-					}
-
-					if (pitch > 127)
-						pitch = 127;
-					if (pitch < 0)
-						pitch = 0;
-					velo += track->velocity;
-					velo = (velo * track->compression) / 100;
-					if (velo > 127)
-						velo = 127;
-					if (velo < 1) // no off event
-						velo = 1;
-					len = (len * track->len) / 100;
-					if (len <= 0) // dont allow zero length
-						len = 1;
-					int veloOff = ev.veloOff();
-
-					if (port == defaultPort)
-					{
-						//printf("Adding event normally: frame=%d port=%d channel=%d pitch=%d velo=%d\n",frame, port, channel, pitch, velo);
-
-						// p3.3.25
-						// If syncing to external midi sync, we cannot use the tempo map.
-						// Therefore we cannot get sub-tick resolution. Just use ticks instead of frames.
-						if (extSyncFlag.value())
-							playEvents->add(MidiPlayEvent(tick, port, channel, 0x90, pitch, velo, (Track*)track));
-						else
-							playEvents->add(MidiPlayEvent(frame, port, channel, 0x90, pitch, velo, (Track*)track));
-
-						stuckNotes->add(MidiPlayEvent(tick + len, port, channel, veloOff ? 0x80 : 0x90, pitch, veloOff, (Track*)track));
-					}
-					else
-					{ //Handle events to different port than standard.
-						MidiDevice* mdAlt = midiPorts[port].device();
-						if (mdAlt)
-						{
-							if (extSyncFlag.value())
-								mdAlt->playEvents()->add(MidiPlayEvent(tick, port, channel, 0x90, pitch, velo, (Track*)track));
-							else
-								mdAlt->playEvents()->add(MidiPlayEvent(frame, port, channel, 0x90, pitch, velo, (Track*)track));
-
-							mdAlt->stuckNotes()->add(MidiPlayEvent(tick + len, port, channel, veloOff ? 0x80 : 0x90, pitch, veloOff, (Track*)track));
-						}
-					}
-
-					if (velo > track->activity())
-						track->setActivity(velo);
-				}
-					break;
-
-					// Added by T356.
-				case Controller:
-				{
-					//int len   = ev.lenTick();
-					//int pitch = ev.pitch();
-					if (track->type() == Track::DRUM)
-					{
-						int ctl = ev.dataA();
-						// Is it a drum controller event, according to the track port's instrument?
-						MidiController *mc = midiPorts[defaultPort].drumController(ctl);
-						if (mc)
-						{
-							int instr = ctl & 0x7f;
-							ctl &= ~0xff;
-							int pitch = drumMap[instr].anote & 0x7f;
-							port = drumMap[instr].port; //This changes to non-default port
-							channel = drumMap[instr].channel;
-							MidiDevice* mdAlt = midiPorts[port].device();
-							if (mdAlt)
-							{
-								// p3.3.25
-								// If syncing to external midi sync, we cannot use the tempo map.
-								// Therefore we cannot get sub-tick resolution. Just use ticks instead of frames.
-								if (extSyncFlag.value())
-									mdAlt->playEvents()->add(MidiPlayEvent(tick, port, channel, ME_CONTROLLER, ctl | pitch, ev.dataB(), (Track*)track));
-								else
-
-									mdAlt->playEvents()->add(MidiPlayEvent(frame, port, channel, ME_CONTROLLER, ctl | pitch, ev.dataB(), (Track*)track));
-
-							}
-							break;
-						}
-					}
-					// p3.3.25
-					if (extSyncFlag.value())
-						playEvents->add(MidiPlayEvent(tick, port, channel, ev, (Track*)track));
-					else
-						playEvents->add(MidiPlayEvent(frame, port, channel, ev, (Track*)track));
-				}
-					break;
-
-
-				default:
-					if (extSyncFlag.value())
-						playEvents->add(MidiPlayEvent(tick, port, channel, ev, (Track*)track));
-					else
-						playEvents->add(MidiPlayEvent(frame, port, channel, ev, (Track*)track));
-
-					break;
-			}
+			int iend = store->lowerBound(etick);
+			for (int i = store->lowerBound(stick); i < iend; ++i)
+				collectEvent(track, PackedEvent(store, i), offset, defaultPort, channel,
+						playEvents, stuckNotes, tempo);
+		}
+		else
+		{
+			// changed since the last store was made
+			iEvent ie = events->lower_bound(stick);
+			iEvent iend = events->lower_bound(etick);
+			for (; ie != iend; ++ie)
+				collectEvent(track, ie->second, offset, defaultPort, channel,
+						playEvents, stuckNotes, tempo);
 		}
 	}
 }
@@ -1050,6 +1082,7 @@ void Audio::collectEvents(MidiTrack* track, unsigned int cts, unsigned int nts)
 
 void Audio::processMidi()
 {
+	DspLoadScope load(DSP_LOAD_MIDI, this);
 	midiBusy = true;
 	//
 	// TODO: syntis should directly write into recordEventList
@@ -1353,6 +1386,7 @@ void Audio::processMidi()
 		MPEventList* stuckNotes = md->stuckNotes();
 		MPEventList* playEvents = md->playEvents();
 
+		TempoCursor tempo(&tempomap);
 		iMPEvent k;
 		for (k = stuckNotes->begin(); k != stuckNotes->end(); ++k)
 		{
@@ -1366,7 +1400,7 @@ void Audio::processMidi()
 			}
 			else
 			{
-				int frame = tempomap.tick2frame(k->time()) + frameOffset;
+				int frame = tempo.tick2frame(k->time()) + frameOffset;
 				ev.setTime(frame);
 			}
 
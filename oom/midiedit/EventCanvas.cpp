@@ -165,7 +165,22 @@ void EventCanvas::songChanged(int flags)/*{{{*/
 
 	if (flags & ~SC_SELECTION)
 	{
-		_items.clear();
+		// if only events changed, renew the items of the parts
+		// they are in and keep the others
+		const SongChangeSet& changes = song->changes();
+		bool partial = changes.flags() == flags && changes.eventsOnly();
+		if (partial)
+		{
+			for (iCItem k = _items.begin(); k != _items.end();)
+			{
+				if (changes.hasPart(k->second->part()))
+					_items.erase(k++);
+				else
+					++k;
+			}
+		}
+		else
+			_items.clear();
 		start_tick = MAXINT;
 		end_tick = 0;
 	_curPart = 0;
@@ -183,6 +198,8 @@ void EventCanvas::songChanged(int flags)/*{{{*/
 			if (etick > end_tick)
 				end_tick = etick;
 
+			if (partial && !changes.hasPart(part))
+				continue;
 			EventList* el = part->events();
 			for (iEvent i = el->begin(); i != el->end(); ++i)
 			{
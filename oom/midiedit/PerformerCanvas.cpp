@@ -1276,6 +1276,7 @@ void PerformerCanvas::cmd(int cmd, int quantStrength, int quantLimit, bool quant
 		case CMD_CUT:
 			copy();
 			song->startUndo();
+			audio->startBatch();
 			for (iCItem i = _items.begin(); i != _items.end(); ++i)
 			{
 				if (!(i->second->isSelected()))
@@ -1285,6 +1286,7 @@ void PerformerCanvas::cmd(int cmd, int quantStrength, int quantLimit, bool quant
 				// Indicate no undo, and do not do port controller values and clone parts.
 				audio->msgDeleteEvent(ev, e->part(), false, false, false);
 			}
+			audio->endBatch();
 			song->endUndo(SC_EVENT_REMOVED);
 			break;
 		case CMD_COPY:
@@ -1533,6 +1535,7 @@ void PerformerCanvas::cmd(int cmd, int quantStrength, int quantLimit, bool quant
 			int offset = w.offsetVal();
 
 			song->startUndo();
+			audio->startBatch();
 			for (iCItem k = _items.begin(); k != _items.end(); ++k)
 			{
 				NEvent* nevent = (NEvent*) (k->second);
@@ -1565,6 +1568,7 @@ void PerformerCanvas::cmd(int cmd, int quantStrength, int quantLimit, bool quant
 					}
 				}
 			}
+			audio->endBatch();
 			song->endUndo(SC_EVENT_MODIFIED);
 		}
 			break;
@@ -1580,6 +1584,7 @@ void PerformerCanvas::cmd(int cmd, int quantStrength, int quantLimit, bool quant
 			int offset = w.offsetVal();
 
 			song->startUndo();
+			audio->startBatch();
 	    	for (iCItem k = _items.begin(); k != _items.end(); ++k)
 			{
 				NEvent* nevent = (NEvent*) (k->second);
@@ -1615,6 +1620,7 @@ void PerformerCanvas::cmd(int cmd, int quantStrength, int quantLimit, bool quant
 					}
 				}
 			}
+			audio->endBatch();
 			song->endUndo(SC_EVENT_MODIFIED);
 		}
 			break;
@@ -1623,6 +1629,7 @@ void PerformerCanvas::cmd(int cmd, int quantStrength, int quantLimit, bool quant
 			if (!selectionSize())
 				break;
 			song->startUndo();
+			audio->startBatch();
 			for (iCItem k = _items.begin(); k != _items.end(); ++k)
 			{
 				if (k->second->isSelected())
@@ -1636,6 +1643,7 @@ void PerformerCanvas::cmd(int cmd, int quantStrength, int quantLimit, bool quant
 					audio->msgChangeEvent(event, newEvent, nevent->part(), false, false, false);
 				}
 			}
+			audio->endBatch();
 			song->endUndo(SC_EVENT_MODIFIED);
 			break;
 
@@ -1644,6 +1652,7 @@ void PerformerCanvas::cmd(int cmd, int quantStrength, int quantLimit, bool quant
 				break;
 
 			song->startUndo();
+			audio->startBatch();
 	    	for (iCItem k = _items.begin(); k != _items.end(); k++)
 			{
 				if (k->second->isSelected() == false)
@@ -1709,6 +1718,7 @@ void PerformerCanvas::cmd(int cmd, int quantStrength, int quantLimit, bool quant
 					audio->msgChangeEvent(ce1, newEvent, e1->part(), false, false, false);
 				}
 			}
+			audio->endBatch();
 			song->endUndo(SC_EVENT_MODIFIED);
 			break;
 
@@ -1739,6 +1749,7 @@ void PerformerCanvas::cmd(int cmd, int quantStrength, int quantLimit, bool quant
 void PerformerCanvas::quantize(int strength, int limit, bool quantLen)/*{{{*/
 {
 	song->startUndo();
+	audio->startBatch();
     for (iCItem k = _items.begin(); k != _items.end(); ++k)
 	{
 		NEvent* nevent = (NEvent*) (k->second);
@@ -1780,6 +1791,7 @@ void PerformerCanvas::quantize(int strength, int limit, bool quantLen)/*{{{*/
 			audio->msgChangeEvent(event, newEvent, part, false, false, false);
 		}
 	}
+	audio->endBatch();
 	song->endUndo(SC_EVENT_MODIFIED);
 }/*}}}*/
 
@@ -0,0 +1,83 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#include "midieventstore.h"
+
+//---------------------------------------------------------
+//   MidiEventStore
+//---------------------------------------------------------
+
+MidiEventStore::MidiEventStore(const EventList* el, unsigned serial)
+{
+	_serial = serial;
+
+	int n = 0;
+	unsigned sysexLen = 0;
+	for (ciEvent i = el->begin(); i != el->end(); ++i)
+	{
+		const Event& ev = i->second;
+		if (ev.type() == Meta)
+			continue;
+		++n;
+		if (ev.type() == Sysex)
+			sysexLen += ev.dataLen();
+	}
+	_tick.reserve(n);
+	_len.reserve(n);
+	_a.reserve(n);
+	_b.reserve(n);
+	_c.reserve(n);
+	_type.reserve(n);
+	_sysex.reserve(sysexLen);
+
+	for (ciEvent i = el->begin(); i != el->end(); ++i)
+	{
+		const Event& ev = i->second;
+		EventType type = ev.type();
+		if (type == Meta)
+			continue;
+		_tick.push_back(i->first);
+		_type.push_back(type);
+		if (type == Sysex)
+		{
+			_len.push_back(0);
+			_a.push_back(_sysex.size());
+			_b.push_back(ev.dataLen());
+			_c.push_back(0);
+			_sysex.insert(_sysex.end(), ev.data(), ev.data() + ev.dataLen());
+		}
+		else
+		{
+			_len.push_back(type == Note ? ev.lenTick() : 0);
+			_a.push_back(ev.dataA());
+			_b.push_back(ev.dataB());
+			_c.push_back(ev.dataC());
+		}
+	}
+}
+
+//---------------------------------------------------------
+//   lowerBound
+//    index of the first event at or after tick, like
+//    EventList::lower_bound()
+//---------------------------------------------------------
+
+int MidiEventStore::lowerBound(unsigned tick) const
+{
+	int lo = 0;
+	int hi = _tick.size();
+	while (lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		if (_tick[mid] < tick)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return lo;
+}
+
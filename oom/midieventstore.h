@@ -0,0 +1,177 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#ifndef __MIDIEVENTSTORE_H__
+#define __MIDIEVENTSTORE_H__
+
+#include <vector>
+
+#include "event.h"
+
+//---------------------------------------------------------
+//   MidiEventStore
+//    Immutable playback copy of the event list of a midi
+//    part, one array per field and sorted by tick. A note
+//    takes 18 bytes here instead of a map node, an Event
+//    and its EventBase on the heap, and the playback scan
+//    walks the arrays in order.
+//    Meta events are never played and are left out. The
+//    bytes of sysex events are kept in a side table, dataA
+//    is their offset and dataB their length.
+//---------------------------------------------------------
+
+class MidiEventStore
+{
+    std::vector<unsigned> _tick;
+    std::vector<unsigned> _len; // note length in ticks
+    std::vector<int> _a;
+    std::vector<int> _b;
+    std::vector<unsigned char> _c;
+    std::vector<unsigned char> _type;
+    std::vector<unsigned char> _sysex;
+    unsigned _serial; // EventList serial this was made from
+
+public:
+    MidiEventStore(const EventList*, unsigned serial);
+
+    unsigned serial() const
+    {
+        return _serial;
+    }
+
+    int size() const
+    {
+        return _tick.size();
+    }
+
+    int lowerBound(unsigned tick) const;
+
+    unsigned tick(int i) const
+    {
+        return _tick[i];
+    }
+
+    unsigned lenTick(int i) const
+    {
+        return _len[i];
+    }
+
+    EventType type(int i) const
+    {
+        return EventType(_type[i]);
+    }
+
+    int dataA(int i) const
+    {
+        return _a[i];
+    }
+
+    int dataB(int i) const
+    {
+        return _b[i];
+    }
+
+    int dataC(int i) const
+    {
+        return _c[i];
+    }
+
+    // only sysex events have bytes, dataA and dataB of the
+    // others are the controller or note values
+
+    const unsigned char* data(int i) const
+    {
+        return _type[i] == Sysex && _b[i] ? &_sysex[_a[i]] : 0;
+    }
+
+    int dataLen(int i) const
+    {
+        return _type[i] == Sysex ? _b[i] : 0;
+    }
+};
+
+//---------------------------------------------------------
+//   PackedEvent
+//    one event of a MidiEventStore with the accessors of
+//    Event which the playback needs
+//---------------------------------------------------------
+
+class PackedEvent
+{
+    const MidiEventStore* _store;
+    int _idx;
+
+public:
+    PackedEvent(const MidiEventStore* store, int idx)
+    {
+        _store = store;
+        _idx = idx;
+    }
+
+    EventType type() const
+    {
+        return _store->type(_idx);
+    }
+
+    bool isNote() const
+    {
+        return type() == Note;
+    }
+
+    unsigned tick() const
+    {
+        return _store->tick(_idx);
+    }
+
+    unsigned lenTick() const
+    {
+        return _store->lenTick(_idx);
+    }
+
+    int dataA() const
+    {
+        return _store->dataA(_idx);
+    }
+
+    int pitch() const
+    {
+        return _store->dataA(_idx);
+    }
+
+    int dataB() const
+    {
+        return _store->dataB(_idx);
+    }
+
+    int velo() const
+    {
+        return _store->dataB(_idx);
+    }
+
+    int dataC() const
+    {
+        return _store->dataC(_idx);
+    }
+
+    int veloOff() const
+    {
+        return _store->dataC(_idx);
+    }
+
+    const unsigned char* data() const
+    {
+        return _store->data(_idx);
+    }
+
+    int dataLen() const
+    {
+        return _store->dataLen(_idx);
+    }
+};
+
+#endif
+
@@ -564,7 +564,7 @@ void MidiMonitor::processMsg1(const void* m)/*{{{*/
 										if(!auxMap->isEmpty() && auxMap->contains(CTRL_AUX1))
 										{
 											//printf("auxSend\n");
-											((AudioTrack*) info->track())->setAuxSend(auxMap->value(CTRL_AUX1), dbToTrackVol(midiToDb(msg->mevent.dataB())), true);
+											audio->msgSetAux((AudioTrack*) info->track(), auxMap->value(CTRL_AUX1), dbToTrackVol(midiToDb(msg->mevent.dataB())));
 											song->update(SC_AUX);
 										}
 									}/*}}}*/
@@ -577,7 +577,7 @@ void MidiMonitor::processMsg1(const void* m)/*{{{*/
 										if(!auxMap->isEmpty() && auxMap->contains(CTRL_AUX2))
 										{
 											//printf("auxSend\n");
-											((AudioTrack*) info->track())->setAuxSend(auxMap->value(CTRL_AUX2), dbToTrackVol(midiToDb(msg->mevent.dataB())), true);
+											audio->msgSetAux((AudioTrack*) info->track(), auxMap->value(CTRL_AUX2), dbToTrackVol(midiToDb(msg->mevent.dataB())));
 											song->update(SC_AUX);
 										}
 									}/*}}}*/
@@ -590,7 +590,7 @@ void MidiMonitor::processMsg1(const void* m)/*{{{*/
 										if(!auxMap->isEmpty() && auxMap->contains(CTRL_AUX3))
 										{
 											//printf("auxSend\n");
-											((AudioTrack*) info->track())->setAuxSend(auxMap->value(CTRL_AUX3), dbToTrackVol(midiToDb(msg->mevent.dataB())), true);
+											audio->msgSetAux((AudioTrack*) info->track(), auxMap->value(CTRL_AUX3), dbToTrackVol(midiToDb(msg->mevent.dataB())));
 											song->update(SC_AUX);
 										}
 									}/*}}}*/
@@ -603,7 +603,7 @@ void MidiMonitor::processMsg1(const void* m)/*{{{*/
 										if(!auxMap->isEmpty() && auxMap->contains(CTRL_AUX4))
 										{
 											//printf("auxSend\n");
-											((AudioTrack*) info->track())->setAuxSend(auxMap->value(CTRL_AUX4), dbToTrackVol(midiToDb(msg->mevent.dataB())), true);
+											audio->msgSetAux((AudioTrack*) info->track(), auxMap->value(CTRL_AUX4), dbToTrackVol(midiToDb(msg->mevent.dataB())));
 											song->update(SC_AUX);
 										}
 									}/*}}}*/
@@ -74,11 +74,14 @@ void MidiSeq::processMsg(const ThreadMsg* m)
 			break;
 		case SEQM_ADD_TRACK:
 			song->insertTrackRealtime(msg->track, msg->ival);
+			song->swapAuxSends((AuxSendSwapList*) msg->p1);
 			updatePollFd();
 			break;
 		case SEQM_REMOVE_TRACK:
 			song->cmdRemoveTrack(msg->track);
+			song->swapAuxSends((AuxSendSwapList*) msg->p1);
 			updatePollFd();
+			break;
 		case SEQM_REMOVE_TRACK_GROUP:
 		{	
 			for(int i = 0; i < msg->list.size(); i++)
@@ -87,6 +90,7 @@ void MidiSeq::processMsg(const ThreadMsg* m)
 				if(track && track->id() != song->masterId() && track->id() != song->oomVerbId())
 					song->cmdRemoveTrack(track);
 			}
+			song->swapAuxSends((AuxSendSwapList*) msg->p1);
 			updatePollFd();
 		}
 		break;
@@ -52,6 +52,7 @@
 #include "mididev.h"
 #include "midiport.h"
 #include "midimonitor.h"
+#include "dspload.h"
 
 //---------------------------------------------------------
 //   AudioStrip
@@ -352,6 +353,20 @@ AudioStrip::AudioStrip(QWidget* parent, Track* at)
 	connect(autoType, SIGNAL(activated(int, int)), SLOT(setAutomationType(int, int)));
 	m_autoBox->addWidget(autoType);
 
+	m_dspLoad = new QLabel(this);
+	m_dspLoad->setFont(config.fonts[1]);
+	m_dspLoad->setAlignment(Qt::AlignCenter);
+	m_dspLoad->setToolTip(tr("DSP load per cycle: average / worst"));
+	m_dspLoad->hide();
+	m_autoBox->addWidget(m_dspLoad);
+
+	m_latency = new QLabel(this);
+	m_latency->setFont(config.fonts[1]);
+	m_latency->setAlignment(Qt::AlignCenter);
+	m_latency->hide();
+	m_autoBox->addWidget(m_latency);
+	m_latencyShown = 0;
+
 	m_btnPower->blockSignals(true);
 	updateOffState(); // init state
 	m_btnPower->blockSignals(false);
@@ -368,6 +383,49 @@ AudioStrip::~AudioStrip()
 	//delete rack;
 }
 
+//---------------------------------------------------------
+//   updateDspLoad
+//    microseconds per cycle of the track and its plugins
+//---------------------------------------------------------
+
+void AudioStrip::updateDspLoad()
+{
+	DspLoadStat stat;
+	if (!dspLoad.enabled())
+	{
+		if (m_dspLoad->isVisible())
+			m_dspLoad->hide();
+		return;
+	}
+	if (dspLoad.load(m_track, &stat))
+		m_dspLoad->setText(QString("%1/%2us").arg(stat.avg, 0, 'f', 0).arg(stat.worst, 0, 'f', 0));
+	else
+		m_dspLoad->setText("-");
+	if (!m_dspLoad->isVisible())
+		m_dspLoad->show();
+}
+
+//---------------------------------------------------------
+//   updateLatency
+//    latency of the track output after delay compensation
+//---------------------------------------------------------
+
+void AudioStrip::updateLatency()
+{
+	int latency = m_track->latency();
+	if (latency == m_latencyShown)
+		return;
+	m_latencyShown = latency;
+	if (latency == 0)
+	{
+		m_latency->hide();
+		return;
+	}
+	m_latency->setText(QString("%1ms").arg(latency * 1000.0 / sampleRate, 0, 'f', 1));
+	m_latency->setToolTip(tr("Output latency: %1 frames").arg(latency));
+	m_latency->show();
+}
+
 //---------------------------------------------------------
 //   heartBeat
 //---------------------------------------------------------
@@ -386,6 +444,8 @@ void AudioStrip::heartBeat()
 	Strip::heartBeat();
 	updateVolume();
 	updatePan();
+	updateDspLoad();
+	updateLatency();
 	bool usePixmap = false;
 	QColor sliderBgColor = g_trackColorListSelected.value(track->type());/*{{{*/
     switch(vuColorStrip)
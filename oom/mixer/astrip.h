@@ -81,6 +81,10 @@ class AudioStrip : public Strip
 	//QHash<qint64, DoubleLabel*> auxLabelList;
 	//QHash<qint64, QLabel*> auxNameLabelList;
 
+    QLabel* m_dspLoad; // shown while the dsp profiler runs
+    QLabel* m_latency; // shown while the output is late
+    int m_latencyShown;
+
     double volume;
     double panVal;
 
@@ -93,6 +97,8 @@ class AudioStrip : public Strip
     void updateVolume();
     void updatePan();
     void updateChannels();
+    void updateDspLoad();
+    void updateLatency();
 	//void updateAuxNames();
 protected:
 	void trackChanged();
@@ -10,6 +10,7 @@
 
 #include "helper.h"
 #include "event.h"
+#include "midieventstore.h"
 #include "midictrl.h"
 #include "midiport.h"
 #include "oom/midi.h"
@@ -70,6 +71,52 @@ MEvent::MEvent(unsigned tick, int port, int channel, const Event& e, Track* trk)
 	}
 }
 
+//---------------------------------------------------------
+//   MEvent
+//    from the playback store of a part
+//---------------------------------------------------------
+
+MEvent::MEvent(unsigned tick, int port, int channel, const PackedEvent& e, Track* trk)
+{
+	m_track = trk;
+	m_source = SystemSource;
+	setChannel(channel);
+	setTime(tick);
+	setPort(port);
+	setLoopNum(0);
+	switch (e.type())
+	{
+		case Note:
+			setType(ME_NOTEON);
+			setA(e.dataA());
+			setB(e.dataB());
+			break;
+		case Controller:
+			setType(ME_CONTROLLER);
+			setA(e.dataA()); // controller number
+			setB(e.dataB()); // controller value
+			break;
+		case PAfter:
+			setType(ME_POLYAFTER);
+			setA(e.dataA());
+			setB(e.dataB());
+			break;
+		case CAfter:
+			setType(ME_AFTERTOUCH);
+			setA(e.dataA());
+			setB(0);
+			break;
+		case Sysex:
+			setType(ME_SYSEX);
+			edata.setData(e.data(), e.dataLen());
+			break;
+		default:
+			printf("MEvent::MEvent(): event type %d not implemented\n",
+					type());
+			break;
+	}
+}
+
 //---------------------------------------------------------
 //   dump
 //---------------------------------------------------------
@@ -120,12 +167,11 @@ bool MEvent::operator<(const MEvent& e) const
 
 bool MidiFifo::put(const MidiPlayEvent& event)
 {
-	if (size < MIDI_FIFO_SIZE)
+	if (wcount - oom_load_acquire(&rcount) < (unsigned) MIDI_FIFO_SIZE)
 	{
 		fifo[wIndex] = event;
 		wIndex = (wIndex + 1) % MIDI_FIFO_SIZE;
-		// q_atomic_increment(&size);
-		++size;
+		oom_store_release(&wcount, wcount + 1);
 		return false;
 	}
 	return true;
@@ -139,8 +185,7 @@ MidiPlayEvent MidiFifo::get()
 {
 	MidiPlayEvent event(fifo[rIndex]);
 	rIndex = (rIndex + 1) % MIDI_FIFO_SIZE;
-	// q_atomic_decrement(&size);
-	--size;
+	oom_store_release(&rcount, rcount + 1);
 	return event;
 }
 
@@ -161,7 +206,7 @@ const MidiPlayEvent& MidiFifo::peek(int n)
 void MidiFifo::remove()
 {
 	rIndex = (rIndex + 1) % MIDI_FIFO_SIZE;
-	--size;
+	oom_store_release(&rcount, rcount + 1);
 }
 
 //---------------------------------------------------------
@@ -171,11 +216,11 @@ void MidiFifo::remove()
 
 bool MidiRecFifo::put(const MidiPlayEvent& event)
 {
-	if (size < MIDI_REC_FIFO_SIZE)
+	if (wcount - oom_load_acquire(&rcount) < (unsigned) MIDI_REC_FIFO_SIZE)
 	{
 		fifo[wIndex] = event;
 		wIndex = (wIndex + 1) % MIDI_REC_FIFO_SIZE;
-		++size;
+		oom_store_release(&wcount, wcount + 1);
 		return false;
 	}
 	return true;
@@ -189,7 +234,7 @@ MidiPlayEvent MidiRecFifo::get()
 {
 	MidiPlayEvent event(fifo[rIndex]);
 	rIndex = (rIndex + 1) % MIDI_REC_FIFO_SIZE;
-	--size;
+	oom_store_release(&rcount, rcount + 1);
 	return event;
 }
 
@@ -210,5 +255,5 @@ const MidiPlayEvent& MidiRecFifo::peek(int n)
 void MidiRecFifo::remove()
 {
 	rIndex = (rIndex + 1) % MIDI_REC_FIFO_SIZE;
-	--size;
+	oom_store_release(&rcount, rcount + 1);
 }
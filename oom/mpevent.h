@@ -14,12 +14,14 @@
 #include "evdata.h"
 #include "memory.h"
 #include "config.h"
+#include "lockfree.h"
 
 //#define MIDI_FIFO_SIZE    2100
 //#define MIDI_REC_FIFO_SIZE    160
 
 class Event;
 class EvData;
+class PackedEvent;
 class Track;
 
 //---------------------------------------------------------
@@ -69,6 +71,7 @@ public:
 		m_source = SystemSource;
     }
     MEvent(unsigned t, int port, int channel, const Event& e, Track* trk = 0);
+    MEvent(unsigned t, int port, int channel, const PackedEvent& e, Track* trk = 0);
 
     ~MEvent()
     {
@@ -290,6 +293,11 @@ public:
     {
     }
 
+    MidiPlayEvent(unsigned t, int port, int channel, const PackedEvent& e, Track* trk = 0)
+    : MEvent(t, port, channel, e, trk)
+    {
+    }
+
     ~MidiPlayEvent()
     {
     }
@@ -316,14 +324,19 @@ typedef MPEventList::const_iterator ciMPEvent;
 
 //---------------------------------------------------------
 //   MidiFifo
+//    single producer / single consumer, lock free
 //---------------------------------------------------------
 
 class MidiFifo
 {
     MidiPlayEvent fifo[MIDI_FIFO_SIZE];
-    volatile int size;
+    char _pad0[OOM_CACHE_LINE];
+    volatile unsigned wcount; // only touched by writer
     int wIndex;
+    char _pad1[OOM_CACHE_LINE];
+    volatile unsigned rcount; // only touched by reader
     int rIndex;
+    char _pad2[OOM_CACHE_LINE];
 
 public:
 
@@ -338,26 +351,39 @@ public:
 
     bool isEmpty() const
     {
-        return size == 0;
+        return getSize() == 0;
     }
 
+    //  not thread safe, reader and writer must be idle
     void clear()
     {
-        size = 0, wIndex = 0, rIndex = 0;
+        wIndex = 0, rIndex = 0;
+        oom_store_release(&rcount, 0);
+        oom_store_release(&wcount, 0);
     }
 
     int getSize() const
     {
-        return size;
+        unsigned r = oom_load_acquire(&rcount);
+        return oom_load_acquire(&wcount) - r;
     }
 };
 
+//---------------------------------------------------------
+//   MidiRecFifo
+//    single producer / single consumer, lock free
+//---------------------------------------------------------
+
 class MidiRecFifo
 {
 	MidiPlayEvent fifo[MIDI_REC_FIFO_SIZE];
-	volatile int size;
+	char _pad0[OOM_CACHE_LINE];
+	volatile unsigned wcount; // only touched by writer
 	int wIndex;
+	char _pad1[OOM_CACHE_LINE];
+	volatile unsigned rcount; // only touched by reader
 	int rIndex;
+	char _pad2[OOM_CACHE_LINE];
 
 public:
 	MidiRecFifo() { clear(); }
@@ -365,9 +391,9 @@ public:
 	MidiPlayEvent get();
 	const MidiPlayEvent& peek(int n = 0);
 	void remove();
-	bool isEmpty() const { return size == 0; }
-	void clear() { size = 0, wIndex = 0, rIndex = 0; }
-	int getSize() const { return size; }
+	bool isEmpty() const { return getSize() == 0; }
+	void clear() { wIndex = 0, rIndex = 0; oom_store_release(&rcount, 0); oom_store_release(&wcount, 0); }
+	int getSize() const { unsigned r = oom_load_acquire(&rcount); return oom_load_acquire(&wcount) - r; }
 };
 
 #endif
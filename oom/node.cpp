@@ -10,6 +10,9 @@
 #include <assert.h>
 #include <sndfile.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
 
 #include "node.h"
 #include "globals.h"
@@ -27,6 +30,8 @@
 #include "mididev.h"
 #include "midiport.h"
 #include "midimonitor.h"
+#include "diskwriter.h"
+#include "dspload.h"
 
 // Uncomment this (and make sure to set Jack buffer size high like 2048) 
 //  to see process flow messages.
@@ -312,12 +317,273 @@ void Track::setOff(bool val)
 	_off = val;
 }
 
+//---------------------------------------------------------
+//   processAuxSends
+//    mix the post-effect buffers into the aux send buffers
+//    of the auxes in the send table (see auxSendTable()),
+//    post fader sends use the per frame gain if the volume
+//    is automated (see volumeGain())
+//---------------------------------------------------------
+
+void AudioTrack::processAuxSends(int srcChans, unsigned nframes, float** buffer, const double* vol, float* const* gain)
+{
+	const AuxSendTable* t = oom_load_acquire(&_auxTable);
+	if (t == 0)
+		return;
+	for (AuxSendTable::const_iterator i = t->begin(); i != t->end(); ++i)
+	{
+		bool preaux = i->prefader;
+		float m = i->gain;
+		if (m <= 0.0001) // optimize
+			continue;
+		AudioAux* a = i->aux;
+		float** dst = a->sendBuffer();
+		int auxChannels = a->channels();
+		// Several tracks may send to the same aux from different graph workers.
+		a->lockSend();
+		if ((srcChans == 1 && auxChannels == 1) || srcChans == 2)
+		{
+			for (int ch = 0; ch < srcChans; ++ch)
+			{
+				float* db = dst[ch % auxChannels]; // no matter whether there's one or two dst buffers
+				float* sb = buffer[ch];
+				if (!preaux && gain)
+					AL::dsp->mixWithGainRamp(db, sb, gain[ch], nframes, m); // add to mix
+				else if(preaux)
+					AL::dsp->mixWithGain(db, sb, nframes, m); // dont add to mix
+				else
+					AL::dsp->mixWithGain(db, sb, nframes, m * vol[ch]); // add to mix
+			}
+		}
+		else if (srcChans == 1 && auxChannels == 2) // copy mono to both channels
+		{
+			for (int ch = 0; ch < auxChannels; ++ch)
+			{
+				float* db = dst[ch];
+				float* sb = buffer[0];
+				if (!preaux && gain)
+					AL::dsp->mixWithGainRamp(db, sb, gain[ch], nframes, m); // add to mix
+				else if(preaux)
+					AL::dsp->mixWithGain(db, sb, nframes, m); // dont add to mix
+				else
+					AL::dsp->mixWithGain(db, sb, nframes, m * vol[ch]); // add to mix
+			}
+		}
+		a->unlockSend();
+	}
+}
+
+//---------------------------------------------------------
+//   delayOutput
+//    plugin delay compensation, aligns the output with
+//    the other inputs of the tracks it is summed into.
+//    Returns the buffers to send to the auxes, they are
+//    aligned with the other sends of the auxes.
+//---------------------------------------------------------
+
+float** AudioTrack::delayOutput(int channels, unsigned nframes, float** buffer)
+{
+	LatencyDelay* d = oom_load_acquire(&_latencyDelay);
+	if (d)
+		return d->process(channels, nframes, buffer);
+	return buffer;
+}
+
+//---------------------------------------------------------
+//   applyVolumeRamp
+//    the 'apply volume' part of copyData/addData with a per
+//    frame gain for each output channel, see volumeGain()
+//---------------------------------------------------------
+
+void AudioTrack::applyVolumeRamp(int srcChans, float** buffer, int dstChannels, float** dstBuffer, unsigned nframes, float* const* gain, bool add)
+{
+	if (srcChans == dstChannels)
+	{
+		for (int c = 0; c < dstChannels; ++c)
+		{
+			const float* sp = buffer[c];
+			const float* g = gain[c & 1];
+			float* dp = dstBuffer[c];
+			double meter = 0.0;
+			for (unsigned k = 0; k < nframes; ++k)
+			{
+				float val = sp[k] * g[k];
+				if (add)
+					dp[k] += val;
+				else
+					dp[k] = val;
+				double f = fabs(val);
+				if (f > meter)
+					meter = f;
+			}
+			if (!_prefader)
+				postMeter(c, meter);
+		}
+	}
+	else if (srcChans == 1 && dstChannels == 2)
+	{
+		const float* sp = buffer[0];
+		double meter = 0.0;
+		for (unsigned k = 0; k < nframes; ++k)
+		{
+			float val = sp[k];
+			// the volume is the mean of both channel gains
+			double f = fabs(val) * (gain[0][k] + gain[1][k]) * 0.5;
+			if (f > meter)
+				meter = f;
+			if (add)
+			{
+				dstBuffer[0][k] += val * gain[0][k];
+				dstBuffer[1][k] += val * gain[1][k];
+			}
+			else
+			{
+				dstBuffer[0][k] = val * gain[0][k];
+				dstBuffer[1][k] = val * gain[1][k];
+			}
+		}
+		if (!_prefader)
+			postMeter(0, meter);
+	}
+	else if (srcChans == 2 && dstChannels == 1)
+	{
+		const float* sp1 = buffer[0];
+		const float* sp2 = buffer[1];
+		float* dp = dstBuffer[0];
+		double meter1 = 0.0;
+		double meter2 = 0.0;
+		for (unsigned k = 0; k < nframes; ++k)
+		{
+			float val1 = sp1[k] * gain[0][k];
+			float val2 = sp2[k] * gain[1][k];
+			double f1 = fabs(val1);
+			if (f1 > meter1)
+				meter1 = f1;
+			double f2 = fabs(val2);
+			if (f2 > meter2)
+				meter2 = f2;
+			if (add)
+				dp[k] += val1 + val2;
+			else
+				dp[k] = val1 + val2;
+		}
+		if (!_prefader)
+		{
+			postMeter(0, meter1);
+			postMeter(1, meter2);
+		}
+	}
+}
+
+//---------------------------------------------------------
+//   prepareData
+//    run the pre-volume part of copyData (input, plugin
+//    chain, aux sends, metering) and leave the
+//    result in outBuffers. The following copyData/addData
+//    calls of this cycle only apply volume and pan.
+//    Called by the AudioGraph workers.
+//---------------------------------------------------------
+
+void AudioTrack::prepareData(unsigned pos, unsigned nframes)
+{
+	DspLoadScope load(DSP_LOAD_TRACK, this);
+	if (processed())
+		return;
+
+	int srcChans = channels();
+	int srcTotalOutChans = totalOutChannels();
+	if (channels() == 1)
+		srcTotalOutChans = 1;
+
+	float* buffer[srcTotalOutChans];
+	float data[nframes * srcTotalOutChans];
+	for (int i = 0; i < srcTotalOutChans; ++i)
+		buffer[i] = data + i * nframes;
+
+	if (off() || !getData(pos, srcTotalOutChans, nframes, buffer) || (isMute() && !_prefader))
+	{
+		for (int i = 0; i < srcChans; ++i)
+			_meter[i] = 0.0;
+		_haveData = false;
+		_metered = true;
+		_processed = true;
+		return;
+	}
+
+	_efxPipe->apply(srcChans, nframes, buffer);
+	float** sendBuf = delayOutput(srcTotalOutChans, nframes, buffer);
+
+	double vol[2];
+	double _volume = volume();
+	double _pan = pan();
+	vol[0] = _volume * (1.0 - _pan);
+	vol[1] = _volume * (1.0 + _pan);
+	// per frame gain while volume or pan are automated
+	float gain0[nframes];
+	float gain1[nframes];
+	float* gain[2] = {gain0, gain1};
+	bool ramp = volumeGain(nframes, gain0, gain1);
+
+	if (hasAuxSend() && !isMute())
+		processAuxSends(srcChans, nframes, sendBuf, vol, ramp ? gain : 0);
+
+	// the postfader meter is taken here as well, see postMeter()
+	for (int i = 0; i < srcChans; ++i)
+	{
+		double meter = 0.0;
+		if (_prefader)
+			meter = AL::dsp->peak(buffer[i], nframes, 0.0);
+		else if (isMute())
+			meter = 0.0;
+		else if (ramp && srcChans == 1)
+		{
+			// the volume is the mean of both channel gains
+			for (unsigned k = 0; k < nframes; ++k)
+			{
+				double f = fabs(buffer[0][k]) * (gain0[k] + gain1[k]) * 0.5;
+				if (f > meter)
+					meter = f;
+			}
+		}
+		else if (ramp)
+		{
+			const float* g = gain[i & 1];
+			for (unsigned k = 0; k < nframes; ++k)
+			{
+				double f = fabs(buffer[i][k] * g[k]);
+				if (f > meter)
+					meter = f;
+			}
+		}
+		else
+			meter = AL::dsp->peak(buffer[i], nframes, 0.0) * (srcChans == 1 ? _volume : vol[i & 1]);
+		_meter[i] = meter;
+		if (_meter[i] > _peak[i])
+			_peak[i] = _meter[i];
+	}
+	_metered = true;
+
+	if (isMute())
+	{
+		_haveData = false;
+		_processed = true;
+		return;
+	}
+
+	for (int i = 0; i < srcTotalOutChans; ++i)
+		AL::dsp->cpy(outBuffers[i], buffer[i], nframes);
+
+	_haveData = true;
+	_processed = true;
+}
+
 //---------------------------------------------------------
 //   copyData
 //---------------------------------------------------------
 
 void AudioTrack::copyData(unsigned pos, int dstChannels, int srcStartChan, int srcChannels, unsigned nframes, float** dstBuffer)
 {
+	DspLoadScope load(DSP_LOAD_TRACK, this);
 	//Changed by T356. 12/12/09.
 	// Overhaul and streamline to eliminate multiple processing during one process loop.
 	// Was causing ticking sound with synths + multiple out routes because synths were being processed multiple times.
@@ -353,6 +619,11 @@ void AudioTrack::copyData(unsigned pos, int dstChannels, int srcStartChan, int s
 	double _pan = pan();
 	vol[0] = _volume * (1.0 - _pan);
 	vol[1] = _volume * (1.0 + _pan);
+	// per frame gain while volume or pan are automated
+	float gain0[nframes];
+	float gain1[nframes];
+	float* gain[2] = {gain0, gain1};
+	bool ramp = volumeGain(nframes, gain0, gain1);
 	float meter[srcChans];
 
 	// Have we been here already during this process cycle?
@@ -436,60 +707,14 @@ void AudioTrack::copyData(unsigned pos, int dstChannels, int srcStartChan, int s
 
 		//fprintf(stderr, "AudioTrack::copyData %s efx apply srcChans:%d\n", name().toLatin1().constData(), srcChans);
 		_efxPipe->apply(srcChans, nframes, buffer);
+		float** sendBuf = delayOutput(srcTotalOutChans, nframes, buffer);
 
 		//---------------------------------------------------
 		// aux sends
 		//---------------------------------------------------
 
 		if (hasAuxSend() && !isMute())
-		{
-			QHashIterator<qint64, AuxInfo> iter(_auxSend);/*{{{*/
-			while (iter.hasNext())
-			{
-				iter.next();
-				bool preaux = iter.value().first;
-				float m = iter.value().second;
-				Track* at = song->findTrackByIdAndType(iter.key(), Track::AUDIO_AUX);
-				if(at)
-				{
-					if (m <= 0.0001) // optimize
-						continue;
-					AudioAux* a = (AudioAux*) at;
-					float** dst = a->sendBuffer();
-					int auxChannels = a->channels();
-					if ((srcChans == 1 && auxChannels == 1) || srcChans == 2)
-					{
-						for (int ch = 0; ch < srcChans; ++ch)
-						{
-							float* db = dst[ch % a->channels()]; // no matter whether there's one or two dst buffers
-							float* sb = buffer[ch];
-							for (unsigned f = 0; f < nframes; ++f)
-							{
-								if(preaux)
-									*db++ += (*sb++ * m);// * vol[ch]); // add to mix
-								else
-									*db++ += (*sb++ * m * vol[ch]); // add to mix
-							}
-						}
-					}
-					else if (srcChans == 1 && auxChannels == 2) // copy mono to both channels
-					{
-						for (int ch = 0; ch < auxChannels; ++ch)
-						{
-							float* db = dst[ch % a->channels()];
-							float* sb = buffer[0];
-							for (unsigned f = 0; f < nframes; ++f)
-							{
-								if(preaux)
-									*db++ += (*sb++ * m);// * vol[ch]); // add to mix
-								else
-									*db++ += (*sb++ * m * vol[ch]); // add to mix
-							}
-						}
-					}
-				}
-			}/*}}}*/
-		}
+			processAuxSends(srcChans, nframes, sendBuf, vol, ramp ? gain : 0);
 
 		//---------------------------------------------------
 		//    prefader metering
@@ -499,15 +724,7 @@ void AudioTrack::copyData(unsigned pos, int dstChannels, int srcStartChan, int s
 		{
 			for (i = 0; i < srcChans; ++i)
 			{
-				float* p = buffer[i];
-				meter[i] = 0.0;
-				for (unsigned k = 0; k < nframes; ++k)
-				{
-					double f = fabs(*p);
-					if (f > meter[i])
-						meter[i] = f;
-					++p;
-				}
+				meter[i] = AL::dsp->peak(buffer[i], nframes, 0.0);
 				_meter[i] = meter[i];
 				if (_meter[i] > _peak[i])
 					_peak[i] = _meter[i];
@@ -570,40 +787,25 @@ void AudioTrack::copyData(unsigned pos, int dstChannels, int srcStartChan, int s
 	//    postfader metering
 	//---------------------------------------------------
 
+	if (ramp)
+	{
+		applyVolumeRamp(srcChans, buffer + srcStartChan, dstChannels, dstBuffer, nframes, gain, false);
+		_processed = true;
+		return;
+	}
+
 
 	if (srcChans == dstChannels)
 	{
-		if (_prefader)
+		for (int c = 0; c < dstChannels; ++c)
 		{
-			for (int c = 0; c < dstChannels; ++c)
-			{
-				float* sp = buffer[c + srcStartChan];
-
-				float* dp = dstBuffer[c];
-				for (unsigned k = 0; k < nframes; ++k)
-					*dp++ = (*sp++ * vol[c]);
-			}
-		}
-		else
-		{
-			for (int c = 0; c < dstChannels; ++c)
+			float* sp = buffer[c + srcStartChan];
+			if (_prefader)
+				AL::dsp->cpyWithGain(dstBuffer[c], sp, nframes, vol[c]);
+			else
 			{
-				meter[c] = 0.0;
-
-				float* sp = buffer[c + srcStartChan];
-
-				float* dp = dstBuffer[c];
-				for (unsigned k = 0; k < nframes; ++k)
-				{
-					float val = *sp++ * vol[c];
-					*dp++ = val;
-					double f = fabs(val);
-					if (f > meter[c])
-						meter[c] = f;
-				}
-				_meter[c] = meter[c];
-				if (_meter[c] > _peak[c])
-					_peak[c] = _meter[c];
+				meter[c] = AL::dsp->cpyWithGainPeak(dstBuffer[c], sp, nframes, vol[c], 0.0);
+				postMeter(c, meter[c]);
 			}
 		}
 	}
@@ -611,66 +813,31 @@ void AudioTrack::copyData(unsigned pos, int dstChannels, int srcStartChan, int s
 	{
 		float* sp = buffer[srcStartChan];
 
-		if (_prefader)
+		for (int c = 0; c < dstChannels; ++c)
+			AL::dsp->cpyWithGain(dstBuffer[c], sp, nframes, vol[c]);
+		if (!_prefader)
 		{
-			for (int c = 0; c < dstChannels; ++c)
-			{
-				float* dp = dstBuffer[c];
-				for (unsigned k = 0; k < nframes; ++k)
-					*dp++ = (*sp++ * vol[c]);
-			}
-		}
-		else
-		{
-			meter[0] = 0.0;
-			for (unsigned k = 0; k < nframes; ++k)
-			{
-				float val = *sp++;
-				double f = fabs(val) * _volume;
-				if (f > meter[0])
-					meter[0] = f;
-				*(dstBuffer[0] + k) = val * vol[0];
-				*(dstBuffer[1] + k) = val * vol[1];
-			}
-			_meter[0] = meter[0];
-			if (_meter[0] > _peak[0])
-				_peak[0] = _meter[0];
+			meter[0] = AL::dsp->peak(sp, nframes, 0.0) * _volume;
+			postMeter(0, meter[0]);
 		}
 	}
 	else if (srcChans == 2 && dstChannels == 1)
 	{
 		float* sp1 = buffer[srcStartChan];
 		float* sp2 = buffer[srcStartChan + 1];
+		float* dp = dstBuffer[0];
 
 		if (_prefader)
 		{
-			float* dp = dstBuffer[0];
-			for (unsigned k = 0; k < nframes; ++k)
-				*dp++ = (*sp1++ * vol[0] + *sp2++ * vol[1]);
+			AL::dsp->cpyWithGain(dp, sp1, nframes, vol[0]);
+			AL::dsp->mixWithGain(dp, sp2, nframes, vol[1]);
 		}
 		else
 		{
-			float* dp = dstBuffer[0];
-			meter[0] = 0.0;
-			meter[1] = 0.0;
-			for (unsigned k = 0; k < nframes; ++k)
-			{
-				float val1 = *sp1++ * vol[0];
-				float val2 = *sp2++ * vol[1];
-				double f1 = fabs(val1);
-				if (f1 > meter[0])
-					meter[0] = f1;
-				double f2 = fabs(val2);
-				if (f2 > meter[1])
-					meter[1] = f2;
-				*dp++ = (val1 + val2);
-			}
-			_meter[0] = meter[0];
-			if (_meter[0] > _peak[0])
-				_peak[0] = _meter[0];
-			_meter[1] = meter[1];
-			if (_meter[1] > _peak[1])
-				_peak[1] = _meter[1];
+			meter[0] = AL::dsp->cpyWithGainPeak(dp, sp1, nframes, vol[0], 0.0);
+			meter[1] = AL::dsp->mixWithGainPeak(dp, sp2, nframes, vol[1], 0.0);
+			postMeter(0, meter[0]);
+			postMeter(1, meter[1]);
 		}
 	}
 
@@ -683,6 +850,7 @@ void AudioTrack::copyData(unsigned pos, int dstChannels, int srcStartChan, int s
 
 void AudioTrack::addData(unsigned pos, int dstChannels, int srcStartChan, int srcChannels, unsigned nframes, float** dstBuffer)
 {
+	DspLoadScope load(DSP_LOAD_TRACK, this);
 	// Overhaul and streamline to eliminate multiple processing during one process loop.
 	// Was causing ticking sound with synths + multiple out routes because synths were being processed multiple times.
 	// Make better use of AudioTrack::outBuffers as a post-effect pre-volume cache system for multiple calls here during processing.
@@ -721,6 +889,11 @@ void AudioTrack::addData(unsigned pos, int dstChannels, int srcStartChan, int sr
 	double _pan = pan();
 	vol[0] = _volume * (1.0 - _pan);
 	vol[1] = _volume * (1.0 + _pan);
+	// per frame gain while volume or pan are automated
+	float gain0[nframes];
+	float gain1[nframes];
+	float* gain[2] = {gain0, gain1};
+	bool ramp = volumeGain(nframes, gain0, gain1);
 	float meter[srcChans];
 
 	// Have we been here already during this process cycle?
@@ -779,6 +952,7 @@ void AudioTrack::addData(unsigned pos, int dstChannels, int srcStartChan, int sr
 		//fprintf(stderr, "AudioTrack::addData %s efx apply srcChans:%d nframes:%ld %e %e %e %e\n",
 		//        name().toLatin1().constData(), srcChans, nframes, buffer[0][0], buffer[0][1], buffer[0][2], buffer[0][3]);
 		_efxPipe->apply(srcChans, nframes, buffer);
+		float** sendBuf = delayOutput(srcTotalOutChans, nframes, buffer);
 		// p3.3.41
 		//fprintf(stderr, "AudioTrack::addData after efx: %e %e %e %e\n",
 		//        buffer[0][0], buffer[0][1], buffer[0][2], buffer[0][3]);
@@ -788,54 +962,7 @@ void AudioTrack::addData(unsigned pos, int dstChannels, int srcStartChan, int sr
 		//---------------------------------------------------
 
 		if (hasAuxSend() && !isMute())
-		{
-			QHashIterator<qint64, AuxInfo> iter(_auxSend);/*{{{*/
-			while (iter.hasNext())
-			{
-				iter.next();
-				bool preaux = iter.value().first;
-				float m = iter.value().second;
-				Track* at = song->findTrackByIdAndType(iter.key(), Track::AUDIO_AUX);
-				if(at)
-				{
-					if (m <= 0.0001) // optimize
-						continue;
-					AudioAux* a = (AudioAux*) at;
-					float** dst = a->sendBuffer();
-					int auxChannels = a->channels();
-					if ((srcChans == 1 && auxChannels == 1) || srcChans == 2)
-					{
-						for (int ch = 0; ch < srcChans; ++ch)
-						{
-							float* db = dst[ch % a->channels()];
-							float* sb = buffer[ch];
-							for (unsigned f = 0; f < nframes; ++f)
-							{
-								if(preaux)
-									*db++ += (*sb++ * m); // dont add to mix
-								else
-									*db++ += (*sb++ * m * vol[ch]); // add to mix
-							}
-						}
-					}
-					else if (srcChans == 1 && auxChannels == 2)
-					{
-						for (int ch = 0; ch < auxChannels; ++ch)
-						{
-							float* db = dst[ch % a->channels()];
-							float* sb = buffer[0];
-							for (unsigned f = 0; f < nframes; ++f)
-							{
-								if(preaux)
-									*db++ += (*sb++ * m); // dont add to mix
-								else
-									*db++ += (*sb++ * m * vol[ch]); // add to mix
-							}
-						}
-					}
-				}
-			}/*}}}*/
-		}
+			processAuxSends(srcChans, nframes, sendBuf, vol, ramp ? gain : 0);
 
 		//---------------------------------------------------
 		//    prefader metering
@@ -845,15 +972,7 @@ void AudioTrack::addData(unsigned pos, int dstChannels, int srcStartChan, int sr
 		{
 			for (i = 0; i < srcChans; ++i)
 			{
-				float* p = buffer[i];
-				meter[i] = 0.0;
-				for (unsigned k = 0; k < nframes; ++k)
-				{
-					double f = fabs(*p);
-					if (f > meter[i])
-						meter[i] = f;
-					++p;
-				}
+				meter[i] = AL::dsp->peak(buffer[i], nframes, 0.0);
 				//_meter[i] = lrint(meter[i] * 32767.0);
 				_meter[i] = meter[i];
 				if (_meter[i] > _peak[i])
@@ -905,38 +1024,24 @@ void AudioTrack::addData(unsigned pos, int dstChannels, int srcStartChan, int sr
 	//    postfader metering
 	//---------------------------------------------------
 
-	if (srcChans == dstChannels)
+	if (ramp)
 	{
-		if (_prefader)
-		{
-			for (int c = 0; c < dstChannels; ++c)
-			{
-				float* sp = buffer[c + srcStartChan];
+		applyVolumeRamp(srcChans, buffer + srcStartChan, dstChannels, dstBuffer, nframes, gain, true);
+		_processed = true;
+		return;
+	}
 
-				float* dp = dstBuffer[c];
-				for (unsigned k = 0; k < nframes; ++k)
-					*dp++ += (*sp++ * vol[c]);
-			}
-		}
-		else
+	if (srcChans == dstChannels)
+	{
+		for (int c = 0; c < dstChannels; ++c)
 		{
-			for (int c = 0; c < dstChannels; ++c)
+			float* sp = buffer[c + srcStartChan];
+			if (_prefader)
+				AL::dsp->mixWithGain(dstBuffer[c], sp, nframes, vol[c]);
+			else
 			{
-				meter[c] = 0.0;
-				float* sp = buffer[c + srcStartChan];
-
-				float* dp = dstBuffer[c];
-				for (unsigned k = 0; k < nframes; ++k)
-				{
-					float val = *sp++ * vol[c];
-					*dp++ += val;
-					double f = fabs(val);
-					if (f > meter[c])
-						meter[c] = f;
-				}
-				_meter[c] = meter[c];
-				if (_meter[c] > _peak[c])
-					_peak[c] = _meter[c];
+				meter[c] = AL::dsp->mixWithGainPeak(dstBuffer[c], sp, nframes, vol[c], 0.0);
+				postMeter(c, meter[c]);
 			}
 		}
 	}
@@ -944,66 +1049,31 @@ void AudioTrack::addData(unsigned pos, int dstChannels, int srcStartChan, int sr
 	{
 		float* sp = buffer[srcStartChan];
 
-		if (_prefader)
+		for (int c = 0; c < dstChannels; ++c)
+			AL::dsp->mixWithGain(dstBuffer[c], sp, nframes, vol[c]);
+		if (!_prefader)
 		{
-			for (int c = 0; c < dstChannels; ++c)
-			{
-				float* dp = dstBuffer[c];
-				for (unsigned k = 0; k < nframes; ++k)
-					*dp++ += (*sp++ * vol[c]);
-			}
-		}
-		else
-		{
-			meter[0] = 0.0;
-			for (unsigned k = 0; k < nframes; ++k)
-			{
-				float val = *sp++;
-				double f = fabs(val) * _volume;
-				if (f > meter[0])
-					meter[0] = f;
-				*(dstBuffer[0] + k) += val * vol[0];
-				*(dstBuffer[1] + k) += val * vol[1];
-			}
-			_meter[0] = meter[0];
-			if (_meter[0] > _peak[0])
-				_peak[0] = _meter[0];
+			meter[0] = AL::dsp->peak(sp, nframes, 0.0) * _volume;
+			postMeter(0, meter[0]);
 		}
 	}
 	else if (srcChans == 2 && dstChannels == 1)
 	{
 		float* sp1 = buffer[srcStartChan];
 		float* sp2 = buffer[srcStartChan + 1];
+		float* dp = dstBuffer[0];
 
 		if (_prefader)
 		{
-			float* dp = dstBuffer[0];
-			for (unsigned k = 0; k < nframes; ++k)
-				*dp++ += (*sp1++ * vol[0] + *sp2++ * vol[1]);
+			AL::dsp->mixWithGain(dp, sp1, nframes, vol[0]);
+			AL::dsp->mixWithGain(dp, sp2, nframes, vol[1]);
 		}
 		else
 		{
-			float* dp = dstBuffer[0];
-			meter[0] = 0.0;
-			meter[1] = 0.0;
-			for (unsigned k = 0; k < nframes; ++k)
-			{
-				float val1 = *sp1++ * vol[0];
-				float val2 = *sp2++ * vol[1];
-				double f1 = fabs(val1);
-				if (f1 > meter[0])
-					meter[0] = f1;
-				double f2 = fabs(val2);
-				if (f2 > meter[1])
-					meter[1] = f2;
-				*dp++ += (val1 + val2);
-			}
-			_meter[0] = meter[0];
-			if (_meter[0] > _peak[0])
-				_peak[0] = _meter[0];
-			_meter[1] = meter[1];
-			if (_meter[1] > _peak[1])
-				_peak[1] = _meter[1];
+			meter[0] = AL::dsp->mixWithGainPeak(dp, sp1, nframes, vol[0], 0.0);
+			meter[1] = AL::dsp->mixWithGainPeak(dp, sp2, nframes, vol[1], 0.0);
+			postMeter(0, meter[0]);
+			postMeter(1, meter[1]);
 		}
 	}
 
@@ -1082,7 +1152,9 @@ void AudioTrack::putFifo(int channels, unsigned long n, float** bp)
 {
 	if (fifo.put(channels, n, bp, audio->pos().frame()))
 	{
-		printf("   overrun ???\n");
+		++_recordOverruns;
+		if(debugMsg)
+			printf("AudioTrack::putFifo(): fifo overrun\n");
 	}
 }
 
@@ -1371,8 +1443,9 @@ void AudioTrack::record()
 			{
 				pos -= fr;
 
-				_recFile->seek(pos, 0);
-				_recFile->write(_channels, buffer, segmentSize);
+				if (!_recBatch)
+					_recBatch = new RecordBatch();
+				_recBatch->add(_recFile, pos, _channels, buffer, segmentSize);
 			}
 		}
 		else
@@ -1382,6 +1455,17 @@ void AudioTrack::record()
 	}
 }
 
+//---------------------------------------------------------
+//   finishRecord
+//    write out the frames still waiting in the batch
+//---------------------------------------------------------
+
+void AudioTrack::finishRecord()
+{
+	if (_recBatch)
+		_recBatch->finish();
+}
+
 //---------------------------------------------------------
 //   processInit
 //---------------------------------------------------------
@@ -1509,13 +1593,16 @@ void AudioOutput::setName(const QString& s)
 
 Fifo::Fifo()
 {
-	oom_atomic_init(&count);
 	//nbuffer = FIFO_BUFFER;
 	nbuffer = fifoLength;
 	buffer = new FifoBuffer*[nbuffer];
 	for (int i = 0; i < nbuffer; ++i)
 		buffer[i] = new FifoBuffer;
-	clear();
+	wcount = 0;
+	discard = 0;
+	widx = 0;
+	rcount = 0;
+	ridx = 0;
 }
 
 Fifo::~Fifo()
@@ -1533,7 +1620,6 @@ Fifo::~Fifo()
 	}
 
 	delete[] buffer;
-	oom_atomic_destroy(&count);
 }
 
 //---------------------------------------------------------
@@ -1547,10 +1633,10 @@ bool Fifo::put(int segs, unsigned long samples, float** src, unsigned pos)
 	printf("FIFO::put segs:%d samples:%lu pos:%u\n", segs, samples, pos);
 #endif
 
-	if (oom_atomic_read(&count) == nbuffer)
+	if (full())
 	{
 		if(debugMsg)
-			printf("FIFO %p overrun... %d\n", this, count.counter);
+			printf("FIFO %p overrun... %d\n", this, nbuffer);
 		return true;
 	}
 	FifoBuffer* b = buffer[widx];
@@ -1600,33 +1686,85 @@ bool Fifo::get(int segs, unsigned long samples, float** dst, unsigned* pos)
 	printf("FIFO::get segs:%d samples:%lu\n", segs, samples);
 #endif
 
-	if (oom_atomic_read(&count) == 0)
-	{
-		if(debugMsg)
-			printf("FIFO %p underrun... %d\n", this, count.counter);
-		return true;
-	}
-	FifoBuffer* b = buffer[ridx];
-	if (!b->buffer)
+	for (;;)
 	{
-		if(debugMsg)
-			printf("Fifo::get no buffer! segs:%d samples:%lu b->pos:%u\n", segs, samples, b->pos);
-		return true;
-	}
+		skipDiscarded();
+		if (oom_load_acquire(&wcount) == rcount)
+		{
+			if(debugMsg)
+				printf("FIFO %p underrun...\n", this);
+			return true;
+		}
+		FifoBuffer* b = buffer[ridx];
+		if (!b->buffer)
+		{
+			if(debugMsg)
+				printf("Fifo::get no buffer! segs:%d samples:%lu b->pos:%u\n", segs, samples, b->pos);
+			return true;
+		}
 
-	if (pos)
-		*pos = b->pos;
+		unsigned p = b->pos;
+		for (int i = 0; i < segs; ++i)
+			dst[i] = b->buffer + samples * (i % b->segs);
 
-	for (int i = 0; i < segs; ++i)
-		dst[i] = b->buffer + samples * (i % b->segs);
-	remove();
-	return false;
+		// the writer keeps off the buffer from here on (see full()),
+		// unless a clear() meanwhile already gave it back
+		remove();
+		__sync_synchronize();
+		if (int(oom_load_acquire(&discard) - rcount) >= 0)
+			continue;
+		if (pos)
+			*pos = p;
+		return false;
+	}
 }
 
+//---------------------------------------------------------
+//   getCount
+//    may be called from either side
+//---------------------------------------------------------
+
 int Fifo::getCount()
 {
-	return oom_atomic_read(&count);
+	unsigned r = oom_load_acquire(&rcount);
+	unsigned d = oom_load_acquire(&discard);
+	if (int(d - r) > 0)
+		r = d;
+	return oom_load_acquire(&wcount) - r;
 }
+
+//---------------------------------------------------------
+//   full
+//    writer side, true if the next buffer is not free: the
+//    reader has not got it yet, unless a clear() dropped
+//    it, or it is the one the last get() returned, which
+//    the reader uses until its next get()
+//---------------------------------------------------------
+
+bool Fifo::full()
+{
+	unsigned r = oom_load_acquire(&rcount);
+	unsigned first = int(discard - r) > 0 ? discard : r;
+	if (wcount - first >= (unsigned) nbuffer)
+		return true;
+	return (wcount - (r - 1)) % nbuffer == 0;
+}
+
+//---------------------------------------------------------
+//   skipDiscarded
+//    reader side, drop the buffers written before the last
+//    clear()
+//---------------------------------------------------------
+
+void Fifo::skipDiscarded()
+{
+	unsigned d = oom_load_acquire(&discard);
+	if (int(d - rcount) <= 0)
+		return;
+	ridx = (ridx + (d - rcount)) % nbuffer;
+	oom_store_release(&rcount, d);
+}
+
 //---------------------------------------------------------
 //   remove
 //---------------------------------------------------------
@@ -1634,7 +1772,8 @@ int Fifo::getCount()
 void Fifo::remove()
 {
 	ridx = (ridx + 1) % nbuffer;
-	oom_atomic_dec(&count);
+	// hand the slot back to the writer
+	oom_store_release(&rcount, rcount + 1);
 }
 
 //---------------------------------------------------------
@@ -1647,7 +1786,7 @@ bool Fifo::getWriteBuffer(int segs, unsigned long samples, float** buf, unsigned
 	printf("Fifo::getWriteBuffer segs:%d samples:%lu pos:%u\n", segs, samples, pos);
 #endif
 
-	if (oom_atomic_read(&count) == nbuffer)
+	if (full())
 		return true;
 	FifoBuffer* b = buffer[widx];
 	int n = segs * samples;
@@ -1692,7 +1831,250 @@ bool Fifo::getWriteBuffer(int segs, unsigned long samples, float** buf, unsigned
 void Fifo::add()
 {
 	widx = (widx + 1) % nbuffer;
-	oom_atomic_inc(&count);
+	// publish the filled slot to the reader
+	oom_store_release(&wcount, wcount + 1);
+}
+
+//---------------------------------------------------------
+//   FifoBench
+//---------------------------------------------------------
+
+struct FifoBench
+{
+	Fifo* fifo;
+	volatile bool stop;
+	volatile bool writerDone;
+	unsigned long puts;
+	unsigned long clears;
+	unsigned long gets;
+	unsigned long generations; // generations the reader saw
+	unsigned long errors;
+};
+
+static const unsigned long FIFO_BENCH_FRAMES = 64;
+static const unsigned FIFO_BENCH_CLEAR = 300; // buffers between two clear()
+static const unsigned FIFO_BENCH_SIZES = 4; // buffer sizes, the fifo reallocates growing ones
+
+//---------------------------------------------------------
+//   fifoBenchFrames
+//    the buffer size of a generation
+//---------------------------------------------------------
+
+static unsigned long fifoBenchFrames(unsigned gen)
+{
+	return FIFO_BENCH_FRAMES * (1 + gen % FIFO_BENCH_SIZES);
+}
+
+//---------------------------------------------------------
+//   fifoBenchWriter
+//    clears the fifo as a seek of the prefetch thread does.
+//    The pos of a buffer is its generation and its number
+//    in the generation, every sample holds the number. The
+//    size changes with the generation.
+//---------------------------------------------------------
+
+static void* fifoBenchWriter(void* p)
+{
+	FifoBench* b = (FifoBench*) p;
+	float data[FIFO_BENCH_FRAMES * FIFO_BENCH_SIZES];
+	float* bp[1] = {data};
+	unsigned gen = 0;
+	unsigned seq = 0;
+	while (!b->stop)
+	{
+		if (seq == FIFO_BENCH_CLEAR)
+		{
+			b->fifo->clear();
+			++b->clears;
+			++gen;
+			seq = 0;
+		}
+		unsigned long frames = fifoBenchFrames(gen);
+		for (unsigned i = 0; i < frames; ++i)
+			data[i] = seq;
+		if (b->fifo->put(1, frames, bp, (gen << 16) | seq))
+		{
+			sched_yield();
+			continue;
+		}
+		++b->puts;
+		++seq;
+	}
+	b->writerDone = true;
+	return 0;
+}
+
+//---------------------------------------------------------
+//   fifoBenchReader
+//    a buffer older than the last one, or a gap or repeat
+//    inside a generation is an error. A generation is
+//    either dropped as a whole or seen from its start. So
+//    is a sample the writer changed while the reader still
+//    had the buffer.
+//---------------------------------------------------------
+
+static void* fifoBenchReader(void* p)
+{
+	FifoBench* b = (FifoBench*) p;
+	float* bp[1];
+	bool first = true;
+	unsigned last = 0;
+	for (;;)
+	{
+		unsigned pos;
+		if (b->fifo->get(1, FIFO_BENCH_FRAMES, bp, &pos))
+		{
+			if (b->writerDone)
+				break;
+			sched_yield();
+			continue;
+		}
+		++b->gets;
+		unsigned gen = pos >> 16;
+		unsigned seq = pos & 0xffff;
+		// generations wrap at 16 bits
+		unsigned ahead = (gen - (last >> 16)) & 0xffff;
+		bool ok;
+		if (first || (ahead != 0 && ahead < 0x8000))
+		{
+			ok = seq == 0;
+			++b->generations;
+		}
+		else
+			ok = ahead == 0 && seq == (last & 0xffff) + 1;
+		if (!ok)
+		{
+			if (b->errors < 10)
+				printf("bench: got generation %u buffer %u after generation %u buffer %u\n",
+						gen, seq, last >> 16, last & 0xffff);
+			++b->errors;
+		}
+		// hold the buffer a while, as the audio thread does
+		sched_yield();
+		unsigned long frames = fifoBenchFrames(gen);
+		for (unsigned long i = 0; i < frames; ++i)
+		{
+			if (bp[0][i] != float(seq))
+			{
+				if (b->errors < 10)
+					printf("bench: generation %u buffer %u sample %lu is %g\n", gen, seq, i, bp[0][i]);
+				++b->errors;
+				break;
+			}
+		}
+		first = false;
+		last = pos;
+	}
+	return 0;
+}
+
+//---------------------------------------------------------
+//   benchFifo
+//    --bench-fifo: run a writer and a reader thread on one
+//    Fifo for the given time and check the order of what
+//    the reader gets
+//    returns 1 if an error was found
+//---------------------------------------------------------
+
+int benchFifo(int seconds)
+{
+	if (seconds <= 0)
+		seconds = 10;
+	FifoBench b;
+	b.fifo = new Fifo;
+	b.stop = false;
+	b.writerDone = false;
+	b.puts = 0;
+	b.clears = 0;
+	b.gets = 0;
+	b.generations = 0;
+	b.errors = 0;
+
+	printf("bench: fifo of %u buffers, clear every %u buffers, %d s\n", fifoLength, FIFO_BENCH_CLEAR, seconds);
+	double startTime = curTime();
+	pthread_t writer;
+	pthread_t reader;
+	pthread_create(&writer, 0, fifoBenchWriter, &b);
+	pthread_create(&reader, 0, fifoBenchReader, &b);
+	sleep(seconds);
+	b.stop = true;
+	pthread_join(writer, 0);
+	pthread_join(reader, 0);
+	double elapsed = curTime() - startTime;
+
+	printf("bench: %lu buffers put, %lu got, %lu clears, %lu generations seen, %.0f buffers/s\n",
+			b.puts, b.gets, b.clears, b.generations, elapsed > 0.0 ? b.puts / elapsed : 0.0);
+	printf("bench: %lu errors\n", b.errors);
+	delete b.fifo;
+	return b.errors ? 1 : 0;
+}
+
+//---------------------------------------------------------
+//   LatencyDelay
+//---------------------------------------------------------
+
+LatencyDelay::LatencyDelay(int channels, unsigned main, unsigned sends)
+{
+	_channels = channels;
+	_main = main;
+	_sends = sends;
+	_size = (main > sends ? main : sends) + 1;
+	_pos = 0;
+	_buffer = new float[channels * _size];
+	float val = config.useDenormalBias ? denormalBias : 0.0;
+	for (unsigned i = 0; i < channels * _size; ++i)
+		_buffer[i] = val;
+	_sendFrames = main == sends ? 0 : segmentSize;
+	_sendData = _sendFrames ? new float[channels * _sendFrames] : 0;
+	_send = new float*[channels];
+	for (int ch = 0; ch < channels; ++ch)
+		_send[ch] = _sendData ? _sendData + ch * _sendFrames : 0;
+}
+
+LatencyDelay::~LatencyDelay()
+{
+	delete[] _buffer;
+	delete[] _sendData;
+	delete[] _send;
+}
+
+//---------------------------------------------------------
+//   process
+//    delay the buffers in place by the output delay and
+//    return the buffers for the aux sends, delayed by the
+//    send delay. Channels the line was not made for pass
+//    unchanged, then the sends get the output.
+//---------------------------------------------------------
+
+float** LatencyDelay::process(int channels, unsigned nframes, float** buffer)
+{
+	bool sends = _sendFrames && nframes <= _sendFrames && channels <= _channels;
+	if (channels > _channels)
+		channels = _channels;
+	for (int ch = 0; ch < channels; ++ch)
+	{
+		float* line = _buffer + ch * _size;
+		float* p = buffer[ch];
+		float* s = _send[ch];
+		unsigned w = _pos;
+		unsigned rm = (_pos + _size - _main) % _size;
+		unsigned rs = (_pos + _size - _sends) % _size;
+		for (unsigned i = 0; i < nframes; ++i)
+		{
+			line[w] = p[i];
+			if (sends)
+				s[i] = line[rs];
+			p[i] = line[rm];
+			if (++w == _size)
+				w = 0;
+			if (++rm == _size)
+				rm = 0;
+			if (++rs == _size)
+				rs = 0;
+		}
+	}
+	_pos = (_pos + nframes) % _size;
+	return sends ? _send : buffer;
 }
 
 //---------------------------------------------------------
@@ -11,88 +11,7 @@
 
 #include <list>
 
-#ifndef i386
-#include <pthread.h>
-
-typedef struct {
-    pthread_mutex_t lock;
-    int counter;
-} oom_atomic_t;
-#else
-
-typedef struct {
-    int counter;
-} oom_atomic_t;
-#endif
-
-static inline int oom_atomic_read(oom_atomic_t *v) {
-#ifndef i386
-    int ret;
-    pthread_mutex_lock(&v->lock);
-    ret = v->counter;
-    pthread_mutex_unlock(&v->lock);
-    return ret;
-#else
-    return v->counter;
-#endif
-}
-
-static inline void oom_atomic_set(oom_atomic_t *v, int i) {
-#ifndef i386
-    pthread_mutex_lock(&v->lock);
-    v->counter = i;
-    pthread_mutex_unlock(&v->lock);
-#else
-    v->counter = i;
-#endif
-}
-
-static inline void oom_atomic_inc(oom_atomic_t *v) {
-#ifndef i386
-    pthread_mutex_lock(&v->lock);
-    v->counter++;
-    pthread_mutex_unlock(&v->lock);
-#else
-    __asm__ __volatile__(
-            "lock ; " "incl %0"
-            : "=m" (v->counter)
-            : "m" (v->counter));
-#endif
-}
-
-static inline void oom_atomic_dec(oom_atomic_t *v) {
-#ifndef i386
-    pthread_mutex_lock(&v->lock);
-    v->counter--;
-    pthread_mutex_unlock(&v->lock);
-#else
-    __asm__ __volatile__(
-            "lock ; " "decl %0"
-            : "=m" (v->counter)
-            : "m" (v->counter));
-#endif
-}
-#ifndef i386
-
-static inline void oom_atomic_init(oom_atomic_t *v) {
-    pthread_mutex_init(&v->lock, NULL);
-}
-#else
-
-static inline void oom_atomic_init(oom_atomic_t*) {
-}
-#endif
-
-#ifndef i386
-
-static inline void oom_atomic_destroy(oom_atomic_t *v) {
-    pthread_mutex_destroy(&v->lock);
-}
-#else
-
-static inline void oom_atomic_destroy(oom_atomic_t*) {
-}
-#endif
+#include "lockfree.h"
 
 class Xml;
 class Pipeline;
@@ -102,7 +21,7 @@ class SndFile;
 //const int FIFO_BUFFER = 4096;//64;
 
 //---------------------------------------------------------
-//   Fifo
+//   FifoBuffer
 //---------------------------------------------------------
 
 struct FifoBuffer {
@@ -119,21 +38,40 @@ struct FifoBuffer {
     }
 };
 
+//---------------------------------------------------------
+//   Fifo
+//    single producer / single consumer ring buffer
+//    The writer only advances wcount and discard, the
+//    reader only advances rcount, no lock is taken on
+//    either side. clear() is done by the writer, it marks
+//    everything written so far as stale and the reader
+//    skips it. The buffer get() returned last stays the
+//    reader's until its next get(), the writer neither
+//    fills nor reallocates it, also after a clear().
+//---------------------------------------------------------
+
 class Fifo {
     int nbuffer;
-    int ridx; // read index; only touched by reader
-    int widx; // write index; only touched by writer
-    oom_atomic_t count; // buffer count; writer increments, reader decrements
     FifoBuffer** buffer;
 
+    char _pad0[OOM_CACHE_LINE];
+    volatile unsigned wcount; // buffers added so far; only touched by writer
+    volatile unsigned discard; // wcount at the last clear(); only touched by writer
+    int widx; // write index; only touched by writer
+    char _pad1[OOM_CACHE_LINE];
+    volatile unsigned rcount; // buffers removed so far; only touched by reader
+    int ridx; // read index; only touched by reader
+    char _pad2[OOM_CACHE_LINE];
+
 public:
     Fifo();
     ~Fifo();
 
+    //  writer side, the slots are reused once the reader
+    //  has seen the mark or the writer needs them
     void clear() {
-        ridx = 0;
-        widx = 0;
-        oom_atomic_set(&count, 0);
+        oom_store_release(&discard, wcount);
+        __sync_synchronize();
     }
     bool put(int, unsigned long, float** buffer, unsigned pos);
     bool getWriteBuffer(int, unsigned long, float** buffer, unsigned pos);
@@ -141,6 +79,49 @@ public:
     bool get(int, unsigned long, float** buffer, unsigned* pos);
     void remove();
     int getCount();
+
+private:
+    bool full();
+    void skipDiscarded();
+};
+
+extern int benchFifo(int seconds);
+
+//---------------------------------------------------------
+//   LatencyDelay
+//    fixed delay line for plugin delay compensation with
+//    one tap for the track output and one for its aux
+//    sends, the memory is allocated by the gui before the
+//    audio thread gets it
+//---------------------------------------------------------
+
+class LatencyDelay {
+    float* _buffer; // _channels lines of _size samples
+    float* _sendData; // _channels * segmentSize delayed for the sends
+    float** _send;
+    int _channels;
+    unsigned _main;
+    unsigned _sends;
+    unsigned _size;
+    unsigned _sendFrames;
+    unsigned _pos;
+
+public:
+    LatencyDelay(int channels, unsigned main, unsigned sends);
+    ~LatencyDelay();
+
+    int channels() const {
+        return _channels;
+    }
+
+    unsigned mainFrames() const {
+        return _main;
+    }
+
+    unsigned sendFrames() const {
+        return _sends;
+    }
+    float** process(int channels, unsigned nframes, float** buffer);
 };
 
 #endif
@@ -0,0 +1,656 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sndfile.h>
+#include <vector>
+
+#include <QAction>
+#include <QFileInfo>
+#include <QUndoStack>
+
+#include "offlinerender.h"
+#include "audio.h"
+#include "audiodev.h"
+#include "audiograph.h"
+#include "audioprefetch.h"
+#include "conf.h"
+#include "diskwriter.h"
+#include "filedialog.h"
+#include "gconfig.h"
+#include "globals.h"
+#include "midimonitor.h"
+#include "midiport.h"
+#include "midiseq.h"
+#include "midi.h"
+#include "instruments/minstrument.h"
+#include "part.h"
+#include "plugin.h"
+#include "song.h"
+#include "track.h"
+#include "utils.h"
+#include "wave.h"
+#include "xml.h"
+
+extern void dummyAudioCycle();
+extern void initMidiSynth();
+
+//---------------------------------------------------------
+//   createTransportActions
+//    Song keeps the transport actions of the main window
+//    in sync, give it some which nobody shows
+//---------------------------------------------------------
+
+static void createTransportActions()
+{
+	undoAction = new QAction(0);
+	redoAction = new QAction(0);
+	playAction = new QAction(0);
+	stopAction = new QAction(0);
+	loopAction = new QAction(0);
+	punchinAction = new QAction(0);
+	punchoutAction = new QAction(0);
+	recordAction = new QAction(0);
+	masterEnableAction = new QAction(0);
+}
+
+//---------------------------------------------------------
+//   readProject
+//    the song part of OOMidi::read()
+//    returns true on error
+//---------------------------------------------------------
+
+static bool readProject(const QString& name)
+{
+	QFileInfo fi(name);
+	oomProject = fi.absolutePath();
+	oomProjectFile = fi.absoluteFilePath();
+
+	bool popenFlag;
+	FILE* f = fileOpen(0, fi.filePath(), QString(".oom"), "r", popenFlag, true);
+	if (f == 0)
+	{
+		fprintf(stderr, "render: cannot open %s: %s\n", name.toLatin1().constData(), strerror(errno));
+		return true;
+	}
+	Xml xml(f);
+	bool skipmode = true;
+	bool done = false;
+	while (!done)
+	{
+		Xml::Token token = xml.parse();
+		const QString& tag = xml.s1();
+		switch (token)
+		{
+			case Xml::Error:
+			case Xml::End:
+				done = true;
+				break;
+			case Xml::TagStart:
+				if (skipmode && tag == "oom")
+					skipmode = false;
+				else if (skipmode)
+					break;
+				else if (tag == "configuration")
+					readConfiguration(xml, true /* only read sequencer settings */);
+				else if (tag == "song")
+				{
+					song->read(xml);
+					audio->msgUpdateSoloStates();
+				}
+				else
+					xml.skip(tag);
+				break;
+			case Xml::Attribut:
+				if (tag == "version")
+				{
+					int major = xml.s2().section('.', 0, 0).toInt();
+					int minor = xml.s2().section('.', 1, 1).toInt();
+					xml.setVersion(major, minor);
+				}
+				break;
+			case Xml::TagEnd:
+				if (!skipmode && tag == "oom")
+					done = true;
+				break;
+			default:
+				break;
+		}
+	}
+	bool fileError = ferror(f);
+	popenFlag ? pclose(f) : fclose(f);
+	if (fileError)
+	{
+		fprintf(stderr, "render: read error in %s\n", name.toLatin1().constData());
+		return true;
+	}
+	return false;
+}
+
+//---------------------------------------------------------
+//   rangePos
+//    frame of one end of the --range argument
+//    returns true on error
+//---------------------------------------------------------
+
+static bool rangePos(const QString& s, unsigned* frame)
+{
+	if (s == "l")
+		*frame = song->lPos().frame();
+	else if (s == "r")
+		*frame = song->rPos().frame();
+	else if (s == "start")
+		*frame = 0;
+	else if (s == "end")
+		*frame = Pos(song->len(), true).frame();
+	else
+	{
+		bool ok;
+		*frame = s.toUInt(&ok);
+		if (!ok)
+			return true;
+	}
+	return false;
+}
+
+//---------------------------------------------------------
+//   openEngine
+//    set up the engine without the gui and an empty song
+//---------------------------------------------------------
+
+static void openEngine()
+{
+	offlineRender = true;
+	createTransportActions();
+	initMidiInstruments();
+	initMidiPorts();
+	initMidiSynth();
+
+	// the engine without the gui, nothing runs in its own thread
+	// so every message is executed right away
+	song = new Song(new QUndoStack(), "song");
+	song->blockSignals(true);
+	midiSeq = new MidiSeq("Midi");
+	audio = new Audio();
+	audioPrefetch = new AudioPrefetch("Prefetch");
+	diskWriter = new DiskWriter("DiskWriter");
+	audioGraph = new AudioGraph();
+	midiMonitor = new MidiMonitor("MidiMonitor");
+}
+
+//---------------------------------------------------------
+//   openProject
+//    set up the engine without the gui and read project,
+//    from and to are set from range
+//    returns the output which is rendered, 0 on error
+//---------------------------------------------------------
+
+static AudioOutput* openProject(const QString& project, const QString& range, unsigned* from, unsigned* to)
+{
+	openEngine();
+	if (readProject(project))
+		return 0;
+
+	OutputList* ol = song->outputs();
+	if (ol->empty())
+	{
+		fprintf(stderr, "render: %s has no audio output\n", project.toLatin1().constData());
+		return 0;
+	}
+	for (iAudioOutput i = ol->begin(); i != ol->end(); ++i)
+		(*i)->setName((*i)->name()); // register driver ports
+
+	*from = 0;
+	*to = Pos(song->len(), true).frame();
+	if (!range.isEmpty())
+	{
+		if (rangePos(range.section(':', 0, 0), from) || rangePos(range.section(':', 1, 1), to))
+		{
+			fprintf(stderr, "render: bad range <%s>\n", range.toLatin1().constData());
+			return 0;
+		}
+	}
+	if (*to <= *from)
+	{
+		fprintf(stderr, "render: empty range %u:%u\n", *from, *to);
+		return 0;
+	}
+
+	song->setLoop(false);
+	song->setClick(false);
+	// freewheel reads the wave files in the audio cycle instead
+	// of waiting for the prefetch thread
+	audio->setFreewheel(true);
+	// synth tracks get their events from the audio cycle
+	midiSeqRunning = true;
+	return ol->front();
+}
+
+//---------------------------------------------------------
+//   renderRange
+//    run the engine from from to to, the mix of ao goes to
+//    sf if it is set. progress prints how much is done.
+//    returns true if the transport did not start
+//---------------------------------------------------------
+
+static bool renderRange(AudioOutput* ao, unsigned from, unsigned to, SndFile* sf, RecordBatch* batch, bool progress)
+{
+	song->updatePartSchedules();
+	if (song->parallelAudio())
+	{
+		audioGraph->start(0);
+		audioGraph->update();
+	}
+
+	audioDevice->seekTransport(from);
+	audioDevice->startTransport();
+
+	unsigned last = ~0;
+	unsigned lastSecond = 0;
+	int idleCycles = 0;
+	bool started = false;
+	for (;;)
+	{
+		dummyAudioCycle();
+		if (!audio->isPlaying())
+		{
+			// stopped at the end of the song
+			if (started || ++idleCycles > 16)
+				break;
+			continue;
+		}
+		started = true;
+		unsigned next = audio->pos().frame();
+		if (next == last)
+			continue; // end of song, transport stops in the next cycle
+		last = next;
+
+		unsigned at = next - segmentSize;
+		unsigned s = at < from ? from : at;
+		unsigned e = next > to ? to : next;
+		if (sf && s < e)
+		{
+			float* bp[MAX_CHANNELS];
+			float** src = ao->outputBuffers();
+			for (int ch = 0; ch < ao->channels(); ++ch)
+				bp[ch] = src[ch] + (s - at);
+			batch->add(sf, s - from, ao->channels(), bp, e - s);
+		}
+		if (next >= to)
+			break;
+		if (progress && (next - from) / sampleRate != lastSecond)
+		{
+			lastSecond = (next - from) / sampleRate;
+			if (lastSecond % 10 == 0)
+			{
+				printf("render: %u%%\r", (unsigned) ((next - from) * 100.0 / (to - from)));
+				fflush(stdout);
+			}
+		}
+	}
+	audioDevice->stopTransport();
+	dummyAudioCycle();
+
+	if (song->parallelAudio())
+		audioGraph->stop();
+	return !started;
+}
+
+//---------------------------------------------------------
+//   renderProject
+//---------------------------------------------------------
+
+int renderProject(const QString& project, const QString& output, const QString& range)
+{
+	unsigned from;
+	unsigned to;
+	AudioOutput* ao = openProject(project, range, &from, &to);
+	if (ao == 0)
+		return 1;
+
+	SndFile* sf = new SndFile(output);
+	sf->setFormat(SF_FORMAT_WAV | SF_FORMAT_FLOAT, ao->channels(), sampleRate);
+	if (sf->openWrite())
+	{
+		fprintf(stderr, "render: cannot create %s: %s\n",
+				output.toLatin1().constData(), sf->strerror().toLatin1().constData());
+		delete sf;
+		return 1;
+	}
+	RecordBatch batch;
+	batch.prepare(sf);
+
+	printf("render: %s frames %u - %u to %s\n", project.toLatin1().constData(),
+			from, to, output.toLatin1().constData());
+
+	double startTime = curTime();
+	bool failed = renderRange(ao, from, to, sf, &batch, true);
+
+	batch.finish();
+	sf->close();
+	delete sf;
+
+	if (failed)
+	{
+		fprintf(stderr, "render: transport did not start\n");
+		return 1;
+	}
+	double seconds = curTime() - startTime;
+	double length = double(to - from) / sampleRate;
+	printf("render: %.1f s rendered in %.1f s (%.1fx realtime)\n", length, seconds,
+			seconds > 0.0 ? length / seconds : 0.0);
+	return 0;
+}
+
+//---------------------------------------------------------
+//   benchAudioGraph
+//    --bench-graph: render the range of a project on the
+//    serial path and on the AudioGraph workers, two passes
+//    each in turn, and print the best time of either.
+//    Nothing is written. Plugins keep their state from one
+//    pass to the next, so the passes are timed but not
+//    compared.
+//---------------------------------------------------------
+
+int benchAudioGraph(const QString& project, const QString& range)
+{
+	unsigned from;
+	unsigned to;
+	AudioOutput* ao = openProject(project, range, &from, &to);
+	if (ao == 0)
+		return 1;
+
+	double length = double(to - from) / sampleRate;
+	printf("bench: %s frames %u - %u, %d tracks, %d cpus\n", project.toLatin1().constData(),
+			from, to, int(song->tracks()->size()), int(sysconf(_SC_NPROCESSORS_ONLN)));
+
+	double best[2] = { 0.0, 0.0 };
+	for (int pass = 0; pass < 4; ++pass)
+	{
+		int parallel = pass & 1;
+		song->setParallelAudio(parallel);
+		double startTime = curTime();
+		if (renderRange(ao, from, to, 0, 0, false))
+		{
+			fprintf(stderr, "bench: transport did not start\n");
+			return 1;
+		}
+		double seconds = curTime() - startTime;
+		printf("bench: %s pass %.3f s (%.1fx realtime)\n", parallel ? "parallel" : "serial  ",
+				seconds, seconds > 0.0 ? length / seconds : 0.0);
+		if (pass < 2 || seconds < best[parallel])
+			best[parallel] = seconds;
+	}
+	printf("bench: serial %.3f s, parallel %.3f s, speedup %.2f\n", best[0], best[1],
+			best[1] > 0.0 ? best[0] / best[1] : 0.0);
+	return 0;
+}
+
+//---------------------------------------------------------
+//   benchWaveFades
+//    --bench-fades: render the fade envelope of every wave
+//    part of a project once per frame with gain(unsigned),
+//    the way readInternal() did, and once per block with
+//    gain(pos, n, buf). Prints the frames which differ and
+//    the time of either.
+//---------------------------------------------------------
+
+int benchWaveFades(const QString& project)
+{
+	unsigned from;
+	unsigned to;
+	if (openProject(project, QString(), &from, &to) == 0)
+		return 1;
+
+	const unsigned block = 256; // FADE_BLOCK of wave.cpp
+	float ref[block];
+	float buf[block];
+	double sink = 0.0;
+	double frameTime = 0.0;
+	double blockTime = 0.0;
+	unsigned frames = 0;
+	unsigned mismatches = 0;
+	int nparts = 0;
+
+	WaveTrackList* wl = song->waves();
+	for (iWaveTrack t = wl->begin(); t != wl->end(); ++t)
+	{
+		PartList* pl = (*t)->parts();
+		for (iPart ip = pl->begin(); ip != pl->end(); ++ip)
+		{
+			WavePart* part = (WavePart*) (ip->second);
+			unsigned start = part->frame();
+			unsigned end = start + part->lenFrame();
+			++nparts;
+			frames += end - start;
+
+			for (unsigned pos = start; pos < end; pos += block)
+			{
+				unsigned n = end - pos > block ? block : end - pos;
+				part->gain(pos, n, buf);
+				for (unsigned i = 0; i < n; ++i)
+				{
+					if (part->gain(pos + i) != buf[i])
+						++mismatches;
+				}
+			}
+
+			double startTime = curTime();
+			for (unsigned pos = start; pos < end; pos += block)
+			{
+				unsigned n = end - pos > block ? block : end - pos;
+				for (unsigned i = 0; i < n; ++i)
+					ref[i] = part->gain(pos + i);
+				sink += ref[0];
+			}
+			frameTime += curTime() - startTime;
+
+			startTime = curTime();
+			for (unsigned pos = start; pos < end; pos += block)
+			{
+				unsigned n = end - pos > block ? block : end - pos;
+				part->gain(pos, n, buf);
+				sink += buf[0];
+			}
+			blockTime += curTime() - startTime;
+		}
+	}
+
+	printf("bench: %s %d wave parts, %u frames, %u differ\n", project.toLatin1().constData(),
+			nparts, frames, mismatches);
+	printf("bench: per frame %.3f s, per block %.3f s, speedup %.2f (%g)\n", frameTime, blockTime,
+			blockTime > 0.0 ? frameTime / blockTime : 0.0, sink);
+	return mismatches ? 1 : 0;
+}
+
+//---------------------------------------------------------
+//   StubSynth
+//    a synth plugin without a library for benchSynthEvents().
+//    process() takes the events of the cycle the way the
+//    LV2 and VST plugins do and remembers their offsets.
+//---------------------------------------------------------
+
+class StubSynth : public BasePlugin
+{
+public:
+	std::vector<unsigned> times;
+	std::vector<uint32_t> offsets;
+
+	StubSynth()
+	{
+		m_name = "stub";
+		m_aoutsCount = 1;
+		m_portsOut = new void*[1];
+		m_portsOut[0] = 0; // the buffer of the dummy driver
+		m_enabled = true;
+	}
+
+	virtual void deleteMe()
+	{
+		delete this;
+	}
+	virtual bool hasNativeGui()
+	{
+		return false;
+	}
+	virtual void showNativeGui(bool)
+	{
+	}
+	virtual bool nativeGuiVisible()
+	{
+		return false;
+	}
+	virtual void updateNativeGui()
+	{
+	}
+	virtual QString getParameterName(uint32_t)
+	{
+		return QString();
+	}
+	virtual QString getParameterUnit(uint32_t)
+	{
+		return QString();
+	}
+	virtual void setNativeParameterValue(uint32_t, double)
+	{
+	}
+	virtual uint32_t getProgramCount()
+	{
+		return 0;
+	}
+	virtual QString getProgramName(uint32_t)
+	{
+		return QString();
+	}
+	virtual void setProgram(uint32_t)
+	{
+	}
+	virtual bool init(QString, QString)
+	{
+		return true;
+	}
+	virtual void reload()
+	{
+	}
+	virtual void reloadPrograms(bool)
+	{
+	}
+	virtual void bufferSizeChanged(uint32_t)
+	{
+	}
+	virtual bool readConfiguration(Xml&, bool)
+	{
+		return false;
+	}
+	virtual void writeConfiguration(int, Xml&)
+	{
+	}
+
+	virtual void process(uint32_t frames, float**, float**, MPEventList* eventList)
+	{
+		if (eventList == 0)
+			return;
+		iMPEvent ev = eventList->begin();
+		for (; ev != eventList->end(); ++ev)
+		{
+			uint32_t offset = eventFrameOffset(*ev, frames);
+			if (offset >= frames)
+				break;
+			times.push_back(ev->time());
+			offsets.push_back(offset);
+		}
+		eventList->erase(eventList->begin(), ev);
+	}
+};
+
+//---------------------------------------------------------
+//   benchSynthEvents
+//    --bench-synth: drive a stub synth through processSynth()
+//    for cycles cycles of random note events up to three
+//    cycles ahead, enabled and disabled in turn. An enabled
+//    synth must get the events of the cycle at their frame,
+//    a disabled one none. Either way the later events must
+//    stay in the list. Prints the events which went wrong.
+//---------------------------------------------------------
+
+int benchSynthEvents(int cycles)
+{
+	openEngine();
+
+	srand(1);
+	StubSynth* synth = new StubSynth;
+	MPEventList events;
+	unsigned frames = segmentSize;
+	int played = 0;
+	int kept = 0;
+	int wrong = 0;
+
+	for (int k = 0; k < cycles; ++k)
+	{
+		bool enabled = k & 1;
+		synth->setEnabled(enabled);
+		synth->times.clear();
+		synth->offsets.clear();
+		events.clear();
+		int n = rand() % 32;
+		for (int i = 0; i < n; ++i)
+			events.add(MidiPlayEvent(rand() % (3 * frames), 0, 0, ME_NOTEON, 60, 100));
+
+		std::vector<unsigned> now;
+		std::vector<unsigned> later;
+		for (ciMPEvent i = events.begin(); i != events.end(); ++i)
+		{
+			if (i->time() < frames)
+				now.push_back(i->time());
+			else
+				later.push_back(i->time());
+		}
+
+		synth->processSynth(&events);
+
+		// the events of the cycle, the time is the frame offset as
+		// the transport stands at frame 0
+		std::vector<unsigned> expect;
+		if (enabled)
+			expect = now;
+		if (synth->times != expect)
+		{
+			printf("bench: cycle %d %s: %d events played, %d expected\n", k,
+					enabled ? "enabled" : "disabled", int(synth->times.size()), int(expect.size()));
+			++wrong;
+		}
+		for (unsigned i = 0; i < synth->offsets.size(); ++i)
+		{
+			if (synth->offsets[i] != synth->times[i])
+			{
+				printf("bench: cycle %d: event at %u played at frame %u\n", k, synth->times[i], synth->offsets[i]);
+				++wrong;
+			}
+		}
+		played += synth->times.size();
+
+		std::vector<unsigned> left;
+		for (ciMPEvent i = events.begin(); i != events.end(); ++i)
+			left.push_back(i->time());
+		if (left != later)
+		{
+			printf("bench: cycle %d %s: %d events kept, %d expected\n", k,
+					enabled ? "enabled" : "disabled", int(left.size()), int(later.size()));
+			++wrong;
+		}
+		kept += left.size();
+	}
+	synth->deleteMe();
+
+	printf("bench: %d cycles of %u frames, %d events played, %d kept, %d wrong\n",
+			cycles, frames, played, kept, wrong);
+	return wrong ? 1 : 0;
+}
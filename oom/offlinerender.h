@@ -0,0 +1,49 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#ifndef __OFFLINERENDER_H__
+#define __OFFLINERENDER_H__
+
+class QString;
+
+//---------------------------------------------------------
+//   renderProject
+//    load a project without the gui and mix the range
+//    "from:to" of its first output into a wav file as fast
+//    as the cpu allows. from and to are l, r, start, end
+//    or a frame number, an empty range is the whole song.
+//    returns the exit code for main()
+//---------------------------------------------------------
+
+extern int renderProject(const QString& project, const QString& output, const QString& range);
+
+//---------------------------------------------------------
+//   benchAudioGraph
+//    time rendering the range of a project with and without
+//    the AudioGraph workers, nothing is written
+//---------------------------------------------------------
+
+extern int benchAudioGraph(const QString& project, const QString& range);
+
+//---------------------------------------------------------
+//   benchWaveFades
+//    compare and time the fade envelope of the wave parts
+//    of a project rendered per frame and per block
+//---------------------------------------------------------
+
+extern int benchWaveFades(const QString& project);
+
+//---------------------------------------------------------
+//   benchSynthEvents
+//    check the frame offsets processSynth() gives a stub
+//    synth plugin and the events it keeps for later cycles
+//---------------------------------------------------------
+
+extern int benchSynthEvents(int cycles);
+
+#endif
+
@@ -736,6 +736,7 @@ void Part::setZIndex(int i)
 	if(_track)
 	{
 		_track->setMaxZIndex(i);
+		_track->partsChanged();
 		if (_track->type() == Track::WAVE)
 		{
 			((WaveTrack*)_track)->calculateCrossFades();
@@ -837,6 +838,87 @@ float WavePart::gain(unsigned pos)
 	return gainValue;
 }
 
+//---------------------------------------------------------
+//   fadeRange
+//    clip the part relative frames [start, end) to a block
+//    of n frames starting at part relative frame p0
+//    return false if they do not overlap
+//---------------------------------------------------------
+
+static bool fadeRange(unsigned p0, unsigned n, unsigned start, unsigned end, unsigned* from, unsigned* to)
+{
+	unsigned b = start > p0 ? start - p0 : 0;
+	unsigned e = end > p0 ? end - p0 : 0;
+	if (e > n)
+		e = n;
+	if (b >= e)
+		return false;
+	*from = b;
+	*to = e;
+	return true;
+}
+
+//---------------------------------------------------------
+//   gain
+//    render the fade envelope for n frames starting at
+//    frame pos into buf. Gives the same values as calling
+//    gain(unsigned) for every frame, but walks the fade
+//    curves only once per block.
+//---------------------------------------------------------
+
+void WavePart::gain(unsigned pos, unsigned n, float* buf)
+{
+	for (unsigned i = 0; i < n; ++i)
+		buf[i] = 1.0f;
+
+	unsigned p0 = pos - frame();
+	unsigned from, to;
+
+	FadeCurve* fadeIns[2] = {m_fadeIn, m_crossFadeIn};
+	for (int k = 0; k < 2; ++k)
+	{
+		FadeCurve* fade = fadeIns[k];
+		if (!fade)
+			continue;
+		long w = fade->width();
+		unsigned start = fade->getFrame();
+		unsigned end = start + w;
+		if (w <= 0 || !fadeRange(p0, n, start, end, &from, &to))
+			continue;
+		for (unsigned i = from; i < to; ++i)
+			buf[i] *= float(p0 + i - start) / w;
+	}
+
+	// Fade out ends are inclusive, and both factors are multiplied
+	// together before they are applied, like getFadeOutValue() does.
+	unsigned from1 = 0, to1 = 0, from2 = 0, to2 = 0;
+	long w1 = m_fadeOut ? m_fadeOut->width() : 0;
+	long w2 = m_crossFadeOut ? m_crossFadeOut->width() : 0;
+	unsigned start1 = w1 > 0 ? m_fadeOut->getFrame() : 0;
+	unsigned start2 = w2 > 0 ? m_crossFadeOut->getFrame() : 0;
+	bool out1 = w1 > 0 && fadeRange(p0, n, start1, unsigned(start1 + w1) + 1, &from1, &to1);
+	bool out2 = w2 > 0 && fadeRange(p0, n, start2, unsigned(start2 + w2) + 1, &from2, &to2);
+
+	if (out1)
+	{
+		for (unsigned i = from1; i < to1; ++i)
+		{
+			float out = 1.0f - float(p0 + i - start1) / w1;
+			if (out2 && i >= from2 && i < to2)
+				out *= 1.0f - float(p0 + i - start2) / w2;
+			buf[i] *= out;
+		}
+	}
+	if (out2)
+	{
+		for (unsigned i = from2; i < to2; ++i)
+		{
+			if (!out1 || i < from1 || i >= to1)
+				buf[i] *= 1.0f - float(p0 + i - start2) / w2;
+		}
+	}
+}
+
 float WavePart::getFadeOutValue(unsigned pos, QList<FadeCurve *> fades)
 {
 	float gain = 1.0f;
@@ -1027,6 +1109,7 @@ void Song::removePart(Part* part)
 	removePortCtrlEvents(part, false);
 	Track* track = part->track();
 	track->parts()->remove(part);
+	track->partsChanged();
 }
 
 //---------------------------------------------------------
@@ -1515,6 +1598,9 @@ void Song::changePart(Part* oPart, Part* nPart)
 
 	oTrack->parts()->remove(oPart);
 	nTrack->parts()->add(nPart);
+	oTrack->partsChanged();
+	if (nTrack != oTrack)
+		nTrack->partsChanged();
 	nPart->setColorIndex(oPart->colorIndex());
 
 	// adjust song len:
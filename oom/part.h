@@ -266,6 +266,7 @@ public:
 	FadeCurve* crossFadeOut() { return m_crossFadeOut;}
 
 	float gain(unsigned);
+	void gain(unsigned pos, unsigned n, float* buf);
 	float getFadeOutValue(unsigned pos, QList<FadeCurve*> fades);
 	float getFadeInValue(unsigned pos, QList<FadeCurve*> fades);
 	void setHasCrossFadeForPartialOverlapLeft(bool crossFade) {m_hasCrossFadeForPartialOverlapLeft = crossFade;}
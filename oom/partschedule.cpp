@@ -0,0 +1,119 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#include <algorithm>
+
+#include "partschedule.h"
+#include "part.h"
+
+//---------------------------------------------------------
+//   smallerStart
+//---------------------------------------------------------
+
+static bool smallerStart(const ScheduleEntry& a, const ScheduleEntry& b)
+{
+	return a.start < b.start;
+}
+
+//---------------------------------------------------------
+//   PartSchedule
+//---------------------------------------------------------
+
+PartSchedule::PartSchedule(const PartList* pl, unsigned serial, int tempoSN)
+{
+	_serial = serial;
+	_tempoSN = tempoSN;
+	_maxLen = 0;
+
+	// the z order of the parts, equal z values stay in list order
+	std::vector<Part*> byZ;
+	byZ.reserve(pl->size());
+	for (ciPart ip = pl->begin(); ip != pl->end(); ++ip)
+		byZ.push_back(ip->second);
+	std::stable_sort(byZ.begin(), byZ.end(), Part::smallerZValue);
+
+	_entries.resize(byZ.size());
+	for (unsigned i = 0; i < byZ.size(); ++i)
+	{
+		ScheduleEntry& e = _entries[i];
+		e.part = (WavePart*) byZ[i];
+		e.z = i;
+		e.start = e.part->frame();
+		e.end = e.start + e.part->lenFrame();
+		if (e.end - e.start > _maxLen)
+			_maxLen = e.end - e.start;
+	}
+	std::sort(_entries.begin(), _entries.end(), smallerStart);
+}
+
+//---------------------------------------------------------
+//   window
+//    entries [first, last) are the only ones which can
+//    overlap the frames [from, to]
+//---------------------------------------------------------
+
+void PartSchedule::window(unsigned from, unsigned to, int* first, int* last) const
+{
+	// parts starting more than the longest part before from have ended
+	unsigned minStart = from > _maxLen ? from - _maxLen : 0;
+
+	int lo = 0;
+	int hi = _entries.size();
+	while (lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		if (_entries[mid].start < minStart)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	*first = lo;
+
+	hi = _entries.size();
+	while (lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		if (_entries[mid].start <= to)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	*last = lo;
+}
+
+//---------------------------------------------------------
+//   find
+//    parts of the entries [first, last) which overlap the
+//    frames [from, to], bottom part first. parts must have
+//    room for last - first values.
+//    returns the number of parts found
+//---------------------------------------------------------
+
+int PartSchedule::find(unsigned from, unsigned to, int first, int last, WavePart** parts) const
+{
+	int z[last - first + 1];
+	int n = 0;
+	for (int i = first; i < last; ++i)
+	{
+		const ScheduleEntry& e = _entries[i];
+		if (e.start > to || from >= e.end)
+			continue;
+
+		// insertion sort by z, only a few parts overlap
+		int k = n++;
+		while (k > 0 && z[k - 1] > e.z)
+		{
+			z[k] = z[k - 1];
+			parts[k] = parts[k - 1];
+			--k;
+		}
+		z[k] = e.z;
+		parts[k] = e.part;
+	}
+	return n;
+}
+
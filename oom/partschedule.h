@@ -0,0 +1,62 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#ifndef __PARTSCHEDULE_H__
+#define __PARTSCHEDULE_H__
+
+#include <vector>
+
+class PartList;
+class WavePart;
+
+//---------------------------------------------------------
+//   ScheduleEntry
+//---------------------------------------------------------
+
+struct ScheduleEntry
+{
+    unsigned start; // part start frame
+    unsigned end;
+    int z; // position in z order, bottom part first
+    WavePart* part;
+};
+
+//---------------------------------------------------------
+//   PartSchedule
+//    Immutable playback index of the parts of a wave track,
+//    sorted by start frame. Built when the parts change and
+//    queried by the prefetch thread for the parts sounding
+//    in a range, so the cost of a prefetch depends on the
+//    overlapping parts and not on the size of the song.
+//---------------------------------------------------------
+
+class PartSchedule
+{
+    std::vector<ScheduleEntry> _entries;
+    unsigned _maxLen; // longest part, bounds the search to the left
+    unsigned _serial;
+    int _tempoSN;
+
+public:
+    PartSchedule(const PartList*, unsigned serial, int tempoSN);
+
+    unsigned serial() const
+    {
+        return _serial;
+    }
+
+    int tempoSN() const
+    {
+        return _tempoSN;
+    }
+
+    void window(unsigned from, unsigned to, int* first, int* last) const;
+    int find(unsigned from, unsigned to, int first, int last, WavePart** parts) const;
+};
+
+#endif
+
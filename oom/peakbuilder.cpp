@@ -0,0 +1,316 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#include <stdio.h>
+#include <string.h>
+#include <sndfile.h>
+
+#include <QThread>
+#include <QMutexLocker>
+
+#include "peakbuilder.h"
+#include "peakfile.h"
+#include "wave.h"
+#include "waveoverlay.h"
+#include "globals.h"
+
+// frames read at once, a multiple of PEAK_BASE_MAG
+static const unsigned PEAK_CHUNK = 65536;
+// reading is mostly disk bound, more threads do not help
+static const int MAX_PEAK_WORKERS = 4;
+
+PeakBuilder* peakBuilder;
+
+//---------------------------------------------------------
+//   PeakWorker
+//---------------------------------------------------------
+
+class PeakWorker : public QThread
+{
+	PeakBuilder* _builder;
+
+public:
+	PeakWorker(PeakBuilder* b)
+	{
+		_builder = b;
+	}
+
+protected:
+	virtual void run()
+	{
+		_builder->workerLoop();
+	}
+};
+
+//---------------------------------------------------------
+//   PeakBuilder
+//---------------------------------------------------------
+
+PeakBuilder::PeakBuilder(int threads, QObject* parent)
+: QObject(parent)
+{
+	_quit = false;
+	_notifyPending = false;
+	if (threads <= 0)
+	{
+		threads = QThread::idealThreadCount();
+		if (threads > MAX_PEAK_WORKERS)
+			threads = MAX_PEAK_WORKERS;
+		if (threads < 1)
+			threads = 1;
+	}
+	for (int i = 0; i < threads; ++i)
+	{
+		QThread* t = new PeakWorker(this);
+		t->start(QThread::LowPriority);
+		_workers.append(t);
+	}
+	if (debugMsg)
+		printf("PeakBuilder: started %d worker threads\n", threads);
+}
+
+PeakBuilder::~PeakBuilder()
+{
+	_lock.lock();
+	_quit = true;
+	foreach(PeakJob* job, _running)
+		job->abort = true;
+	_jobAdded.wakeAll();
+	_lock.unlock();
+
+	foreach(QThread* t, _workers)
+	{
+		t->wait();
+		delete t;
+	}
+	qDeleteAll(_jobs);
+}
+
+//---------------------------------------------------------
+//   add
+//    queue the frames [from, to) of sf. initial is set for
+//    a newly created peak file.
+//---------------------------------------------------------
+
+void PeakBuilder::add(SndFile* sf, PeakFile* peaks, unsigned from, unsigned to, bool initial)
+{
+	from -= from % PEAK_BASE_MAG;
+
+	QMutexLocker locker(&_lock);
+	// merge with a job for the same file that has not started yet
+	foreach(PeakJob* job, _jobs)
+	{
+		if (job->sf == sf)
+		{
+			if (from < job->from)
+				job->from = from;
+			if (to > job->to)
+				job->to = to;
+			job->initial = job->initial || initial;
+			return;
+		}
+	}
+
+	PeakJob* job = new PeakJob;
+	job->sf = sf;
+	job->peaks = peaks;
+	job->path = sf->path();
+	job->channels = sf->channels();
+	job->from = from;
+	job->to = to;
+	job->initial = initial;
+	job->abort = false;
+	_jobs.append(job);
+	_jobAdded.wakeOne();
+}
+
+//---------------------------------------------------------
+//   cancel
+//    drop all jobs for sf and wait until no worker
+//    uses it any more
+//---------------------------------------------------------
+
+void PeakBuilder::cancel(SndFile* sf)
+{
+	QMutexLocker locker(&_lock);
+	for (int i = 0; i < _jobs.size();)
+	{
+		if (_jobs[i]->sf == sf)
+			delete _jobs.takeAt(i);
+		else
+			++i;
+	}
+	for (;;)
+	{
+		bool busy = false;
+		foreach(PeakJob* job, _running)
+		{
+			if (job->sf == sf)
+			{
+				job->abort = true;
+				busy = true;
+			}
+		}
+		if (!busy)
+			break;
+		_jobDone.wait(&_lock);
+	}
+}
+
+//---------------------------------------------------------
+//   takeJob
+//    next job for a file no other worker is on
+//    called with _lock held
+//---------------------------------------------------------
+
+PeakJob* PeakBuilder::takeJob()
+{
+	for (int i = 0; i < _jobs.size(); ++i)
+	{
+		bool busy = false;
+		foreach(PeakJob* job, _running)
+		{
+			if (job->sf == _jobs[i]->sf)
+				busy = true;
+		}
+		if (!busy)
+			return _jobs.takeAt(i);
+	}
+	return 0;
+}
+
+//---------------------------------------------------------
+//   workerLoop
+//---------------------------------------------------------
+
+void PeakBuilder::workerLoop()
+{
+	_lock.lock();
+	for (;;)
+	{
+		PeakJob* job = 0;
+		while (!_quit && (job = takeJob()) == 0)
+			_jobAdded.wait(&_lock);
+		if (_quit)
+			break;
+		_running.append(job);
+		_lock.unlock();
+
+		build(job);
+
+		_lock.lock();
+		_running.removeAll(job);
+		delete job;
+		_jobDone.wakeAll();
+		// a job for the same file may be waiting
+		_jobAdded.wakeAll();
+	}
+	_lock.unlock();
+}
+
+//---------------------------------------------------------
+//   build
+//    runs in a worker thread
+//---------------------------------------------------------
+
+void PeakBuilder::build(PeakJob* job)
+{
+	SF_INFO info;
+	memset(&info, 0, sizeof (info));
+	SNDFILE* f = sf_open(job->path.toLatin1().constData(), SFM_READ, &info);
+	if (f == 0)
+	{
+		printf("PeakBuilder: cannot open %s: %s\n", job->path.toLatin1().constData(), sf_strerror(0));
+		return;
+	}
+	unsigned channels = info.channels;
+	if (channels != job->channels)
+	{
+		printf("PeakBuilder: %s has changed, skipped\n", job->path.toLatin1().constData());
+		sf_close(f);
+		return;
+	}
+	unsigned to = job->to;
+	if (to > info.frames)
+		to = info.frames;
+	unsigned pos = job->from;
+	if (pos >= to || sf_seek(f, pos, SEEK_SET) == -1)
+	{
+		sf_close(f);
+		return;
+	}
+
+	if (!job->initial)
+		job->peaks->invalidate();
+
+	// the peaks are of the file as it is heard
+	WaveOverlay* overlay = job->sf->overlay();
+	float* buffer = new float[PEAK_CHUNK * channels];
+	float* data = new float[PEAK_CHUNK];
+	while (pos < to && !job->abort)
+	{
+		unsigned n = to - pos < PEAK_CHUNK ? to - pos : PEAK_CHUNK;
+		sf_count_t got = sf_readf_float(f, buffer, n);
+		if (got <= 0)
+			break;
+		unsigned rn = got;
+		if (overlay)
+			overlay->apply(pos, rn, buffer);
+		for (unsigned ch = 0; ch < channels; ++ch)
+		{
+			for (unsigned i = 0; i < rn; ++i)
+				data[i] = buffer[i * channels + ch];
+			for (unsigned i = 0; i < rn; i += PEAK_BASE_MAG)
+			{
+				unsigned frames = rn - i < PEAK_BASE_MAG ? rn - i : PEAK_BASE_MAG;
+				job->peaks->setBase(ch, (pos + i) / PEAK_BASE_MAG, data + i, frames);
+			}
+		}
+		job->peaks->buildLevels(pos, pos + rn);
+		pos += rn;
+		if (job->initial)
+			job->peaks->setReady(pos);
+		requestNotify();
+	}
+	if (!job->abort)
+		job->peaks->finish();
+
+	delete[] data;
+	delete[] buffer;
+	if (overlay)
+		overlay->deref();
+	sf_close(f);
+	requestNotify();
+}
+
+//---------------------------------------------------------
+//   requestNotify
+//    called from the workers, at most one notification
+//    is queued for the gui at a time
+//---------------------------------------------------------
+
+void PeakBuilder::requestNotify()
+{
+	_lock.lock();
+	bool post = !_notifyPending;
+	_notifyPending = true;
+	_lock.unlock();
+	if (post)
+		QMetaObject::invokeMethod(this, "notify", Qt::QueuedConnection);
+}
+
+//---------------------------------------------------------
+//   notify
+//---------------------------------------------------------
+
+void PeakBuilder::notify()
+{
+	_lock.lock();
+	_notifyPending = false;
+	_lock.unlock();
+	emit peaksReady();
+}
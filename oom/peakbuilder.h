@@ -0,0 +1,83 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#ifndef __PEAKBUILDER_H__
+#define __PEAKBUILDER_H__
+
+#include <QObject>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QWaitCondition>
+
+class QThread;
+class SndFile;
+class PeakFile;
+
+//---------------------------------------------------------
+//   PeakJob
+//    compute the peak values for the frames [from, to)
+//---------------------------------------------------------
+
+struct PeakJob
+{
+    SndFile* sf;
+    PeakFile* peaks;
+    QString path;
+    unsigned channels;
+    unsigned from;
+    unsigned to;
+    bool initial; // new file, frames past the job are not ready yet
+    volatile bool abort;
+};
+
+//---------------------------------------------------------
+//   PeakBuilder
+//    Builds peak files on a pool of worker threads, so
+//    opening and importing wave files does not block the
+//    gui. Every worker reads its file sequentially in large
+//    chunks through its own sndfile handle and publishes
+//    each finished chunk, peaksReady() tells the gui to
+//    redraw what is available.
+//---------------------------------------------------------
+
+class PeakBuilder : public QObject
+{
+    Q_OBJECT
+
+    QList<PeakJob*> _jobs;
+    QList<PeakJob*> _running;
+    QList<QThread*> _workers;
+    QMutex _lock;
+    QWaitCondition _jobAdded;
+    QWaitCondition _jobDone;
+    bool _quit;
+    bool _notifyPending;
+
+    PeakJob* takeJob();
+    void build(PeakJob*);
+    void requestNotify();
+
+private slots:
+    void notify();
+
+signals:
+    void peaksReady();
+
+public:
+    PeakBuilder(int threads = 0, QObject* parent = 0);
+    ~PeakBuilder();
+
+    void add(SndFile*, PeakFile*, unsigned from, unsigned to, bool initial);
+    void cancel(SndFile*);
+    void workerLoop();
+};
+
+extern PeakBuilder* peakBuilder;
+
+#endif
+
@@ -0,0 +1,355 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <cmath>
+
+#include <QString>
+
+#include "peakfile.h"
+#include "wave.h"
+
+static const char peakMagic[8] = {'O', 'O', 'M', 'P', 'E', 'A', 'K', 0};
+
+//---------------------------------------------------------
+//   PeakFile
+//---------------------------------------------------------
+
+PeakFile::PeakFile()
+{
+	_fd = -1;
+	_map = 0;
+	_size = 0;
+	_header = 0;
+	_writable = false;
+	_ready = 0;
+}
+
+PeakFile::~PeakFile()
+{
+	close();
+}
+
+//---------------------------------------------------------
+//   close
+//---------------------------------------------------------
+
+void PeakFile::close()
+{
+	if (_map)
+		munmap(_map, _size);
+	if (_fd != -1)
+		::close(_fd);
+	_fd = -1;
+	_map = 0;
+	_size = 0;
+	_header = 0;
+	_writable = false;
+	_ready = 0;
+}
+
+//---------------------------------------------------------
+//   mapFile
+//    returns true on error
+//---------------------------------------------------------
+
+bool PeakFile::mapFile(const QString& path, bool create, size_t size)
+{
+	close();
+	if (create)
+	{
+		_fd = ::open(path.toLatin1().constData(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		_writable = _fd != -1;
+	}
+	else
+	{
+		// writable if possible, so changed ranges can be updated in place
+		_fd = ::open(path.toLatin1().constData(), O_RDWR);
+		if (_fd == -1)
+			_fd = ::open(path.toLatin1().constData(), O_RDONLY);
+		else
+			_writable = true;
+	}
+	if (_fd == -1)
+		return true;
+
+	if (create)
+	{
+		if (ftruncate(_fd, size) == -1)
+		{
+			printf("PeakFile: cannot resize %s: %s\n", path.toLatin1().constData(), strerror(errno));
+			close();
+			return true;
+		}
+	}
+	else
+	{
+		struct stat st;
+		if (fstat(_fd, &st) == -1 || st.st_size < (off_t) sizeof (PeakFileHeader))
+		{
+			close();
+			return true;
+		}
+		size = st.st_size;
+	}
+
+	void* p = mmap(0, size, _writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, _fd, 0);
+	if (p == MAP_FAILED)
+	{
+		printf("PeakFile: cannot map %s: %s\n", path.toLatin1().constData(), strerror(errno));
+		close();
+		return true;
+	}
+	_map = (char*) p;
+	_size = size;
+	_header = (PeakFileHeader*) _map;
+	return false;
+}
+
+//---------------------------------------------------------
+//   open
+//    map an existing peak file, fails if it is from an
+//    older version or does not match the wave file
+//---------------------------------------------------------
+
+bool PeakFile::open(const QString& path, unsigned channels, unsigned frames)
+{
+	if (mapFile(path, false, 0))
+		return true;
+
+	const PeakFileHeader* h = _header;
+	bool ok = memcmp(h->magic, peakMagic, sizeof (peakMagic)) == 0
+			&& h->version == PEAK_FILE_VERSION
+			&& h->channels == channels
+			&& h->frames == frames
+			&& h->levels > 0 && h->levels <= PEAK_MAX_LEVELS;
+	for (unsigned l = 0; ok && l < h->levels; ++l)
+	{
+		quint64 end = h->offset[l] + quint64(h->count[l]) * channels * sizeof (PeakV);
+		if (end > _size)
+			ok = false;
+	}
+	if (!ok)
+	{
+		close();
+		return true;
+	}
+	_ready = frames;
+	return false;
+}
+
+//---------------------------------------------------------
+//   create
+//    make a new, empty peak file. The caller fills level 0
+//    with setBase(), calls buildLevels() and setReady() for
+//    each finished range and finally finish().
+//---------------------------------------------------------
+
+bool PeakFile::create(const QString& path, unsigned channels, unsigned frames)
+{
+	PeakFileHeader h;
+	memset(&h, 0, sizeof (h));
+	h.version = PEAK_FILE_VERSION;
+	h.channels = channels;
+	h.frames = frames;
+
+	quint64 offset = sizeof (PeakFileHeader);
+	unsigned mag = PEAK_BASE_MAG;
+	for (int l = 0; l < PEAK_MAX_LEVELS; ++l)
+	{
+		unsigned count = (frames + mag - 1) / mag;
+		h.mag[l] = mag;
+		h.count[l] = count;
+		h.offset[l] = offset;
+		offset += quint64(count) * channels * sizeof (PeakV);
+		h.levels = l + 1;
+		if (count <= 1)
+			break;
+		mag <<= PEAK_LEVEL_SHIFT;
+	}
+
+	if (mapFile(path, true, offset))
+	{
+		printf("PeakFile: cannot create %s\n", path.toLatin1().constData());
+		return true;
+	}
+	// magic stays zero until finish()
+	memcpy(_header, &h, sizeof (h));
+	return false;
+}
+
+//---------------------------------------------------------
+//   setBase
+//    compute value idx of the finest level from n frames
+//---------------------------------------------------------
+
+void PeakFile::setBase(unsigned ch, unsigned idx, const float* data, unsigned n)
+{
+	if (!_writable || ch >= _header->channels || idx >= _header->count[0])
+		return;
+
+	float rms = 0.0;
+	float mn = 0.0;
+	float mx = 0.0;
+	for (unsigned i = 0; i < n; ++i)
+	{
+		float fd = data[i];
+		rms += fd * fd;
+		if (fd < mn)
+			mn = fd;
+		if (fd > mx)
+			mx = fd;
+	}
+
+	int peak = int((mx > -mn ? mx : -mn) * 255.0);
+	// rms on the scale of the peak, not amplified
+	int rmsValue = n ? int(sqrt(rms / n) * 255.0) : 0;
+	int imin = int(mn * 127.0);
+	int imax = int(mx * 127.0);
+
+	PeakV* v = values(0, ch) + idx;
+	v->peak = peak > 255 ? 255 : peak;
+	v->rms = rmsValue > 255 ? 255 : rmsValue;
+	v->min = imin < -127 ? -127 : imin;
+	v->max = imax > 127 ? 127 : imax;
+}
+
+//---------------------------------------------------------
+//   buildLevels
+//    update the coarser levels for the frames [from, to)
+//    of level 0
+//---------------------------------------------------------
+
+void PeakFile::buildLevels(unsigned from, unsigned to)
+{
+	if (!_writable)
+		return;
+	const unsigned step = 1 << PEAK_LEVEL_SHIFT;
+	for (unsigned l = 1; l < _header->levels; ++l)
+	{
+		unsigned mag = _header->mag[l];
+		unsigned count = _header->count[l];
+		unsigned srcCount = _header->count[l - 1];
+		unsigned begin = from / mag;
+		unsigned end = (to + mag - 1) / mag;
+		if (end > count)
+			end = count;
+		for (unsigned ch = 0; ch < _header->channels; ++ch)
+		{
+			const PeakV* src = values(l - 1, ch);
+			PeakV* dst = values(l, ch);
+			for (unsigned i = begin; i < end; ++i)
+			{
+				unsigned first = i * step;
+				unsigned last = first + step < srcCount ? first + step : srcCount;
+				int peak = 0, mn = 0, mx = 0;
+				float sq = 0.0;
+				for (unsigned k = first; k < last; ++k)
+				{
+					if (src[k].peak > peak)
+						peak = src[k].peak;
+					if (src[k].min < mn)
+						mn = src[k].min;
+					if (src[k].max > mx)
+						mx = src[k].max;
+					sq += float(src[k].rms) * src[k].rms;
+				}
+				int rms = last > first ? int(sqrt(sq / (last - first))) : 0;
+				dst[i].peak = peak;
+				dst[i].rms = rms > 255 ? 255 : rms;
+				dst[i].min = mn;
+				dst[i].max = mx;
+			}
+		}
+	}
+}
+
+//---------------------------------------------------------
+//   invalidate
+//    clear the magic while the file is rewritten, so it is
+//    rebuilt on the next open if the update is interrupted
+//---------------------------------------------------------
+
+void PeakFile::invalidate()
+{
+	if (!_writable)
+		return;
+	memset(_header->magic, 0, sizeof (_header->magic));
+}
+
+//---------------------------------------------------------
+//   finish
+//    flush the values and mark the file as complete
+//---------------------------------------------------------
+
+void PeakFile::finish()
+{
+	if (!_writable)
+		return;
+	msync(_map, _size, MS_SYNC);
+	memcpy(_header->magic, peakMagic, sizeof (peakMagic));
+	msync(_map, sizeof (PeakFileHeader), MS_ASYNC);
+	setReady(_header->frames);
+}
+
+//---------------------------------------------------------
+//   read
+//    peak and rms of mag frames starting at pos, taken
+//    from the coarsest level that still has at least one
+//    value per mag frames, the rms values are combined as
+//    the root of their mean square
+//    returns false if mag is finer than the finest level
+//---------------------------------------------------------
+
+bool PeakFile::read(SampleV* s, unsigned channels, int mag, unsigned pos, bool overwrite) const
+{
+	if (!_header || mag < (int) _header->mag[0])
+		return false;
+
+	int l = _header->levels - 1;
+	while (l > 0 && (unsigned) mag < _header->mag[l])
+		--l;
+
+	unsigned lmag = _header->mag[l];
+	unsigned first = pos / lmag;
+	unsigned n = mag / lmag;
+	// values past ready() are still being computed
+	unsigned count = (ready() + lmag - 1) / lmag;
+	if (count > _header->count[l])
+		count = _header->count[l];
+	if (first >= count)
+		return true;
+	if (first + n > count)
+		n = count - first;
+
+	if (channels > _header->channels)
+		channels = _header->channels;
+	for (unsigned ch = 0; ch < channels; ++ch)
+	{
+		const PeakV* v = values(l, ch) + first;
+		float sq = 0.0;
+		for (unsigned i = 0; i < n; ++i)
+		{
+			sq += float(v[i].rms) * v[i].rms;
+			if (s[ch].peak < v[i].peak)
+				s[ch].peak = v[i].peak;
+		}
+		int rms = int(sqrt(sq / n));
+		if (overwrite)
+			s[ch].rms = rms;
+		else
+			s[ch].rms += rms;
+	}
+	return true;
+}
+
@@ -0,0 +1,124 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#ifndef __PEAKFILE_H__
+#define __PEAKFILE_H__
+
+#include <QtGlobal>
+
+#include "lockfree.h"
+
+class QString;
+struct SampleV;
+
+#define PEAK_FILE_VERSION 1
+#define PEAK_MAX_LEVELS   8
+// frames per value of the finest level
+#define PEAK_BASE_MAG     16
+// every level is 1 << PEAK_LEVEL_SHIFT times coarser than the one below
+#define PEAK_LEVEL_SHIFT  2
+
+//---------------------------------------------------------
+//   PeakV
+//    one peak file value, covering mag frames of one channel
+//---------------------------------------------------------
+
+struct PeakV
+{
+    unsigned char peak; // max abs value, 0 - 255
+    unsigned char rms; // 0 - 255
+    signed char min; // -127 - 127
+    signed char max;
+};
+
+//---------------------------------------------------------
+//   PeakFileHeader
+//---------------------------------------------------------
+
+struct PeakFileHeader
+{
+    char magic[8];
+    quint32 version;
+    quint32 channels;
+    quint32 frames;
+    quint32 levels;
+    quint32 mag[PEAK_MAX_LEVELS]; // frames per value
+    quint32 count[PEAK_MAX_LEVELS]; // values per channel
+    quint64 offset[PEAK_MAX_LEVELS]; // file offset of channel 0
+};
+
+//---------------------------------------------------------
+//   PeakFile
+//    Peak values of a wave file at several zoom levels.
+//    The file is memory mapped and never loaded as a whole,
+//    each level holds the values of all channels one after
+//    another:
+//
+//      header | level 0: ch0 ch1 .. | level 1: ch0 ch1 .. | ..
+//
+//    The magic is written last when a new file is created,
+//    so an interrupted build is detected and redone on the
+//    next open.
+//
+//    A file can be filled while it is read: only the frames
+//    below ready() are returned by read(), and buildLevels()
+//    updates the coarser levels for each finished range.
+//---------------------------------------------------------
+
+class PeakFile
+{
+    int _fd;
+    char* _map;
+    size_t _size;
+    PeakFileHeader* _header;
+    bool _writable;
+    volatile unsigned _ready; // frames with valid values
+
+    PeakV* values(int level, unsigned ch) const
+    {
+        return (PeakV*) (_map + _header->offset[level]) + ch * _header->count[level];
+    }
+    bool mapFile(const QString& path, bool create, size_t size);
+
+public:
+    PeakFile();
+    ~PeakFile();
+
+    bool open(const QString& path, unsigned channels, unsigned frames); //!< returns true on error
+    bool create(const QString& path, unsigned channels, unsigned frames); //!< returns true on error
+    void close();
+
+    unsigned baseCount() const
+    {
+        return _header ? _header->count[0] : 0;
+    }
+
+    bool isWritable() const
+    {
+        return _writable;
+    }
+
+    unsigned ready() const
+    {
+        return oom_load_acquire(&_ready);
+    }
+
+    void setReady(unsigned frames)
+    {
+        oom_store_release(&_ready, frames);
+    }
+
+    void setBase(unsigned ch, unsigned idx, const float* data, unsigned n);
+    void buildLevels(unsigned from, unsigned to);
+    void invalidate();
+    void finish();
+
+    bool read(SampleV* s, unsigned channels, int mag, unsigned pos, bool overwrite) const;
+};
+
+#endif
+
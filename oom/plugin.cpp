@@ -54,7 +54,9 @@
 #include "audio.h"
 #include "audiodev.h"
 #include "track.h"
+#include "sync.h"
 #include "al/dsp.h"
+#include "dspload.h"
 
 #include "lib_functions.h"
 
@@ -102,6 +104,133 @@ void set_last_error(const char* error)
     last_error = strdup(error);
 }
 
+//---------------------------------------------------------
+//   PluginControlFifo
+//---------------------------------------------------------
+
+PluginControlFifo::PluginControlFifo()
+{
+    for (unsigned i = 0; i < PLUGIN_CONTROL_FIFO_SIZE; ++i)
+        fifo[i].seq = i;
+    rcount = 0;
+    oom_store_release(&wcount, 0);
+}
+
+//---------------------------------------------------------
+//   put
+//    return true on fifo overflow
+//---------------------------------------------------------
+
+bool PluginControlFifo::put(const PluginControl& c)
+{
+    for (;;)
+    {
+        unsigned count = oom_load_acquire(&wcount);
+        Slot* s = &fifo[count % PLUGIN_CONTROL_FIFO_SIZE];
+        int diff = int(oom_load_acquire(&s->seq) - count);
+        if (diff < 0)
+            return true; // the reader did not free the slot yet
+        if (diff == 0 && __sync_bool_compare_and_swap(&wcount, count, count + 1))
+        {
+            s->control = c;
+            oom_store_release(&s->seq, count + 1);
+            return false;
+        }
+        // another writer was faster, try the next slot
+    }
+}
+
+//---------------------------------------------------------
+//   get
+//    only called from the audio thread
+//---------------------------------------------------------
+
+bool PluginControlFifo::get(PluginControl* c)
+{
+    Slot* s = &fifo[rcount % PLUGIN_CONTROL_FIFO_SIZE];
+    if (oom_load_acquire(&s->seq) != rcount + 1)
+        return false;
+    *c = s->control;
+    oom_store_release(&s->seq, rcount + PLUGIN_CONTROL_FIFO_SIZE);
+    ++rcount;
+    return true;
+}
+
+//---------------------------------------------------------
+//   sendControl
+//    queue a change for the audio thread. If the fifo is
+//    full (the plugin is not processed, or a preset sets
+//    many parameters at once) the change is not lost,
+//    applyControls() then takes the current values.
+//---------------------------------------------------------
+
+void BasePlugin::sendControl(PluginControlType type, uint32_t index, double value)
+{
+    PluginControl c;
+    c.type = type;
+    c.index = index;
+    c.value = value;
+    if (m_controls.put(c))
+        __sync_fetch_and_or(&m_resync, 1 << type);
+}
+
+//---------------------------------------------------------
+//   applyControls
+//    apply the queued changes, called by process() in the
+//    audio thread before the plugin runs
+//---------------------------------------------------------
+
+void BasePlugin::applyControls()
+{
+    PluginControl c;
+    while (m_controls.get(&c))
+    {
+        switch (c.type)
+        {
+        case PLUGIN_CONTROL_PARAMETER:
+            setNativeParameterValue(c.index, c.value);
+            break;
+        case PLUGIN_CONTROL_ACTIVE:
+            m_procActive = c.value != 0.0;
+            break;
+        }
+    }
+
+    if (oom_load_acquire(&m_resync) == 0)
+        return;
+    unsigned lost = __sync_fetch_and_and(&m_resync, 0);
+    if (lost & (1 << PLUGIN_CONTROL_PARAMETER))
+    {
+        for (uint32_t i = 0; i < m_paramCount; i++)
+        {
+            if (m_params[i].type == PARAMETER_INPUT)
+                setNativeParameterValue(i, m_params[i].value);
+        }
+    }
+    if (lost & (1 << PLUGIN_CONTROL_ACTIVE))
+        m_procActive = m_active;
+}
+
+//---------------------------------------------------------
+//   changeProgram
+//    gui thread. The plugin reads its parameters back after
+//    a program change, so it is disabled around setProgram()
+//    like around a preset load and the parameters are the
+//    ones of the new program when this returns.
+//---------------------------------------------------------
+
+void BasePlugin::changeProgram(uint32_t index)
+{
+    if (index >= getProgramCount())
+        return;
+    bool enabled = m_enabled;
+    if (enabled)
+        audio->msgEnablePlugin(this, false);
+    setProgram(index);
+    if (enabled)
+        audio->msgEnablePlugin(this, true);
+}
+
 //---------------------------------------------------------
 //   getAudioOutputPortName
 //---------------------------------------------------------
@@ -119,6 +248,7 @@ QString BasePlugin::getAudioOutputPortName(uint32_t index)
 
 void BasePlugin::processSynth(MPEventList* eventList)
 {
+    DspLoadScope load(DSP_LOAD_PLUGIN, this);
     if (m_enabled && m_aoutsCount > 0)
     {
         float* ains_buffer[m_ainsCount];
@@ -136,13 +266,96 @@ void BasePlugin::processSynth(MPEventList* eventList)
     {
         if (eventList)
         {
-            //iMPEvent ev = eventList->begin();
-            //eventList->erase(eventList->begin(), ev);
-            eventList->clear();
+            // drop what this cycle would have played, the rest waits
+            // for the next one like it does in process()
+            iMPEvent ev = eventList->begin();
+            while (ev != eventList->end() && eventFrameOffset(*ev, segmentSize) < segmentSize)
+                ++ev;
+            eventList->erase(eventList->begin(), ev);
         }
     }
 }
 
+//---------------------------------------------------------
+//   eventFrameOffset
+//    frame of ev within the current cycle of 'frames'
+//    frames, like MidiJackDevice::queueEvent() computes it.
+//    A result >= frames means the event belongs to a later
+//    cycle and has to stay in the play list.
+//    With external midi sync the tempo map does not apply
+//    and the time of an event is its tick (see midi.cpp),
+//    there is no frame to place it at, so all events play
+//    at the start of the cycle.
+//---------------------------------------------------------
+
+uint32_t BasePlugin::eventFrameOffset(const MidiPlayEvent& ev, uint32_t frames)
+{
+    if (ev.time() == 0 || extSyncFlag.value())
+        return 0;
+
+    int ft = ev.time() - audio->getFrameOffset() - audio->pos().frame();
+    if (ft < 0)
+        return 0;
+    if ((uint32_t) ft >= frames && debugMsg)
+        printf("BasePlugin: event time:%d is %d frames ahead, kept for the next cycle\n", ev.time(), ft);
+    return ft;
+}
+
+//---------------------------------------------------------
+//   automated
+//    true if the parameters follow the track automation
+//---------------------------------------------------------
+
+bool BasePlugin::automated() const
+{
+    return automation && m_track && m_track->automationType() != AUTO_OFF && m_id != -1;
+}
+
+//---------------------------------------------------------
+//   automationBlock
+//    frames from offset to the next automation point of an
+//    automated parameter, at most config.automationBlockSize.
+//    process() runs the cycle in blocks of this size and
+//    updates the parameters in between, so automation is
+//    not tied to the period size.
+//---------------------------------------------------------
+
+uint32_t BasePlugin::automationBlock(uint32_t offset, uint32_t frames) const
+{
+    uint32_t n = frames - offset;
+    if (config.automationBlockSize > 0 && n > (uint32_t) config.automationBlockSize)
+        n = config.automationBlockSize;
+
+    unsigned pos = audio->pos().frame() + offset;
+    for (uint32_t i = 0; i < m_paramCount; i++)
+    {
+        if (m_params[i].enCtrl && m_params[i].en2Ctrl)
+            n = m_track->nextCtrlFrame(genACnum(m_id, i), pos, pos + n) - pos;
+    }
+    return n;
+}
+
+//---------------------------------------------------------
+//   automationValue
+//    take the automation value of parameter index at frame
+//    offset of the cycle, which starts at audio->pos(),
+//    returns true if it changed
+//---------------------------------------------------------
+
+bool BasePlugin::automationValue(uint32_t index, uint32_t offset)
+{
+    if (m_params[index].enCtrl && m_params[index].en2Ctrl)
+        m_params[index].tmpValue = m_track->pluginCtrlVal(genACnum(m_id, index), audio->pos().frame() + offset);
+
+    if (m_params[index].value != m_params[index].tmpValue)
+    {
+        m_params[index].value = m_params[index].tmpValue;
+        m_params[index].update = true;
+        return true;
+    }
+    return false;
+}
+
 //---------------------------------------------------------
 //   makeGui
 //---------------------------------------------------------
@@ -588,7 +801,7 @@ Patch* SynthPluginDevice::getPatch(int, int prog, MType, bool)
         patch.drum = false;
         
         if (prog != m_plugin->getCurrentProgram())
-            m_plugin->setProgram(prog);
+            m_plugin->changeProgram(prog);
 
         return &patch;
     }
@@ -940,6 +1153,7 @@ void Pipeline::apply(int ports, uint32_t nframes, float** buffer1)
         BasePlugin* p = *ip;
         if (p && p->enabled())
         {
+            DspLoadScope load(DSP_LOAD_PLUGIN, p);
             p->setChannels(ports);
 
             if (p->hints() & PLUGIN_HAS_IN_PLACE_BROKEN)
@@ -970,6 +1184,22 @@ void Pipeline::apply(int ports, uint32_t nframes, float** buffer1)
     //fprintf(stderr, "Pipeline::apply after data: nframes:%ld %e %e %e %e\n", nframes, buffer1[0][0], buffer1[0][1], buffer1[0][2], buffer1[0][3]);
 }
 
+//---------------------------------------------------------
+//   latency
+//    frames the chain delays the signal by
+//---------------------------------------------------------
+
+uint32_t Pipeline::latency()
+{
+    uint32_t n = 0;
+    for (iPluginI ip = begin(); ip != end(); ++ip)
+    {
+        if (*ip)
+            n += (*ip)->latency();
+    }
+    return n;
+}
+
 //---------------------------------------------------------
 //   showGui
 //---------------------------------------------------------
@@ -14,6 +14,7 @@
 #include "ctrl.h"
 #include "globals.h"
 #include "lib_functions.h"
+#include "lockfree.h"
 
 #include "mididev.h"
 #include "instruments/minstrument.h"
@@ -154,8 +155,60 @@ public:
     bool update;
 };
 
+//---------------------------------------------------------
+//   PluginControl
+//    a parameter or activation change for the audio thread
+//---------------------------------------------------------
+
+enum PluginControlType {
+    PLUGIN_CONTROL_PARAMETER = 0,
+    PLUGIN_CONTROL_ACTIVE    = 1
+};
+
+struct PluginControl
+{
+    PluginControlType type;
+    uint32_t index;
+    double value;
+};
+
+#define PLUGIN_CONTROL_FIFO_SIZE 256 // power of two
+
+//---------------------------------------------------------
+//   PluginControlFifo
+//    multiple producer / single consumer, lock free, works
+//    like AudioMsgFifo but holds the changes by value
+//---------------------------------------------------------
+
+class PluginControlFifo
+{
+    struct Slot
+    {
+        volatile unsigned seq;
+        PluginControl control;
+    };
+    Slot fifo[PLUGIN_CONTROL_FIFO_SIZE];
+    char _pad0[OOM_CACHE_LINE];
+    volatile unsigned wcount; // shared by the writers
+    char _pad1[OOM_CACHE_LINE];
+    unsigned rcount; // only touched by reader
+
+public:
+    PluginControlFifo();
+    bool put(const PluginControl&); // returns true on fifo overflow
+    bool get(PluginControl*); // returns false if empty
+};
+
 //---------------------------------------------------------
 //   Plugin
+//    Parameter and activation changes from other threads
+//    go through a control fifo and are applied by
+//    applyControls() at the start of process(), the audio
+//    thread never waits for them. Loading a plugin happens
+//    before it is added to a pipeline, other changes which
+//    can not run alongside process(), like a program change
+//    from the gui, are done with the plugin disabled by
+//    Audio::msgEnablePlugin().
 //---------------------------------------------------------
 
 class BasePlugin
@@ -169,6 +222,10 @@ public:
 
         m_active = false;
         m_activeBefore = false;
+        m_procActive = false;
+        m_resync = 0;
+        m_latencyIndex = -1;
+        m_latency = 0;
 
         m_paramCount = 0;
         m_params = 0;
@@ -298,6 +355,12 @@ public:
         return m_enabled;
     }
 
+    // frames the output is late by, as last reported to process()
+    uint32_t latency()
+    {
+        return (m_enabled && m_active) ? m_latency : 0;
+    }
+
     uint32_t getParameterCount()
     {
         return m_paramCount;
@@ -389,7 +452,15 @@ public:
     void setActive(bool active)
     {
         m_active = active;
+        sendControl(PLUGIN_CONTROL_ACTIVE, 0, active);
+    }
+
+    void setEnabled(bool yesno)
+    {
+        m_enabled = yesno;
     }
+
+    void changeProgram(uint32_t index);
     
     void setName(QString name)
     {
@@ -406,7 +477,7 @@ public:
             m_params[index].value    = value;
             m_params[index].tmpValue = value;
             m_params[index].update   = true;
-            setNativeParameterValue(index, value);
+            sendControl(PLUGIN_CONTROL_PARAMETER, index, value);
         }
     }
 
@@ -425,16 +496,21 @@ public:
         m_track = track;
     }
 
+    // called when the plugin is not in a pipeline (any more)
     void aboutToRemove()
     {
-        bool blocked = m_proc_lock.tryLock();
         m_enabled = false;
-        if (blocked) m_proc_lock.unlock();
     }
     
     // needed for synths
     QString getAudioOutputPortName(uint32_t index);
     void processSynth(MPEventList* eventList);
+    static uint32_t eventFrameOffset(const MidiPlayEvent& ev, uint32_t frames);
+
+    // plugin automation in sub-blocks
+    bool automated() const;
+    uint32_t automationBlock(uint32_t offset, uint32_t frames) const;
+    bool automationValue(uint32_t index, uint32_t offset);
 
     void makeGui();
     void deleteGui();
@@ -466,6 +542,9 @@ public:
     virtual void writeConfiguration(int level, Xml& xml) = 0;
 
 protected:
+    void sendControl(PluginControlType type, uint32_t index, double value);
+    void applyControls();
+
 	PluginType m_type;
     unsigned int m_hints;
 
@@ -490,7 +569,14 @@ protected:
 
     bool m_enabled;
     void* m_lib;
-    QMutex m_proc_lock;
+
+    // changes for the audio thread
+    PluginControlFifo m_controls;
+    volatile unsigned m_resync; // 1 << PluginControlType of changes lost to a full fifo
+    bool m_procActive; // m_active as seen by process()
+
+    int32_t m_latencyIndex; // output parameter reporting the latency, -1 if none
+    volatile uint32_t m_latency;
 
     // synths only
     uint32_t m_ainsCount;
@@ -866,6 +952,7 @@ public:
         m_hints = 0;
         m_filename = QString(filename);
         m_label = QString(label);
+        m_library = m_filename;
         m_audioInputCount = 0;
         m_audioOutputCount = 0;
 
@@ -915,6 +1002,11 @@ public:
         return m_maker;
     }
 
+    QString library()
+    {
+        return m_library;
+    }
+
     uint32_t getAudioInputCount()
     {
         return m_audioInputCount;
@@ -929,6 +1021,7 @@ public:
     unsigned int m_hints;
     QString m_name;
     QString m_maker;
+    QString m_library; // the shared object, the filename for LADSPA and VST
     uint32_t m_audioInputCount;
     uint32_t m_audioOutputCount;
 
@@ -1002,6 +1095,7 @@ public:
     bool empty(int idx) const;
     void move(int idx, bool up);
     void apply(int ports, uint32_t nframes, float** buffer);
+    uint32_t latency();
 
     void showGui(int, bool);
     void deleteGui(int idx);
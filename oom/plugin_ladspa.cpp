@@ -141,10 +141,8 @@ bool LadspaPlugin::init(QString filename, QString label)
 
 void LadspaPlugin::reload()
 {
-    // safely disable plugin during reload
-    m_proc_lock.lock();
+    // plugins are (re)loaded before they are added to a pipeline
     m_enabled = false;
-    m_proc_lock.unlock();
 
     // delete old data
     if (m_paramCount > 0)
@@ -161,6 +159,7 @@ void LadspaPlugin::reload()
     m_params = 0;
     m_paramCount   = 0;
     m_paramsBuffer = 0;
+    m_latencyIndex = -1;
 
     // query new data
     uint32_t ains, aouts, params, j;
@@ -362,6 +361,7 @@ void LadspaPlugin::reload()
                 else
                 {
                     // latency parameter
+                    m_latencyIndex = j;
                     min = 0;
                     max = sampleRate;
                     def = 0;
@@ -396,9 +396,7 @@ void LadspaPlugin::reload()
     }
 
     // enable it again
-    m_proc_lock.lock();
     m_enabled = true;
-    m_proc_lock.unlock();
 }
 
 void LadspaPlugin::reloadPrograms(bool)
@@ -460,21 +458,20 @@ void LadspaPlugin::process(uint32_t frames, float** src, float** dst, MPEventLis
 {
     if (descriptor && m_enabled)
     {
-        m_proc_lock.lock();
-        // --------------------------
+        applyControls();
 
-        if (m_active)
+        if (m_procActive)
         {
             // connect ports
             int ains  = m_audioInIndexes.size();
             int aouts = m_audioOutIndexes.size();
             bool need_buffer_copy  = false;
             bool need_extra_buffer = false;
+            int max = m_channels;
 
             if (ains == aouts)
             {
                 uint32_t pin, pout;
-                int max = m_channels;
 
                 if (aouts < m_channels)
                 {
@@ -497,7 +494,6 @@ void LadspaPlugin::process(uint32_t frames, float** src, float** dst, MPEventLis
             else
             {
                 // cannot proccess (this should not happen)
-                m_proc_lock.unlock();
                 return;
             }
 
@@ -508,35 +504,17 @@ void LadspaPlugin::process(uint32_t frames, float** src, float** dst, MPEventLis
                     descriptor->activate(handle);
             }
 
-            // Process automation
-            if (automation && m_track && m_track->automationType() != AUTO_OFF && m_id != -1)
+            // process, automated parameters are updated at their
+            // automation points and every automationBlock() frames
+            if (need_extra_buffer && (m_hints & PLUGIN_HAS_IN_PLACE_BROKEN))
             {
-                for (uint32_t i = 0; i < m_paramCount; i++)
-                {
-                    if (m_params[i].enCtrl && m_params[i].en2Ctrl)
-                    {
-                        m_params[i].tmpValue = m_track->pluginCtrlVal(genACnum(m_id, i));
-                    }
-
-                    if (m_params[i].value != m_params[i].tmpValue)
-                    {
-                        m_params[i].value = m_paramsBuffer[i] = m_params[i].tmpValue;
-                        m_params[i].update = true;
-                    }
-                }
+                // cannot proccess
+                return;
             }
 
-            // process
+            float extra_buffer[need_extra_buffer ? frames : 1];
             if (need_extra_buffer)
             {
-                if (m_hints & PLUGIN_HAS_IN_PLACE_BROKEN)
-                {
-                    // cannot proccess
-                    m_proc_lock.unlock();
-                    return;
-                }
-
-                float extra_buffer[frames];
                 memset(extra_buffer, 0, sizeof(float)*frames);
 
                 for (int i=m_channels; i < aouts ; i++)
@@ -544,18 +522,46 @@ void LadspaPlugin::process(uint32_t frames, float** src, float** dst, MPEventLis
                     descriptor->connect_port(handle, m_audioInIndexes.at(i), extra_buffer);
                     descriptor->connect_port(handle, m_audioOutIndexes.at(i), extra_buffer);
                 }
-
-                descriptor->run(handle, frames);
             }
-            else
+
+            bool automate = automated();
+            uint32_t offset = 0;
+            while (offset < frames)
             {
-                descriptor->run(handle, frames);
+                uint32_t n = frames - offset;
+                if (automate)
+                {
+                    n = automationBlock(offset, frames);
+                    for (uint32_t i = 0; i < m_paramCount; i++)
+                    {
+                        if (automationValue(i, offset))
+                            m_paramsBuffer[i] = m_params[i].value;
+                    }
+                }
 
-                if (need_buffer_copy)
+                if (offset)
                 {
-                    for (int i=aouts; i < m_channels ; i++)
-                        memcpy(dst[i], dst[i-1], sizeof(float)*frames);
+                    for (int i=0; i < max; i++)
+                    {
+                        descriptor->connect_port(handle, m_audioInIndexes.at(i), src[i] + offset);
+                        descriptor->connect_port(handle, m_audioOutIndexes.at(i), dst[i] + offset);
+                    }
                 }
+
+                descriptor->run(handle, n);
+                offset += n;
+            }
+
+            if (m_latencyIndex >= 0)
+            {
+                float latency = m_paramsBuffer[m_latencyIndex];
+                m_latency = latency > 0.0f ? lrintf(latency) : 0;
+            }
+
+            if (need_buffer_copy)
+            {
+                for (int i=aouts; i < m_channels ; i++)
+                    memcpy(dst[i], dst[i-1], sizeof(float)*frames);
             }
         }
         else
@@ -567,10 +573,7 @@ void LadspaPlugin::process(uint32_t frames, float** src, float** dst, MPEventLis
             }
         }
 
-        m_activeBefore = m_active;
-
-        // --------------------------
-        m_proc_lock.unlock();
+        m_activeBefore = m_procActive;
     }
 }
 
@@ -622,7 +625,7 @@ bool LadspaPlugin::readConfiguration(Xml& xml, bool readPreset)
             else if (tag == "active")
             {
                 if (readPreset == false)
-                    m_active = xml.parseInt();
+                    setActive(xml.parseInt());
             }
             else if (tag == "gui")
             {
@@ -686,6 +686,7 @@ void Lv2Plugin::initPluginI(PluginI* plugi, const QString&, const QString& label
     }
 
     plugi->m_name = QString(label);
+    plugi->m_library = QString(lilv_uri_to_path(lilv_node_as_uri(lilv_plugin_get_library_uri(lv2plug))));
 
     LilvNode* lv2maker = lilv_plugin_get_author_name(lv2plug);
     if (lv2maker)
@@ -1018,10 +1019,8 @@ bool Lv2Plugin::init(QString filename, QString label)
 
 void Lv2Plugin::reload()
 {
-    // safely disable plugin during reload
-    m_proc_lock.lock();
+    // plugins are (re)loaded before they are added to a pipeline
     m_enabled = false;
-    m_proc_lock.unlock();
 
     // delete old data
     if (m_paramCount > 0)
@@ -1066,6 +1065,7 @@ void Lv2Plugin::reload()
     m_aoutsCount = 0;
     m_paramCount = 0;
     m_paramsBuffer = 0;
+    m_latencyIndex = -1;
 
     // query new data
     uint32_t ains, aouts, evins, params, j;
@@ -1274,6 +1274,7 @@ void Lv2Plugin::reload()
                     else
                     {
                         // latency parameter
+                        m_latencyIndex = j;
                         min = 0;
                         max = sampleRate;
                         def = 0;
@@ -1329,9 +1330,7 @@ void Lv2Plugin::reload()
     // enable it again (only if jack is active, otherwise non-needed)
     if (audioDevice && audioDevice->isJackAudio())
     {
-        m_proc_lock.lock();
         m_enabled = true;
-        m_proc_lock.unlock();
     }
 }
 
@@ -1751,16 +1750,16 @@ void Lv2Plugin::process(uint32_t frames, float** src, float** dst, MPEventList*
 {
     if (descriptor && m_enabled)
     {
-        m_proc_lock.lock();
-        // --------------------------
+        applyControls();
 
-        if (m_active)
+        if (m_procActive)
         {
             // connect ports
             int ains  = m_audioInIndexes.size();
             int aouts = m_audioOutIndexes.size();
             bool need_buffer_copy  = false;
             bool need_extra_buffer = false;
+            int max = m_channels;
 
             if (m_hints & PLUGIN_IS_SYNTH)
             {
@@ -1775,7 +1774,6 @@ void Lv2Plugin::process(uint32_t frames, float** src, float** dst, MPEventList*
                 if (ains == aouts)
                 {
                     uint32_t pin, pout;
-                    int max = m_channels;
                     
                     if (aouts < m_channels)
                     {
@@ -1798,14 +1796,12 @@ void Lv2Plugin::process(uint32_t frames, float** src, float** dst, MPEventList*
                 else
                 {
                     // cannot proccess
-                    m_proc_lock.unlock();
                     return;
                 }
             }
             else
             {
                 // cannot proccess
-                m_proc_lock.unlock();
                 return;
             }
 
@@ -1836,6 +1832,11 @@ void Lv2Plugin::process(uint32_t frames, float** src, float** dst, MPEventList*
                         {
                             //qWarning("LV2 Event: 0x%02X %02i %02i", ev->type()+ev->channel(), ev->dataA(), ev->dataB());
 
+                            // the list is sorted by time, keep the rest for the next cycle
+                            uint32_t offset = eventFrameOffset(*ev, frames);
+                            if (offset >= frames)
+                                break;
+
                             switch (ev->type())
                             {
                             case ME_NOTEOFF:
@@ -1855,7 +1856,9 @@ void Lv2Plugin::process(uint32_t frames, float** src, float** dst, MPEventList*
                                 break;
                             }
 
-                            uint8_t* midi_event = lv2_event_reserve(&ev_iters[i], 0, 0, OOM_URI_MAP_ID_EVENT_MIDI, 3);
+                            uint8_t* midi_event = lv2_event_reserve(&ev_iters[i], offset, 0, OOM_URI_MAP_ID_EVENT_MIDI, 3);
+                            if (midi_event == 0)
+                                break;
                             midi_event[0] = ev->type() + ev->channel();
                             midi_event[1] = ev->dataA();
                             midi_event[2] = ev->dataB();
@@ -1926,35 +1929,19 @@ void Lv2Plugin::process(uint32_t frames, float** src, float** dst, MPEventList*
                 }
             }
 
-            // Process automation
-            if (automation && m_track && m_track->automationType() != AUTO_OFF && m_id != -1)
+            // process, automated parameters are updated at their
+            // automation points and every automationBlock() frames.
+            // Synths run the whole cycle, their events are stamped
+            // relative to its start.
+            if (need_extra_buffer && (m_hints & PLUGIN_HAS_IN_PLACE_BROKEN))
             {
-                for (uint32_t i = 0; i < m_paramCount; i++)
-                {
-                    if (m_params[i].enCtrl && m_params[i].en2Ctrl)
-                    {
-                        m_params[i].tmpValue = m_track->pluginCtrlVal(genACnum(m_id, i));
-                    }
-
-                    if (m_params[i].value != m_params[i].tmpValue)
-                    {
-                        m_params[i].value = m_paramsBuffer[i] = m_params[i].tmpValue;
-                        m_params[i].update = true;
-                    }
-                }
+                // cannot proccess
+                return;
             }
 
-            // process
+            float extra_buffer[need_extra_buffer ? frames : 1];
             if (need_extra_buffer)
             {
-                if (m_hints & PLUGIN_HAS_IN_PLACE_BROKEN)
-                {
-                    // cannot proccess
-                    m_proc_lock.unlock();
-                    return;
-                }
-
-                float extra_buffer[frames];
                 memset(extra_buffer, 0, sizeof(float)*frames);
 
                 for (int i=m_channels; i < aouts ; i++)
@@ -1962,18 +1949,52 @@ void Lv2Plugin::process(uint32_t frames, float** src, float** dst, MPEventList*
                     descriptor->connect_port(handle, m_audioInIndexes.at(i), extra_buffer);
                     descriptor->connect_port(handle, m_audioOutIndexes.at(i), extra_buffer);
                 }
-
-                descriptor->run(handle, frames);
             }
-            else
+
+            bool automate = automated();
+            bool split = automate && !eventList && (m_hints & PLUGIN_IS_FX);
+            uint32_t offset = 0;
+            while (offset < frames)
             {
-                descriptor->run(handle, frames);
+                uint32_t n = frames - offset;
+                if (automate)
+                {
+                    if (split)
+                        n = automationBlock(offset, frames);
+                    for (uint32_t i = 0; i < m_paramCount; i++)
+                    {
+                        if (automationValue(i, offset))
+                            m_paramsBuffer[i] = m_params[i].value;
+                    }
+                }
 
-                if (need_buffer_copy)
+                if (offset)
                 {
-                    for (int i=aouts; i < m_channels ; i++)
-                        memcpy(dst[i], dst[i-1], sizeof(float)*frames);
+                    for (int i=0; i < max; i++)
+                    {
+                        descriptor->connect_port(handle, m_audioInIndexes.at(i), src[i] + offset);
+                        descriptor->connect_port(handle, m_audioOutIndexes.at(i), dst[i] + offset);
+                    }
+
+                    // the time event was delivered with the first block
+                    for (size_t i = 0; i < m_events.size(); i++)
+                        lv2_event_buffer_reset(m_events[i].buffer, LV2_EVENT_AUDIO_STAMP, (uint8_t*)(m_events[i].buffer + 1));
                 }
+
+                descriptor->run(handle, n);
+                offset += n;
+            }
+
+            if (m_latencyIndex >= 0)
+            {
+                float latency = m_paramsBuffer[m_latencyIndex];
+                m_latency = latency > 0.0f ? lrintf(latency) : 0;
+            }
+
+            if (need_buffer_copy)
+            {
+                for (int i=aouts; i < m_channels ; i++)
+                    memcpy(dst[i], dst[i-1], sizeof(float)*frames);
             }
         }
         else
@@ -1985,10 +2006,7 @@ void Lv2Plugin::process(uint32_t frames, float** src, float** dst, MPEventList*
             }
         }
 
-        m_activeBefore = m_active;
-
-        // --------------------------
-        m_proc_lock.unlock();
+        m_activeBefore = m_procActive;
     }
 }
 
@@ -2056,7 +2074,7 @@ bool Lv2Plugin::readConfiguration(Xml& xml, bool readPreset)
             else if (tag == "active")
             {
                 if (readPreset == false)
-                    m_active = xml.parseInt();
+                    setActive(xml.parseInt());
             }
             else if (tag == "gui")
             {
@@ -33,6 +33,19 @@ struct VstTimeInfo_R
 };
 #endif
 
+// the latency the plugin reports, vestige has no name for
+// the field, it is the first int after the two pointers
+static uint32_t VstInitialDelay(AEffect* effect)
+{
+#ifdef USE_OFFICIAL_VSTSDK
+    int32_t delay = effect->initialDelay;
+#else
+    int32_t delay;
+    memcpy(&delay, effect->empty3, sizeof(delay));
+#endif
+    return delay > 0 ? delay : 0;
+}
+
 VstPlugin* VstHostUserCheck(AEffect* effect)
 {
     if (effect && effect->user)
@@ -406,10 +419,8 @@ bool VstPlugin::init(QString filename, QString label)
 
 void VstPlugin::reload()
 {    
-    // safely disable plugin during reload
-    m_proc_lock.lock();
+    // plugins are (re)loaded before they are added to a pipeline
     m_enabled = false;
-    m_proc_lock.unlock();
 
     // delete old data
     if (m_paramCount > 0)
@@ -572,9 +583,7 @@ void VstPlugin::reload()
     // enable it again (only if jack is active, otherwise non-needed)
     if (audioDevice && audioDevice->isJackAudio())
     {
-        m_proc_lock.lock();
         m_enabled = true;
-        m_proc_lock.unlock();
     }
 }
 
@@ -835,15 +844,13 @@ void VstPlugin::process(uint32_t frames, float** src, float** dst, MPEventList*
 {
     if (effect && m_enabled)
     {
-        m_proc_lock.lock();
-        // --------------------------
+        applyControls();
 
-        if (m_active)
+        if (m_procActive)
         {
             if ((m_hints & PLUGIN_IS_SYNTH) == 0 && (effect->numInputs != effect->numOutputs || effect->numOutputs != m_channels))
             {
                 // cannot proccess
-                m_proc_lock.unlock();
                 return;
             }
 
@@ -864,6 +871,11 @@ void VstPlugin::process(uint32_t frames, float** src, float** dst, MPEventList*
                 {
                     //qWarning("VST Event: 0x%02X %02i %02i", ev->type()+ev->channel(), ev->dataA(), ev->dataB());
 
+                    // the list is sorted by time, keep the rest for the next cycle
+                    uint32_t offset = eventFrameOffset(*ev, frames);
+                    if (offset >= frames || midiEventCount == MAX_VST_EVENTS)
+                        break;
+
                     switch (ev->type())
                     {
                     case ME_NOTEOFF:
@@ -888,6 +900,7 @@ void VstPlugin::process(uint32_t frames, float** src, float** dst, MPEventList*
 
                     midiEvent->type = kVstMidiType;
                     midiEvent->byteSize = sizeof(VstMidiEvent);
+                    midiEvent->deltaFrames = offset;
                     midiEvent->midiData[0] = ev->type() + ev->channel();
                     midiEvent->midiData[1] = ev->dataA();
                     midiEvent->midiData[2] = ev->dataB();
@@ -909,26 +922,44 @@ void VstPlugin::process(uint32_t frames, float** src, float** dst, MPEventList*
                 }
             }
 
-            // Process automation
-            if (automation && m_track && m_track->automationType() != AUTO_OFF && m_id != -1)
+            // process, automated parameters are updated at their
+            // automation points and every automationBlock() frames.
+            // Synths run the whole cycle, their events are stamped
+            // relative to its start.
+            bool automate = automated();
+            bool split = automate && !eventList && (m_hints & PLUGIN_IS_SYNTH) == 0;
+            float* srcBlock[m_channels];
+            float* dstBlock[m_channels];
+            uint32_t offset = 0;
+            while (offset < frames)
             {
-                for (uint32_t i = 0; i < m_paramCount; i++)
+                uint32_t n = frames - offset;
+                if (automate)
                 {
-                    if (m_params[i].enCtrl && m_params[i].en2Ctrl)
+                    if (split)
+                        n = automationBlock(offset, frames);
+                    for (uint32_t i = 0; i < m_paramCount; i++)
                     {
-                        m_params[i].tmpValue = m_track->pluginCtrlVal(genACnum(m_id, i));
+                        if (automationValue(i, offset))
+                            effect->setParameter(effect, i, m_params[i].value);
                     }
+                }
 
-                    if (m_params[i].value != m_params[i].tmpValue)
+                if (offset)
+                {
+                    for (int i = 0; i < m_channels; i++)
                     {
-                        m_params[i].value = m_params[i].tmpValue;
-                        m_params[i].update = true;
-                        effect->setParameter(effect, i, m_params[i].value);
+                        srcBlock[i] = src[i] + offset;
+                        dstBlock[i] = dst[i] + offset;
                     }
+                    effect->processReplacing(effect, srcBlock, dstBlock, n);
                 }
+                else
+                    effect->processReplacing(effect, src, dst, n);
+                offset += n;
             }
 
-            effect->processReplacing(effect, src, dst, frames);
+            m_latency = VstInitialDelay(effect);
         }
         else
         {
@@ -939,16 +970,13 @@ void VstPlugin::process(uint32_t frames, float** src, float** dst, MPEventList*
             }
         }
 
-        m_activeBefore = m_active;
-
-        // --------------------------
-        m_proc_lock.unlock();
+        m_activeBefore = m_procActive;
     }
 }
 
 void VstPlugin::bufferSizeChanged(uint32_t bsize)
 {
-    if (m_active)
+    if (m_activeBefore)
     {
         effect->dispatcher(effect, effStopProcess, 0, 0, 0, 0.0f);
         effect->dispatcher(effect, effMainsChanged, 0, 0, 0, 0.0f);
@@ -956,7 +984,7 @@ void VstPlugin::bufferSizeChanged(uint32_t bsize)
 
     effect->dispatcher(effect, effSetBlockSize, 0, bsize, 0, 0.0f);
 
-    if (m_active)
+    if (m_activeBefore)
     {
         effect->dispatcher(effect, effMainsChanged, 0, 1, 0, 0.0f);
         effect->dispatcher(effect, effStartProcess, 0, 0, 0, 0.0f);
@@ -1016,7 +1044,7 @@ bool VstPlugin::readConfiguration(Xml& xml, bool readPreset)
                 else if (tag == "active")
                 {
                     if (readPreset == false)
-                        m_active = xml.parseInt();
+                        setActive(xml.parseInt());
                 }
                 else if (tag == "gui")
                 {
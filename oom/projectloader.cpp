@@ -0,0 +1,384 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#include <stdio.h>
+
+#include <QFileInfo>
+#include <QThread>
+#include <QMutexLocker>
+#include <QVector>
+
+#include "projectloader.h"
+#include "binxml.h"
+#include "filedialog.h"
+#include "globals.h"
+#include "lib_functions.h"
+#include "peakbuilder.h"
+#include "plugin.h"
+#include "wave.h"
+#include "xml.h"
+
+ProjectLoader* projectLoader;
+
+//---------------------------------------------------------
+//   ProjectScanner
+//   ProjectWorker
+//---------------------------------------------------------
+
+class ProjectScanner : public QThread
+{
+	ProjectLoader* _loader;
+
+public:
+	ProjectScanner(ProjectLoader* l)
+	{
+		_loader = l;
+	}
+
+protected:
+	virtual void run()
+	{
+		_loader->scannerLoop();
+	}
+};
+
+class ProjectWorker : public QThread
+{
+	ProjectLoader* _loader;
+
+public:
+	ProjectWorker(ProjectLoader* l)
+	{
+		_loader = l;
+	}
+
+protected:
+	virtual void run()
+	{
+		_loader->workerLoop();
+	}
+};
+
+//---------------------------------------------------------
+//   ProjectLoader
+//    project is the file given to loadProjectFile1(), it is
+//    scanned through its snapshot if snapshot is set
+//---------------------------------------------------------
+
+ProjectLoader::ProjectLoader(const QString& project, bool snapshot, int threads)
+{
+	_project = project;
+	_snapshot = snapshot;
+	_scanned = false;
+	_quit = false;
+	if (threads <= 0)
+	{
+		threads = QThread::idealThreadCount();
+		if (threads > MAX_LOAD_WORKERS)
+			threads = MAX_LOAD_WORKERS;
+		if (threads < 1)
+			threads = 1;
+	}
+	_scanner = new ProjectScanner(this);
+	_scanner->start();
+	for (int i = 0; i < threads; ++i)
+	{
+		QThread* t = new ProjectWorker(this);
+		t->start();
+		_workers.append(t);
+	}
+}
+
+//---------------------------------------------------------
+//   ~ProjectLoader
+//    files and libraries the project did not take are
+//    released, a taken library stays loaded by its plugin
+//---------------------------------------------------------
+
+ProjectLoader::~ProjectLoader()
+{
+	_lock.lock();
+	_quit = true;
+	_jobs.clear();
+	_jobAdded.wakeAll();
+	_lock.unlock();
+
+	_scanner->wait();
+	delete _scanner;
+	foreach(QThread* t, _workers)
+	{
+		t->wait();
+		delete t;
+	}
+
+	int unused = 0;
+	foreach(LoadJob* job, _waves)
+	{
+		if (job->sf)
+		{
+			if (!job->error)
+				++unused;
+			delete job->sf;
+		}
+		delete job;
+	}
+	foreach(LoadJob* job, _libs)
+	{
+		if (job->lib)
+			lib_close(job->lib);
+		delete job;
+	}
+	if (debugMsg)
+		printf("ProjectLoader: %d wave files opened ahead, %d of them not used, %d plugin libraries loaded\n",
+				_waves.size(), unused, _libs.size());
+}
+
+//---------------------------------------------------------
+//   add
+//    queue a file once, a gui thread waiting for a file
+//    the scanner had not found yet looks again
+//---------------------------------------------------------
+
+void ProjectLoader::add(LoadJob::Kind kind, const QString& path)
+{
+	QMutexLocker locker(&_lock);
+	if (kind == LoadJob::Wave ? _waves.contains(path) : _libPaths.contains(path))
+		return;
+	LoadJob* job = new LoadJob;
+	job->kind = kind;
+	job->path = path;
+	job->sf = 0;
+	job->lib = 0;
+	job->error = false;
+	job->done = false;
+	if (kind == LoadJob::Wave)
+		_waves.insert(path, job);
+	else
+	{
+		_libs.append(job);
+		_libPaths.insert(path);
+	}
+	_jobs.append(job);
+	_jobAdded.wakeOne();
+	_jobDone.wakeAll();
+}
+
+//---------------------------------------------------------
+//   addPlugin
+//    the library is found the way the plugins find it in
+//    readConfiguration(), the plugin list is not changed
+//    while a project is read
+//---------------------------------------------------------
+
+void ProjectLoader::addPlugin(const QString& tag, const QString& filename, const QString& label)
+{
+	QString library;
+	if (tag == "Lv2Plugin")
+	{
+		for (iPlugin i = plugins.begin(); i != plugins.end(); ++i)
+		{
+			if (i->type() == PLUGIN_LV2 && i->filename() == filename)
+			{
+				library = i->library();
+				break;
+			}
+		}
+	}
+	else
+	{
+		QFileInfo fi(filename);
+		if (fi.exists())
+			library = filename;
+		else
+		{
+			PluginI* plugi = plugins.find(fi.completeBaseName(), label);
+			if (plugi)
+				library = plugi->library();
+		}
+	}
+	if (!library.isEmpty())
+		add(LoadJob::Library, library);
+}
+
+//---------------------------------------------------------
+//   scan
+//    runs in the scanner thread, looks for the <file> of
+//    wave events and the attributes of rack plugins
+//---------------------------------------------------------
+
+void ProjectLoader::scan(Xml& xml)
+{
+	QVector<QString> tags; // open elements
+	QString plugin;        // plugin element whose attributes are read
+	QString filename;
+	QString label;
+
+	for (;;)
+	{
+		if (_quit)
+			return;
+		Xml::Token token = xml.parse();
+		const QString& tag = xml.s1();
+		if (!plugin.isEmpty() && token != Xml::Attribut)
+		{
+			addPlugin(plugin, filename, label);
+			plugin = QString();
+		}
+		switch (token)
+		{
+			case Xml::Error:
+			case Xml::End:
+				return;
+			case Xml::TagStart:
+				// without the peak builder readCache() shows a
+				// progress dialog, the file is left to the gui
+				if (tag == "file" && peakBuilder && !tags.isEmpty() && tags.last() == "event")
+				{
+					add(LoadJob::Wave, wavePath(xml.parse1()));
+					break;
+				}
+				if (tag == "LadspaPlugin" || tag == "plugin" || tag == "Lv2Plugin" || tag == "VstPlugin")
+				{
+					plugin = tag;
+					filename = QString();
+					label = QString();
+				}
+				tags.append(tag);
+				break;
+			case Xml::Attribut:
+				if (!plugin.isEmpty())
+				{
+					if (tag == "filename" || tag == "file" || tag == "uri")
+						filename = xml.s2();
+					else if (tag == "label")
+						label = xml.s2();
+				}
+				break;
+			case Xml::TagEnd:
+				if (!tags.isEmpty())
+					tags.resize(tags.size() - 1);
+				break;
+			default:
+				break;
+		}
+	}
+}
+
+//---------------------------------------------------------
+//   scannerLoop
+//---------------------------------------------------------
+
+void ProjectLoader::scannerLoop()
+{
+	BinXml* snapshot = _snapshot ? openSnapshot(_project) : 0;
+	if (snapshot)
+	{
+		Xml xml(snapshot);
+		scan(xml);
+		delete snapshot;
+	}
+	else
+	{
+		bool popenFlag;
+		FILE* f = fileOpen(0, _project, QString(".oom"), "r", popenFlag, true);
+		if (f)
+		{
+			Xml xml(f);
+			scan(xml);
+			popenFlag ? pclose(f) : fclose(f);
+		}
+	}
+
+	_lock.lock();
+	_scanned = true;
+	_jobAdded.wakeAll();
+	_jobDone.wakeAll();
+	_lock.unlock();
+}
+
+//---------------------------------------------------------
+//   run
+//    runs in a worker or in the gui thread, a file which
+//    did not open is kept for the gui thread to delete, the
+//    destructor of SndFile uses the list of files
+//---------------------------------------------------------
+
+void ProjectLoader::run(LoadJob* job)
+{
+	if (job->kind == LoadJob::Wave)
+	{
+		job->sf = new SndFile(job->path, false);
+		job->error = job->sf->openRead();
+	}
+	else
+		job->lib = lib_open(job->path.toUtf8().constData());
+}
+
+//---------------------------------------------------------
+//   workerLoop
+//    the workers stop when the scan is done and nothing is
+//    left to do
+//---------------------------------------------------------
+
+void ProjectLoader::workerLoop()
+{
+	_lock.lock();
+	for (;;)
+	{
+		while (!_quit && !_scanned && _jobs.isEmpty())
+			_jobAdded.wait(&_lock);
+		if (_quit || _jobs.isEmpty())
+			break;
+		LoadJob* job = _jobs.takeFirst();
+		_lock.unlock();
+
+		run(job);
+
+		_lock.lock();
+		job->done = true;
+		_jobDone.wakeAll();
+	}
+	_lock.unlock();
+}
+
+//---------------------------------------------------------
+//   takeWave
+//    called by getWave() in the gui thread, waits until the
+//    scanner has come to path or is done. A file no worker
+//    has started is opened here.
+//    returns 0 if the file is not known or did not open,
+//    getWave() then opens it as usual
+//---------------------------------------------------------
+
+SndFile* ProjectLoader::takeWave(const QString& path)
+{
+	QMutexLocker locker(&_lock);
+	for (;;)
+	{
+		LoadJob* job = _waves.value(path);
+		if (job)
+		{
+			if (_jobs.removeOne(job))
+			{
+				locker.unlock();
+				run(job);
+				locker.relock();
+				job->done = true;
+			}
+			while (!job->done)
+				_jobDone.wait(&_lock);
+			if (job->error)
+				return 0;
+			SndFile* sf = job->sf;
+			job->sf = 0;
+			return sf;
+		}
+		if (_scanned)
+			return 0;
+		_jobDone.wait(&_lock);
+	}
+}
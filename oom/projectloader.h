@@ -0,0 +1,88 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#ifndef __PROJECTLOADER_H__
+#define __PROJECTLOADER_H__
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <QWaitCondition>
+
+class QThread;
+class SndFile;
+class Xml;
+
+#define MAX_LOAD_WORKERS 8
+
+//---------------------------------------------------------
+//   LoadJob
+//---------------------------------------------------------
+
+struct LoadJob
+{
+    enum Kind
+    {
+        Wave,   // open a wave file and its peak file
+        Library // load the shared object of a plugin
+    };
+    Kind kind;
+    QString path;
+    SndFile* sf; // 0 once it is taken
+    void* lib;
+    bool error;  // sf did not open, it is deleted in the gui thread
+    bool done;
+};
+
+//---------------------------------------------------------
+//   ProjectLoader
+//    Exists while a project is read. A scanner thread reads
+//    the project a second time, ahead of Song::read(), and
+//    queues the wave files and plugin libraries it refers to
+//    for a pool of workers. The wave files are opened and
+//    their peak files mapped or queued for the peak builder,
+//    the libraries are loaded, so the serial read finds them
+//    ready. A file the read wants before a worker had it is
+//    opened by the gui thread itself.
+//---------------------------------------------------------
+
+class ProjectLoader
+{
+    QString _project;
+    bool _snapshot;
+    QThread* _scanner;
+    QList<QThread*> _workers;
+    QList<LoadJob*> _jobs;         // waiting for a worker
+    QHash<QString, LoadJob*> _waves; // all wave jobs by path
+    QList<LoadJob*> _libs;
+    QSet<QString> _libPaths;
+    QMutex _lock;
+    QWaitCondition _jobAdded;
+    QWaitCondition _jobDone;
+    bool _scanned;
+    volatile bool _quit;
+
+    void add(LoadJob::Kind, const QString& path);
+    void addPlugin(const QString& tag, const QString& filename, const QString& label);
+    void scan(Xml& xml);
+    void run(LoadJob*);
+
+public:
+    ProjectLoader(const QString& project, bool snapshot, int threads = 0);
+    ~ProjectLoader();
+
+    SndFile* takeWave(const QString& path);
+    void scannerLoop();
+    void workerLoop();
+};
+
+extern ProjectLoader* projectLoader;
+
+#endif
+
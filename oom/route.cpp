@@ -16,6 +16,7 @@
 #include "audiodev.h"
 #include "xml.h"
 #include "globals.h"
+#include "audiograph.h"
 #include "midiport.h"
 #include "driver/jackmidi.h"
 #include "driver/alsamidi.h"
@@ -173,6 +174,9 @@ void addRoute(Route src, Route dst)/*{{{*/
 	fprintf(stderr, "addRoute:\n");
 #endif
 
+	if (audioGraph)
+		audioGraph->invalidate();
+
 	if (!src.isValid() || !dst.isValid())
 	{
 		if (!src.isValid())
@@ -474,6 +478,9 @@ void removeRoute(Route src, Route dst)/*{{{*/
 {
 //TODO: Add hooks to update the patchcanvas on success
 //This should be conditionally checked so we dont update if the canvas is what made the connection
+	if (audioGraph)
+		audioGraph->invalidate();
+
 	if (src.type == Route::JACK_ROUTE)
 	{
 		if (!dst.isValid())
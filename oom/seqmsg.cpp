@@ -7,6 +7,8 @@
 //=========================================================
 
 #include <stdio.h>
+#include <errno.h>
+#include <unistd.h>
 
 #include "song.h"
 #include "midiport.h"
@@ -25,29 +27,39 @@
 #include "plugin.h"
 #include "driver/jackmidi.h"
 
+//---------------------------------------------------------
+//   waitDone
+//---------------------------------------------------------
+
+static void waitDone(sem_t* done)
+{
+	while (sem_wait(done) == -1 && errno == EINTR)
+		;
+}
+
 //---------------------------------------------------------
 //   sendMsg
+//    Queue a message for the audio thread and wait until
+//    it is processed. Messages of the thread running a
+//    batch are only collected.
 //---------------------------------------------------------
 
 void Audio::sendMsg(AudioMsg* m, bool waitRead)
 {
-	static int sno = 0;
-
 	if (_running && waitRead)
 	{
-		m->serialNo = sno++;
-		//DEBUG:
-		msg = m;
-		// wait for next audio "process" call to finish operation
-        int no = -1;
-		int rv = read(fromThreadFdr, &no, sizeof (int));
-		if (rv != sizeof (int))
-			perror("Audio: read pipe failed");
-		else if (no != (sno - 1))
+		if (_batchDepth && pthread_equal(_batchThread, pthread_self()))
 		{
-			fprintf(stderr, "audio: bad serial number, read %d expected %d\n",
-					no, sno - 1);
+			_batch.append(new AudioMsg(*m));
+			return;
 		}
+		sem_t done;
+		sem_init(&done, 0, 0);
+		m->done = &done;
+		while (msgFifo.put(m))
+			usleep(1000); // full of the batch of another thread
+		waitDone(&done);
+		sem_destroy(&done);
 	}
 	else
 	{
@@ -57,6 +69,65 @@ void Audio::sendMsg(AudioMsg* m, bool waitRead)
 	}
 }
 
+//---------------------------------------------------------
+//   startBatch
+//    Messages sent from this thread until endBatch() are
+//    collected and go to the audio thread together. Only
+//    for messages nobody reads a result of, and the sender
+//    must not rely on the effect of an earlier message of
+//    the batch. Batches nest.
+//---------------------------------------------------------
+
+void Audio::startBatch()
+{
+	if (_batchDepth++ == 0)
+		_batchThread = pthread_self();
+}
+
+//---------------------------------------------------------
+//   endBatch
+//    Send the collected messages and wait until all of
+//    them are processed. The audio thread takes up to
+//    AUDIO_MSGS_PER_CYCLE in one cycle, instead of one
+//    message per cycle.
+//---------------------------------------------------------
+
+void Audio::endBatch()
+{
+	if (--_batchDepth)
+		return;
+	sem_t done;
+	sem_init(&done, 0, 0);
+	int pending = 0;
+	for (QList<AudioMsg*>::iterator i = _batch.begin(); i != _batch.end(); ++i)
+	{
+		AudioMsg* m = *i;
+		if (!_running)
+		{
+			processMsg(m);
+			continue;
+		}
+		m->done = &done;
+		while (msgFifo.put(m))
+		{
+			if (pending)
+			{
+				waitDone(&done);
+				--pending;
+			}
+			else
+				usleep(1000);
+		}
+		++pending;
+	}
+	while (pending--)
+		waitDone(&done);
+	sem_destroy(&done);
+	for (QList<AudioMsg*>::iterator i = _batch.begin(); i != _batch.end(); ++i)
+		delete *i;
+	_batch.clear();
+}
+
 //---------------------------------------------------------
 //   sendMessage
 //    send request from gui to sequencer
@@ -236,6 +307,64 @@ void Audio::msgIdlePlugin(AudioTrack* node, BasePlugin* plugin)
 	sendMsg(&msg);
 }
 
+//---------------------------------------------------------
+//   msgEnablePlugin
+//    a disabled plugin is not processed from the next
+//    cycle on, when this returns the audio thread is done
+//    with it
+//---------------------------------------------------------
+
+void Audio::msgEnablePlugin(BasePlugin* plugin, bool flag)
+{
+	AudioMsg msg;
+	msg.id = AUDIO_ENABLEPLUGIN;
+	msg.plugin = plugin;
+	msg.ival = flag;
+	sendMsg(&msg);
+}
+
+//---------------------------------------------------------
+//   msgSetGraph
+//    publish a schedule built by AudioGraph::update()
+//---------------------------------------------------------
+
+void Audio::msgSetGraph(GraphSchedule* schedule)
+{
+	AudioMsg msg;
+	msg.id = AUDIO_SET_GRAPH;
+	msg.p1 = schedule;
+	sendMsg(&msg);
+}
+
+//---------------------------------------------------------
+//   msgSetPartSchedule
+//    publish a schedule built by WaveTrack::updateSchedule()
+//---------------------------------------------------------
+
+void Audio::msgSetPartSchedule(WaveTrack* track, PartSchedule* schedule)
+{
+	AudioMsg msg;
+	msg.id = AUDIO_SET_PART_SCHEDULE;
+	msg.track = track;
+	msg.p1 = schedule;
+	sendMsg(&msg);
+}
+
+//---------------------------------------------------------
+//   msgSwapLatencyDelay
+//    the delay line *d replaces the one of track, *d is
+//    the old line when the message is done
+//---------------------------------------------------------
+
+void Audio::msgSwapLatencyDelay(AudioTrack* track, LatencyDelay** d)
+{
+	AudioMsg msg;
+	msg.id = AUDIO_SWAP_LATENCY_DELAY;
+	msg.snode = track;
+	msg.p1 = d;
+	sendMsg(&msg);
+}
+
 //---------------------------------------------------------
 //   msgSetRecord
 //---------------------------------------------------------
@@ -593,10 +722,12 @@ void Audio::msgSeek(const Pos& pos)
 //   msgUndo
 //---------------------------------------------------------
 
-void Audio::msgUndo()
+void Audio::msgUndo(AuxSendSwapList* sends, TempoIndex** tempo)
 {
 	AudioMsg msg;
 	msg.id = SEQM_UNDO;
+	msg.p1 = sends;
+	msg.p2 = tempo;
 	sendMsg(&msg);
 }
 
@@ -604,10 +735,12 @@ void Audio::msgUndo()
 //   msgRedo
 //---------------------------------------------------------
 
-void Audio::msgRedo()
+void Audio::msgRedo(AuxSendSwapList* sends, TempoIndex** tempo)
 {
 	AudioMsg msg;
 	msg.id = SEQM_REDO;
+	msg.p1 = sends;
+	msg.p2 = tempo;
 	sendMsg(&msg);
 }
 
@@ -676,12 +809,15 @@ void Song::msgInsertTrack(Track* track, int idx, bool doUndoFlag)
 	msg.id = SEQM_ADD_TRACK;
 	msg.track = track;
 	msg.ival = idx;
+	AuxSendSwapList* sends = prepareAuxSends(QList<Track*>() << track, QList<Track*>());
+	msg.p1 = sends;
 	if (doUndoFlag)
 	{
 		song->startUndo();
 		undoOp(UndoOp::AddTrack, idx, track);
 	}
 	audio->sendMsg(&msg);
+	deleteAuxSends(sends);
 	if (doUndoFlag)
 		endUndo(SC_TRACK_INSERTED);
 }
@@ -697,7 +833,10 @@ void Audio::msgRemoveTrack(Track* track, bool doUndoFlag)
 	AudioMsg msg;
 	msg.id = SEQM_REMOVE_TRACK;
 	msg.track = track;
+	AuxSendSwapList* sends = song->prepareAuxSends(QList<Track*>(), QList<Track*>() << track);
+	msg.p1 = sends;
 	sendMessage(&msg, doUndoFlag);
+	song->deleteAuxSends(sends);
 }
 
 //---------------------------------------------------------
@@ -709,7 +848,17 @@ void Audio::msgRemoveTrackGroup(QList<qint64> list, bool doUndoFlag)
 	AudioMsg msg;
 	msg.id = SEQM_REMOVE_TRACK_GROUP;
 	msg.list = list;
+	QList<Track*> removed;
+	foreach(qint64 id, list)
+	{
+		Track* track = song->findTrackById(id);
+		if (track && track->id() != song->masterId() && track->id() != song->oomVerbId())
+			removed.append(track);
+	}
+	AuxSendSwapList* sends = song->prepareAuxSends(QList<Track*>(), removed);
+	msg.p1 = sends;
 	sendMessage(&msg, doUndoFlag);
+	song->deleteAuxSends(sends);
 }
 
 //---------------------------------------------------------
@@ -935,17 +1084,33 @@ void Audio::msgChangeEvent(Event& oe, Event& ne, Part* part, bool doUndoFlag, bo
     sendMessage(&msg, doUndoFlag, waitRead);
 }
 
+//---------------------------------------------------------
+//   sendTempoMessage
+//    the gui has changed the tempo list, the message takes
+//    the index built from it to the audio thread and brings
+//    back the old one
+//---------------------------------------------------------
+
+void Audio::sendTempoMessage(AudioMsg* msg, bool doUndo)
+{
+	TempoIndex* index = tempomap.buildIndex();
+	msg->p1 = &index;
+	sendMessage(msg, doUndo);
+	tempomap.deleteIndex(index);
+}
+
 //---------------------------------------------------------
 //   msgAddTempo
 //---------------------------------------------------------
 
 void Audio::msgAddTempo(int tick, int tempo, bool doUndoFlag)
 {
+	tempomap.addTempo(tick, tempo);
 	AudioMsg msg;
 	msg.id = SEQM_ADD_TEMPO;
 	msg.a = tick;
 	msg.b = tempo;
-	sendMessage(&msg, doUndoFlag);
+	sendTempoMessage(&msg, doUndoFlag);
 }
 
 //---------------------------------------------------------
@@ -954,11 +1119,12 @@ void Audio::msgAddTempo(int tick, int tempo, bool doUndoFlag)
 
 void Audio::msgSetTempo(int tick, int tempo, bool doUndoFlag)
 {
+	tempomap.setTempo(tick, tempo);
 	AudioMsg msg;
 	msg.id = SEQM_SET_TEMPO;
 	msg.a = tick;
 	msg.b = tempo;
-	sendMessage(&msg, doUndoFlag);
+	sendTempoMessage(&msg, doUndoFlag);
 }
 
 //---------------------------------------------------------
@@ -967,10 +1133,11 @@ void Audio::msgSetTempo(int tick, int tempo, bool doUndoFlag)
 
 void Audio::msgSetGlobalTempo(int val)
 {
+	tempomap.setGlobalTempo(val);
 	AudioMsg msg;
 	msg.id = SEQM_SET_GLOBAL_TEMPO;
 	msg.a = val;
-	sendMessage(&msg, false);
+	sendTempoMessage(&msg, false);
 }
 
 //---------------------------------------------------------
@@ -979,23 +1146,34 @@ void Audio::msgSetGlobalTempo(int val)
 
 void Audio::msgDeleteTempo(int tick, int tempo, bool doUndoFlag)
 {
+	tempomap.delTempo(tick);
 	AudioMsg msg;
 	msg.id = SEQM_REMOVE_TEMPO;
 	msg.a = tick;
 	msg.b = tempo;
-	sendMessage(&msg, doUndoFlag);
+	sendTempoMessage(&msg, doUndoFlag);
 }
 
 //---------------------------------------------------------
 //   msgDeleteTempoRange
+//    the events are copied for the undo list, removing
+//    them changes the ones which follow
 //---------------------------------------------------------
 
 void Audio::msgDeleteTempoRange(QList<void*> tempo, bool doUndoFlag)
 {
+	if (tempo.isEmpty())
+		return;
 	AudioMsg msg;
 	msg.id = SEQM_REMOVE_TEMPO_RANGE;
-	msg.objectList = tempo;
-	sendMessage(&msg, doUndoFlag);
+	foreach(void* p, tempo)
+	{
+		TEvent* ev = (TEvent*) p;
+		msg.list.append(ev->tick);
+		msg.list.append(ev->tempo);
+	}
+	tempomap.delTempoRange(((TEvent*) tempo.front())->tick, ((TEvent*) tempo.back())->tick);
+	sendTempoMessage(&msg, doUndoFlag);
 }
 
 //---------------------------------------------------------
@@ -1099,12 +1277,52 @@ void Audio::msgUpdateSoloStates()
 
 void Audio::msgSetAux(AudioTrack* track, qint64 id, double val)
 {
+	track->setAuxSend(id, val);
+	msgSwapAuxSends(song->prepareAuxSends(QList<Track*>() << track, QList<Track*>()));
+}
+
+//---------------------------------------------------------
+//   msgSetAuxPrefader
+//---------------------------------------------------------
+
+void Audio::msgSetAuxPrefader(AudioTrack* track, qint64 id, bool prefader)
+{
+	track->setAuxPrefader(id, prefader);
+	msgSwapAuxSends(song->prepareAuxSends(QList<Track*>() << track, QList<Track*>()));
+}
+
+//---------------------------------------------------------
+//   msgSwapAuxSends
+//    publish the aux send tables built by the gui, see
+//    Song::prepareAuxSends()
+//---------------------------------------------------------
+
+void Audio::msgSwapAuxSends(AuxSendSwapList* sends)
+{
+	if (sends == 0)
+		return;
 	AudioMsg msg;
-	msg.id = SEQM_SET_AUX;
-	msg.snode = track;
-	msg.sid = id;
-	msg.dval = val;
-	sendMessage(&msg, false);
+	msg.id = SEQM_SWAP_AUX_SENDS;
+	msg.p1 = sends;
+	sendMsg(&msg);
+	song->deleteAuxSends(sends);
+}
+
+//---------------------------------------------------------
+//   msgSwapEventStores
+//    publish the playback stores made by the gui, see
+//    Song::packMidiEvents()
+//---------------------------------------------------------
+
+void Audio::msgSwapEventStores(EventStoreSwapList* stores)
+{
+	if (stores == 0)
+		return;
+	AudioMsg msg;
+	msg.id = SEQM_SWAP_EVENT_STORES;
+	msg.p1 = stores;
+	sendMsg(&msg);
+	song->deleteEventStores(stores);
 }
 
 //---------------------------------------------------------
@@ -16,6 +16,7 @@
 #include <QMenu>
 #include <QMessageBox>
 #include <QPoint>
+#include <QSet>
 #include <QSignalMapper>
 #include <QTextStream>
 #include <QUndoStack>
@@ -52,6 +53,9 @@
 #include "traverso_shared/OOMCommand.h"
 #include "traverso_shared/TConfig.h"
 #include "CreateTrackDialog.h"
+#include "audiograph.h"
+#include "dspload.h"
+#include "midieventstore.h"
 //#include <omp.h>
 
 extern void clearMidiTransforms();
@@ -99,6 +103,7 @@ Song::Song(QUndoStack* stack, const char* name)
 	viewselected = false;
 	hasSelectedParts = false;
 	invalid = false;
+	_changes = SongChangeSet(0);
 	_replay = false;
 	_replayPos = 0;
 	//Master track ID
@@ -1173,6 +1178,381 @@ void Song::updateAuxIndex()
 	}
 }
 
+//---------------------------------------------------------
+//   prepareAuxSends
+//    gui part of inserting and removing tracks, builds the
+//    aux send tables the tracks will have afterwards. When
+//    an aux comes or goes that are all tracks with sends,
+//    otherwise the ones of added.
+//    returns 0 if there is nothing to swap
+//---------------------------------------------------------
+
+AuxSendSwapList* Song::prepareAuxSends(const QList<Track*>& added, const QList<Track*>& removed)
+{
+	AuxList auxs = _auxs;
+	bool auxChanged = false;
+	foreach(Track* t, added)
+	{
+		if (t->type() == Track::AUDIO_AUX)
+		{
+			auxs.push_back(t);
+			auxChanged = true;
+		}
+	}
+	foreach(Track* t, removed)
+	{
+		if (t->type() == Track::AUDIO_AUX)
+		{
+			auxs.erase(t);
+			auxChanged = true;
+		}
+	}
+
+	QList<Track*> tracks = added;
+	if (auxChanged)
+	{
+		for (ciTrack it = _tracks.begin(); it != _tracks.end(); ++it)
+		{
+			if (!removed.contains(*it) && !tracks.contains(*it))
+				tracks.append(*it);
+		}
+	}
+
+	AuxSendSwapList* l = 0;
+	foreach(Track* t, tracks)
+	{
+		if (t->isMidiTrack())
+			continue;
+		AudioTrack* at = (AudioTrack*) t;
+		if (!at->hasAuxSend())
+			continue;
+		if (l == 0)
+			l = new AuxSendSwapList;
+		AuxSendSwap e;
+		e.track = at;
+		e.table = at->auxSendTable(auxs);
+		l->push_back(e);
+	}
+	return l;
+}
+
+//---------------------------------------------------------
+//   undoAuxSends
+//    prepareAuxSends() for the tracks undo (or redo) of u
+//    inserts and removes
+//---------------------------------------------------------
+
+AuxSendSwapList* Song::undoAuxSends(Undo& u, bool undo)
+{
+	QList<Track*> added;
+	QList<Track*> removed;
+	for (iUndoOp i = u.begin(); i != u.end(); ++i)
+	{
+		if (i->type == UndoOp::AddTrack)
+			(undo ? removed : added).append(i->oTrack);
+		else if (i->type == UndoOp::DeleteTrack)
+			(undo ? added : removed).append(i->oTrack);
+	}
+	return prepareAuxSends(added, removed);
+}
+
+//---------------------------------------------------------
+//   swapAuxSends
+//    realtime part, publish the tables of l. l gets the old
+//    tables for deleteAuxSends().
+//---------------------------------------------------------
+
+void Song::swapAuxSends(AuxSendSwapList* l)
+{
+	if (l == 0)
+		return;
+	for (AuxSendSwapList::iterator i = l->begin(); i != l->end(); ++i)
+		i->table = i->track->swapAuxSendTable(i->table);
+}
+
+//---------------------------------------------------------
+//   deleteAuxSends
+//    gui thread, after the message which swapped l
+//---------------------------------------------------------
+
+void Song::deleteAuxSends(AuxSendSwapList* l)
+{
+	if (l == 0)
+		return;
+	for (AuxSendSwapList::iterator i = l->begin(); i != l->end(); ++i)
+		delete i->table;
+	delete l;
+}
+
+//---------------------------------------------------------
+//   updateAuxSends
+//    rebuild the aux send tables of all tracks, the auxes
+//    they point to were added or removed
+//---------------------------------------------------------
+
+void Song::updateAuxSends()
+{
+	AuxSendSwapList* l = 0;
+	for (ciTrack it = _tracks.begin(); it != _tracks.end(); ++it)
+	{
+		if ((*it)->isMidiTrack())
+			continue;
+		AudioTrack* at = (AudioTrack*) *it;
+		if (!at->hasAuxSend())
+			continue;
+		if (l == 0)
+			l = new AuxSendSwapList;
+		AuxSendSwap e;
+		e.track = at;
+		e.table = at->auxSendTable(_auxs);
+		l->push_back(e);
+	}
+	audio->msgSwapAuxSends(l);
+}
+
+//---------------------------------------------------------
+//   settleLatency
+//    iterate the latencies of the inputs and outputs and,
+//    if dm is given, the delays of the sources until they
+//    do not change. Sources in smallest get the smallest
+//    delay their summing points need, the others the
+//    largest. pdm and pds are set to the delays of the
+//    pass before the last.
+//    returns false if they do not settle
+//---------------------------------------------------------
+
+static bool settleLatency(const std::vector<AudioTrack*>& tracks,
+		const std::vector<std::vector<int> >& routeSrc, const std::vector<std::vector<int> >& sendSrc,
+		const std::vector<unsigned>& pipe, const std::vector<bool>& smallest,
+		std::vector<unsigned>& in, std::vector<unsigned>& out,
+		std::vector<unsigned>* dm, std::vector<unsigned>* ds,
+		std::vector<unsigned>* pdm = 0, std::vector<unsigned>* pds = 0)
+{
+	int n = tracks.size();
+	std::fill(in.begin(), in.end(), 0);
+	std::fill(out.begin(), out.end(), 0);
+	if (dm)
+	{
+		std::fill(dm->begin(), dm->end(), 0);
+		std::fill(ds->begin(), ds->end(), 0);
+	}
+	int maxPass = dm ? 2 * n + 2 : n + 1;
+	for (int pass = 0; pass <= maxPass; ++pass)
+	{
+		bool changed = false;
+		for (int i = 0; i < n; ++i)
+		{
+			unsigned l = 0;
+			for (unsigned k = 0; k < routeSrc[i].size(); ++k)
+			{
+				int s = routeSrc[i][k];
+				unsigned a = out[s] + (dm ? (*dm)[s] : 0);
+				if (a > l)
+					l = a;
+			}
+			for (unsigned k = 0; k < sendSrc[i].size(); ++k)
+			{
+				int s = sendSrc[i][k];
+				unsigned a = out[s] + (ds ? (*ds)[s] : 0);
+				if (a > l)
+					l = a;
+			}
+			unsigned o = tracks[i]->type() == Track::WAVE ? 0 : l + pipe[i];
+			if (l != in[i] || o != out[i])
+				changed = true;
+			in[i] = l;
+			out[i] = o;
+		}
+		if (dm)
+		{
+			std::vector<unsigned> nm(n, ~0U);
+			std::vector<unsigned> ns(n, ~0U);
+			for (int i = 0; i < n; ++i)
+			{
+				for (int kind = 0; kind < 2; ++kind)
+				{
+					const std::vector<int>& src = kind ? sendSrc[i] : routeSrc[i];
+					std::vector<unsigned>& d = kind ? ns : nm;
+					for (unsigned k = 0; k < src.size(); ++k)
+					{
+						int s = src[k];
+						unsigned need = in[i] > out[s] ? in[i] - out[s] : 0;
+						if (d[s] == ~0U || (smallest[s] ? need < d[s] : need > d[s]))
+							d[s] = need;
+					}
+				}
+			}
+			for (int k = 0; k < n; ++k)
+			{
+				if (nm[k] == ~0U)
+					nm[k] = 0;
+				if (ns[k] == ~0U)
+					ns[k] = 0;
+			}
+			if (pdm)
+			{
+				*pdm = *dm;
+				*pds = *ds;
+			}
+			if (nm != *dm || ns != *ds)
+				changed = true;
+			*dm = nm;
+			*ds = ns;
+		}
+		if (!changed)
+			return true;
+	}
+	return false;
+}
+
+//---------------------------------------------------------
+//   updateLatency
+//    plugin delay compensation
+//    The latency of a track output is the one of its latest
+//    input plus the one of its plugins. The other inputs of
+//    a summing point (routes into a track, aux sends into
+//    an aux) are delayed to the latest. A source has one
+//    delay for its routes and one for its aux sends, each
+//    the largest any of its summing points needs, and the
+//    delay is part of the latency further down.
+//    A source whose paths meet again behind different
+//    latencies (routed into a group and into the output
+//    of the group) cannot be aligned, its delays would
+//    grow without end. It falls back to the smallest
+//    delay its points need.
+//    Wave tracks read ahead by the latency of their plugins
+//    and by less the smaller of their delays, a delay line
+//    only makes up the difference between them.
+//    Their inputs are only monitored and are not counted.
+//    Called from the heartbeat, plugins report their
+//    latency while they run.
+//---------------------------------------------------------
+
+void Song::updateLatency()
+{
+	std::vector<AudioTrack*> tracks;
+	QHash<Track*, int> index;
+	for (ciTrack it = _tracks.begin(); it != _tracks.end(); ++it)
+	{
+		if ((*it)->isMidiTrack())
+			continue;
+		index.insert(*it, tracks.size());
+		tracks.push_back((AudioTrack*) *it);
+	}
+	int n = tracks.size();
+
+	// the inputs of every summing point
+	std::vector<std::vector<int> > routeSrc(n);
+	std::vector<std::vector<int> > sendSrc(n);
+	std::vector<bool> hasRoute(n, false);
+	std::vector<bool> hasSend(n, false);
+	std::vector<unsigned> pipe(n);
+	for (int i = 0; i < n; ++i)
+	{
+		AudioTrack* t = tracks[i];
+		pipe[i] = t->efxPipe()->latency();
+		if (t->type() == Track::WAVE)
+			continue;
+		const RouteList* rl = t->inRoutes();
+		for (ciRoute ir = rl->begin(); ir != rl->end(); ++ir)
+		{
+			if (ir->type == Route::TRACK_ROUTE && index.contains(ir->track))
+			{
+				int k = index.value(ir->track);
+				routeSrc[i].push_back(k);
+				hasRoute[k] = true;
+			}
+		}
+		if (t->type() == Track::AUDIO_AUX)
+		{
+			for (int k = 0; k < n; ++k)
+			{
+				if (tracks[k]->hasAuxSend() && tracks[k]->auxSends()->contains(t->id()))
+				{
+					sendSrc[i].push_back(k);
+					hasSend[k] = true;
+				}
+			}
+		}
+	}
+
+	// latency of the inputs and the output, first without
+	// compensation to find routing cycles: an acyclic graph
+	// settles after at most n passes
+	std::vector<unsigned> in(n, 0);
+	std::vector<unsigned> out(n, 0);
+	std::vector<unsigned> dm(n, 0); // delay of the routes
+	std::vector<unsigned> ds(n, 0); // delay of the sends
+	bool cycle = !settleLatency(tracks, routeSrc, sendSrc, pipe, std::vector<bool>(), in, out, 0, 0);
+
+	// a routing cycle is not compensated
+	if (!cycle)
+	{
+		std::vector<bool> smallest(n, false);
+		for (int attempt = 0; attempt <= n; ++attempt)
+		{
+			std::vector<unsigned> pdm, pds;
+			if (settleLatency(tracks, routeSrc, sendSrc, pipe, smallest, in, out, &dm, &ds, &pdm, &pds))
+				break;
+			// the sources which still moved fall back
+			bool more = false;
+			for (int k = 0; k < n; ++k)
+			{
+				if (!smallest[k] && (dm[k] != pdm[k] || ds[k] != pds[k]))
+				{
+					smallest[k] = true;
+					more = true;
+				}
+			}
+			if (!more || attempt == n)
+			{
+				cycle = true;
+				break;
+			}
+		}
+		if (cycle)
+		{
+			settleLatency(tracks, routeSrc, sendSrc, pipe, std::vector<bool>(), in, out, 0, 0);
+			std::fill(dm.begin(), dm.end(), 0);
+			std::fill(ds.begin(), ds.end(), 0);
+		}
+	}
+	for (int k = 0; k < n; ++k)
+	{
+		// the delay of a path which is not used follows the other
+		if (!hasSend[k])
+			ds[k] = dm[k];
+		else if (!hasRoute[k])
+			dm[k] = ds[k];
+	}
+
+	bool seek = false;
+	for (int i = 0; i < n; ++i)
+	{
+		AudioTrack* t = tracks[i];
+		if (t->type() == Track::WAVE)
+		{
+			WaveTrack* wt = (WaveTrack*) t;
+			unsigned base = dm[i] < ds[i] ? dm[i] : ds[i];
+			int shift = cycle ? 0 : int(pipe[i]) - int(base);
+			if (shift != wt->readShift())
+			{
+				wt->setReadShift(shift);
+				seek = true;
+			}
+			t->setLatencyCompensation(cycle ? pipe[i] : dm[i], dm[i] - base, ds[i] - base);
+		}
+		else
+			t->setLatencyCompensation(out[i] + dm[i], dm[i], ds[i]);
+	}
+
+	// what the prefetch thread read with the old shift while
+	// stopped is read again, while playing the change takes
+	// effect with the next reads
+	if (seek && !audio->isPlaying())
+		audio->msgSeek(cPos());
+}
+
 //---------------------------------------------------------
 //   findTrackById
 //    find track by id
@@ -1461,7 +1841,8 @@ void Song::setClick(bool val)
 				}
 			}
 		}
-		if(!hasoutput || !audioClickFlag)
+		// no main window when rendering from the command line
+		if(oom && (!hasoutput || !audioClickFlag))
 		{
 			oom->configMetronome();
 		}
@@ -1740,11 +2121,137 @@ void Song::update(int flags)
 	{
 		emit composerViewChanged();
 	}*/
-	if(!invalid)
-		emit songChanged(flags);
+	emitChanges(flags, 0);
 	--level;
 }
 
+//---------------------------------------------------------
+//   emitChanges
+//    emit songChanged(flags) with changes() telling which
+//    parts and tracks it is about. The scope comes from the
+//    undo group, if any, and from the parts whose events
+//    changed since the last notification.
+//---------------------------------------------------------
+
+void Song::emitChanges(int flags, const Undo* undo)
+{
+	packMidiEvents();
+	updatePartSchedules();
+
+	SongChangeSet cs;
+	cs.addFlags(flags);
+	for (iTrack t = _tracks.begin(); t != _tracks.end(); ++t)
+	{
+		PartList* pl = (*t)->parts();
+		for (iPart p = pl->begin(); p != pl->end(); ++p)
+		{
+			if (p->second->events()->changedSinceNotify())
+				cs.addPart(p->second);
+		}
+	}
+	// clones share the event list, mark it after all of them are seen
+	bool events = !cs.parts().isEmpty();
+	foreach(Part* p, cs.parts())
+		p->events()->setNotified();
+
+	const int eventFlags = SC_EVENT_INSERTED | SC_EVENT_REMOVED | SC_EVENT_MODIFIED;
+	if ((flags & eventFlags) && !events)
+		cs.setGlobal(); // events changed in place, don't know where
+	if (undo)
+		cs.addUndo(*undo);
+	else if (flags & ~(eventFlags | SC_SELECTION | SC_MIDI_CONTROLLER))
+		cs.setGlobal();
+
+	if (invalid)
+		return;
+	SongChangeSet outer = _changes;
+	_changes = cs;
+	emit songChanged(flags);
+	_changes = outer;
+}
+
+//---------------------------------------------------------
+//   packMidiEvents
+//    renew the playback stores of the midi parts changed
+//    since the last update, unchanged parts cost a compare.
+//    The new stores go to the audio thread in one message
+//    and the old ones are deleted when it is done. Not
+//    while this thread collects a batch.
+//---------------------------------------------------------
+
+void Song::packMidiEvents()
+{
+	if (audio->inBatch())
+		return;
+	EventStoreSwapList* l = 0;
+	QSet<EventList*> packed; // clones share the list
+	for (iMidiTrack t = _midis.begin(); t != _midis.end(); ++t)
+	{
+		PartList* pl = (*t)->parts();
+		for (iPart p = pl->begin(); p != pl->end(); ++p)
+		{
+			EventList* el = p->second->events();
+			if (packed.contains(el))
+				continue;
+			MidiEventStore* s = el->pack();
+			if (s == 0)
+				continue;
+			packed.insert(el);
+			if (l == 0)
+				l = new EventStoreSwapList;
+			EventStoreSwap e;
+			e.list = el;
+			e.store = s;
+			l->push_back(e);
+		}
+	}
+	audio->msgSwapEventStores(l);
+}
+
+//---------------------------------------------------------
+//   swapEventStores
+//    realtime part, publish the stores of l. l gets the old
+//    stores for deleteEventStores().
+//---------------------------------------------------------
+
+void Song::swapEventStores(EventStoreSwapList* l)
+{
+	if (l == 0)
+		return;
+	for (EventStoreSwapList::iterator i = l->begin(); i != l->end(); ++i)
+		i->store = i->list->swapStore(i->store);
+}
+
+//---------------------------------------------------------
+//   deleteEventStores
+//    gui thread, after the message which swapped l
+//---------------------------------------------------------
+
+void Song::deleteEventStores(EventStoreSwapList* l)
+{
+	if (l == 0)
+		return;
+	for (EventStoreSwapList::iterator i = l->begin(); i != l->end(); ++i)
+		delete i->store;
+	delete l;
+}
+
+//---------------------------------------------------------
+//   updatePartSchedules
+//    gui thread, publish the playback schedules of the
+//    wave tracks changed since the last call. Not while
+//    this thread collects a batch, the old schedules could
+//    not be deleted after the messages.
+//---------------------------------------------------------
+
+void Song::updatePartSchedules()
+{
+	if (audio->inBatch())
+		return;
+	for (iWaveTrack t = _waves.begin(); t != _waves.end(); ++t)
+		(*t)->updateSchedule();
+}
+
 //---------------------------------------------------------
 //   updatePos
 //---------------------------------------------------------
@@ -1996,6 +2503,18 @@ void Song::beat()
 	if (audio->isPlaying())
 		setPos(0, tick, true, false, true);
 
+	// before the mixer strips show it
+	if (!invalid)
+		updateLatency();
+	// publish a schedule for the current routing, the audio
+	// thread processes serially until it is in place
+	if (audioGraph && _parallelAudio)
+		audioGraph->update();
+	// parts changed without a song update, e.g. restacked
+	updatePartSchedules();
+	if (dspLoad.enabled())
+		dspLoad.collect();
+
 	// p3.3.40 Update synth native guis at the heartbeat rate.
     //for (ciSynthI is = _synthIs.begin(); is != _synthIs.end(); ++is)
     //	(*is)->guiHeartBeat();
@@ -2196,8 +2715,7 @@ void Song::endMsgCmd()
 			//printf("Song::endMsgCmd() calling updateTrackViews()\n");
 			//updateTrackViews();
 		}
-		if(!invalid)
-			emit songChanged(updateFlags);
+		emitChanges(updateFlags, undoList->empty() ? 0 : &undoList->back());
 	}
 }
 
@@ -2210,7 +2728,11 @@ void Song::undo()
 	updateFlags = 0;
 	if (doUndo1())
 		return;
-	audio->msgUndo();
+	AuxSendSwapList* sends = undoAuxSends(undoList->back(), true);
+	TempoIndex* tempo = (updateFlags & SC_TEMPO) ? tempomap.buildIndex() : 0;
+	audio->msgUndo(sends, tempo ? &tempo : 0);
+	deleteAuxSends(sends);
+	tempomap.deleteIndex(tempo);
 	doUndo3();
 	redoAction->setEnabled(true);
 	undoAction->setEnabled(!undoList->empty());
@@ -2221,8 +2743,7 @@ void Song::undo()
 	if(updateFlags && (SC_TRACK_REMOVED | SC_TRACK_INSERTED | SC_TRACK_MODIFIED))
 		updateTrackViews();
 
-	if(!invalid)
-		emit songChanged(updateFlags);
+	emitChanges(updateFlags, redoList->empty() ? 0 : &redoList->back());
 }
 
 //---------------------------------------------------------
@@ -2234,7 +2755,11 @@ void Song::redo()
 	updateFlags = 0;
 	if (doRedo1())
 		return;
-	audio->msgRedo();
+	AuxSendSwapList* sends = undoAuxSends(redoList->back(), false);
+	TempoIndex* tempo = (updateFlags & SC_TEMPO) ? tempomap.buildIndex() : 0;
+	audio->msgRedo(sends, tempo ? &tempo : 0);
+	deleteAuxSends(sends);
+	tempomap.deleteIndex(tempo);
 	doRedo3();
 	undoAction->setEnabled(true);
 	redoAction->setEnabled(!redoList->empty());
@@ -2244,8 +2769,7 @@ void Song::redo()
 
 	if(updateFlags && (SC_TRACK_REMOVED | SC_TRACK_INSERTED | SC_TRACK_MODIFIED))
 		updateTrackViews();
-	if(!invalid)
-		emit songChanged(updateFlags);
+	emitChanges(updateFlags, undoList->empty() ? 0 : &undoList->back());
 }
 
 //---------------------------------------------------------
@@ -2262,9 +2786,15 @@ void Song::processMsg(AudioMsg* msg)
 			break;
 		case SEQM_UNDO:
 			doUndo2();
+			swapAuxSends((AuxSendSwapList*) msg->p1);
+			if (msg->p2)
+				tempomap.swapIndex((TempoIndex**) msg->p2);
 			break;
 		case SEQM_REDO:
 			doRedo2();
+			swapAuxSends((AuxSendSwapList*) msg->p1);
+			if (msg->p2)
+				tempomap.swapIndex((TempoIndex**) msg->p2);
 			break;
 		case SEQM_MOVE_TRACK:
 			if (msg->a > msg->b)
@@ -2376,49 +2906,31 @@ void Song::processMsg(AudioMsg* msg)
 			updateFlags = SC_EVENT_MODIFIED;
 			break;
 
+		// the gui changed the list, see Audio::sendTempoMessage()
 		case SEQM_ADD_TEMPO:
-			//printf("processMsg (SEQM_ADD_TEMPO) UndoOp::AddTempo. adding tempo at: %d with tempo=%d\n", msg->a, msg->b);
-			undoOp(UndoOp::AddTempo, msg->a, msg->b);
-			tempomap.addTempo(msg->a, msg->b);
-			updateFlags = SC_TEMPO;
-			break;
-
 		case SEQM_SET_TEMPO:
-			//printf("processMsg (SEQM_SET_TEMPO) UndoOp::AddTempo. adding tempo at: %d with tempo=%d\n", msg->a, msg->b);
 			undoOp(UndoOp::AddTempo, msg->a, msg->b);
-			tempomap.setTempo(msg->a, msg->b);
+			tempomap.swapIndex((TempoIndex**) msg->p1);
 			updateFlags = SC_TEMPO;
 			break;
 
 		case SEQM_SET_GLOBAL_TEMPO:
-			tempomap.setGlobalTempo(msg->a);
+			tempomap.swapIndex((TempoIndex**) msg->p1);
 			break;
 
 		case SEQM_REMOVE_TEMPO:
-			//printf("processMsg (SEQM_REMOVE_TEMPO) UndoOp::DeleteTempo. adding tempo at: %d with tempo=%d\n", msg->a, msg->b);
 			undoOp(UndoOp::DeleteTempo, msg->a, msg->b);
-			tempomap.delTempo(msg->a);
+			tempomap.swapIndex((TempoIndex**) msg->p1);
 			updateFlags = SC_TEMPO;
 			break;
 
 		case SEQM_REMOVE_TEMPO_RANGE:
-		{
-			//printf("processMsg (SEQM_REMOVE_TEMPO) UndoOp::DeleteTempo. adding tempo at: %d with tempo=%d\n", msg->a, msg->b);
-			QList<void*> list = msg->objectList;
-			if(!list.isEmpty())
-			{
-				TEvent* se = (TEvent*)list.front();
-				TEvent* ee = (TEvent*)list.back();
-				for(int i = 0; i < list.size(); i++)
-				{
-					TEvent* ev = (TEvent*)list.at(i);
-					undoOp(UndoOp::DeleteTempo, ev->tick, ev->tempo);
-				}
-				tempomap.delTempoRange(se->tick, ee->tick);
-				updateFlags = SC_TEMPO;
-			}
+			for (int i = 0; i + 1 < msg->list.size(); i += 2)
+				undoOp(UndoOp::DeleteTempo, msg->list.at(i), msg->list.at(i + 1));
+			tempomap.swapIndex((TempoIndex**) msg->p1);
+			updateFlags = SC_TEMPO;
 			break;
-		}
+
 		case SEQM_ADD_SIG:
 			undoOp(UndoOp::AddSig, msg->a, msg->b, msg->c);
 			AL::sigmap.add(msg->a, AL::TimeSignature(msg->b, msg->c));
@@ -2519,6 +3031,9 @@ void Song::clear(bool signal)
 	m_masterId = 0;
 	m_oomVerbId = 0;
 
+	if (audioGraph)
+		audioGraph->invalidate();
+
 	m_tracks.clear();
 	m_trackIndex.clear();
 	m_composerTracks.clear();
@@ -2656,6 +3171,7 @@ void Song::clear(bool signal)
 	_quantize = false;
 	_len = 405504; // song len in ticks
 	_follow = JUMP;
+	_parallelAudio = config.parallelAudio;
 	// _tempo      = 500000;      // default tempo 120
 	dirty = false;
 	initDrumMap();
@@ -3848,7 +4364,9 @@ void Song::updateTrackViews()
 void Song::insertTrack(Track* track, int idx)
 {
 	insertTrack1(track, idx);
+	AuxSendSwapList* sends = prepareAuxSends(QList<Track*>() << track, QList<Track*>());
 	insertTrackRealtime(track, idx); // audio->msgInsertTrack(track, idx, false);
+	audio->msgSwapAuxSends(sends);
 }
 
 //---------------------------------------------------------
@@ -3889,7 +4407,9 @@ void Song::insertTrackRealtime(Track* track, int idx)
 {
 	//printf("Song::insertTrackRealtime track:%lx\n", track);
 
-	int n;
+	if (audioGraph)
+		audioGraph->invalidate();
+
 	iTrack ia;
 	switch (track->type())
 	{
@@ -3939,9 +4459,8 @@ void Song::insertTrackRealtime(Track* track, int idx)
 			return;
 	}
 
-	//
-	// initialize missing aux send
-	//
+	// the aux sends are swapped in by the caller, see
+	// prepareAuxSends()
 	iTrack i = _tracks.index2iterator(idx);
 	//printf("Song::insertTrackRealtime inserting into _tracks...\n");
 
@@ -3951,19 +4470,6 @@ void Song::insertTrackRealtime(Track* track, int idx)
 	_autotviews.value(m_commentViewId)->addTrack(track->id());
 	//printf("Song::insertTrackRealtime inserted\n");
 
-	n = _auxs.size();
-	for (iTrack i = _tracks.begin(); i != _tracks.end(); ++i)
-	{
-		if ((*i)->isMidiTrack())
-			continue;
-		//WaveTrack* wt = (WaveTrack*) * i;
-		AudioTrack* wt = (AudioTrack*) * i;
-		if (wt->hasAuxSend())
-		{
-			wt->addAuxSend();
-		}
-	}
-
 	//
 	//  add routes
 	//
@@ -4081,6 +4587,9 @@ void Song::removeTrackRealtime(Track* track)
 	//printf("Song::removeTrackRealtime track:%s\n", track->name().toLatin1().constData());
 	midiMonitor->msgDeleteMonitoredTrack(track);
 
+	if (audioGraph)
+		audioGraph->invalidate();
+
 	switch (track->type())
 	{
 		case Track::MIDI:
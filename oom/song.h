@@ -18,6 +18,7 @@
 #include "tempo.h"
 #include "al/sig.h"
 #include "undo.h"
+#include "songchange.h"
 #include "track.h"
 #include "trackview.h"
 
@@ -149,6 +150,8 @@ private:
     int noteFifoRindex;
 
     int updateFlags;
+    SongChangeSet _changes; // of the songChanged() being emitted
+    void emitChanges(int flags, const Undo* undo);
 
 	QHash<qint64, Track*> m_tracks; //New indexed list of tracks
 	QHash<qint64, Track*> m_composerTracks;
@@ -211,6 +214,7 @@ private:
     unsigned _len; // song len in ticks
     FollowMode _follow;
     int _globalPitchShift;
+    bool _parallelAudio; // process audio tracks on the AudioGraph workers
     void readMarker(Xml&);
 
     QString songInfoStr; // contains user supplied song information, stored in song file.
@@ -277,6 +281,19 @@ public:
 
     void clear(bool signal);
     void update(int flags = -1);
+    void packMidiEvents();
+    void updatePartSchedules();
+
+    //---------------------------------------------------
+    //   changes
+    //    what the songChanged() signal being emitted is
+    //    about, global outside of one
+    //---------------------------------------------------
+
+    const SongChangeSet& changes() const
+    {
+        return _changes;
+    }
     void cleanupForQuit();
 
     int globalPitchShift() const {
@@ -384,6 +401,16 @@ public:
     bool quantize() const {
         return _quantize;
     }
+
+    bool parallelAudio() const {
+        return _parallelAudio;
+    }
+
+    void setParallelAudio(bool f) {
+        if (_parallelAudio != f)
+            dirty = true;
+        _parallelAudio = f;
+    }
     void setStopPlay(bool);
     void stopRolling();
     void abortRolling();
@@ -538,6 +565,14 @@ public:
     void connectJackRoutes(AudioTrack* track, bool disconnect);
     void updateSoloStates();
 	void updateAuxIndex();
+	void updateAuxSends();
+	AuxSendSwapList* prepareAuxSends(const QList<Track*>& added, const QList<Track*>& removed);
+	AuxSendSwapList* undoAuxSends(Undo& u, bool undo);
+	void swapAuxSends(AuxSendSwapList*);
+	void deleteAuxSends(AuxSendSwapList*);
+	void swapEventStores(EventStoreSwapList*);
+	void deleteEventStores(EventStoreSwapList*);
+	void updateLatency();
     //void chooseMidiRoutes(QButton* /*parent*/, MidiTrack* /*track*/, bool /*dst*/);
 
     // TrackView
@@ -652,7 +687,7 @@ public:
     void undoOp(UndoOp::UndoType, int channel, int ctrl, int oval, int nval);
     //void undoOp(UndoOp::UndoType, Part* oPart, Part* nPart);
     void undoOp(UndoOp::UndoType, Part* oPart, Part* nPart, bool doCtrls, bool doClones);
-    void undoOp(UndoOp::UndoType type, const char* changedFile, const char* changeData, int startframe, int endframe);
+    void undoOp(UndoOp::UndoType type, const char* changedFile, const char* changeData, int startframe, int endframe, WaveOverlay* oOverlay, WaveOverlay* nOverlay);
     void undoOp(UndoOp::UndoType type, Marker* copyMarker, Marker* realMarker);
     bool doUndo1();
     void doUndo2();
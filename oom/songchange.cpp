@@ -0,0 +1,240 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#include "songchange.h"
+#include "song.h"
+#include "part.h"
+#include "track.h"
+#include "undo.h"
+
+// the single bit flags up to SC_MIDI_CONTROLLER_ADD, in bit order
+static const SongChangeSet::Kind lowKinds[] = {
+	SongChangeSet::TrackInserted, SongChangeSet::TrackRemoved, SongChangeSet::TrackModified,
+	SongChangeSet::PartInserted, SongChangeSet::PartRemoved, SongChangeSet::PartModified,
+	SongChangeSet::EventInserted, SongChangeSet::EventRemoved, SongChangeSet::EventModified,
+	SongChangeSet::Sig, SongChangeSet::Tempo, SongChangeSet::Master, SongChangeSet::Selection,
+	SongChangeSet::MidiController, SongChangeSet::Mute, SongChangeSet::Solo,
+	SongChangeSet::RecFlag, SongChangeSet::Route, SongChangeSet::Channels,
+	SongChangeSet::Config, SongChangeSet::Drummap, SongChangeSet::MixerVolume,
+	SongChangeSet::MixerPan, SongChangeSet::Automation, SongChangeSet::Aux,
+	SongChangeSet::Rack, SongChangeSet::ClipModified, SongChangeSet::MidiControllerAdd
+};
+
+// the top nibble is a number, 1 is SC_MIDI_TRACK_PROP
+static const SongChangeSet::Kind topKinds[] = {
+	SongChangeSet::MidiTrackProp, SongChangeSet::SongType,
+	SongChangeSet::TrackViewInserted, SongChangeSet::TrackViewRemoved,
+	SongChangeSet::TrackViewModified, SongChangeSet::PatchUpdated,
+	SongChangeSet::ViewChanged, SongChangeSet::ViewAdded, SongChangeSet::ViewDeleted
+};
+
+static const int N_LOW_KINDS = sizeof(lowKinds) / sizeof(*lowKinds);
+static const int N_TOP_KINDS = sizeof(topKinds) / sizeof(*topKinds);
+
+static const quint64 TRACK_KINDS = (1 << SongChangeSet::TrackInserted)
+		| (1 << SongChangeSet::TrackRemoved) | (1 << SongChangeSet::TrackModified)
+		| (1 << SongChangeSet::TrackInstrument);
+static const quint64 PART_KINDS = (1 << SongChangeSet::PartInserted)
+		| (1 << SongChangeSet::PartRemoved) | (1 << SongChangeSet::PartModified)
+		| (1 << SongChangeSet::PartColorModified);
+static const quint64 EVENT_KINDS = (1 << SongChangeSet::EventInserted)
+		| (1 << SongChangeSet::EventRemoved) | (1 << SongChangeSet::EventModified);
+
+//---------------------------------------------------------
+//   SongChangeSet
+//    an empty set to add changes and their scope to
+//---------------------------------------------------------
+
+SongChangeSet::SongChangeSet()
+{
+	_flags = 0;
+	_kinds = 0;
+	_global = false;
+	_startTick = ~0;
+	_endTick = 0;
+}
+
+//---------------------------------------------------------
+//   SongChangeSet
+//    the kinds of the legacy flags without a scope
+//---------------------------------------------------------
+
+SongChangeSet::SongChangeSet(int flags)
+{
+	_flags = 0;
+	_kinds = 0;
+	_global = true;
+	_startTick = ~0;
+	_endTick = 0;
+	addFlags(flags);
+}
+
+//---------------------------------------------------------
+//   addKinds
+//---------------------------------------------------------
+
+void SongChangeSet::addKinds(int flags)
+{
+	if (flags == -1)
+	{
+		_kinds = (quint64(1) << KINDS) - 1;
+		_global = true;
+		return;
+	}
+	// the two low values which are not a single bit are
+	// only known when they come alone
+	if (flags == SC_TRACK_INSTRUMENT)
+	{
+		_kinds |= bit(TrackInstrument);
+		return;
+	}
+	if (flags == SC_PART_COLOR_MODIFIED)
+	{
+		_kinds |= bit(PartColorModified);
+		return;
+	}
+	for (int i = 0; i < N_LOW_KINDS; ++i)
+	{
+		if (flags & (1 << i))
+			_kinds |= bit(lowKinds[i]);
+	}
+	unsigned top = unsigned(flags) >> 28;
+	if (top == 0)
+		return;
+	if (int(top) <= N_TOP_KINDS)
+		_kinds |= bit(topKinds[top - 1]);
+	else
+	{
+		// not a value of any flag
+		_kinds = (quint64(1) << KINDS) - 1;
+		_global = true;
+	}
+}
+
+//---------------------------------------------------------
+//   addFlags
+//    adds kinds, not the scope of them
+//---------------------------------------------------------
+
+void SongChangeSet::addFlags(int flags)
+{
+	_flags |= flags;
+	addKinds(flags);
+}
+
+//---------------------------------------------------------
+//   eventsOnly
+//    true if only events of the parts in the set changed,
+//    other than selections and controller values
+//---------------------------------------------------------
+
+bool SongChangeSet::eventsOnly() const
+{
+	const quint64 allowed = EVENT_KINDS | bit(Selection) | bit(MidiController);
+	return !_global && (_kinds & EVENT_KINDS) && !(_kinds & ~allowed);
+}
+
+//---------------------------------------------------------
+//   addTrack
+//---------------------------------------------------------
+
+void SongChangeSet::addTrack(Track* track)
+{
+	if (track)
+		_tracks.insert(track->id());
+}
+
+//---------------------------------------------------------
+//   addPart
+//    the clones of a part share its events, they are
+//    added too
+//---------------------------------------------------------
+
+void SongChangeSet::addPart(Part* part)
+{
+	if (part == 0)
+		return;
+	Part* p = part;
+	do
+	{
+		_parts.insert(p);
+		addTrack(p->track());
+		if (p->tick() < _startTick)
+			_startTick = p->tick();
+		if (p->endTick() > _endTick)
+			_endTick = p->endTick();
+		p = p->nextClone();
+	} while (p && p != part);
+}
+
+//---------------------------------------------------------
+//   addUndo
+//    scope from the operations of an undo group, call it
+//    after the flags are added. Kinds of track or part
+//    changes the group has no operation for, and
+//    operations on anything else, make the set global.
+//---------------------------------------------------------
+
+void SongChangeSet::addUndo(const Undo& undo)
+{
+	bool trackOps = false;
+	bool partOps = false;
+	for (Undo::const_iterator i = undo.begin(); i != undo.end(); ++i)
+	{
+		switch (i->type)
+		{
+			case UndoOp::AddTrack:
+			case UndoOp::DeleteTrack:
+				addTrack(i->oTrack);
+				trackOps = true;
+				break;
+			case UndoOp::ModifyTrack:
+				addTrack(i->oTrack);
+				addTrack(i->nTrack);
+				trackOps = true;
+				break;
+			case UndoOp::AddPart:
+			case UndoOp::DeletePart:
+				addPart(i->oPart);
+				partOps = true;
+				break;
+			case UndoOp::ModifyPart:
+				addPart(i->oPart);
+				addPart(i->nPart);
+				partOps = true;
+				break;
+			case UndoOp::AddEvent:
+			case UndoOp::DeleteEvent:
+			case UndoOp::ModifyEvent:
+				addPart(i->part);
+				break;
+			default:
+				_global = true;
+				break;
+		}
+	}
+	if (((_kinds & TRACK_KINDS) && !trackOps) || ((_kinds & PART_KINDS) && !partOps))
+		_global = true;
+}
+
+//---------------------------------------------------------
+//   merge
+//---------------------------------------------------------
+
+void SongChangeSet::merge(const SongChangeSet& cs)
+{
+	_flags |= cs._flags;
+	_kinds |= cs._kinds;
+	_global = _global || cs._global;
+	_tracks.unite(cs._tracks);
+	_parts.unite(cs._parts);
+	if (cs._startTick < _startTick)
+		_startTick = cs._startTick;
+	if (cs._endTick > _endTick)
+		_endTick = cs._endTick;
+}
+
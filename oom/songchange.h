@@ -0,0 +1,133 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#ifndef __SONGCHANGE_H__
+#define __SONGCHANGE_H__
+
+#include <QSet>
+
+class Part;
+class Track;
+class Undo;
+
+//---------------------------------------------------------
+//   SongChangeSet
+//    What one songChanged() notification is about: the
+//    kinds of change, the tracks and parts they touched
+//    and the tick range of the changed parts.
+//    The SC_ flags can not say everything, some of them
+//    share bits (SC_TRACK_INSTRUMENT is SC_TRACK_INSERTED |
+//    SC_TRACK_MODIFIED, the view flags count in the top
+//    nibble), every kind has a bit of its own here.
+//    A global change set has no scope, receivers must
+//    assume that anything of the given kinds changed.
+//    One made from flags alone is global.
+//---------------------------------------------------------
+
+class SongChangeSet
+{
+public:
+
+    enum Kind
+    {
+        TrackInserted, TrackRemoved, TrackModified, TrackInstrument,
+        PartInserted, PartRemoved, PartModified, PartColorModified,
+        EventInserted, EventRemoved, EventModified,
+        Sig, Tempo, Master, Selection, MidiController,
+        Mute, Solo, RecFlag, Route, Channels, Config, Drummap,
+        MixerVolume, MixerPan, Automation, Aux, Rack, ClipModified,
+        MidiControllerAdd, MidiTrackProp, SongType,
+        TrackViewInserted, TrackViewRemoved, TrackViewModified,
+        PatchUpdated, ViewChanged, ViewAdded, ViewDeleted,
+        KINDS
+    };
+
+private:
+    int _flags; // the SC_ flags for songChanged(int)
+    quint64 _kinds;
+    bool _global;
+    QSet<qint64> _tracks;
+    QSet<Part*> _parts;
+    unsigned _startTick;
+    unsigned _endTick;
+
+    static quint64 bit(Kind k)
+    {
+        return quint64(1) << k;
+    }
+    void addKinds(int flags);
+
+public:
+    SongChangeSet();
+    SongChangeSet(int flags);
+
+    int flags() const
+    {
+        return _flags;
+    }
+
+    bool global() const
+    {
+        return _global;
+    }
+
+    void setGlobal()
+    {
+        _global = true;
+    }
+
+    bool has(Kind k) const
+    {
+        return _kinds & bit(k);
+    }
+
+    bool empty() const
+    {
+        return _kinds == 0;
+    }
+
+    const QSet<qint64>& tracks() const
+    {
+        return _tracks;
+    }
+
+    const QSet<Part*>& parts() const
+    {
+        return _parts;
+    }
+
+    unsigned startTick() const
+    {
+        return _startTick;
+    }
+
+    unsigned endTick() const
+    {
+        return _endTick;
+    }
+
+    bool hasTrack(qint64 id) const
+    {
+        return _global || _tracks.contains(id);
+    }
+
+    bool hasPart(Part* part) const
+    {
+        return _global || _parts.contains(part);
+    }
+
+    bool eventsOnly() const;
+
+    void addFlags(int flags);
+    void addTrack(Track*);
+    void addPart(Part*);
+    void addUndo(const Undo&);
+    void merge(const SongChangeSet&);
+};
+
+#endif
+
@@ -346,6 +346,35 @@ Part* readXmlPart(Xml& xml, Track* track, bool doClone, bool toTrack)/*{{{*/
 				else
 					xml.unknown("readXmlPart");
 				break;
+			case Xml::Text:
+				// a run of events of a binary snapshot, as the
+				// "event" tag above
+				if (xml.packed() == Xml::PackedEvents && npart && !clone && track->isMidiTrack())
+				{
+					EventList* el = npart->events();
+					for (unsigned i = 0; i < xml.packedCount(); ++i)
+					{
+						XmlEvent xe;
+						xml.event(i, &xe);
+						Event e(xe.type == -1 ? Note : EventType(xe.type));
+						e.setTick(xe.tick);
+						if (xe.type == -1)
+							e.setLenTick(xe.len);
+						e.setA(xe.a);
+						e.setB(xe.b);
+						e.setC(xe.c);
+						e.move(-npart->tick());
+						int tick = e.tick();
+						if (tick < 0)
+						{
+							printf("readClone: warning: event at tick:%d not in part:%s, discarded\n",
+									tick, npart->name().toLatin1().constData());
+						}
+						else
+							el->add(e, el->end());
+					}
+				}
+				break;
 			case Xml::Attribut:
 				if (tag == "type")
 				{
@@ -643,6 +672,8 @@ void Song::read(Xml& xml)/*{{{*/
 					_len = xml.parseInt();
 				else if (tag == "follow")
 					_follow = FollowMode(xml.parseInt());
+				else if (tag == "parallelAudio")
+					_parallelAudio = xml.parseInt();
 				else if (tag == "tempolist")
 				{
 					tempomap.read(xml);
@@ -819,6 +850,8 @@ void Song::read(Xml& xml)/*{{{*/
 					{
 						updateAuxIndex();
 					}
+					// the sends were read before the auxes were
+					updateAuxSends();
 					setClick(click);
 					//Call to update the track view menu
 					update(SC_VIEW_CHANGED);
@@ -917,6 +950,7 @@ void Song::write(int level, Xml& xml) const
 	xml.intTag(level, "quantize", _quantize);
 	xml.intTag(level, "len", _len);
 	xml.intTag(level, "follow", _follow);
+	xml.intTag(level, "parallelAudio", _parallelAudio);
 	if (_globalPitchShift)
 		xml.intTag(level, "globalPitchShift", _globalPitchShift);
 
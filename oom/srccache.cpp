@@ -0,0 +1,347 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <sndfile.h>
+#include <samplerate.h>
+
+#include <QThread>
+#include <QMutexLocker>
+
+#include "srccache.h"
+#include "wave.h"
+#include "waveoverlay.h"
+#include "globals.h"
+
+// input frames converted at once
+static const unsigned SRC_CHUNK = 65536;
+
+SrcCache* srcCache;
+
+//---------------------------------------------------------
+//   SrcWorker
+//---------------------------------------------------------
+
+class SrcWorker : public QThread
+{
+	SrcCache* _cache;
+
+public:
+	SrcWorker(SrcCache* c)
+	{
+		_cache = c;
+	}
+
+protected:
+	virtual void run()
+	{
+		_cache->workerLoop();
+	}
+};
+
+//---------------------------------------------------------
+//   SrcCache
+//---------------------------------------------------------
+
+SrcCache::SrcCache(QObject* parent)
+: QObject(parent)
+{
+	_quit = false;
+	_worker = new SrcWorker(this);
+	_worker->start(QThread::LowPriority);
+}
+
+SrcCache::~SrcCache()
+{
+	_lock.lock();
+	_quit = true;
+	foreach(SrcJob* job, _running)
+		job->abort = true;
+	_jobAdded.wakeAll();
+	_lock.unlock();
+
+	_worker->wait();
+	delete _worker;
+	qDeleteAll(_jobs);
+}
+
+//---------------------------------------------------------
+//   add
+//    queue the conversion of sf to rate, a conversion of
+//    sf which is running is aborted, the file has changed
+//---------------------------------------------------------
+
+void SrcCache::add(SndFile* sf, unsigned rate)
+{
+	QMutexLocker locker(&_lock);
+	_ready.removeAll(sf);
+	foreach(SrcJob* job, _running)
+	{
+		if (job->sf == sf)
+			job->abort = true;
+	}
+	foreach(SrcJob* job, _jobs)
+	{
+		if (job->sf == sf)
+		{
+			job->rate = rate;
+			job->target = sf->resampledPath(rate);
+			return;
+		}
+	}
+
+	SrcJob* job = new SrcJob;
+	job->sf = sf;
+	job->path = sf->path();
+	job->target = sf->resampledPath(rate);
+	job->channels = sf->channels();
+	job->rate = rate;
+	job->abort = false;
+	_jobs.append(job);
+	_jobAdded.wakeOne();
+}
+
+//---------------------------------------------------------
+//   cancel
+//    drop all jobs for sf and wait until the worker does
+//    not use it any more
+//---------------------------------------------------------
+
+void SrcCache::cancel(SndFile* sf)
+{
+	QMutexLocker locker(&_lock);
+	_ready.removeAll(sf);
+	for (int i = 0; i < _jobs.size();)
+	{
+		if (_jobs[i]->sf == sf)
+			delete _jobs.takeAt(i);
+		else
+			++i;
+	}
+	for (;;)
+	{
+		bool busy = false;
+		foreach(SrcJob* job, _running)
+		{
+			if (job->sf == sf)
+			{
+				job->abort = true;
+				busy = true;
+			}
+		}
+		if (!busy)
+			break;
+		_jobDone.wait(&_lock);
+	}
+}
+
+//---------------------------------------------------------
+//   takeJob
+//    next job for a file which is not converted now
+//    called with _lock held
+//---------------------------------------------------------
+
+SrcJob* SrcCache::takeJob()
+{
+	for (int i = 0; i < _jobs.size(); ++i)
+	{
+		bool busy = false;
+		foreach(SrcJob* job, _running)
+		{
+			if (job->sf == _jobs[i]->sf)
+				busy = true;
+		}
+		if (!busy)
+			return _jobs.takeAt(i);
+	}
+	return 0;
+}
+
+//---------------------------------------------------------
+//   workerLoop
+//---------------------------------------------------------
+
+void SrcCache::workerLoop()
+{
+	_lock.lock();
+	for (;;)
+	{
+		SrcJob* job = 0;
+		while (!_quit && (job = takeJob()) == 0)
+			_jobAdded.wait(&_lock);
+		if (_quit)
+			break;
+		_running.append(job);
+		_lock.unlock();
+
+		bool error = convert(job);
+
+		_lock.lock();
+		_running.removeAll(job);
+		if (!error && !job->abort)
+		{
+			_ready.append(job->sf);
+			QMetaObject::invokeMethod(this, "finish", Qt::QueuedConnection);
+		}
+		delete job;
+		_jobDone.wakeAll();
+		// a job for the same file may be waiting
+		_jobAdded.wakeAll();
+	}
+	_lock.unlock();
+}
+
+//---------------------------------------------------------
+//   convert
+//    runs in the worker thread, the result is written to
+//    a temporary file which replaces the target when it
+//    is complete
+//    returns true on error or abort
+//---------------------------------------------------------
+
+bool SrcCache::convert(SrcJob* job)
+{
+	SF_INFO info;
+	memset(&info, 0, sizeof (info));
+	SNDFILE* in = sf_open(job->path.toLatin1().constData(), SFM_READ, &info);
+	if (in == 0)
+	{
+		printf("SrcCache: cannot open %s: %s\n", job->path.toLatin1().constData(), sf_strerror(0));
+		return true;
+	}
+	int channels = info.channels;
+	if ((unsigned) channels != job->channels || info.samplerate <= 0)
+	{
+		printf("SrcCache: %s has changed, skipped\n", job->path.toLatin1().constData());
+		sf_close(in);
+		return true;
+	}
+	double ratio = double(job->rate) / double(info.samplerate);
+
+	SF_INFO oinfo;
+	memset(&oinfo, 0, sizeof (oinfo));
+	oinfo.samplerate = job->rate;
+	oinfo.channels = channels;
+	// plain wav is limited to 4GB
+	if (double(info.frames) * ratio * channels * sizeof (float) < 2147483648.0)
+		oinfo.format = SF_FORMAT_WAV | SF_FORMAT_FLOAT;
+	else
+		oinfo.format = SF_FORMAT_W64 | SF_FORMAT_FLOAT;
+	QString tmp = job->target + ".tmp";
+	SNDFILE* out = sf_open(tmp.toLatin1().constData(), SFM_WRITE, &oinfo);
+	if (out == 0)
+	{
+		printf("SrcCache: cannot create %s: %s\n", tmp.toLatin1().constData(), sf_strerror(0));
+		sf_close(in);
+		return true;
+	}
+
+	int err;
+	SRC_STATE* src = src_new(SRC_SINC_MEDIUM_QUALITY, channels, &err);
+	if (src == 0)
+	{
+		printf("SrcCache: %s\n", src_strerror(err));
+		sf_close(out);
+		sf_close(in);
+		::remove(tmp.toLatin1().constData());
+		return true;
+	}
+
+	// the file is converted as it is heard, with its edits
+	WaveOverlay* overlay = job->sf->overlay();
+	long outCap = long(ceil(SRC_CHUNK * ratio)) + 64;
+	float* inbuf = new float[SRC_CHUNK * channels];
+	float* outbuf = new float[outCap * channels];
+	unsigned pos = 0;
+	bool error = false;
+	bool eof = false;
+	while (!eof && !error && !job->abort)
+	{
+		sf_count_t rn = sf_readf_float(in, inbuf, SRC_CHUNK);
+		if (rn < 0)
+			rn = 0;
+		if (overlay)
+			overlay->apply(pos, rn, inbuf);
+		pos += rn;
+		eof = rn < (sf_count_t) SRC_CHUNK;
+
+		SRC_DATA d;
+		d.data_in = inbuf;
+		d.input_frames = rn;
+		d.end_of_input = eof;
+		d.src_ratio = ratio;
+		for (;;)
+		{
+			d.data_out = outbuf;
+			d.output_frames = outCap;
+			err = src_process(src, &d);
+			if (err)
+			{
+				printf("SrcCache: %s: %s\n", job->path.toLatin1().constData(), src_strerror(err));
+				error = true;
+				break;
+			}
+			if (d.output_frames_gen && sf_writef_float(out, outbuf, d.output_frames_gen) != d.output_frames_gen)
+			{
+				printf("SrcCache: writing %s failed\n", tmp.toLatin1().constData());
+				error = true;
+				break;
+			}
+			d.data_in += d.input_frames_used * channels;
+			d.input_frames -= d.input_frames_used;
+			// at the end the converter is drained until it
+			// has nothing left
+			if (d.input_frames_used == 0 && d.output_frames_gen == 0)
+				break;
+			if (d.input_frames == 0 && !eof)
+				break;
+		}
+	}
+
+	delete[] outbuf;
+	delete[] inbuf;
+	if (overlay)
+		overlay->deref();
+	src_delete(src);
+	sf_close(in);
+	if (sf_close(out))
+		error = true;
+
+	if (error || job->abort)
+	{
+		::remove(tmp.toLatin1().constData());
+		return true;
+	}
+	if (::rename(tmp.toLatin1().constData(), job->target.toLatin1().constData()))
+	{
+		printf("SrcCache: cannot rename %s: %s\n", tmp.toLatin1().constData(), strerror(errno));
+		::remove(tmp.toLatin1().constData());
+		return true;
+	}
+	if (debugMsg)
+		printf("SrcCache: %s converted to %u Hz\n", job->path.toLatin1().constData(), job->rate);
+	return false;
+}
+
+//---------------------------------------------------------
+//   finish
+//    open the converted files in the gui thread
+//---------------------------------------------------------
+
+void SrcCache::finish()
+{
+	_lock.lock();
+	QList<SndFile*> ready = _ready;
+	_ready.clear();
+	_lock.unlock();
+
+	foreach(SndFile* sf, ready)
+		sf->openResampled();
+}
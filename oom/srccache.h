@@ -0,0 +1,75 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#ifndef __SRCCACHE_H__
+#define __SRCCACHE_H__
+
+#include <QObject>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QWaitCondition>
+
+class QThread;
+class SndFile;
+
+//---------------------------------------------------------
+//   SrcJob
+//    convert the file at path to rate into target
+//---------------------------------------------------------
+
+struct SrcJob
+{
+    SndFile* sf;
+    QString path;
+    QString target;
+    unsigned channels;
+    unsigned rate;
+    volatile bool abort;
+};
+
+//---------------------------------------------------------
+//   SrcCache
+//    Converts wave files which are not at the session rate
+//    with libsamplerate on a low priority thread. The
+//    result is kept next to the peak file, so it is made
+//    once per file and rate. Until it is ready the prefetch
+//    thread converts on the fly.
+//---------------------------------------------------------
+
+class SrcCache : public QObject
+{
+    Q_OBJECT
+
+    QList<SrcJob*> _jobs;
+    QList<SrcJob*> _running;
+    QList<SndFile*> _ready;
+    QThread* _worker;
+    QMutex _lock;
+    QWaitCondition _jobAdded;
+    QWaitCondition _jobDone;
+    bool _quit;
+
+    SrcJob* takeJob();
+    bool convert(SrcJob*);
+
+private slots:
+    void finish();
+
+public:
+    SrcCache(QObject* parent = 0);
+    ~SrcCache();
+
+    void add(SndFile*, unsigned rate);
+    void cancel(SndFile*);
+    void workerLoop();
+};
+
+extern SrcCache* srcCache;
+
+#endif
+
@@ -36,6 +36,7 @@
 #include "audio.h"
 #include "midiseq.h"
 #include "midictrl.h"
+#include "dspload.h"
 //#include "stringparam.h"
 
 std::vector<Synth*> synthis; // array of available synthis
@@ -911,6 +912,7 @@ void SynthI::preProcessAlways()
 	if (_sif)
 		_sif->preProcessAlways();
 	_processed = false;
+	_metered = false;
 	if(off())
 	{
 	    // Clear any accumulated play events.
@@ -933,6 +935,7 @@ void MessSynthIF::preProcessAlways()
 
 bool SynthI::getData(unsigned pos, int ports, unsigned n, float** buffer)
 {
+	DspLoadScope load(DSP_LOAD_SYNTH, this);
 	for (int k = 0; k < ports; ++k)
 		memset(buffer[k], 0, n * sizeof (float));
 
@@ -8,15 +8,51 @@
 
 #include <stdio.h>
 #include <errno.h>
+#include <stdlib.h>
+#include <sched.h>
 #include <cmath>
 
 #include "tempo.h"
 #include "globals.h"
 #include "gconfig.h"
+#include "lockfree.h"
+#include "utils.h"
 #include "xml.h"
 
 TempoList tempomap;
 
+//---------------------------------------------------------
+//   TempoIndexRef
+//    the current index of a list for one conversion, the
+//    list does not delete an index while a conversion is
+//    counted
+//---------------------------------------------------------
+
+class TempoIndexRef
+{
+	const TempoList* _list;
+	const TempoIndex* _index;
+
+public:
+	TempoIndexRef(const TempoList* list)
+	{
+		_list = list;
+		// counted before the index is loaded, see deleteIndex()
+		__sync_fetch_and_add(&list->_readers, 1);
+		_index = oom_load_acquire(&list->_index);
+	}
+
+	~TempoIndexRef()
+	{
+		__sync_fetch_and_sub(&_list->_readers, 1);
+	}
+
+	const TempoIndex& operator*() const
+	{
+		return *_index;
+	}
+};
+
 //---------------------------------------------------------
 //   TempoList
 //---------------------------------------------------------
@@ -28,6 +64,14 @@ TempoList::TempoList()
 	_tempoSN = 1;
 	_globalTempo = 100;
 	useList = true;
+	_index = 0;
+	_readers = 0;
+	update();
+}
+
+TempoList::~TempoList()
+{
+	delete _index;
 }
 
 //---------------------------------------------------------
@@ -50,7 +94,6 @@ void TempoList::add(unsigned tick, int tempo)
 		ne->tick = tick;
 		insert(std::pair<const unsigned, TEvent*> (tick, ev));
 	}
-	normalize();
 }
 
 //---------------------------------------------------------
@@ -69,6 +112,162 @@ void TempoList::normalize()
 	}
 }
 
+//---------------------------------------------------------
+//   buildIndex
+//    the frames of the list are computed again and copied
+//    with the segments into a new index, one build for all
+//    changes sent with one message
+//    gui context
+//---------------------------------------------------------
+
+TempoIndex* TempoList::buildIndex()
+{
+	normalize();
+	TempoIndex* index = new TempoIndex;
+	index->resize(size());
+	int idx = 0;
+	for (ciTEvent e = begin(); e != end(); ++e, ++idx)
+	{
+		TempoSegment& s = (*index)[idx];
+		s.endTick = e->first;
+		s.tick = e->second->tick;
+		s.frame = e->second->frame;
+		s.tempo = e->second->tempo;
+	}
+	index->serial = ++_tempoSN;
+	index->useList = useList;
+	index->tempo = _tempo;
+	index->globalTempo = _globalTempo;
+	return index;
+}
+
+//---------------------------------------------------------
+//   swapIndex
+//    publish *index, *index is set to the index it
+//    replaces for deleteIndex()
+//    audio thread while it runs, else gui context
+//---------------------------------------------------------
+
+void TempoList::swapIndex(TempoIndex** index)
+{
+	TempoIndex* old = _index;
+	oom_store_release(&_index, *index);
+	// the readers are loaded after the store, see deleteIndex()
+	__sync_synchronize();
+	*index = old;
+}
+
+//---------------------------------------------------------
+//   deleteIndex
+//    delete an index swapped out by swapIndex(). A
+//    conversion counts itself before it loads the index,
+//    so once no conversion is counted none of them can
+//    still hold the old one.
+//    gui context, after the message which swapped it
+//---------------------------------------------------------
+
+void TempoList::deleteIndex(TempoIndex* index)
+{
+	if (index == 0)
+		return;
+	__sync_synchronize();
+	while (oom_load_acquire(&_readers))
+		sched_yield();
+	delete index;
+}
+
+//---------------------------------------------------------
+//   update
+//    publish the list without a message, for changes while
+//    a song is loaded or cleared. Safe against conversions
+//    running in other threads, but the audio thread may see
+//    the new index in the middle of a cycle.
+//    gui context
+//---------------------------------------------------------
+
+void TempoList::update()
+{
+	TempoIndex* index = buildIndex();
+	swapIndex(&index);
+	deleteIndex(index);
+}
+
+//---------------------------------------------------------
+//   tempoSN
+//    serial of the current index, a value cached with it
+//    is valid while it does not change
+//---------------------------------------------------------
+
+int TempoList::tempoSN() const
+{
+	TempoIndexRef idx(this);
+	return (*idx).serial;
+}
+
+//---------------------------------------------------------
+//   findTick
+//    index of the segment containing tick, the first one
+//    ending after it (upper_bound() of the list), -1 if
+//    tick is past the end
+//---------------------------------------------------------
+
+int TempoList::findTick(const TempoIndex& index, unsigned tick)
+{
+	int lo = 0;
+	int hi = index.size();
+	while (lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		if (index[mid].endTick > tick)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return lo == (int) index.size() ? -1 : lo;
+}
+
+//---------------------------------------------------------
+//   findFrame
+//    index of the last segment starting at or before frame
+//---------------------------------------------------------
+
+int TempoList::findFrame(const TempoIndex& index, unsigned frame)
+{
+	int lo = 1;
+	int hi = index.size();
+	while (lo < hi)
+	{
+		int mid = (lo + hi) / 2;
+		if (index[mid].frame > frame)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return lo - 1;
+}
+
+//---------------------------------------------------------
+//   segmentFrame
+//   segmentTick
+//    convert within one segment
+//---------------------------------------------------------
+
+unsigned TempoList::segmentFrame(const TempoIndex& index, const TempoSegment& s, unsigned tick)
+{
+	unsigned dtick = tick - s.tick;
+	double dtime = double(dtick) / (config.division * index.globalTempo * 10000.0 / s.tempo);
+	unsigned dframe = lrint(dtime * sampleRate);
+	return s.frame + dframe;
+}
+
+unsigned TempoList::segmentTick(const TempoIndex& index, const TempoSegment& s, unsigned frame)
+{
+	unsigned te = s.tempo;
+	int dframe = frame - s.frame;
+	double dtime = double(dframe) / double(sampleRate);
+	return s.tick + lrint(dtime * index.globalTempo * config.division * 10000.0 / te);
+}
+
 //---------------------------------------------------------
 //   TempoList::dump
 //---------------------------------------------------------
@@ -94,7 +293,7 @@ void TempoList::clear()
 		delete i->second;
 	TEMPOLIST::clear();
 	insert(std::pair<const unsigned, TEvent*> (MAX_TICK + 1, new TEvent(500000, 0)));
-	++_tempoSN;
+	update();
 }
 
 //---------------------------------------------------------
@@ -103,19 +302,21 @@ void TempoList::clear()
 
 int TempoList::tempo(unsigned tick) const
 {
-	if (useList)
+	TempoIndexRef ref(this);
+	const TempoIndex& idx = *ref;
+	if (idx.useList)
 	{
-		ciTEvent i = upper_bound(tick);
-		if (i == end())
+		int i = findTick(idx, tick);
+		if (i == -1)
 		{
 			if(debugMsg)
 				printf("no TEMPO at tick %d,0x%x\n", tick, tick);
 			return 1000;
 		}
-		return i->second->tempo;
+		return idx[i].tempo;
 	}
 	else
-		return _tempo;
+		return idx.tempo;
 }
 
 //---------------------------------------------------------
@@ -133,7 +334,6 @@ void TempoList::del(unsigned tick)
 		return;
 	}
 	del(e);
-	++_tempoSN;
 }
 
 void TempoList::del(iTEvent e)
@@ -149,8 +349,6 @@ void TempoList::del(iTEvent e)
 	ne->second->tempo = e->second->tempo;
 	ne->second->tick = e->second->tick;
 	erase(e);
-	normalize();
-	++_tempoSN;
 }
 
 //---------------------------------------------------------
@@ -161,8 +359,6 @@ void TempoList::change(unsigned tick, int newTempo)
 {
 	iTEvent e = find(tick);
 	e->second->tempo = newTempo;
-	normalize();
-	++_tempoSN;
 }
 
 //---------------------------------------------------------
@@ -177,7 +373,6 @@ void TempoList::setTempo(unsigned tick, int newTempo)
 		add(tick, newTempo);
 	else
 		_tempo = newTempo;
-	++_tempoSN;
 }
 
 //---------------------------------------------------------
@@ -187,8 +382,6 @@ void TempoList::setTempo(unsigned tick, int newTempo)
 void TempoList::setGlobalTempo(int val)
 {
 	_globalTempo = val;
-	++_tempoSN;
-	normalize();
 }
 
 //---------------------------------------------------------
@@ -198,7 +391,6 @@ void TempoList::setGlobalTempo(int val)
 void TempoList::addTempo(unsigned t, int tempo)
 {
 	add(t, tempo);
-	++_tempoSN;
 }
 
 //---------------------------------------------------------
@@ -208,7 +400,6 @@ void TempoList::addTempo(unsigned t, int tempo)
 void TempoList::delTempo(unsigned tick)
 {
 	del(tick);
-	++_tempoSN;
 }
 
 void TempoList::delTempoRange(unsigned start, unsigned end)
@@ -238,7 +429,6 @@ void TempoList::delTempoRange(unsigned start, unsigned end)
 void TempoList::changeTempo(unsigned tick, int newTempo)
 {
 	change(tick, newTempo);
-	++_tempoSN;
 }
 
 //---------------------------------------------------------
@@ -250,7 +440,7 @@ bool TempoList::setMasterFlag(unsigned /*tick*/, bool val)
 	if (useList != val)
 	{
 		useList = val;
-		++_tempoSN;
+		update();
 		return true;
 	}
 	return false;
@@ -262,7 +452,7 @@ bool TempoList::setMasterFlag(unsigned /*tick*/, bool val)
 
 unsigned TempoList::tick2frame(unsigned tick, unsigned frame, int* sn) const
 {
-	return (*sn == _tempoSN) ? frame : tick2frame(tick, sn);
+	return (*sn == tempoSN()) ? frame : tick2frame(tick, sn);
 }
 
 //---------------------------------------------------------
@@ -271,29 +461,28 @@ unsigned TempoList::tick2frame(unsigned tick, unsigned frame, int* sn) const
 
 unsigned TempoList::tick2frame(unsigned tick, int* sn) const
 {
+	TempoIndexRef ref(this);
+	const TempoIndex& idx = *ref;
 	int f;
-	if (useList)
+	if (idx.useList)
 	{
-		ciTEvent i = upper_bound(tick);
-		if (i == end())
+		int i = findTick(idx, tick);
+		if (i == -1)
 		{
 			if(debugMsg)
 				printf("tick2frame(%d,0x%x): not found\n", tick, tick);
 			// abort();
 			return 0;
 		}
-		unsigned dtick = tick - i->second->tick;
-		double dtime = double(dtick) / (config.division * _globalTempo * 10000.0 / i->second->tempo);
-		unsigned dframe = lrint(dtime * sampleRate);
-		f = i->second->frame + dframe;
+		f = segmentFrame(idx, idx[i], tick);
 	}
 	else
 	{
-		double t = (double(tick) * double(_tempo)) / (double(config.division) * _globalTempo * 10000.0);
+		double t = (double(tick) * double(idx.tempo)) / (double(config.division) * idx.globalTempo * 10000.0);
 		f = lrint(t * sampleRate);
 	}
 	if (sn)
-		*sn = _tempoSN;
+		*sn = idx.serial;
 	return f;
 }
 
@@ -304,7 +493,7 @@ unsigned TempoList::tick2frame(unsigned tick, int* sn) const
 
 unsigned TempoList::frame2tick(unsigned frame, unsigned t, int* sn) const
 {
-	return (*sn == _tempoSN) ? t : frame2tick(frame, sn);
+	return (*sn == tempoSN()) ? t : frame2tick(frame, sn);
 }
 
 //---------------------------------------------------------
@@ -313,29 +502,15 @@ unsigned TempoList::frame2tick(unsigned frame, unsigned t, int* sn) const
 
 unsigned TempoList::frame2tick(unsigned frame, int* sn) const
 {
+	TempoIndexRef ref(this);
+	const TempoIndex& idx = *ref;
 	unsigned tick;
-	if (useList)
-	{
-		ciTEvent e;
-		for (e = begin(); e != end();)
-		{
-			ciTEvent ee = e;
-			++ee;
-			if (ee == end())
-				break;
-			if (frame < ee->second->frame)
-				break;
-			e = ee;
-		}
-		unsigned te = e->second->tempo;
-		int dframe = frame - e->second->frame;
-		double dtime = double(dframe) / double(sampleRate);
-		tick = e->second->tick + lrint(dtime * _globalTempo * config.division * 10000.0 / te);
-	}
+	if (idx.useList)
+		tick = segmentTick(idx, idx[findFrame(idx, frame)], frame);
 	else
-		tick = lrint((double(frame) / double(sampleRate)) * _globalTempo * config.division * 10000.0 / double(_tempo));
+		tick = lrint((double(frame) / double(sampleRate)) * idx.globalTempo * config.division * 10000.0 / double(idx.tempo));
 	if (sn)
-		*sn = _tempoSN;
+		*sn = idx.serial;
 	return tick;
 }
 
@@ -345,42 +520,38 @@ unsigned TempoList::frame2tick(unsigned frame, int* sn) const
 
 unsigned TempoList::deltaTick2frame(unsigned tick1, unsigned tick2, int* sn) const
 {
+	TempoIndexRef ref(this);
+	const TempoIndex& idx = *ref;
 	int f1, f2;
-	if (useList)
+	if (idx.useList)
 	{
-		ciTEvent i = upper_bound(tick1);
-		if (i == end())
+		int i = findTick(idx, tick1);
+		if (i == -1)
 		{
 			if(debugMsg)
 				printf("TempoList::deltaTick2frame: tick1:%d not found\n", tick1);
 			// abort();
 			return 0;
 		}
-		unsigned dtick = tick1 - i->second->tick;
-		double dtime = double(dtick) / (config.division * _globalTempo * 10000.0 / i->second->tempo);
-		unsigned dframe = lrint(dtime * sampleRate);
-		f1 = i->second->frame + dframe;
+		f1 = segmentFrame(idx, idx[i], tick1);
 
-		i = upper_bound(tick2);
-		if (i == end())
+		i = findTick(idx, tick2);
+		if (i == -1)
 		{
 			return 0;
 		}
-		dtick = tick2 - i->second->tick;
-		dtime = double(dtick) / (config.division * _globalTempo * 10000.0 / i->second->tempo);
-		dframe = lrint(dtime * sampleRate);
-		f2 = i->second->frame + dframe;
+		f2 = segmentFrame(idx, idx[i], tick2);
 	}
 	else
 	{
-		double t = (double(tick1) * double(_tempo)) / (double(config.division) * _globalTempo * 10000.0);
+		double t = (double(tick1) * double(idx.tempo)) / (double(config.division) * idx.globalTempo * 10000.0);
 		f1 = lrint(t * sampleRate);
 
-		t = (double(tick2) * double(_tempo)) / (double(config.division) * _globalTempo * 10000.0);
+		t = (double(tick2) * double(idx.tempo)) / (double(config.division) * idx.globalTempo * 10000.0);
 		f2 = lrint(t * sampleRate);
 	}
 	if (sn)
-		*sn = _tempoSN;
+		*sn = idx.serial;
 	// FIXME: Caution: This should be rounded off properly somehow, but how to do that?
 	//                 But it seems to work so far.
 	return f2 - f1;
@@ -393,52 +564,182 @@ unsigned TempoList::deltaTick2frame(unsigned tick1, unsigned tick2, int* sn) con
 
 unsigned TempoList::deltaFrame2tick(unsigned frame1, unsigned frame2, int* sn) const
 {
+	TempoIndexRef ref(this);
+	const TempoIndex& idx = *ref;
 	unsigned tick1, tick2;
-	if (useList)
+	if (idx.useList)
 	{
-		ciTEvent e;
-		for (e = begin(); e != end();)
-		{
-			ciTEvent ee = e;
-			++ee;
-			if (ee == end())
-				break;
-			if (frame1 < ee->second->frame)
-				break;
-			e = ee;
-		}
-		unsigned te = e->second->tempo;
-		int dframe = frame1 - e->second->frame;
-		double dtime = double(dframe) / double(sampleRate);
-		tick1 = e->second->tick + lrint(dtime * _globalTempo * config.division * 10000.0 / te);
-
-		for (e = begin(); e != end();)
-		{
-			ciTEvent ee = e;
-			++ee;
-			if (ee == end())
-				break;
-			if (frame2 < ee->second->frame)
-				break;
-			e = ee;
-		}
-		te = e->second->tempo;
-		dframe = frame2 - e->second->frame;
-		dtime = double(dframe) / double(sampleRate);
-		tick2 = e->second->tick + lrint(dtime * _globalTempo * config.division * 10000.0 / te);
+		tick1 = segmentTick(idx, idx[findFrame(idx, frame1)], frame1);
+		tick2 = segmentTick(idx, idx[findFrame(idx, frame2)], frame2);
 	}
 	else
 	{
-		tick1 = lrint((double(frame1) / double(sampleRate)) * _globalTempo * config.division * 10000.0 / double(_tempo));
-		tick2 = lrint((double(frame2) / double(sampleRate)) * _globalTempo * config.division * 10000.0 / double(_tempo));
+		tick1 = lrint((double(frame1) / double(sampleRate)) * idx.globalTempo * config.division * 10000.0 / double(idx.tempo));
+		tick2 = lrint((double(frame2) / double(sampleRate)) * idx.globalTempo * config.division * 10000.0 / double(idx.tempo));
 	}
 	if (sn)
-		*sn = _tempoSN;
+		*sn = idx.serial;
 	// FIXME: Caution: This should be rounded off properly somehow, but how to do that?
 	//                 But it seems to work so far.
 	return tick2 - tick1;
 }
 
+//---------------------------------------------------------
+//   TempoCursor
+//---------------------------------------------------------
+
+TempoCursor::TempoCursor(const TempoList* list)
+{
+	_list = list;
+	_sn = -1;
+	_idx = 0;
+}
+
+//---------------------------------------------------------
+//   tick2frame
+//    same result as TempoList::tick2frame(). A tick in the
+//    last segment or a few segments after it is found by
+//    stepping forward, anything else by a binary search.
+//---------------------------------------------------------
+
+unsigned TempoCursor::tick2frame(unsigned tick)
+{
+	TempoIndexRef ref(_list);
+	const TempoIndex& index = *ref;
+	if (!index.useList)
+		return _list->tick2frame(tick);
+
+	bool found = false;
+	if (_sn == index.serial && _idx < index.size() && (_idx == 0 || tick >= index[_idx - 1].endTick))
+	{
+		for (int step = 0; step < 4 && _idx < index.size(); ++step, ++_idx)
+		{
+			if (tick < index[_idx].endTick)
+			{
+				found = true;
+				break;
+			}
+		}
+	}
+	if (!found)
+	{
+		int i = TempoList::findTick(index, tick);
+		if (i == -1)
+			return _list->tick2frame(tick); // not found, reports it
+		_idx = i;
+		_sn = index.serial;
+	}
+	return TempoList::segmentFrame(index, index[_idx], tick);
+}
+
+//---------------------------------------------------------
+//   scanTick2frame
+//   scanFrame2tick
+//    the conversions the way the list did them before it
+//    had an index, walking the map from the start
+//---------------------------------------------------------
+
+static unsigned scanTick2frame(const TempoList& list, unsigned tick)
+{
+	ciTEvent i = list.begin();
+	while (i != list.end() && i->first <= tick)
+		++i;
+	if (i == list.end())
+		return 0;
+	unsigned dtick = tick - i->second->tick;
+	double dtime = double(dtick) / (config.division * list.globalTempo() * 10000.0 / i->second->tempo);
+	unsigned dframe = lrint(dtime * sampleRate);
+	return i->second->frame + dframe;
+}
+
+static unsigned scanFrame2tick(const TempoList& list, unsigned frame)
+{
+	ciTEvent e;
+	for (e = list.begin(); e != list.end();)
+	{
+		ciTEvent ee = e;
+		++ee;
+		if (ee == list.end())
+			break;
+		if (frame < ee->second->frame)
+			break;
+		e = ee;
+	}
+	unsigned te = e->second->tempo;
+	int dframe = frame - e->second->frame;
+	double dtime = double(dframe) / double(sampleRate);
+	return e->second->tick + lrint(dtime * list.globalTempo() * config.division * 10000.0 / te);
+}
+
+//---------------------------------------------------------
+//   benchTempoMap
+//    --bench-tempo: fill a list with events tempo changes
+//    and convert ticks and frames across it by the index,
+//    by a TempoCursor moving forward and by the old walk
+//    through the map. Every result is compared with the
+//    walk, then the three are timed.
+//    returns 1 if a result differs
+//---------------------------------------------------------
+
+int benchTempoMap(int events)
+{
+	if (events <= 0)
+		events = 10000;
+	TempoList list;
+	srand(1);
+	unsigned tick = 0;
+	for (int i = 0; i < events; ++i)
+	{
+		tick += config.division / 4 + rand() % (config.division * 4);
+		list.addTempo(tick, 300000 + rand() % 700000);
+	}
+	list.update();
+	unsigned lastTick = tick + config.division * 4;
+	unsigned lastFrame = list.tick2frame(lastTick);
+
+	// every conversion the same number of times, in increasing order
+	const int n = 20000;
+	unsigned* ticks = new unsigned[n];
+	unsigned* frames = new unsigned[n];
+	for (int i = 0; i < n; ++i)
+	{
+		ticks[i] = (unsigned) ((unsigned long long) lastTick * i / n);
+		frames[i] = (unsigned) ((unsigned long long) lastFrame * i / n);
+	}
+
+	unsigned errors = 0;
+	TempoCursor check(&list);
+	for (int i = 0; i < n; ++i)
+	{
+		unsigned f = scanTick2frame(list, ticks[i]);
+		if (list.tick2frame(ticks[i]) != f || check.tick2frame(ticks[i]) != f)
+			++errors;
+		if (list.frame2tick(frames[i]) != scanFrame2tick(list, frames[i]))
+			++errors;
+	}
+
+	unsigned sink = 0;
+	double t0 = curTime();
+	for (int i = 0; i < n; ++i)
+		sink += scanTick2frame(list, ticks[i]) + scanFrame2tick(list, frames[i]);
+	double t1 = curTime();
+	for (int i = 0; i < n; ++i)
+		sink += list.tick2frame(ticks[i]) + list.frame2tick(frames[i]);
+	double t2 = curTime();
+	TempoCursor cursor(&list);
+	for (int i = 0; i < n; ++i)
+		sink += cursor.tick2frame(ticks[i]);
+	double t3 = curTime();
+
+	printf("bench: %d tempo events, %d tick and frame conversions each, %u differ\n", events, n, errors);
+	printf("bench: walk %.3f s, index %.3f s (%.0fx), cursor tick2frame %.3f s (%u)\n",
+			t1 - t0, t2 - t1, t2 > t1 ? (t1 - t0) / (t2 - t1) : 0.0, t3 - t2, sink);
+	delete[] ticks;
+	delete[] frames;
+	list.clear();
+	return errors ? 1 : 0;
+}
+
 //---------------------------------------------------------
 //   TempoList::write
 //---------------------------------------------------------
@@ -490,8 +791,7 @@ void TempoList::read(Xml& xml)
 			case Xml::TagEnd:
 				if (tag == "tempolist")
 				{
-					normalize();
-					++_tempoSN;
+					update();
 					return;
 				}
 			default:
@@ -10,6 +10,7 @@
 #define __TEMPO_H__
 
 #include <map>
+#include <vector>
 
 #ifndef MAX_TICK
 #define MAX_TICK (0x7fffffff/100)
@@ -42,8 +43,43 @@ struct TEvent
     }
 };
 
+//---------------------------------------------------------
+//   TempoSegment
+//    flat copy of one tempo list entry
+//---------------------------------------------------------
+
+struct TempoSegment
+{
+    unsigned endTick; // list key, the next segment starts here
+    unsigned tick;
+    unsigned frame;
+    int tempo;
+};
+
+//---------------------------------------------------------
+//   TempoIndex
+//    the segments of a tempo list in a sorted array, with
+//    everything else a conversion needs. Never changed once
+//    published.
+//---------------------------------------------------------
+
+class TempoIndex : public std::vector<TempoSegment>
+{
+public:
+    int serial; // tempoSN() while this is the current index
+    bool useList;
+    int tempo; // tempo if not using tempo list
+    int globalTempo;
+};
+
 //---------------------------------------------------------
 //   TempoList
+//    The list itself is only used by the gui. Conversions
+//    in any thread use the current TempoIndex, a binary
+//    search instead of a walk through the map. After a
+//    change the gui builds a new index, the audio thread
+//    swaps it in with the message of the change, and the
+//    gui deletes the old one once no conversion holds it.
 //---------------------------------------------------------
 
 typedef std::map<unsigned, TEvent*, std::less<unsigned> > TEMPOLIST;
@@ -54,12 +90,18 @@ typedef TEMPOLIST::const_reverse_iterator criTEvent;
 
 class TempoList : public TEMPOLIST
 {
-    int _tempoSN; // serial no to track tempo changes
+    int _tempoSN; // serial of the last index built
     bool useList;
     int _tempo; // tempo if not using tempo list
     int _globalTempo; // %percent 50-200%
+    TempoIndex* volatile _index;
+    mutable volatile unsigned _readers; // conversions using an index
 
     void normalize();
+    static int findTick(const TempoIndex&, unsigned tick);
+    static int findFrame(const TempoIndex&, unsigned frame);
+    static unsigned segmentFrame(const TempoIndex&, const TempoSegment&, unsigned tick);
+    static unsigned segmentTick(const TempoIndex&, const TempoSegment&, unsigned frame);
     void add(unsigned tick, int tempo);
     void change(unsigned tick, int newTempo);
     void del(iTEvent);
@@ -67,6 +109,7 @@ class TempoList : public TEMPOLIST
 
 public:
     TempoList();
+    ~TempoList();
     void clear();
 
     void read(Xml&);
@@ -81,10 +124,12 @@ public:
     unsigned deltaTick2frame(unsigned tick1, unsigned tick2, int* sn = 0) const;
     unsigned deltaFrame2tick(unsigned frame1, unsigned frame2, int* sn = 0) const;
 
-    int tempoSN() const
-    {
-        return _tempoSN;
-    }
+    int tempoSN() const;
+    TempoIndex* buildIndex();
+    void swapIndex(TempoIndex** index);
+    void deleteIndex(TempoIndex* index);
+    void update();
+
     void setTempo(unsigned tick, int newTempo);
     void addTempo(unsigned t, int tempo);
     void delTempo(unsigned tick);
@@ -97,7 +142,30 @@ public:
         return _globalTempo;
     }
     void setGlobalTempo(int val);
+
+    friend class TempoIndexRef;
+    friend class TempoCursor;
+};
+
+//---------------------------------------------------------
+//   TempoCursor
+//    tick2frame() for ticks that mostly increase, like the
+//    events of a process cycle. The segment of the last
+//    lookup is remembered, so the next one usually needs
+//    no search at all.
+//---------------------------------------------------------
+
+class TempoCursor
+{
+    const TempoList* _list;
+    int _sn;
+    unsigned _idx;
+
+public:
+    TempoCursor(const TempoList* list);
+    unsigned tick2frame(unsigned tick);
 };
 
 extern TempoList tempomap;
+extern int benchTempoMap(int events);
 #endif
@@ -846,7 +846,9 @@ AudioTrack* MidiTrack::getAutomationTrack()
 iPart Track::addPart(Part* p)
 {
 	p->setTrack(this);
-	return _parts.add(p);
+	iPart i = _parts.add(p);
+	partsChanged();
+	return i;
 }
 
 //---------------------------------------------------------
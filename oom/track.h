@@ -16,6 +16,7 @@
 
 #include <vector>
 #include <algorithm>
+#include <semaphore.h>
 
 #include "part.h"
 #include "key.h"
@@ -28,10 +29,14 @@ class Pipeline;
 class Xml;
 class SndFile;
 class MPEventList;
+class PartSchedule;
+class RecordBatch;
 class BasePlugin;
 class MidiAssignData;
 class MidiPort;
 class CCInfo;
+class AudioAux;
+template<class T> class tracklist;
 
 class Track;
 struct MonitorLog
@@ -358,6 +363,11 @@ public:
     Part* findPart(unsigned tick);
     iPart addPart(Part* p);
 
+    //  called after parts were added, removed, moved or restacked
+    virtual void partsChanged()
+    {
+    }
+
     virtual void write(int, Xml&) const = 0;
 
     virtual Track* newTrack() const = 0;
@@ -631,6 +641,42 @@ typedef QPair<bool, double> AuxInfo;
 } AuxInfo;
 */
 
+//---------------------------------------------------------
+//   AuxSendTable
+//    The aux sends of a track the way the audio thread
+//    mixes them, with the aux tracks already looked up.
+//    Never changed once the audio thread can see it, the
+//    gui builds a new table for every change of the sends
+//    and the audio thread swaps it in (see AuxSendSwap).
+//---------------------------------------------------------
+
+struct AuxSendEntry
+{
+    qint64 id;
+    AudioAux* aux;
+    float gain;
+    bool prefader;
+};
+
+typedef std::vector<AuxSendEntry> AuxSendTable;
+
+//---------------------------------------------------------
+//   AuxSendSwap
+//    a table built by the gui for a track, after the audio
+//    thread swapped it in it holds the old table of the
+//    track for the gui to delete
+//---------------------------------------------------------
+
+struct AuxSendSwap
+{
+    AudioTrack* track;
+    AuxSendTable* table;
+};
+
+class AuxSendSwapList : public std::vector<AuxSendSwap>
+{
+};
+
 //---------------------------------------------------------
 //   AudioTrack
 //    this track can hold audio automation data and can
@@ -647,8 +693,11 @@ class AudioTrack : public Track
 
     bool _prefader; // prefader metering
 	QHash<qint64, AuxInfo> _auxSend;
+    AuxSendTable* volatile _auxTable; // _auxSend for the audio thread
 	
     Pipeline* _efxPipe;
+    LatencyDelay* volatile _latencyDelay; // plugin delay compensation
+    unsigned _latency; // of the track output, set by Song::updateLatency()
 
     AutomationType _automationType;
 
@@ -656,6 +705,9 @@ class AudioTrack : public Track
 
 	QHash<int, qint64> m_auxControlList;
     void readAuxSend(Xml& xml);
+    void processAuxSends(int srcChans, unsigned nframes, float** buffer, const double* vol, float* const* gain);
+    void applyVolumeRamp(int srcChans, float** buffer, int dstChannels, float** dstBuffer, unsigned nframes, float* const* gain, bool add);
+    float** delayOutput(int channels, unsigned nframes, float** buffer);
 
 protected:
     float** outBuffers;
@@ -666,7 +718,26 @@ protected:
     virtual bool getData(unsigned, int, unsigned, float**);
     SndFile* _recFile;
     Fifo fifo; // fifo -> _recFile
+    RecordBatch* _recBatch; // fifo -> batch -> _recFile, owned by the disk writer
+    volatile unsigned _recordOverruns; // periods lost because the fifo was full
     bool _processed;
+    bool _metered; // prepareData() set the postfader meter of this cycle
+
+    //---------------------------------------------------
+    //   postMeter
+    //    A track prepared by an AudioGraph worker meters
+    //    itself, the tracks it feeds may call copyData or
+    //    addData on it from several workers at once.
+    //---------------------------------------------------
+
+    void postMeter(int c, double v)
+    {
+        if (_metered)
+            return;
+        _meter[c] = v;
+        if (_meter[c] > _peak[c])
+            _peak[c] = _meter[c];
+    }
 
 public:
     AudioTrack(TrackType t);
@@ -739,6 +810,12 @@ public:
     void putFifo(int channels, unsigned long n, float** bp);
 
     void record();
+    void finishRecord();
+
+    unsigned recordOverruns() const
+    {
+        return _recordOverruns;
+    }
 
     virtual void setMute(bool val, bool monitor = false);
     virtual void setOff(bool val);
@@ -760,6 +837,7 @@ public:
 	bool panFromAutomation();
     double pan() const;
     void setPan(double val, bool monitor = false);
+    bool volumeGain(unsigned nframes, float* gain0, float* gain1);
 
     bool prefader() const
     {
@@ -772,6 +850,8 @@ public:
     double auxSend(qint64 idx) const;
     void setAuxSend(qint64 idx, double v, bool monitor = false);
     void addAuxSend();
+    AuxSendTable* auxSendTable(const tracklist<AudioAux*>& auxs);
+    AuxSendTable* swapAuxSendTable(AuxSendTable*);
 	bool auxIsPrefader(qint64 idx);
 	void setAuxPrefader(qint64 idx, bool);
 
@@ -786,7 +866,16 @@ public:
     void addPlugin(BasePlugin* plugin, int idx);
     void idlePlugin(BasePlugin* plugin);
 
+    unsigned latency() const
+    {
+        return _latency;
+    }
+    void setLatencyCompensation(unsigned latency, unsigned mainDelay, unsigned sendDelay);
+    void swapLatencyDelay(LatencyDelay** d);
+
     double pluginCtrlVal(int ctlID) const;
+    double pluginCtrlVal(int ctlID, unsigned frame) const;
+    unsigned nextCtrlFrame(int ctlID, unsigned frame, unsigned limit) const;
     void setPluginCtrlVal(int param, double val);
 
     void readVolume(Xml& xml);
@@ -794,9 +883,11 @@ public:
     virtual void preProcessAlways()
     {
         _processed = false;
+        _metered = false;
     }
     virtual void addData(unsigned /*samplePos*/, int /*channels*/, int /*srcStartChan*/, int /*srcChannels*/, unsigned /*frames*/, float** /*buffer*/);
     virtual void copyData(unsigned /*samplePos*/, int /*channels*/, int /*srcStartChan*/, int /*srcChannels*/, unsigned /*frames*/, float** /*buffer*/);
+    void prepareData(unsigned /*samplePos*/, unsigned /*frames*/);
 
     virtual bool hasAuxSend() const
     {
@@ -971,6 +1062,12 @@ public:
         return _monitorBuffer;
     }
 
+    // driver buffers of the current period, valid after processWrite()
+    float** outputBuffers()
+    {
+        return buffer;
+    }
+
     virtual bool isMute() const
     {
             return _mute;
@@ -1040,9 +1137,11 @@ public:
 class AudioAux : public AudioTrack
 {
     float* buffer[MAX_CHANNELS];
+    sem_t _sendLock;
 
 public:
     AudioAux();
+    AudioAux(const AudioAux&);
 
     AudioAux* clone(bool /*cloneParts*/) const
     {
@@ -1064,6 +1163,19 @@ public:
         return buffer;
     }
 
+    // guards sendBuffer() while graph workers mix into it,
+    // a worker waiting for it sleeps instead of spinning
+    void lockSend()
+    {
+        while (sem_wait(&_sendLock) != 0)
+            ;
+    }
+
+    void unlockSend()
+    {
+        sem_post(&_sendLock);
+    }
+
     virtual bool isMute() const
     {
             return _mute;
@@ -1080,16 +1192,34 @@ class WaveTrack : public AudioTrack
 	AudioInput* _input;
 	AudioOutput* _output;
 
+    // playback index of the parts, built by the gui in updateSchedule()
+    // and swapped in by the audio thread
+    PartSchedule* volatile _schedule;
+    volatile unsigned _scheduleSerial;
+    volatile unsigned _scheduleReaders; // fetchData() calls using _schedule
+    volatile int _readShift; // frames playback reads ahead, for delay compensation
+
+    int stalePartsSounding(unsigned from, unsigned to, WavePart** parts, int max) const;
+
 public:
     static bool firstWaveTrack;
 
     WaveTrack() : AudioTrack(Track::WAVE)
     {
+        _schedule = 0;
+        _scheduleSerial = 0;
+        _scheduleReaders = 0;
+        _readShift = 0;
     }
 
     WaveTrack(const WaveTrack& wt, bool cloneParts) : AudioTrack(wt, cloneParts)
     {
+        _schedule = 0;
+        _scheduleSerial = 0;
+        _scheduleReaders = 0;
+        _readShift = 0;
     }
+    virtual ~WaveTrack();
 
     virtual WaveTrack* clone(bool cloneParts) const
     {
@@ -1118,6 +1248,16 @@ public:
     {
         return &_prefetchFifo;
     }
+
+    int readShift() const
+    {
+        return _readShift;
+    }
+
+    void setReadShift(int n)
+    {
+        _readShift = n;
+    }
     virtual void setChannels(int n);
 
     virtual bool hasAuxSend() const
@@ -1149,6 +1289,13 @@ public:
 	}
 
 	void calculateCrossFades();
+    virtual void partsChanged();
+    void updateSchedule();
+
+    void setSchedule(PartSchedule* s)
+    {
+        _schedule = s;
+    }
 
 	bool leftEdgeOnTopOfPartBelow(WavePart* topPart, WavePart* bottomPart);
 	bool rightEdgeOnTopOfPartBelow(WavePart* topPart, WavePart* bottomPart);
@@ -63,6 +63,7 @@ void Transpose::accept()
 	typedef std::vector< EventList* >::iterator iDoneList;
 
 	song->startUndo();
+	audio->startBatch();
 	for (iTrack t = tracks->begin(); t != tracks->end(); ++t)
 	{
 		//         if (((*t)->type() == Track::MIDI || (*t)->type() == Track::DRUM)
@@ -101,6 +102,7 @@ void Transpose::accept()
 			}
 		}
 	}
+	audio->endBatch();
 	song->endUndo(SC_EVENT_MODIFIED);
 	close();
 }
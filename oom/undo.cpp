@@ -12,6 +12,8 @@
 #include "undo.h"
 #include "song.h"
 #include "globals.h"
+#include "wave.h"
+#include "waveoverlay.h"
 #include <QUndoStack>
 #include "traverso_shared/OOMCommand.h"
 
@@ -21,6 +23,23 @@ static bool undoMode = false; // for debugging
 
 std::list<QString> temporaryWavFiles;
 
+//---------------------------------------------------------
+//   applyWaveOverlay
+//    undo or redo a ModifyClip by making the version of the
+//    edits before or after it current, audio keeps running
+//---------------------------------------------------------
+
+static void applyWaveOverlay(const char* filename, WaveOverlay* v, unsigned startframe, unsigned endframe)
+{
+	SndFile* f = SndFile::sndFiles.search(QString(filename));
+	if (!f)
+	{
+		printf("Internal error: could not find original file: %s in filelist - Aborting\n", filename);
+		return;
+	}
+	f->setOverlay(v, startframe, endframe);
+}
+
 //---------------------------------------------------------
 //   typeName
 //---------------------------------------------------------
@@ -175,6 +194,12 @@ void UndoList::clearDelete()
 						//      break;
 						//case UndoOp::DeleteSig:
 						//      break;
+					case UndoOp::ModifyClip:
+						if (i->oOverlay)
+							i->oOverlay->deref();
+						if (i->nOverlay)
+							i->nOverlay->deref();
+						break;
 					case UndoOp::ModifyMarker:
 						if (i->copyMarker)
 							delete i->copyMarker;
@@ -392,16 +417,6 @@ void Song::doUndo2()
 					addPortCtrlEvents(i->nEvent, i->part, i->doClones);
 				updateFlags |= SC_EVENT_MODIFIED;
 				break;
-			case UndoOp::AddTempo:
-				//printf("doUndo2: UndoOp::AddTempo. deleting tempo at: %d\n", i->a);
-				tempomap.delTempo(i->a);
-				updateFlags |= SC_TEMPO;
-				break;
-			case UndoOp::DeleteTempo:
-				//printf("doUndo2: UndoOp::DeleteTempo. adding tempo at: %d, tempo=%d\n", i->a, i->b);
-				tempomap.addTempo(i->a, i->b);
-				updateFlags |= SC_TEMPO;
-				break;
 			case UndoOp::AddSig:
 				///sigmap.del(i->a);
 				AL::sigmap.del(i->a);
@@ -414,6 +429,8 @@ void Song::doUndo2()
 				break;
 			case UndoOp::ModifyClip:
 			case UndoOp::ModifyMarker:
+			case UndoOp::AddTempo:
+			case UndoOp::DeleteTempo:
 				break;
 			case UndoOp::AddTrackView:
 			case UndoOp::ModifyTrackView:
@@ -570,16 +587,6 @@ void Song::doRedo2()
 					addPortCtrlEvents(i->oEvent, i->part, i->doClones);
 				updateFlags |= SC_EVENT_MODIFIED;
 				break;
-			case UndoOp::AddTempo:
-				//printf("doRedo2: UndoOp::AddTempo. adding tempo at: %d with tempo=%d\n", i->a, i->b);
-				tempomap.addTempo(i->a, i->b);
-				updateFlags |= SC_TEMPO;
-				break;
-			case UndoOp::DeleteTempo:
-				//printf("doRedo2: UndoOp::DeleteTempo. deleting tempo at: %d with tempo=%d\n", i->a, i->b);
-				tempomap.delTempo(i->a);
-				updateFlags |= SC_TEMPO;
-				break;
 			case UndoOp::AddSig:
 				///sigmap.add(i->a, i->b, i->c);
 				AL::sigmap.add(i->a, AL::TimeSignature(i->b, i->c));
@@ -592,6 +599,8 @@ void Song::doRedo2()
 				break;
 			case UndoOp::ModifyClip:
 			case UndoOp::ModifyMarker:
+			case UndoOp::AddTempo:
+			case UndoOp::DeleteTempo:
 				break;
 			case UndoOp::AddTrackView:
 			case UndoOp::ModifyTrackView:
@@ -714,7 +723,7 @@ void Song::undoOp(UndoOp::UndoType type, SigEvent* oevent, SigEvent* nevent)
 	addUndo(i);
 }
 
-void Song::undoOp(UndoOp::UndoType type, const char* changedFile, const char* changeData, int startframe, int endframe)
+void Song::undoOp(UndoOp::UndoType type, const char* changedFile, const char* changeData, int startframe, int endframe, WaveOverlay* oOverlay, WaveOverlay* nOverlay)
 {
 	UndoOp i;
 	i.type = type;
@@ -722,6 +731,8 @@ void Song::undoOp(UndoOp::UndoType type, const char* changedFile, const char* ch
 	i.tmpwavfile = changeData;
 	i.startframe = startframe;
 	i.endframe = endframe;
+	i.oOverlay = oOverlay;
+	i.nOverlay = nOverlay;
 	addUndo(i);
 	temporaryWavFiles.push_back(QString(changeData));
 
@@ -804,7 +815,17 @@ bool Song::doUndo1()
 
 				break;
 			case UndoOp::ModifyClip:
-				SndFile::applyUndoFile(i->filename, i->tmpwavfile, i->startframe, i->endframe);
+				applyWaveOverlay(i->filename, i->oOverlay, i->startframe, i->endframe);
+				break;
+			// the tempo list is only changed by the gui, undo()
+			// sends the index with the message
+			case UndoOp::AddTempo:
+				tempomap.delTempo(i->a);
+				updateFlags |= SC_TEMPO;
+				break;
+			case UndoOp::DeleteTempo:
+				tempomap.addTempo(i->a, i->b);
+				updateFlags |= SC_TEMPO;
 				break;
 
 			default:
@@ -897,7 +918,15 @@ bool Song::doRedo1()
 				removeTrack1(i->oTrack);
 				break;
 			case UndoOp::ModifyClip:
-				SndFile::applyUndoFile(i->filename, i->tmpwavfile, i->startframe, i->endframe);
+				applyWaveOverlay(i->filename, i->nOverlay, i->startframe, i->endframe);
+				break;
+			case UndoOp::AddTempo:
+				tempomap.addTempo(i->a, i->b);
+				updateFlags |= SC_TEMPO;
+				break;
+			case UndoOp::DeleteTempo:
+				tempomap.delTempo(i->a);
+				updateFlags |= SC_TEMPO;
 				break;
 			default:
 				break;
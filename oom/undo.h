@@ -21,6 +21,7 @@ class TEvent;
 class SigEvent;
 class Part;
 class OOMCommand;
+class WaveOverlay;
 
 extern std::list<QString> temporaryWavFiles; //!< Used for storing all tmp-files, for cleanup on shutdown
 //---------------------------------------------------------
@@ -99,6 +100,8 @@ struct UndoOp
             int endframe; //!< End frame of changed data
             const char* filename; //!< The file that is changed
             const char* tmpwavfile; //!< The file with the changed data
+            WaveOverlay* oOverlay; //!< Edits of the file before the change, referenced
+            WaveOverlay* nOverlay; //!< and after it
         };
 
         struct
@@ -9,12 +9,17 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <sys/stat.h>
 #include <cmath>
+#include <assert.h>
 
+#include <QApplication>
 #include <QDateTime>
 #include <QFileInfo>
 #include <QMessageBox>
+#include <QMutex>
 #include <QProgressDialog>
+#include <QThread>
 
 #include "xml.h"
 #include "song.h"
@@ -28,6 +33,15 @@
 #include "audio.h"
 ///#include "sig.h"
 #include "al/sig.h"
+#include "al/dsp.h"
+#include "FadeCurve.h"
+#include "peakfile.h"
+#include "peakbuilder.h"
+#include "waveoverlay.h"
+#include "srccache.h"
+#include "blockcache.h"
+#include "lockfree.h"
+#include "projectloader.h"
 
 //#define WAVE_DEBUG
 //#define WAVE_DEBUG_PRC
@@ -41,30 +55,128 @@ const char* audioFilePattern[] = {
 	  0
 	  };
  */
-const int cacheMag = 128;
+// frames read at once when building a peak file
+const int peakBlock = 256 * PEAK_BASE_MAG;
+// frames per fade envelope block in readInternal()
+static const unsigned FADE_BLOCK = 256;
 
 // ClipList* waveClips;
 
 SndFileList SndFile::sndFiles;
+static unsigned sndFileSerial;
+// taken by threads other than the prefetch thread to
+// reference the current overlay
+static QMutex overlayLock;
+
+//---------------------------------------------------------
+//   isCompressed
+//    formats where seeking restarts the decoder
+//---------------------------------------------------------
+
+static bool isCompressed(int format)
+{
+	switch (format & SF_FORMAT_TYPEMASK)
+	{
+		case SF_FORMAT_FLAC:
+		case SF_FORMAT_OGG:
+			return true;
+		default:
+			break;
+	}
+	switch (format & SF_FORMAT_SUBMASK)
+	{
+		case SF_FORMAT_VORBIS:
+		case SF_FORMAT_IMA_ADPCM:
+		case SF_FORMAT_MS_ADPCM:
+		case SF_FORMAT_GSM610:
+			return true;
+		default:
+			break;
+	}
+	return false;
+}
 
 //---------------------------------------------------------
 //   SndFile
+//    files which are not listed are opened ahead by the
+//    project loader on its worker threads, getWave() lists
+//    them when the project refers to them
 //---------------------------------------------------------
 
-SndFile::SndFile(const QString& name)
+SndFile::SndFile(const QString& name, bool listed)
 {
 	finfo = new QFileInfo(name);
 	sf = 0;
 	sfUI = 0;
-	csize = 0;
-	cache = 0;
+	peaks = 0;
+	_overlay = 0;
+	_retiredOverlay = 0;
+	_serial = __sync_add_and_fetch(&sndFileSerial, 1);
+	_pos = 0;
+	_resampled = 0;
+	_retiredResampled = 0;
+	_resampledRate = 0;
+	_resampledBuf = 0;
+	_resampledBufFrames = 0;
+	_cached = false;
+	_decodePos = -1;
+	_decodePosUI = -1;
+	_decodeBuf = 0;
+	_decodeBufUI = 0;
 	openFlag = false;
-	sndFiles.push_back(this);
+	_listed = false;
+	if (listed)
+		list();
 	refCount = 0;
 }
 
+//---------------------------------------------------------
+//   list
+//---------------------------------------------------------
+
+void SndFile::list()
+{
+	sndFiles.push_back(this);
+	_listed = true;
+}
+
+//---------------------------------------------------------
+//   unshared
+//    true if only the calling thread can reach the file,
+//    it is not listed yet or the caller is the gui thread
+//---------------------------------------------------------
+
+bool SndFile::unshared() const
+{
+	return !_listed || QThread::currentThread() == qApp->thread();
+}
+
+//---------------------------------------------------------
+//   ~SndFile
+//    the workers which read the file and its edits are
+//    stopped first, they take the overlay with overlay()
+//---------------------------------------------------------
+
 SndFile::~SndFile()
 {
+	if (srcCache)
+		srcCache->cancel(this);
+	if (peakBuilder)
+		peakBuilder->cancel(this);
+	if (waveCompactor)
+		waveCompactor->flush(this);
+
+	overlayLock.lock();
+	WaveOverlay* v = _overlay;
+	WaveOverlay* rv = _retiredOverlay;
+	_overlay = 0;
+	_retiredOverlay = 0;
+	overlayLock.unlock();
+	if (v)
+		v->deref();
+	if (rv)
+		rv->deref();
+
 	if (openFlag)
 		close();
 	for (iSndFile i = sndFiles.begin(); i != sndFiles.end(); ++i)
@@ -75,18 +187,30 @@ SndFile::~SndFile()
 			break;
 		}
 	}
+	if (_resampled)
+		sf_close(_resampled);
+	if (_retiredResampled)
+		sf_close(_retiredResampled);
+	delete[] _decodeBuf;
+	delete[] _decodeBufUI;
+	delete[] _resampledBuf;
 	delete finfo;
-	if (cache)
-	{
-		for (unsigned i = 0; i < channels(); ++i)
-			delete cache[i];
-		delete[] cache;
-		cache = 0;
-	}
+	delete peaks;
+}
+
+//---------------------------------------------------------
+//   isCompressed
+//---------------------------------------------------------
+
+bool SndFile::isCompressed() const
+{
+	return ::isCompressed(sfinfo.format);
 }
 
 //---------------------------------------------------------
 //   openRead
+//    gui context, or any thread while the file is not
+//    listed, see ProjectLoader
 //---------------------------------------------------------
 
 bool SndFile::openRead()
@@ -103,11 +227,21 @@ bool SndFile::openRead()
 	sfUI = sf_open(p.toLatin1().constData(), SFM_READ, &sfinfo);
 	if (sf == 0 || sfUI == 0)
 		return true;
+	_pos = 0;
+	_cached = isCompressed(sfinfo.format) && blockCache;
+	_decodePos = 0;
+	_decodePosUI = 0;
+	if (_cached)
+	{
+		_decodeBuf = new float[BLOCK_CACHE_FRAMES * sfinfo.channels];
+		_decodeBufUI = new float[BLOCK_CACHE_FRAMES * sfinfo.channels];
+	}
 
 	writeFlag = false;
 	openFlag = true;
 	QString cacheName = finfo->absolutePath() + QString("/") + finfo->completeBaseName() + QString(".wca");
 	readCache(cacheName, true);
+	updateResampled();
 	return false;
 }
 
@@ -132,6 +266,11 @@ void SndFile::update()
 
 //---------------------------------------------------------
 //   readCache
+//    map the peak file, create it if it is missing or
+//    does not match the wave file. The values are computed
+//    by the peak builder in the background if it is running.
+//    gui context, or any thread while the file is not
+//    listed, showProgress only in the gui
 //---------------------------------------------------------
 
 void SndFile::readCache(const QString& path, bool showProgress)
@@ -139,98 +278,339 @@ void SndFile::readCache(const QString& path, bool showProgress)
 	//      printf("readCache %s for %d samples channel %d\n",
 	//         path.toLatin1().constData(), samples(), channels());
 
-	if (cache)
-	{
-		for (unsigned i = 0; i < channels(); ++i)
-			delete cache[i];
-		delete[] cache;
-	}
+	if (peakBuilder)
+		peakBuilder->cancel(this);
+	delete peaks;
+	peaks = 0;
+	// a render never draws, and without a gui there is no
+	// progress dialog to build them with
+	if (offlineRender)
+		return;
 	if (samples() == 0)
 	{
 		//            printf("SndFile::readCache: file empty\n");
 		return;
 	}
-	csize = (samples() + cacheMag - 1) / cacheMag;
-	cache = new SampleV*[channels()];
-	for (unsigned ch = 0; ch < channels(); ++ch)
-		cache[ch] = new SampleV[csize];
-
-	FILE* cfile = fopen(path.toLatin1().constData(), "r");
-	if (cfile)
-	{
-		for (unsigned ch = 0; ch < channels(); ++ch)
-			fread(cache[ch], csize * sizeof (SampleV), 1, cfile);
-		fclose(cfile);
+	peaks = new PeakFile;
+	if (!peaks->open(path, channels(), samples()))
 		return;
-	}
 
 	//---------------------------------------------------
 	//  create cache
 	//---------------------------------------------------
+	if (peaks->create(path, channels(), samples()))
+	{
+		delete peaks;
+		peaks = 0;
+		return;
+	}
+	if (peakBuilder)
+	{
+		peakBuilder->add(this, peaks, 0, samples(), true);
+		return;
+	}
 	QProgressDialog* progress = 0;
+	unsigned blocks = (samples() + peakBlock - 1) / peakBlock;
 	if (showProgress)
 	{
 		QString label(QWidget::tr("create peakfile for "));
 		label += basename();
 		progress = new QProgressDialog(label,
-				QString::null, 0, csize, 0);
+				QString::null, 0, blocks, 0);
 		progress->setMinimumDuration(0);
 		progress->show();
 	}
-	float data[channels()][cacheMag];
+	float data[channels()][peakBlock];
 	float* fp[channels()];
 	for (unsigned k = 0; k < channels(); ++k)
 		fp[k] = &data[k][0];
-	int interval = csize / 10;
+	int interval = blocks / 10;
 
 	if (!interval)
 		interval = 1;
-	for (int i = 0; i < csize; i++)
+	seek(0, 0);
+	for (unsigned i = 0; i < blocks; i++)
 	{
 		if (showProgress && ((i % interval) == 0))
 			progress->setValue(i);
-		seek(i * cacheMag, 0);
-		read(channels(), fp, cacheMag, 0);
-		for (unsigned ch = 0; ch < channels(); ++ch)
+		size_t rn = read(channels(), fp, peakBlock, 0);
+		unsigned idx = i * (peakBlock / PEAK_BASE_MAG);
+		for (size_t n = 0; n < rn; n += PEAK_BASE_MAG, ++idx)
 		{
-			float rms = 0.0;
-			cache[ch][i].peak = 0;
-			for (int n = 0; n < cacheMag; n++)
-			{
-				float fd = data[ch][n];
-				rms += fd * fd;
-				int idata = int(fd * 255.0);
-				if (idata < 0)
-					idata = -idata;
-				if (cache[ch][i].peak < idata)
-					cache[ch][i].peak = idata;
-			}
-			// amplify rms value +12dB
-			int rmsValue = int((sqrt(rms / cacheMag) * 255.0));
-			if (rmsValue > 255)
-				rmsValue = 255;
-			cache[ch][i].rms = rmsValue;
+			unsigned frames = rn - n < PEAK_BASE_MAG ? rn - n : PEAK_BASE_MAG;
+			for (unsigned ch = 0; ch < channels(); ++ch)
+				peaks->setBase(ch, idx, &data[ch][n], frames);
 		}
 	}
+	peaks->buildLevels(0, samples());
+	peaks->finish();
 	if (showProgress)
-		progress->setValue(csize);
-	writeCache(path);
-	if (showProgress)
+	{
+		progress->setValue(blocks);
 		delete progress;
+	}
+}
+
+//---------------------------------------------------------
+//   updatePeaks
+//    recompute the peak values of the frames [from, to)
+//    after the file was changed in place
+//---------------------------------------------------------
+
+void SndFile::updatePeaks(unsigned from, unsigned to)
+{
+	if (!peaks || !peaks->isWritable() || !peakBuilder)
+	{
+		update();
+		return;
+	}
+	peakBuilder->add(this, peaks, from, to, false);
+}
+
+//---------------------------------------------------------
+//   overlay
+//    the current edits for a thread other than the
+//    prefetch thread, the caller has to deref() them
+//---------------------------------------------------------
+
+WaveOverlay* SndFile::overlay()
+{
+	QMutexLocker locker(&overlayLock);
+	WaveOverlay* v = _overlay;
+	if (v)
+		v->ref();
+	return v;
+}
+
+//---------------------------------------------------------
+//   publishOverlay
+//    the old version is kept until the next change, the
+//    prefetch thread may still read it
+//---------------------------------------------------------
+
+void SndFile::publishOverlay(WaveOverlay* v)
+{
+	if (v)
+		v->ref();
+	overlayLock.lock();
+	WaveOverlay* old = _overlay;
+	oom_store_release(&_overlay, v);
+	overlayLock.unlock();
+	if (_retiredOverlay)
+		_retiredOverlay->deref();
+	_retiredOverlay = old;
+}
+
+//---------------------------------------------------------
+//   readCurrent
+//    n interleaved frames at pos as they are read now
+//    gui context
+//---------------------------------------------------------
+
+void SndFile::readCurrent(unsigned pos, unsigned n, float* buffer)
+{
+	SNDFILE* f = sfUI;
+	if (f == 0)
+	{
+		// sf belongs to the prefetch thread
+		SF_INFO info;
+		memset(&info, 0, sizeof (info));
+		f = sf_open(path().toLatin1().constData(), SFM_READ, &info);
+		if (f == 0)
+			return;
+	}
+	if (sf_seek(f, pos, SEEK_SET) != -1)
+	{
+		sf_count_t rn = sf_readf_float(f, buffer, n);
+		if (_overlay && rn > 0)
+			_overlay->apply(pos, rn, buffer);
+	}
+	if (f != sfUI)
+		sf_close(f);
+	else
+		_decodePosUI = -1;
+}
+
+//---------------------------------------------------------
+//   edit
+//    make a new version of the edits in which the frames
+//    [pos, pos+n) are replaced by the interleaved frames
+//    of buf. Only the blocks touched are new, the rest
+//    are shared with the current version.
+//    Returns the version referenced, it is not published.
+//    The first edit publishes an empty version for the
+//    unedited file, so there is one to undo to.
+//    gui context
+//---------------------------------------------------------
+
+WaveOverlay* SndFile::edit(unsigned pos, unsigned n, const float* buf)
+{
+	int ch = channels();
+	if (_overlay == 0)
+	{
+		WaveGeneration* g = new WaveGeneration;
+		WaveOverlay* root = new WaveOverlay(_serial, ch, g);
+		g->deref();
+		publishOverlay(root);
+		root->deref();
+	}
+	WaveOverlay* v = new WaveOverlay(*_overlay);
+	unsigned frames = samples();
+	unsigned end = pos + n;
+	if (end > frames)
+		end = frames;
+	for (unsigned block = pos / WAVE_OVERLAY_BLOCK; block * WAVE_OVERLAY_BLOCK < end; ++block)
+	{
+		unsigned start = block * WAVE_OVERLAY_BLOCK;
+		unsigned to = start + WAVE_OVERLAY_BLOCK < end ? start + WAVE_OVERLAY_BLOCK : end;
+		unsigned from = start > pos ? start : pos;
+		WaveBlock* b = new WaveBlock(ch);
+		// what is outside the edit keeps its contents
+		if (from > start || to < start + WAVE_OVERLAY_BLOCK)
+		{
+			unsigned len = frames - start < WAVE_OVERLAY_BLOCK ? frames - start : WAVE_OVERLAY_BLOCK;
+			readCurrent(start, len, b->data());
+		}
+		memcpy(b->data() + (from - start) * ch, buf + (from - pos) * ch, sizeof (float) * (to - from) * ch);
+		v->setBlock(block, b);
+	}
+	return v;
+}
+
+//---------------------------------------------------------
+//   setOverlay
+//    make v the current edits, the frames [from, to) have
+//    changed. Audio keeps running, the prefetch thread
+//    reads the new version with its next read. It is
+//    queued for the compactor, which writes it into the
+//    file.
+//    returns true on error
+//    gui context
+//---------------------------------------------------------
+
+bool SndFile::setOverlay(WaveOverlay* v, unsigned from, unsigned to)
+{
+	if (v && v->file() != _serial)
+	{
+		printf("SndFile::setOverlay: %s: edits of another file\n", path().toLatin1().constData());
+		return true;
+	}
+	publishOverlay(v);
+	if (v && waveCompactor)
+		waveCompactor->add(this, v);
+	updatePeaks(from, to);
+	// the converted file is made again with the edits
+	publishResampled(0);
+	updateResampled();
+	// what was prefetched while stopped is read again,
+	// while playing the change is heard with the next reads
+	if (!audio->isPlaying())
+		audio->msgSeek(song->cPos());
+	return false;
 }
 
 //---------------------------------------------------------
-//   writeCache
+//   resampledPath
+//    the converted files are kept next to the peak file
 //---------------------------------------------------------
 
-void SndFile::writeCache(const QString& path)
+QString SndFile::resampledPath(unsigned rate) const
 {
-	FILE* cfile = fopen(path.toLatin1().constData(), "w");
-	if (cfile == 0)
+	return finfo->absolutePath() + QString("/") + finfo->completeBaseName() + QString(".%1.wcr").arg(rate);
+}
+
+//---------------------------------------------------------
+//   publishResampled
+//    the old handle is closed with the next change, the
+//    prefetch thread may still read it. The read buffer is
+//    made with the first handle and kept, the prefetch
+//    thread sees it with the handle.
+//    gui context, or any thread while the file is not
+//    listed
+//---------------------------------------------------------
+
+void SndFile::publishResampled(SNDFILE* f)
+{
+	assert(unshared());
+	SNDFILE* old = _resampled;
+	if (f == old)
 		return;
-	for (unsigned ch = 0; ch < channels(); ++ch)
-		fwrite(cache[ch], csize * sizeof (SampleV), 1, cfile);
-	fclose(cfile);
+	if (f && _resampledBuf == 0)
+	{
+		_resampledBufFrames = segmentSize;
+		_resampledBuf = new float[_resampledBufFrames * sfinfo.channels];
+	}
+	oom_store_release(&_resampled, f);
+	if (_retiredResampled)
+		sf_close(_retiredResampled);
+	_retiredResampled = old;
+}
+
+//---------------------------------------------------------
+//   updateResampled
+//    open the converted file if the file is not at the
+//    session rate, or have it made if it is missing or
+//    older than the file
+//    gui context, or any thread while the file is not
+//    listed
+//---------------------------------------------------------
+
+void SndFile::updateResampled()
+{
+	if (sampleRate <= 0 || samplerate() == (unsigned) sampleRate || samples() == 0)
+		return;
+	QFileInfo converted(resampledPath(sampleRate));
+	// edits are not in the file yet
+	if (_overlay == 0 && converted.exists() && converted.lastModified() >= QFileInfo(path()).lastModified())
+	{
+		openResampled();
+		return;
+	}
+	if (srcCache)
+		srcCache->add(this, sampleRate);
+}
+
+//---------------------------------------------------------
+//   openResampled
+//    gui context, or any thread while the file is not
+//    listed
+//---------------------------------------------------------
+
+void SndFile::openResampled()
+{
+	assert(unshared());
+	QString p = resampledPath(sampleRate);
+	SF_INFO info;
+	memset(&info, 0, sizeof (info));
+	SNDFILE* f = sf_open(p.toLatin1().constData(), SFM_READ, &info);
+	if (f == 0)
+	{
+		printf("SndFile::openResampled: cannot open %s: %s\n", p.toLatin1().constData(), sf_strerror(0));
+		return;
+	}
+	if (info.channels != sfinfo.channels || info.samplerate != sampleRate)
+	{
+		printf("SndFile::openResampled: %s does not match, skipped\n", p.toLatin1().constData());
+		sf_close(f);
+		return;
+	}
+	publishResampled(f);
+	oom_store_release(&_resampledRate, (unsigned) sampleRate);
+}
+
+//---------------------------------------------------------
+//   foldOverlay
+//    the compactor has written version into the file,
+//    folded is an empty version on the new contents
+//    gui context
+//---------------------------------------------------------
+
+void SndFile::foldOverlay(WaveOverlay* version, WaveOverlay* folded)
+{
+	if (_overlay == version)
+		publishOverlay(folded);
+	if (_cached)
+		blockCache->invalidate(_serial);
 }
 
 //---------------------------------------------------------
@@ -252,7 +632,12 @@ void SndFile::read(SampleV* s, int mag, unsigned pos, bool overwrite)
 		return;
 	}
 
-	if (mag < cacheMag)
+	if (mag >= PEAK_BASE_MAG)
+	{
+		if (peaks)
+			peaks->read(s, channels(), mag, pos, overwrite);
+	}
+	else
 	{
 		float data[channels()][mag];
 		float* fp[channels()];
@@ -262,6 +647,7 @@ void SndFile::read(SampleV* s, int mag, unsigned pos, bool overwrite)
 
 		sf_count_t ret = 0;
 		//#pragma omp parallel shared(ret) 
+		if (!_cached)
 		{
 			if (sfUI)
 				ret = sf_seek(sfUI, pos, SEEK_SET);
@@ -278,12 +664,20 @@ void SndFile::read(SampleV* s, int mag, unsigned pos, bool overwrite)
 			float buffer[n * dstChannels];
 
 			size_t rn = 0;
-			if (sfUI)
+			if (_cached)
+				rn = readCached(sfUI, &_decodePosUI, _decodeBufUI, pos, buffer, n);
+			else if (sfUI)
 				rn = sf_readf_float(sfUI, buffer, n);
 			else
+			{
 				rn = sf_readf_float(sf, buffer, n);
+				_pos = pos + rn;
+			}
 			if (rn != n)
 				return;
+			WaveOverlay* ov = oom_load_acquire(&_overlay);
+			if (ov)
+				ov->apply(pos, rn, buffer);
 			float* src = buffer;
 
 			if (srcChannels == dstChannels)
@@ -337,32 +731,6 @@ void SndFile::read(SampleV* s, int mag, unsigned pos, bool overwrite)
 			s[ch].rms = 0; // TODO rms / mag;
 		}
 	}
-	else
-	{
-		mag /= cacheMag;
-		int rest = csize - (pos / cacheMag);
-		int end = mag;
-		if (rest < mag)
-			end = rest;
-
-//#pragma omp parallel for
-		for (unsigned ch = 0; ch < channels(); ++ch)
-		{
-			int rms = 0;
-			int off = pos / cacheMag;
-			for (int offset = off; offset < off + end; offset++)
-			{
-				rms += cache[ch][offset].rms;
-				if (s[ch].peak < cache[ch][offset].peak)
-					s[ch].peak = cache[ch][offset].peak;
-			}
-
-			if (overwrite)
-				s[ch].rms = rms / mag;
-			else
-				s[ch].rms += rms / mag;
-		}
-	}
 }
 
 //---------------------------------------------------------
@@ -379,6 +747,8 @@ bool SndFile::openWrite()
 	QString p = path();
 	sf = sf_open(p.toLatin1().constData(), SFM_RDWR, &sfinfo);
 	sfUI = 0;
+	_pos = 0;
+	_cached = false;
 	if (sf)
 	{
 		openFlag = true;
@@ -405,6 +775,14 @@ void SndFile::close()
 	if (sfUI)
 		sf_close(sfUI);
 	openFlag = false;
+	// it may be changed until it is opened again
+	if (_cached && blockCache)
+		blockCache->invalidate(_serial);
+	_cached = false;
+	delete[] _decodeBuf;
+	delete[] _decodeBufUI;
+	_decodeBuf = 0;
+	_decodeBufUI = 0;
 }
 
 //---------------------------------------------------------
@@ -415,6 +793,8 @@ void SndFile::remove()
 {
 	if (openFlag)
 		close();
+	if (peakBuilder)
+		peakBuilder->cancel(this);
 	QFile::remove(finfo->filePath());
 }
 
@@ -504,124 +884,246 @@ size_t SndFile::read(int srcChannels, float** dst, size_t n, unsigned offset, bo
 	return rn;
 }
 
+//---------------------------------------------------------
+//   readInternal
+//    the fade envelope is rendered once per block, and the
+//    block is split into runs that either overwrite or mix
+//    into dst
+//---------------------------------------------------------
+
 size_t SndFile::readInternal(int srcChannels, float** dst, size_t n, bool overwrite, float *buffer, unsigned offset, WavePart* part)
 {
 //	if (part->getZIndex() > 0) return 0;
-	size_t rn = sf_readf_float(sf, buffer, n);
-	//TODO: Apply fadein/fadeout curve to signal comming from file
-	bool procFade = false;
-	unsigned startPos = offset;
-	if(part)
-	{
-		// Turn on/off Fade In/Out processing
-		procFade = true;
-		startPos += part->frame();
-	}
-	float* src = buffer;
-	int dstChannels = sfinfo.channels;
-	if (srcChannels == dstChannels)
+	size_t rn;
+	if (_cached)
+		rn = readCached(sf, &_decodePos, _decodeBuf, _pos, buffer, n);
+	else
+		rn = sf_readf_float(sf, buffer, n);
+	WaveOverlay* ov = oom_load_acquire(&_overlay);
+	if (ov)
+		ov->apply(_pos, rn, buffer);
+	_pos += rn;
+	return mixInternal(srcChannels, dst, rn, overwrite, buffer, offset, part);
+}
+
+//---------------------------------------------------------
+//   readCached
+//    n interleaved frames at pos through the blockCache,
+//    the blocks which are missing are decoded through f
+//    together with a few blocks after them, so playing on
+//    does not have to seek the decoder again. *decodePos
+//    is the frame f is at, block is the decode buffer of f
+//    with room for one block.
+//---------------------------------------------------------
+
+size_t SndFile::readCached(SNDFILE* f, sf_count_t* decodePos, float* block, unsigned pos, float* buffer, size_t n)
+{
+	int ch = sfinfo.channels;
+	unsigned frames = sfinfo.frames;
+	size_t done = 0;
+	while (done < n && pos + done < frames)
 	{
-		for (size_t i = 0; i < rn; ++i, ++startPos)
+		unsigned p = pos + done;
+		unsigned index = p / BLOCK_CACHE_FRAMES;
+		unsigned offset = p % BLOCK_CACHE_FRAMES;
+		unsigned got = 0;
+		if (!blockCache->read(_serial, index, offset, n - done, buffer + done * ch, &got))
 		{
-			for (int ch = 0; ch < srcChannels; ++ch)
+			for (unsigned k = 0; k < BLOCK_CACHE_READAHEAD; ++k)
 			{
-				float gain = procFade ? part->gain(startPos) : 1.0f;
-				if (useOverwrite(startPos, part, overwrite))
+				if (k && blockCache->contains(_serial, index + k))
+					break;
+				sf_count_t start = sf_count_t(index + k) * BLOCK_CACHE_FRAMES;
+				if (*decodePos != start && sf_seek(f, start, SEEK_SET) == -1)
 				{
-					*(dst[ch] + i) = (gain * (*src++));
+					*decodePos = -1;
+					break;
 				}
-				else
+				sf_count_t rn = sf_readf_float(f, block, BLOCK_CACHE_FRAMES);
+				if (rn <= 0)
 				{
-					*(dst[ch] + i) += (gain * (*src++));
+					*decodePos = -1;
+					break;
 				}
+				*decodePos = start + rn;
+				blockCache->insert(_serial, index + k, block, rn, ch);
+				if (k == 0 && rn > offset)
+				{
+					got = rn - offset < n - done ? rn - offset : n - done;
+					memcpy(buffer + done * ch, block + offset * ch, sizeof (float) * got * ch);
+				}
+				if (rn < BLOCK_CACHE_FRAMES)
+					break;
 			}
 		}
+		if (got == 0)
+			break;
+		done += got;
 	}
-	// TODO convert these to the way gain and overwrite is handled above
-	else if ((srcChannels == 1) && (dstChannels == 2))
+	return done;
+}
+
+//---------------------------------------------------------
+//   mixInternal
+//    copy or mix the rn interleaved frames of buffer into
+//    dst with the fades of part
+//---------------------------------------------------------
+
+size_t SndFile::mixInternal(int srcChannels, float** dst, size_t rn, bool overwrite, float* buffer, unsigned offset, WavePart* part)
+{
+	unsigned startPos = offset;
+	if(part)
+		startPos += part->frame();
+
+	int dstChannels = sfinfo.channels;
+	bool sameChannels = srcChannels == dstChannels;
+	bool stereoToMono = (srcChannels == 1) && (dstChannels == 2);
+	bool monoToStereo = (srcChannels == 2) && (dstChannels == 1);
+	if (!sameChannels && !stereoToMono && !monoToStereo)
 	{
-		// stereo to mono
-		for (size_t i = 0; i < rn; ++i)
-		{
-			float gain = procFade ? part->gain(startPos) : 1.0f;
-			if (useOverwrite(startPos, part, overwrite))
-			{
-				*(dst[0] + i) = gain * (src[i + i] + src[i + i + 1]);
-			}
-			else {
-				*(dst[0] + i) += gain * (src[i + i] + src[i + i + 1]);
+		printf("SndFile:read channel mismatch %d -> %d\n",
+				srcChannels, dstChannels);
+		return rn;
+	}
 
-			}
-		}
+	float gain[FADE_BLOCK];
+	if (!part)
+	{
+		for (unsigned i = 0; i < FADE_BLOCK; ++i)
+			gain[i] = 1.0f;
 	}
-	else if ((srcChannels == 2) && (dstChannels == 1))
+
+	for (size_t done = 0; done < rn;)
 	{
-		// mono to stereo
-		for (size_t i = 0; i < rn; ++i)
+		unsigned len = rn - done > FADE_BLOCK ? FADE_BLOCK : rn - done;
+		if (part)
+			part->gain(startPos + done, len, gain);
+
+		unsigned end;
+		for (unsigned i = 0; i < len; i = end)
 		{
-			float gain = procFade ? part->gain(startPos) : 1.0f;
-			float data = gain * (*src++);
-			if (useOverwrite(startPos, part, overwrite))
+			bool ow = overwriteRun(startPos + done, len, i, part, overwrite, &end);
+			unsigned frames = end - i;
+			unsigned frame = done + i;
+			float* g = gain + i;
+			if (sameChannels)
 			{
-				*(dst[0] + i) = data;
-				*(dst[1] + i) = data;
+				for (int ch = 0; ch < srcChannels; ++ch)
+				{
+					float* src = buffer + frame * dstChannels + ch;
+					if (ow)
+						AL::dsp->cpyInterleavedWithGain(dst[ch] + frame, src, dstChannels, g, frames);
+					else
+						AL::dsp->mixInterleavedWithGain(dst[ch] + frame, src, dstChannels, g, frames);
+				}
+			}
+			else if (stereoToMono)
+			{
+				float* src = buffer + frame * 2;
+				if (ow)
+					AL::dsp->cpyStereoSumWithGain(dst[0] + frame, src, g, frames);
+				else
+					AL::dsp->mixStereoSumWithGain(dst[0] + frame, src, g, frames);
 			}
 			else
 			{
-				*(dst[0] + i) += data;
-				*(dst[1] + i) += data;
+				// mono to stereo
+				float* src = buffer + frame;
+				for (int ch = 0; ch < 2; ++ch)
+				{
+					if (ow)
+						AL::dsp->cpyInterleavedWithGain(dst[ch] + frame, src, 1, g, frames);
+					else
+						AL::dsp->mixInterleavedWithGain(dst[ch] + frame, src, 1, g, frames);
+				}
 			}
 		}
-	}
-	else
-	{
-		printf("SndFile:read channel mismatch %d -> %d\n",
-				srcChannels, dstChannels);
+		done += len;
 	}
 
 	return rn;
 
 }
 
-bool SndFile::useOverwrite(unsigned pos, WavePart *part, bool overwrite)
+//---------------------------------------------------------
+//   readResampled
+//    read n frames at pos of the file converted to the
+//    session rate. The prefetch thread calls it for every
+//    file which is at another rate and converts on the fly
+//    while it returns true.
+//    The rate is loaded before the handle: a handle newer
+//    than the rate is at worst taken for the wrong rate and
+//    not used. A read longer than the buffer, after the
+//    segment size grew, is converted on the fly as well.
+//---------------------------------------------------------
+
+bool SndFile::readResampled(unsigned pos, int srcChannels, float** dst, size_t n, unsigned offset, bool overwrite, WavePart* part)
 {
-	if(!part)
-		return overwrite;
+	unsigned rate = oom_load_acquire(&_resampledRate);
+	SNDFILE* f = oom_load_acquire(&_resampled);
+	if (f == 0 || rate != (unsigned) sampleRate || n > _resampledBufFrames)
+		return true;
+	size_t rn = 0;
+	if (sf_seek(f, pos, SEEK_SET) != -1)
+		rn = sf_readf_float(f, _resampledBuf, n);
+	mixInternal(srcChannels, dst, rn, overwrite, _resampledBuf, offset, part);
+	return false;
+}
 
-	FadeCurve* crossFadeIn = part->crossFadeIn();
-	FadeCurve* crossFadeOut = part->crossFadeOut();
-	FadeCurve* fadeIn = part->fadeIn();
-	FadeCurve* fadeOut = part->fadeOut();
+//---------------------------------------------------------
+//   overwriteRun
+//    find the run of frames starting at block index i that
+//    is either overwritten or mixed. Frames inside the fades
+//    overlapping another part are always mixed.
+//    pos is the frame of block index 0, n the block length.
+//    Returns whether the run is overwritten, *end is set to
+//    the index after the run.
+//---------------------------------------------------------
 
-	unsigned posToPart = pos - part->frame();
+bool SndFile::overwriteRun(unsigned pos, unsigned n, unsigned i, WavePart *part, bool overwrite, unsigned* end)
+{
+	*end = n;
+	if(!part || !overwrite)
+		return overwrite;
 
+	FadeCurve* fades[2];
 	if (part->hasCrossFadeForPartialOverlapLeft() || part->hasCrossFadeForPartialOverlapRight())
 	{
-		if (posToPart >= fadeIn->getFrame() && posToPart <= (fadeIn->getFrame() + fadeIn->width()))
-		{
-			return false;
-		}
-
-		if (posToPart >= fadeOut->getFrame() && posToPart <= (fadeOut->getFrame() + fadeOut->width()))
-		{
-			return false;
-		}
+		fades[0] = part->fadeIn();
+		fades[1] = part->fadeOut();
 	}
 	else
 	{
-		if (posToPart >= crossFadeIn->getFrame() && posToPart <= (crossFadeIn->getFrame() + crossFadeIn->width()))
+		fades[0] = part->crossFadeIn();
+		fades[1] = part->crossFadeOut();
+	}
+
+	unsigned posToPart = pos + i - part->frame();
+	bool inside = false;
+	unsigned next = n;
+	for (int k = 0; k < 2; ++k)
+	{
+		// fade end is inclusive
+		unsigned start = fades[k]->getFrame();
+		unsigned stop = unsigned(start + fades[k]->width()) + 1;
+		if (posToPart >= start && posToPart < stop)
 		{
-			return false;
+			unsigned e = i + (stop - posToPart);
+			if (!inside || e > next)
+				next = e;
+			inside = true;
 		}
-
-		if (posToPart >= crossFadeOut->getFrame() && posToPart <= (crossFadeOut->getFrame() + crossFadeOut->width()))
+		else if (!inside && start > posToPart)
 		{
-			return false;
+			unsigned e = i + (start - posToPart);
+			if (e < next)
+				next = e;
 		}
 	}
-
-
-	return overwrite;
+	if (next > n)
+		next = n;
+	*end = next;
+	return inside ? false : overwrite;
 }
 
 //---------------------------------------------------------
@@ -634,11 +1136,56 @@ bool SndFile::useOverwrite(unsigned pos, WavePart *part, bool overwrite)
 //---------------------------------------------------------
 
 size_t SndFile::write(int srcChannels, float** src, size_t n)
+{
+	float *buffer = new float[n * sfinfo.channels];
+	if (convert(buffer, srcChannels, src, n))
+	{
+		delete[] buffer;
+		return 0;
+	}
+	int nbr = sf_writef_float(sf, buffer, n);
+	delete[] buffer;
+	_pos += nbr;
+	return nbr;
+}
+
+//---------------------------------------------------------
+//   readDirect
+//   writeDirect
+//    interleaved frames in the format of the file
+//---------------------------------------------------------
+
+size_t SndFile::readDirect(float* buf, size_t n)
+{
+	size_t rn;
+	if (_cached)
+		rn = readCached(sf, &_decodePos, _decodeBuf, _pos, buf, n);
+	else
+		rn = sf_readf_float(sf, buf, n);
+	WaveOverlay* ov = oom_load_acquire(&_overlay);
+	if (ov)
+		ov->apply(_pos, rn, buf);
+	_pos += rn;
+	return rn;
+}
+
+size_t SndFile::writeDirect(const float* buf, size_t n)
+{
+	size_t wn = sf_writef_float(sf, buf, n);
+	_pos += wn;
+	return wn;
+}
+
+//---------------------------------------------------------
+//   convert
+//    interleave n frames of src into dst with the channels
+//    of the file, clipped like write()
+//    returns true on error
+//---------------------------------------------------------
+
+bool SndFile::convert(float* dst, int srcChannels, float** src, size_t n) const
 {
 	int dstChannels = sfinfo.channels;
-	//float buffer[n * dstChannels];
-	float *buffer = new float[n * dstChannels];
-	float *dst = buffer;
 
 	const float limitValue = 0.9999;
 
@@ -686,12 +1233,79 @@ size_t SndFile::write(int srcChannels, float** src, size_t n)
 	{
 		printf("SndFile:write channel mismatch %d -> %d\n",
 				srcChannels, dstChannels);
-		delete buffer;
-		return 0;
+		return true;
 	}
-	int nbr = sf_writef_float(sf, buffer, n);
-	delete buffer;
-	return nbr;
+	return false;
+}
+
+//---------------------------------------------------------
+//   frameBytes
+//    size of one frame in the file, header not counted
+//---------------------------------------------------------
+
+size_t SndFile::frameBytes() const
+{
+	size_t bytes;
+	switch (sfinfo.format & SF_FORMAT_SUBMASK)
+	{
+		case SF_FORMAT_PCM_S8:
+		case SF_FORMAT_PCM_U8:
+			bytes = 1;
+			break;
+		case SF_FORMAT_PCM_16:
+			bytes = 2;
+			break;
+		case SF_FORMAT_PCM_24:
+			bytes = 3;
+			break;
+		case SF_FORMAT_DOUBLE:
+			bytes = 8;
+			break;
+		default:
+			bytes = 4;
+			break;
+	}
+	return bytes * sfinfo.channels;
+}
+
+//---------------------------------------------------------
+//   reserve
+//    allocate disk space for a file of the given number of
+//    frames without changing its size, so writes while
+//    recording do not have to allocate blocks
+//    returns true on error, e.g. if the file system does
+//    not support it
+//---------------------------------------------------------
+
+bool SndFile::reserve(unsigned frames)
+{
+	int fd = ::open(path().toLatin1().constData(), O_WRONLY);
+	if (fd == -1)
+		return true;
+	// room for the header
+	off_t len = off_t(frames) * frameBytes() + 4096;
+	int rv = fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, len);
+	::close(fd);
+	return rv == -1;
+}
+
+//---------------------------------------------------------
+//   release
+//    give back the space reserved past the end of the file,
+//    truncating to the current size frees the blocks
+//    reserve() allocated beyond it
+//    returns true on error
+//---------------------------------------------------------
+
+bool SndFile::release()
+{
+	int fd = ::open(path().toLatin1().constData(), O_WRONLY);
+	if (fd == -1)
+		return true;
+	struct stat st;
+	bool rv = fstat(fd, &st) == -1 || ftruncate(fd, st.st_size) == -1;
+	::close(fd);
+	return rv;
 }
 
 //---------------------------------------------------------
@@ -700,7 +1314,23 @@ size_t SndFile::write(int srcChannels, float** src, size_t n)
 
 off_t SndFile::seek(off_t frames, int whence)
 {
-	return sf_seek(sf, frames, whence);
+	if (_cached)
+	{
+		// the decoder seeks when a block is missing
+		off_t pos = frames;
+		if (whence == SEEK_CUR)
+			pos += _pos;
+		else if (whence == SEEK_END)
+			pos += sfinfo.frames;
+		if (pos < 0 || pos > sfinfo.frames)
+			return -1;
+		_pos = pos;
+		return pos;
+	}
+	off_t pos = sf_seek(sf, frames, whence);
+	if (pos != -1)
+		_pos = pos;
+	return pos;
 }
 
 //---------------------------------------------------------
@@ -730,10 +1360,12 @@ SndFile* SndFileList::search(const QString& name)
 }
 
 //---------------------------------------------------------
-//   getSnd
+//   wavePath
+//    the file a project refers to, relative names are in
+//    the project directory
 //---------------------------------------------------------
 
-SndFile* getWave(const QString& inName, bool readOnlyFlag)
+QString wavePath(const QString& inName)
 {
 	QString name = inName;
 
@@ -751,10 +1383,30 @@ SndFile* getWave(const QString& inName, bool readOnlyFlag)
 			}
 		}
 	}
+	return name;
+}
+
+//---------------------------------------------------------
+//   getWave
+//---------------------------------------------------------
+
+SndFile* getWave(const QString& inName, bool readOnlyFlag)
+{
+	QString name = wavePath(inName);
 	// printf("=====%s %s\n", inName.toLatin1().constData(), name.toLatin1().constData());
 
 	// only open one instance of wave file
 	SndFile* f = SndFile::sndFiles.search(name);
+	if (f == 0 && readOnlyFlag && projectLoader)
+	{
+		// opened ahead while the project is read
+		f = projectLoader->takeWave(name);
+		if (f)
+		{
+			f->list();
+			return f;
+		}
+	}
 	if (f == 0)
 	{
 		if (!QFile::exists(name))
@@ -824,115 +1476,6 @@ SndFile* getWave(const QString& inName, bool readOnlyFlag)
 	return f;
 }
 
-//---------------------------------------------------------
-//   applyUndoFile
-//---------------------------------------------------------
-
-void SndFile::applyUndoFile(const QString& original, const QString& tmpfile, unsigned startframe, unsigned endframe)
-{
-	// This one is called on both undo and redo of a wavfile
-	// For redo to be called, undo must have been called first, and we don't store both the original data and the modified data in separate
-	// files. Thus, each time this function is called the data in the "original"-file will be written to the tmpfile, after the data
-	// from the tmpfile has been applied.
-	//
-	// F.ex. if mute has been made on part of a wavfile, the unmuted data is stored in the tmpfile when
-	// the undo operation occurs. The unmuted data is then written back to the original file, and the mute data will be
-	// put in the tmpfile, and when redo is eventually called the data is switched again (causing the muted data to be written to the "original"
-	// file. The data is merely switched.
-
-	//printf("Applying undofile: orig=%s tmpfile=%s startframe=%d endframe=%d\n", original.toLatin1().constData(), tmpfile.toLatin1().constData(), startframe, endframe);
-	SndFile* orig = sndFiles.search(original);
-	SndFile tmp = SndFile(tmpfile);
-	if (!orig)
-	{
-		printf("Internal error: could not find original file: %s in filelist - Aborting\n", original.toLatin1().constData());
-		return;
-	}
-
-	if (!orig->isOpen())
-	{
-		if (orig->openRead())
-		{
-			printf("Cannot open original file %s for reading - cannot undo! Aborting\n", original.toLatin1().constData());
-			return;
-		}
-	}
-
-	if (!tmp.isOpen())
-	{
-		if (tmp.openRead())
-		{
-			printf("Could not open temporary file %s for writing - cannot undo! Aborting\n", tmpfile.toLatin1().constData());
-			return;
-		}
-	}
-
-	audio->msgIdle(true);
-	tmp.setFormat(orig->format(), orig->channels(), orig->samplerate());
-
-	// Read data in original file to memory before applying tmpfile to original
-	unsigned file_channels = orig->channels();
-	unsigned tmpdatalen = endframe - startframe;
-	float* data2beoverwritten[file_channels];
-
-	for (unsigned i = 0; i < file_channels; i++)
-	{
-		data2beoverwritten[i] = new float[tmpdatalen];
-	}
-	orig->seek(startframe, 0);
-	orig->readWithHeap(file_channels, data2beoverwritten, tmpdatalen);
-
-	orig->close();
-
-	// Read data from temporary file to memory
-	float* tmpfiledata[file_channels];
-	for (unsigned i = 0; i < file_channels; i++)
-	{
-		tmpfiledata[i] = new float[tmpdatalen];
-	}
-	tmp.seek(0, 0);
-	tmp.readWithHeap(file_channels, tmpfiledata, tmpdatalen);
-	tmp.close();
-
-	// Write temporary data to original file:
-	if (orig->openWrite())
-	{
-		printf("Cannot open orig for write - aborting.\n");
-		return;
-	}
-
-	orig->seek(startframe, 0);
-	orig->write(file_channels, tmpfiledata, tmpdatalen);
-
-	// Delete dataholder for temporary file
-	for (unsigned i = 0; i < file_channels; i++)
-	{
-		delete[] tmpfiledata[i];
-	}
-
-	// Write the overwritten data to the tmpfile
-	if (tmp.openWrite())
-	{
-		printf("Cannot open tmpfile for writing - redo operation of this file won't be possible. Aborting.\n");
-		audio->msgIdle(false);
-		return;
-	}
-	tmp.seek(0, 0);
-	tmp.write(file_channels, data2beoverwritten, tmpdatalen);
-	tmp.close();
-
-	// Delete dataholder for replaced original file
-	for (unsigned i = 0; i < file_channels; i++)
-	{
-		delete[] data2beoverwritten[i];
-	}
-
-	orig->close();
-	orig->openRead();
-	orig->update();
-	audio->msgIdle(false);
-}
-
 //---------------------------------------------------------
 //   importAudio
 //---------------------------------------------------------
@@ -1091,15 +1634,66 @@ void Song::cmdAddRecordedWave(WaveTrack* track, Pos s, Pos e)
 //---------------------------------------------------------
 //   cmdChangeWave
 //   called from GUI context
+//    tmpfile holds the new frames [sx, ex) of original,
+//    the file itself is left alone until the compactor
+//    writes the edit
 //---------------------------------------------------------
 
 void Song::cmdChangeWave(QString original, QString tmpfile, unsigned sx, unsigned ex)
 {
+	SndFile* orig = SndFile::sndFiles.search(original);
+	if (!orig)
+	{
+		printf("cmdChangeWave: could not find original file: %s in filelist\n", original.toLatin1().constData());
+		return;
+	}
+	if (ex > orig->samples())
+		ex = orig->samples();
+	if (sx >= ex)
+		return;
+	// libsndfile cannot open FLAC and Ogg for writing, the
+	// compactor could never write the edit into the file
+	if (orig->isCompressed())
+	{
+		printf("cmdChangeWave: %s is compressed, it cannot be edited\n", original.toLatin1().constData());
+		QMessageBox::warning(0, QString("OOMidi"),
+				tr("%1 is a compressed file (FLAC or Ogg) and cannot be edited.\n"
+				"Convert it to a wave file to edit it.").arg(orig->basename()));
+		return;
+	}
+
+	SF_INFO info;
+	memset(&info, 0, sizeof (info));
+	SNDFILE* tmp = sf_open(tmpfile.toLatin1().constData(), SFM_READ, &info);
+	if (tmp == 0)
+	{
+		printf("cmdChangeWave: cannot open %s: %s\n", tmpfile.toLatin1().constData(), sf_strerror(0));
+		return;
+	}
+	if ((unsigned) info.channels != orig->channels())
+	{
+		printf("cmdChangeWave: %s does not match %s\n", tmpfile.toLatin1().constData(), original.toLatin1().constData());
+		sf_close(tmp);
+		return;
+	}
+	unsigned n = ex - sx;
+	float* data = new float[n * info.channels];
+	sf_count_t rn = sf_readf_float(tmp, data, n);
+	sf_close(tmp);
+	if (rn < 0)
+		rn = 0;
+	memset(data + rn * info.channels, 0, sizeof (float) * (n - rn) * info.channels);
+
+	WaveOverlay* nv = orig->edit(sx, n, data);
+	WaveOverlay* ov = orig->overlay();
+	delete[] data;
+
 	char* original_charstr = new char[original.length() + 1];
 	char* tmpfile_charstr = new char[tmpfile.length() + 1];
 	strcpy(original_charstr, original.toLatin1().constData());
 	strcpy(tmpfile_charstr, tmpfile.toLatin1().constData());
-	song->undoOp(UndoOp::ModifyClip, original_charstr, tmpfile_charstr, sx, ex);
+	song->undoOp(UndoOp::ModifyClip, original_charstr, tmpfile_charstr, sx, ex, ov, nv);
+	orig->setOverlay(nv, sx, ex);
 }
 
 //---------------------------------------------------------
@@ -17,6 +17,8 @@
 class QFileInfo;
 class Xml;
 class WavePart;
+class PeakFile;
+class WaveOverlay;
 
 //---------------------------------------------------------
 //   SampleV
@@ -55,21 +57,39 @@ class SndFile
     SNDFILE* sf;
     SNDFILE* sfUI;
     SF_INFO sfinfo;
-    SampleV** cache;
-    int csize; //!< frames in cache
-
-    void writeCache(const QString& path);
+    PeakFile* peaks;
+    WaveOverlay* volatile _overlay; // current edits, read by the prefetch thread
+    WaveOverlay* _retiredOverlay;
+    unsigned _serial;
+    unsigned _pos; // frame of the next read or write through sf
+    SNDFILE* volatile _resampled; // converted to the session rate, read by the prefetch thread
+    SNDFILE* _retiredResampled;
+    volatile unsigned _resampledRate; // rate of _resampled, stored after it
+    float* _resampledBuf; // segmentSize frames read from _resampled
+    unsigned _resampledBufFrames;
+    bool _cached; // compressed, read through the blockCache
+    sf_count_t _decodePos; // frame the decoder of sf is at, -1 if unknown
+    sf_count_t _decodePosUI; // the same for sfUI
+    float* _decodeBuf; // one block decoded through sf, if _cached
+    float* _decodeBufUI; // the same for sfUI
 
     bool openFlag;
     bool writeFlag;
+    bool _listed; // in sndFiles, other threads may use it
+    bool unshared() const;
+    void publishOverlay(WaveOverlay*);
+    void readCurrent(unsigned pos, unsigned n, float* buffer);
+    void publishResampled(SNDFILE*);
+    size_t readCached(SNDFILE*, sf_count_t* decodePos, float* block, unsigned pos, float* buffer, size_t n);
+    size_t mixInternal(int srcChannels, float** dst, size_t rn, bool overwrite, float* buffer, unsigned offset, WavePart* part);
     size_t readInternal(int srcChannels, float** dst, size_t n, bool overwrite, float *buffer, unsigned offset, WavePart* part = 0);
-    bool useOverwrite(unsigned pos, WavePart* part, bool overwrite);
+    bool overwriteRun(unsigned pos, unsigned n, unsigned i, WavePart* part, bool overwrite, unsigned* end);
 
 protected:
     int refCount;
 
 public:
-    SndFile(const QString& name);
+    SndFile(const QString& name, bool listed = true);
     ~SndFile();
 
     int getRefCount()
@@ -78,7 +98,7 @@ public:
     }
 
     static SndFileList sndFiles;
-    static void applyUndoFile(const QString& original, const QString& tmpfile, unsigned sx, unsigned ex);
+    void list(); //!< add to sndFiles, gui context
 
     void readCache(const QString& path, bool progress);
 
@@ -96,7 +116,20 @@ public:
     {
         return writeFlag;
     }
+    bool isCompressed() const; //!< FLAC or Ogg, edits cannot be written into it
     void update();
+    void updatePeaks(unsigned from, unsigned to);
+
+    WaveOverlay* overlay(); //!< referenced current edits, 0 if there are none
+    WaveOverlay* edit(unsigned pos, unsigned n, const float* buf); //!< referenced new version
+    bool setOverlay(WaveOverlay*, unsigned from, unsigned to); //!< returns true on error
+    void foldOverlay(WaveOverlay* version, WaveOverlay* folded);
+
+    QString resampledPath(unsigned rate) const; //!< the file converted to rate
+    void updateResampled();
+    void openResampled();
+    //! returns true if the file converted to the session rate is not ready
+    bool readResampled(unsigned pos, int channel, float**, size_t, unsigned offset, bool overwrite = true, WavePart* part = 0);
 
     QString basename() const; //!< filename without extension
     QString dirPath() const; //!< path
@@ -113,11 +146,14 @@ public:
     size_t read(int channel, float**, size_t, unsigned offset, bool overwrite = true, WavePart* part = 0);
     size_t readWithHeap(int channel, float**, size_t, bool overwrite = true);
 
-    size_t readDirect(float* buf, size_t n)
-    {
-        return sf_readf_float(sf, buf, n);
-    }
+    size_t readDirect(float* buf, size_t n);
     size_t write(int channel, float**, size_t);
+    bool convert(float* dst, int channel, float**, size_t) const; //!< returns true on error
+
+    size_t writeDirect(const float* buf, size_t n);
+    size_t frameBytes() const;
+    bool reserve(unsigned frames); //!< returns true on error
+    bool release(); //!< returns true on error
 
     off_t seek(off_t frames, int whence);
     void read(SampleV* s, int mag, unsigned pos, bool overwrite = true);
@@ -267,6 +303,11 @@ public:
         return sf->readDirect(f, n);
     }
 
+    bool readResampled(unsigned pos, int channel, float** f, size_t n, unsigned offset, bool overwrite = true, WavePart* part = 0)
+    {
+        return sf->readResampled(pos, channel, f, n, offset, overwrite, part);
+    }
+
     size_t write(int channel, float** f, size_t n)
     {
         return sf->write(channel, f, n);
@@ -289,6 +330,7 @@ public:
 };
 
 
+extern QString wavePath(const QString& name);
 extern SndFile* getWave(const QString& name, bool readOnlyFlag);
 #endif
 
@@ -15,9 +15,6 @@
 #include <iostream>
 #include <math.h>
 
-// Added by Tim. p3.3.18
-//#define USE_SAMPLERATE
-//
 //#define WAVEEVENT_DEBUG
 //#define WAVEEVENT_DEBUG_PRC
 
@@ -29,6 +26,29 @@ WaveEventBase::WaveEventBase(EventType t)
 : EventBase(t)
 {
 	deleted = false;
+	_audConv = 0;
+	_liveConv = false;
+}
+
+//---------------------------------------------------------
+//   WaveEventBase
+//    the converter state is not shared with the copy
+//---------------------------------------------------------
+
+WaveEventBase::WaveEventBase(const WaveEventBase& ev)
+: EventBase(ev)
+{
+	_name = ev._name;
+	f = ev.f;
+	_spos = ev._spos;
+	deleted = ev.deleted;
+	_audConv = 0;
+	_liveConv = false;
+}
+
+WaveEventBase::~WaveEventBase()
+{
+	delete _audConv;
 }
 
 //---------------------------------------------------------
@@ -158,35 +178,28 @@ void WaveEventBase::write(int level, Xml& xml, const Pos& offset, bool forcePath
 void WaveEventBase::readAudio(WavePart* part, unsigned offset, float** buffer, int channel, int n, bool doSeek, bool overwrite)
 {
 #ifdef WAVEEVENT_DEBUG_PRC
-	printf("WaveEventBase::readAudio audConv:%p sfCurFrame:%ld offset:%u channel:%d n:%d\n", audConv, sfCurFrame, offset, channel, n);
+	printf("WaveEventBase::readAudio audConv:%p offset:%u channel:%d n:%d\n", _audConv, offset, channel, n);
 #endif
 
-#ifdef USE_SAMPLERATE
+	if (f.isNull())
+		return;
 
-	// TODO:
-	>> >> >> >> >> >+++++++++++++++++++++++++++++
-	// If we have a valid audio converter then use it to do the processing. Otherwise just a normal seek + read.
-	if (audConv)
-		sfCurFrame = audConv->readAudio(f, sfCurFrame, offset, buffer, channel, n, doSeek, overwrite);
-	else
+	if (f.samplerate() != (unsigned) sampleRate)
 	{
-		if (!f.isNull())
+		// the srcCache converts the file in the background,
+		// until then it is converted here
+		if (!f.readResampled(offset + _spos, channel, buffer, n, offset, overwrite, part))
 		{
-			sfCurFrame = f.seek(offset + _spos, 0);
-			sfCurFrame += f.read(channel, buffer, n, offset, overwrite, part);
+			_liveConv = false;
+			return;
 		}
-	}
-	return;
-
-#else
-	if (f.isNull())
+		if (_audConv == 0)
+			_audConv = new SRCAudioConverter(f.channels(), SRC_SINC_MEDIUM_QUALITY);
+		_audConv->readAudio(f, offset + _spos, buffer, channel, n, doSeek || !_liveConv, overwrite);
+		_liveConv = true;
 		return;
+	}
 
 	f.seek(offset + _spos, 0);
 	f.read(channel, buffer, n, offset, overwrite, part);
-
-	return;
-#endif
-
 }
-
@@ -27,6 +27,8 @@ class WaveEventBase : public EventBase
     SndFileR f;
     int _spos; // start sample position in WaveFile
     bool deleted;
+    AudioConverter* _audConv; // prefetch side, until the converted file is ready
+    bool _liveConv; // the last read was converted on the fly
 
     // p3.3.31
     //virtual EventBase* clone() { return new WaveEventBase(*this); }
@@ -34,10 +36,8 @@ class WaveEventBase : public EventBase
 
 public:
     WaveEventBase(EventType t);
-
-    virtual ~WaveEventBase()
-    {
-    }
+    WaveEventBase(const WaveEventBase&);
+    virtual ~WaveEventBase();
 
     virtual void read(Xml&);
     //virtual void write(int, Xml&, const Pos& offset) const;
@@ -0,0 +1,433 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#include <stdio.h>
+#include <string.h>
+#include <sndfile.h>
+
+#include <QThread>
+#include <QMutexLocker>
+
+#include "waveoverlay.h"
+#include "wave.h"
+#include "lockfree.h"
+#include "globals.h"
+
+WaveCompactor* waveCompactor;
+
+//---------------------------------------------------------
+//   WaveBlock
+//---------------------------------------------------------
+
+WaveBlock::WaveBlock(int channels)
+{
+	_refs = 1;
+	_data = new float[WAVE_OVERLAY_BLOCK * channels];
+	memset(_data, 0, sizeof (float) * WAVE_OVERLAY_BLOCK * channels);
+}
+
+WaveBlock::~WaveBlock()
+{
+	delete[] _data;
+}
+
+void WaveBlock::deref()
+{
+	if (__sync_sub_and_fetch(&_refs, 1) == 0)
+		delete this;
+}
+
+//---------------------------------------------------------
+//   WaveGeneration
+//---------------------------------------------------------
+
+WaveGeneration::WaveGeneration()
+{
+	_refs = 1;
+	_next = 0;
+}
+
+WaveGeneration::~WaveGeneration()
+{
+	for (ciWaveBlock i = _preImage.begin(); i != _preImage.end(); ++i)
+		i->second->deref();
+	if (_next)
+		_next->deref();
+}
+
+void WaveGeneration::deref()
+{
+	if (__sync_sub_and_fetch(&_refs, 1) == 0)
+		delete this;
+}
+
+//---------------------------------------------------------
+//   WaveOverlay
+//---------------------------------------------------------
+
+WaveOverlay::WaveOverlay(unsigned file, int channels, WaveGeneration* gen)
+{
+	_refs = 1;
+	_file = file;
+	_channels = channels;
+	_gen = gen;
+	_gen->ref();
+}
+
+WaveOverlay::WaveOverlay(const WaveOverlay& v)
+{
+	_refs = 1;
+	_file = v._file;
+	_channels = v._channels;
+	_gen = v._gen;
+	_gen->ref();
+	_blocks = v._blocks;
+	for (ciWaveBlock i = _blocks.begin(); i != _blocks.end(); ++i)
+		i->second->ref();
+}
+
+WaveOverlay::~WaveOverlay()
+{
+	for (ciWaveBlock i = _blocks.begin(); i != _blocks.end(); ++i)
+		i->second->deref();
+	_gen->deref();
+}
+
+void WaveOverlay::deref()
+{
+	if (__sync_sub_and_fetch(&_refs, 1) == 0)
+		delete this;
+}
+
+//---------------------------------------------------------
+//   setBlock
+//    takes over the reference of b, only for a version
+//    which is not published yet
+//---------------------------------------------------------
+
+void WaveOverlay::setBlock(unsigned block, WaveBlock* b)
+{
+	std::pair<WaveBlockMap::iterator, bool> r = _blocks.insert(std::make_pair(block, b));
+	if (!r.second)
+	{
+		r.first->second->deref();
+		r.first->second = b;
+	}
+}
+
+//---------------------------------------------------------
+//   lookup
+//    the block which replaces the file contents, if the
+//    file was compacted since this version was made the
+//    preimages of the generations in between count as well
+//---------------------------------------------------------
+
+const WaveBlock* WaveOverlay::lookup(unsigned block) const
+{
+	ciWaveBlock i = _blocks.find(block);
+	if (i != _blocks.end())
+		return i->second;
+	WaveGeneration* g = _gen;
+	WaveGeneration* next;
+	while ((next = oom_load_acquire(&g->_next)) != 0)
+	{
+		i = g->_preImage.find(block);
+		if (i != g->_preImage.end())
+			return i->second;
+		g = next;
+	}
+	return 0;
+}
+
+//---------------------------------------------------------
+//   apply
+//    patch the interleaved frames [pos, pos+n) which were
+//    just read from the file. The file must be read first,
+//    the compactor publishes a preimage before it
+//    overwrites the blocks.
+//---------------------------------------------------------
+
+void WaveOverlay::apply(unsigned pos, unsigned n, float* buffer) const
+{
+	if (n == 0)
+		return;
+	unsigned end = pos + n;
+	for (unsigned block = pos / WAVE_OVERLAY_BLOCK; block * WAVE_OVERLAY_BLOCK < end; ++block)
+	{
+		const WaveBlock* b = lookup(block);
+		if (b == 0)
+			continue;
+		unsigned start = block * WAVE_OVERLAY_BLOCK;
+		unsigned from = start > pos ? start : pos;
+		unsigned to = start + WAVE_OVERLAY_BLOCK < end ? start + WAVE_OVERLAY_BLOCK : end;
+		memcpy(buffer + (from - pos) * _channels, b->data() + (from - start) * _channels,
+				sizeof (float) * (to - from) * _channels);
+	}
+}
+
+//---------------------------------------------------------
+//   CompactWorker
+//---------------------------------------------------------
+
+class CompactWorker : public QThread
+{
+	WaveCompactor* _compactor;
+
+public:
+	CompactWorker(WaveCompactor* c)
+	{
+		_compactor = c;
+	}
+
+protected:
+	virtual void run()
+	{
+		_compactor->workerLoop();
+	}
+};
+
+//---------------------------------------------------------
+//   WaveCompactor
+//---------------------------------------------------------
+
+WaveCompactor::WaveCompactor(QObject* parent)
+: QObject(parent)
+{
+	_quit = false;
+	_running = 0;
+	_worker = new CompactWorker(this);
+	_worker->start(QThread::LowPriority);
+}
+
+//---------------------------------------------------------
+//   ~WaveCompactor
+//    the queued jobs are done first, the edits would be
+//    lost otherwise
+//---------------------------------------------------------
+
+WaveCompactor::~WaveCompactor()
+{
+	_lock.lock();
+	_quit = true;
+	_jobAdded.wakeAll();
+	_lock.unlock();
+
+	_worker->wait();
+	delete _worker;
+	foreach(CompactJob* job, _done)
+	{
+		job->version->deref();
+		if (job->folded)
+			job->folded->deref();
+		delete job;
+	}
+}
+
+//---------------------------------------------------------
+//   add
+//    queue version v of sf, replaces a job for sf which
+//    has not started yet
+//---------------------------------------------------------
+
+void WaveCompactor::add(SndFile* sf, WaveOverlay* v)
+{
+	v->ref();
+	QMutexLocker locker(&_lock);
+	foreach(CompactJob* job, _jobs)
+	{
+		if (job->sf == sf)
+		{
+			job->version->deref();
+			job->version = v;
+			return;
+		}
+	}
+	CompactJob* job = new CompactJob;
+	job->sf = sf;
+	job->version = v;
+	job->folded = 0;
+	_jobs.append(job);
+	_jobAdded.wakeOne();
+}
+
+//---------------------------------------------------------
+//   flush
+//    write the edits of sf now, called before sf goes
+//    away. Nothing refers to sf afterwards.
+//---------------------------------------------------------
+
+void WaveCompactor::flush(SndFile* sf)
+{
+	CompactJob* pending = 0;
+	_lock.lock();
+	for (int i = 0; i < _jobs.size(); ++i)
+	{
+		if (_jobs[i]->sf == sf)
+		{
+			pending = _jobs.takeAt(i);
+			break;
+		}
+	}
+	while (_running && _running->sf == sf)
+		_jobDone.wait(&_lock);
+	for (int i = 0; i < _done.size();)
+	{
+		if (_done[i]->sf == sf)
+		{
+			CompactJob* job = _done.takeAt(i);
+			job->version->deref();
+			if (job->folded)
+				job->folded->deref();
+			delete job;
+		}
+		else
+			++i;
+	}
+	_lock.unlock();
+
+	if (pending)
+	{
+		compact(pending);
+		pending->version->deref();
+		if (pending->folded)
+			pending->folded->deref();
+		delete pending;
+	}
+}
+
+//---------------------------------------------------------
+//   workerLoop
+//---------------------------------------------------------
+
+void WaveCompactor::workerLoop()
+{
+	_lock.lock();
+	for (;;)
+	{
+		while (!_quit && _jobs.isEmpty())
+			_jobAdded.wait(&_lock);
+		if (_jobs.isEmpty())
+			break;
+		CompactJob* job = _jobs.takeFirst();
+		_running = job;
+		_lock.unlock();
+
+		compact(job);
+
+		_lock.lock();
+		_running = 0;
+		_done.append(job);
+		_jobDone.wakeAll();
+		if (!_quit)
+			QMetaObject::invokeMethod(this, "finish", Qt::QueuedConnection);
+	}
+	_lock.unlock();
+}
+
+//---------------------------------------------------------
+//   compact
+//    write the blocks in which the version differs from
+//    the newest generation of its file into the file.
+//    Their old contents become the preimage of that
+//    generation, which is published before the file is
+//    touched. Sets job->folded on success.
+//---------------------------------------------------------
+
+void WaveCompactor::compact(CompactJob* job)
+{
+	WaveOverlay* v = job->version;
+	WaveBlockMap diff(v->_blocks);
+	WaveGeneration* g = v->_gen;
+	WaveGeneration* next;
+	while ((next = oom_load_acquire(&g->_next)) != 0)
+	{
+		// insert() keeps what the version or an older
+		// generation has for the block
+		for (ciWaveBlock i = g->_preImage.begin(); i != g->_preImage.end(); ++i)
+			diff.insert(*i);
+		g = next;
+	}
+	if (diff.empty())
+		return;
+
+	QString path = job->sf->path();
+	SF_INFO info;
+	memset(&info, 0, sizeof (info));
+	SNDFILE* f = sf_open(path.toLatin1().constData(), SFM_RDWR, &info);
+	if (f == 0)
+	{
+		printf("WaveCompactor: cannot open %s for writing: %s\n", path.toLatin1().constData(), sf_strerror(0));
+		return;
+	}
+	if (info.channels != v->_channels)
+	{
+		printf("WaveCompactor: %s has changed, skipped\n", path.toLatin1().constData());
+		sf_close(f);
+		return;
+	}
+	sf_command(f, SFC_SET_CLIPPING, 0, SF_TRUE);
+	unsigned frames = info.frames;
+
+	for (ciWaveBlock i = diff.begin(); i != diff.end(); ++i)
+	{
+		WaveBlock* old = new WaveBlock(info.channels);
+		unsigned pos = i->first * WAVE_OVERLAY_BLOCK;
+		if (pos < frames && sf_seek(f, pos, SEEK_SET) != -1)
+		{
+			unsigned n = frames - pos < WAVE_OVERLAY_BLOCK ? frames - pos : WAVE_OVERLAY_BLOCK;
+			sf_readf_float(f, old->data(), n);
+		}
+		g->_preImage.insert(std::make_pair(i->first, old));
+	}
+	WaveGeneration* ng = new WaveGeneration;
+	oom_store_release(&g->_next, ng);
+
+	bool error = false;
+	for (ciWaveBlock i = diff.begin(); i != diff.end(); ++i)
+	{
+		unsigned pos = i->first * WAVE_OVERLAY_BLOCK;
+		if (pos >= frames)
+			continue;
+		sf_count_t n = frames - pos < WAVE_OVERLAY_BLOCK ? frames - pos : WAVE_OVERLAY_BLOCK;
+		if (sf_seek(f, pos, SEEK_SET) == -1 || sf_writef_float(f, i->second->data(), n) != n)
+			error = true;
+	}
+	if (sf_close(f))
+		error = true;
+	if (error)
+	{
+		// the version still covers what was not written
+		printf("WaveCompactor: writing %s failed\n", path.toLatin1().constData());
+		return;
+	}
+	job->folded = new WaveOverlay(v->_file, v->_channels, ng);
+	if (debugMsg)
+		printf("WaveCompactor: %s: %d blocks written\n", path.toLatin1().constData(), int(diff.size()));
+}
+
+//---------------------------------------------------------
+//   finish
+//    gui side of the finished jobs
+//---------------------------------------------------------
+
+void WaveCompactor::finish()
+{
+	_lock.lock();
+	QList<CompactJob*> done = _done;
+	_done.clear();
+	_lock.unlock();
+
+	foreach(CompactJob* job, done)
+	{
+		if (job->folded)
+			job->sf->foldOverlay(job->version, job->folded);
+		job->version->deref();
+		if (job->folded)
+			job->folded->deref();
+		delete job;
+	}
+}
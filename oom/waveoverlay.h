@@ -0,0 +1,175 @@
+//=========================================================
+//  OOMidi
+//  OpenOctave Midi and Audio Editor
+//
+//  (C) Copyright 2012 The Open Octave Project <info@openoctave.org>
+//=========================================================
+
+#ifndef __WAVEOVERLAY_H__
+#define __WAVEOVERLAY_H__
+
+#include <map>
+
+#include <QObject>
+#include <QList>
+#include <QMutex>
+#include <QWaitCondition>
+
+class QThread;
+class SndFile;
+
+#define WAVE_OVERLAY_BLOCK 4096 // frames per overlay block
+
+//---------------------------------------------------------
+//   WaveBlock
+//    WAVE_OVERLAY_BLOCK interleaved frames, shared by all
+//    overlay versions which contain it
+//---------------------------------------------------------
+
+class WaveBlock
+{
+    volatile int _refs;
+    float* _data;
+
+public:
+    WaveBlock(int channels);
+    ~WaveBlock();
+
+    void ref()
+    {
+        __sync_fetch_and_add(&_refs, 1);
+    }
+    void deref();
+
+    float* data() const
+    {
+        return _data;
+    }
+};
+
+typedef std::map<unsigned, WaveBlock*> WaveBlockMap; // block index -> block
+typedef WaveBlockMap::const_iterator ciWaveBlock;
+
+//---------------------------------------------------------
+//   WaveGeneration
+//    the file contents between two compactions. When the
+//    compactor overwrites blocks of the file it keeps
+//    their old contents in the preimage of the generation
+//    before it publishes the next one, so versions made
+//    against an older generation still read what they saw.
+//---------------------------------------------------------
+
+class WaveGeneration
+{
+    volatile int _refs;
+    WaveBlockMap _preImage; // set once before _next
+    WaveGeneration* volatile _next;
+
+    friend class WaveOverlay;
+    friend class WaveCompactor;
+
+public:
+    WaveGeneration();
+    ~WaveGeneration();
+
+    void ref()
+    {
+        __sync_fetch_and_add(&_refs, 1);
+    }
+    void deref();
+};
+
+//---------------------------------------------------------
+//   WaveOverlay
+//    an immutable version of the edits of a SndFile: the
+//    blocks which differ from the file of its generation.
+//    A version is never changed once it is published, an
+//    edit makes a new one which shares the unchanged blocks.
+//    Reading does not lock and does not touch the counts.
+//---------------------------------------------------------
+
+class WaveOverlay
+{
+    volatile int _refs;
+    unsigned _file; // serial of the SndFile it belongs to
+    int _channels;
+    WaveGeneration* _gen;
+    WaveBlockMap _blocks;
+
+    friend class WaveCompactor;
+
+public:
+    WaveOverlay(unsigned file, int channels, WaveGeneration*);
+    WaveOverlay(const WaveOverlay&);
+    ~WaveOverlay();
+
+    void ref()
+    {
+        __sync_fetch_and_add(&_refs, 1);
+    }
+    void deref();
+
+    unsigned file() const
+    {
+        return _file;
+    }
+
+    int channels() const
+    {
+        return _channels;
+    }
+    const WaveBlock* lookup(unsigned block) const;
+    void apply(unsigned pos, unsigned n, float* buffer) const;
+    void setBlock(unsigned block, WaveBlock*);
+};
+
+//---------------------------------------------------------
+//   CompactJob
+//---------------------------------------------------------
+
+struct CompactJob
+{
+    SndFile* sf;
+    WaveOverlay* version; // referenced
+    WaveOverlay* folded; // result, an empty version on the new generation
+};
+
+//---------------------------------------------------------
+//   WaveCompactor
+//    Folds the current overlay version of edited files back
+//    into the file on a low priority thread. The gui then
+//    replaces the version by an empty one on the new
+//    generation if it was not changed meanwhile.
+//---------------------------------------------------------
+
+class WaveCompactor : public QObject
+{
+    Q_OBJECT
+
+    QList<CompactJob*> _jobs;
+    QList<CompactJob*> _done;
+    CompactJob* _running;
+    QThread* _worker;
+    QMutex _lock;
+    QWaitCondition _jobAdded;
+    QWaitCondition _jobDone;
+    bool _quit;
+
+    void compact(CompactJob*);
+
+private slots:
+    void finish();
+
+public:
+    WaveCompactor(QObject* parent = 0);
+    ~WaveCompactor();
+
+    void add(SndFile*, WaveOverlay*);
+    void flush(SndFile*);
+    void workerLoop();
+};
+
+extern WaveCompactor* waveCompactor;
+
+#endif
+
@@ -16,6 +16,12 @@
 #include "globals.h"
 #include "gconfig.h"
 #include "al/dsp.h"
+#include "tempo.h"
+#include "lockfree.h"
+#include "partschedule.h"
+#include "dspload.h"
+
+#include <sched.h>
 
 // Added by Tim. p3.3.18
 //#define WAVETRACK_DEBUG
@@ -43,40 +49,58 @@ void WaveTrack::fetchData(unsigned pos, unsigned samples, float** bp, bool doSee
 	}
 
 
+	// Read ahead by the plugin latency being compensated,
+	// what lies before the start of the song is silence.
+	int shift = _readShift;
+	unsigned lead = 0;
+	if (shift < 0 && unsigned(-shift) > pos)
+		lead = -shift - pos;
+
 	// p3.3.29
 	// Process only if track is not off.
-	if (!off())
+	if (!off() && lead < samples)
 	{
-
-		PartList* pl = parts();
-		unsigned n = samples;
-		QList<Part*> sortedByZValue;
-		for (iPart ip = pl->begin(); ip != pl->end(); ++ip)
-		{
-			sortedByZValue.append(ip->second);
-		}
-
-		qSort(sortedByZValue.begin(), sortedByZValue.end(), Part::smallerZValue);
-		//printf("Sorted List Size:%d\n", sortedByZValue.size());
-
-		foreach(Part* wp, sortedByZValue)
+		unsigned n = samples - lead;
+		pos += shift + lead;
+		float* out[channels()];
+		for (int i = 0; i < channels(); ++i)
+			out[i] = bp[i] + lead;
+
+		// A schedule older than the parts or the tempo map is not
+		// used, the parts are searched directly until the gui has
+		// published a new one.
+		__sync_fetch_and_add(&_scheduleReaders, 1);
+		PartSchedule* sched = oom_load_acquire(&_schedule);
+		if (sched && (sched->serial() != oom_load_acquire(&_scheduleSerial)
+				|| sched->tempoSN() != tempomap.tempoSN()))
+			sched = 0;
+		int first = 0, last = 0;
+		if (sched)
+			sched->window(pos, pos + n, &first, &last);
+		else
+			last = cparts()->size();
+		WavePart* sounding[last - first + 1];
+		int nparts;
+		if (sched)
+			nparts = sched->find(pos, pos + n, first, last, sounding);
+		else
+			nparts = stalePartsSounding(pos, pos + n, sounding, last);
+		__sync_fetch_and_sub(&_scheduleReaders, 1);
+
+		for (int k = 0; k < nparts; ++k)
 		{
-			WavePart* part = (WavePart*) wp;
+			WavePart* part = sounding[k];
 
 			if (part->mute())
 				continue;
 
+			// The schedule finds the candidates. A part resized or
+			// moved in place may still be listed with its old bounds
+			// until partsChanged() is called, so check them again.
 			unsigned p_spos = part->frame();
 			unsigned p_epos = p_spos + part->lenFrame();
-			if (pos + n < p_spos)
-			{
+			if (pos + n < p_spos || pos >= p_epos)
 				continue;
-				//break;
-			}
-			if (pos >= p_epos)
-			{
-				continue;
-			}
 
 			//we now only support a single event per wave part so no need for iteration
 			//EventList* events = part->events();
@@ -110,7 +134,7 @@ void WaveTrack::fetchData(unsigned pos, unsigned samples, float** bp, bool doSee
 					}
 					float* bpp[channels()];
 					for (int i = 0; i < channels(); ++i)
-						bpp[i] = bp[i] + dstOffset;
+						bpp[i] = out[i] + dstOffset;
 
 					//Read in samples, since the parts are now processed via zIndex and 
 					//not left to right we can overwrite as we always want to hear the part on top
@@ -140,6 +164,76 @@ void WaveTrack::fetchData(unsigned pos, unsigned samples, float** bp, bool doSee
 	_prefetchFifo.add();
 }
 
+//---------------------------------------------------------
+//   ~WaveTrack
+//---------------------------------------------------------
+
+WaveTrack::~WaveTrack()
+{
+	delete _schedule;
+}
+
+//---------------------------------------------------------
+//   partsChanged
+//    any thread, the schedule is out of date until the
+//    next updateSchedule()
+//---------------------------------------------------------
+
+void WaveTrack::partsChanged()
+{
+	__sync_fetch_and_add(&_scheduleSerial, 1);
+}
+
+//---------------------------------------------------------
+//   updateSchedule
+//    gui thread, called by Song::updatePartSchedules().
+//    Rebuild the schedule if the parts or the tempo map
+//    changed since the last one and let the audio thread
+//    swap it in. The old one is deleted once the message
+//    is done and no prefetch is reading it.
+//---------------------------------------------------------
+
+void WaveTrack::updateSchedule()
+{
+	unsigned serial = oom_load_acquire(&_scheduleSerial);
+	int tempoSN = tempomap.tempoSN();
+	PartSchedule* old = _schedule;
+	if (old && old->serial() == serial && old->tempoSN() == tempoSN)
+		return;
+
+	audio->msgSetPartSchedule(this, new PartSchedule(cparts(), serial, tempoSN));
+	__sync_synchronize();
+	while (oom_load_acquire(&_scheduleReaders))
+		sched_yield();
+	delete old;
+}
+
+//---------------------------------------------------------
+//   stalePartsSounding
+//    the parts overlapping the frames [from, to], bottom
+//    first, searched in the part list, at most max of them.
+//    Used by fetchData() while the schedule is out of date.
+//---------------------------------------------------------
+
+int WaveTrack::stalePartsSounding(unsigned from, unsigned to, WavePart** parts, int max) const
+{
+	int n = 0;
+	const PartList* pl = cparts();
+	for (ciPart ip = pl->begin(); ip != pl->end() && n < max; ++ip)
+	{
+		Part* p = ip->second;
+		unsigned start = p->frame();
+		if (to < start || from >= start + p->lenFrame())
+			continue;
+		// insertion by z value, equal values stay in list order
+		int k = n++;
+		for (; k > 0 && Part::smallerZValue(p, parts[k - 1]); --k)
+			parts[k] = parts[k - 1];
+		parts[k] = (WavePart*) p;
+	}
+	return n;
+}
+
 //---------------------------------------------------------
 //   write
 //---------------------------------------------------------
@@ -189,6 +283,7 @@ void WaveTrack::read(Xml& xml)
 				{
 					mapRackPluginsToControllers();
 					calculateCrossFades();
+					partsChanged();
 					return;
 				}
 			default:
@@ -230,6 +325,7 @@ Part* WaveTrack::newPart(Part*p, bool clone)
 
 bool WaveTrack::getData(unsigned framePos, int channels, unsigned nframe, float** bp)
 {
+	DspLoadScope load(DSP_LOAD_WAVE, this);
 	//if(debugMsg)
 	//  printf("WaveTrack::getData framePos:%u channels:%d nframe:%u processed?:%d\n", framePos, channels, nframe, processed());
 
@@ -281,6 +377,7 @@ bool WaveTrack::getData(unsigned framePos, int channels, unsigned nframe, float*
 				{
 					if (fifo.put(channels, nframe, bp, audio->pos().frame()))
 					{
+						++_recordOverruns;
 						if(debugMsg)
 							printf("WaveTrack::getData(%d, %d, %d): fifo overrun\n", framePos, channels, nframe);
 					}
@@ -16,6 +16,7 @@
 #include <QMouseEvent>
 #include <QPainter>
 #include <QPalette>
+#include <QTimer>
 #include <QUrl>
 
 #include <errno.h>
@@ -31,6 +32,7 @@
 #include "filedialog.h"
 #include "plugindialog.h"
 #include "plugingui.h"
+#include "dspload.h"
 
 //---------------------------------------------------------
 //   class RackSlot
@@ -78,6 +80,7 @@ EffectRack::EffectRack(QWidget* parent, AudioTrack* t)
 	setObjectName("Rack");
 	setAttribute(Qt::WA_DeleteOnClose);
 	track = t;
+	m_showLoad = false;
 	setFont(config.fonts[1]);
 
 	setHorizontalScrollBarPolicy(Qt::ScrollBarAlwaysOff);
@@ -91,6 +94,7 @@ EffectRack::EffectRack(QWidget* parent, AudioTrack* t)
 			this, SLOT(doubleClicked(QListWidgetItem*)));
 	connect(song, SIGNAL(songChanged(int)), SLOT(songChanged(int)));
     connect(song, SIGNAL(segmentSizeChanged(int)), SLOT(segmentSizeChanged(int)));
+	connect(heartBeatTimer, SIGNAL(timeout()), SLOT(heartBeat()));
 
 	setSpacing(0);
 
@@ -139,6 +143,39 @@ void EffectRack::updateContents()
 	}
 }
 
+//---------------------------------------------------------
+//   heartBeat
+//    while the dsp profiler runs the tooltips of the slots
+//    show the load of their plugins
+//---------------------------------------------------------
+
+void EffectRack::heartBeat()
+{
+	if (!dspLoad.enabled())
+	{
+		if (m_showLoad)
+		{
+			m_showLoad = false;
+			updateContents();
+		}
+		return;
+	}
+	m_showLoad = true;
+	if (!track)
+		return;
+	Pipeline* pipeline = track->efxPipe();
+	if (!pipeline)
+		return;
+	for (int i = 0; i < PipelineDepth && i < (int)pipeline->size(); ++i)
+	{
+		BasePlugin* p = (*pipeline)[i];
+		DspLoadStat stat;
+		if (p && dspLoad.load(p, &stat))
+			item(i)->setToolTip(tr("%1\nDSP load: %2 us average, %3 us worst")
+					.arg(pipeline->name(i)).arg(stat.avg, 0, 'f', 1).arg(stat.worst, 0, 'f', 1));
+	}
+}
+
 //---------------------------------------------------------
 //   songChanged
 //---------------------------------------------------------
@@ -28,6 +28,7 @@ class EffectRack : public QListWidget
     Q_OBJECT
 
     AudioTrack* track;
+    bool m_showLoad; // tooltips show the dsp load
 
     void startDrag(int idx);
     void initPlugin(Xml xml, int idx);
@@ -41,6 +42,7 @@ private slots:
     void songChanged(int);
     void segmentSizeChanged(int);
     void updateContents();
+    void heartBeat();
 
 protected:
     void dropEvent(QDropEvent *event);
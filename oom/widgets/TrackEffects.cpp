@@ -459,7 +459,7 @@ void AuxProxy::auxChanged(double val, int idx)/*{{{*/
 
 void AuxProxy::auxPreToggled(qint64 idx, bool state)/*{{{*/
 {
-	((AudioTrack*)m_track)->setAuxPrefader(idx, state);
+	audio->msgSetAuxPrefader((AudioTrack*)m_track, idx, state);
 }/*}}}*/
 
 //---------------------------------------------------------
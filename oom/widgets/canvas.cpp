@@ -161,6 +161,22 @@ bool Canvas::smallerZValue(const CItem* first, const CItem* second)
 	return first->zValue(PartZIndex) < second->zValue(PartZIndex);
 }
 
+//---------------------------------------------------------
+//   firstItemAt
+//    first item which can reach x, the ones before it end
+//    left of x
+//---------------------------------------------------------
+
+iCItem Canvas::firstItemAt(int x)
+{
+	int reach = _items.maxWidth();
+	// resizing and the length shortcuts grow the current item
+	// after it was added
+	if (_curItem && _curItem->width() > reach)
+		reach = _curItem->width();
+	return _items.lower_bound(x - reach);
+}
+
 //---------------------------------------------------------
 //   draw
 //---------------------------------------------------------
@@ -184,21 +200,24 @@ void Canvas::draw(QPainter& p, const QRect& rect)/*{{{*/
 		// draw Canvas Items
 		//---------------------------------------------------
 
+		iCItem from(firstItemAt(x));
 		iCItem to(_items.lower_bound(x2));
 
 		// Draw items from other parts behind all others.
 		// Only for items with events (not Composer parts).
+		// Only the items which can be in rect are sorted,
+		// drawItem() skips the others anyway.
 		QList<CItem*> sortedByZValue;
-
-		// Draw items from other parts behind all others.
-		// Only for items with events (not Composer parts).
-		for (iCItem i = _items.begin(); i != to; ++i)
+		int y2 = y + h;
+		for (iCItem i = from; i != to; ++i)
 		{
-			sortedByZValue.append(i->second);
+			const QRect& bb = i->second->bbox();
+			if (bb.y() < y2 && bb.y() + bb.height() > y)
+				sortedByZValue.append(i->second);
 		}
 		PartZIndex = m_PartZIndex;
 
-		qSort(sortedByZValue.begin(), sortedByZValue.end(), Canvas::smallerZValue);
+		qStableSort(sortedByZValue.begin(), sortedByZValue.end(), Canvas::smallerZValue);
 
 		foreach(CItem* ci, sortedByZValue)
 		{
@@ -105,6 +105,7 @@ protected:
     virtual void viewMouseMoveEvent(QMouseEvent*);
     virtual void viewMouseReleaseEvent(QMouseEvent*);
     virtual void draw(QPainter&, const QRect&);
+    iCItem firstItemAt(int x);
     virtual void wheelEvent(QWheelEvent* e);
 
     virtual void mousePress(QMouseEvent*)
@@ -118,9 +118,57 @@ CItem* CItemList::find(const QPoint& pos) const/*{{{*/
 
 void CItemList::add(CItem* item)
 {
+	if (_maxWidth >= 0 && item->width() > _maxWidth)
+		_maxWidth = item->width();
 	std::multimap<int, CItem*, std::less<int> >::insert(std::pair<const int, CItem*> (item->bbox().x(), item));
 }
 
+//---------------------------------------------------------
+//   erase
+//    the widest width is looked for again by the next
+//    maxWidth() if it may have gone with the item
+//---------------------------------------------------------
+
+void CItemList::erase(iterator i)
+{
+	if (i->second->width() >= _maxWidth)
+		_maxWidth = -1;
+	std::multimap<int, CItem*, std::less<int> >::erase(i);
+}
+
+void CItemList::erase(iterator first, iterator last)
+{
+	for (iterator i = first; i != last; ++i)
+	{
+		if (i->second->width() >= _maxWidth)
+		{
+			_maxWidth = -1;
+			break;
+		}
+	}
+	std::multimap<int, CItem*, std::less<int> >::erase(first, last);
+}
+
+//---------------------------------------------------------
+//   maxWidth
+//    width of the widest item added, an item which grew in
+//    place after it was added is not known here
+//---------------------------------------------------------
+
+int CItemList::maxWidth() const
+{
+	if (_maxWidth < 0)
+	{
+		_maxWidth = 0;
+		for (const_iterator i = begin(); i != end(); ++i)
+		{
+			if (i->second->width() > _maxWidth)
+				_maxWidth = i->second->width();
+		}
+	}
+	return _maxWidth;
+}
+
 int CItemList::selectionCount()/*{{{*/
 {
 	rciCItem ius;
@@ -141,11 +141,30 @@ typedef std::multimap<int, CItem*, std::less<int> >::const_reverse_iterator rciC
 //---------------------------------------------------------
 //   CItemList
 //    Canvas Item List
+//    Items are sorted by their left edge. The widest item
+//    in the list tells how far left of a rectangle an item
+//    overlapping it can start. It is found again after the
+//    widest item was erased.
 //---------------------------------------------------------
 
 class CItemList : public std::multimap<int, CItem*, std::less<int> > {
+    mutable int _maxWidth; // -1 after the widest item was erased
+
 public:
+    CItemList() {
+        _maxWidth = 0;
+    }
+
+    int maxWidth() const;
+
+    void clear() {
+        _maxWidth = 0;
+        std::multimap<int, CItem*, std::less<int> >::clear();
+    }
+
     void add(CItem*);
+    void erase(iterator i);
+    void erase(iterator first, iterator last);
     CItem* find(const QPoint& pos) const;
 	int selectionCount();
 };
@@ -400,7 +400,13 @@ void PluginGui::load()
             else if (mode == 1 && tag == "plugin")
             {
 
-                if (plugin->readConfiguration(xml, true))
+                // a preset may restore the plugin state, which must
+                // not happen while the audio thread runs the plugin
+                bool enabled = plugin->enabled();
+                audio->msgEnablePlugin(plugin, false);
+                bool error = plugin->readConfiguration(xml, true);
+                audio->msgEnablePlugin(plugin, enabled);
+                if (error)
                 {
                     QMessageBox::critical(this, QString("OOStudio"),
                                           tr("Error reading preset. Might not be right type for this plugin"));
@@ -733,7 +739,7 @@ void PluginGui::programSelected()
 
     if (ok)
     {
-        plugin->setProgram(program);
+        plugin->changeProgram(program);
         updateValues();
     }
 }
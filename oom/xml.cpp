@@ -8,6 +8,7 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <string.h>
 
 #include <QString>
 #include <QColor>
@@ -15,6 +16,7 @@
 #include <QRect>
 
 #include "xml.h"
+#include "binxml.h"
 
 //---------------------------------------------------------
 //  Note:
@@ -40,6 +42,13 @@ Xml::Xml(FILE* _f)
 	bufptr = lbuffer;
 	_minorVersion = -1;
 	_majorVersion = -1;
+	_bin = 0;
+	_bp = 0;
+	_bend = 0;
+	_depth = 0;
+	_packed = NotPacked;
+	_packedCount = 0;
+	_packedData = 0;
 }
 
 Xml::Xml(const char* buf)
@@ -53,6 +62,40 @@ Xml::Xml(const char* buf)
 	bufptr = buf;
 	_minorVersion = -1;
 	_majorVersion = -1;
+	_bin = 0;
+	_bp = 0;
+	_bend = 0;
+	_depth = 0;
+	_packed = NotPacked;
+	_packedCount = 0;
+	_packedData = 0;
+}
+
+//---------------------------------------------------------
+//   Xml
+//    read the tokens of a binary snapshot, the snapshot
+//    must stay open while the Xml is used
+//---------------------------------------------------------
+
+Xml::Xml(const BinXml* bin)
+{
+	f = 0;
+	_line = 0;
+	_col = 0;
+	level = 0;
+	inTag = false;
+	inComment = false;
+	lbuffer[0] = 0;
+	bufptr = lbuffer;
+	_minorVersion = -1;
+	_majorVersion = -1;
+	_bin = bin;
+	_bp = bin->records();
+	_bend = bin->end();
+	_depth = 0;
+	_packed = NotPacked;
+	_packedCount = 0;
+	_packedData = 0;
 }
 
 //---------------------------------------------------------
@@ -85,6 +128,9 @@ QString Xml::xmlString(const QString& ss)
 
 Xml::Token Xml::parse()
 {
+	if (_bin)
+		return parseBinary();
+
 	char buffer[1024 * 1024]; // increase buffer -rj
 	char* p;
 
@@ -308,6 +354,127 @@ error:
 	return Error;
 }
 
+//---------------------------------------------------------
+//   get32
+//    returns true if the record is cut off
+//---------------------------------------------------------
+
+static inline bool get32(const char*& p, const char* end, unsigned* v)
+{
+	if (end - p < 4)
+		return true;
+	memcpy(v, p, 4);
+	p += 4;
+	return false;
+}
+
+//---------------------------------------------------------
+//   parseBinary
+//    the next record of the snapshot, the names are
+//    shared with the name table of the snapshot
+//---------------------------------------------------------
+
+Xml::Token Xml::parseBinary()
+{
+	_packed = NotPacked;
+	if (_bp >= _bend)
+	{
+		if (level)
+			printf("unexpected end of binary snapshot at level %d\n", level);
+		return level == 0 ? End : Error;
+	}
+	int kind = (unsigned char) *_bp++;
+	unsigned id, n;
+	switch (kind)
+	{
+		case BX_TAG_START:
+			if (get32(_bp, _bend, &id) || get32(_bp, _bend, &n) || id >= _bin->names() || n > unsigned(_bend - _bp))
+				break;
+			_s1 = _bin->name(id);
+			if (_depth < 64)
+			{
+				_sectionName[_depth] = id;
+				_sectionEnd[_depth] = _bp + n;
+			}
+			++_depth;
+			++level;
+			return TagStart;
+		case BX_TAG_END:
+		case BX_FLAG:
+			if (get32(_bp, _bend, &id) || id >= _bin->names())
+				break;
+			_s1 = _bin->name(id);
+			if (kind == BX_FLAG)
+				return Flag;
+			if (_depth)
+				--_depth;
+			--level;
+			return TagEnd;
+		case BX_PROC:
+		case BX_TEXT:
+			if (get32(_bp, _bend, &n) || n > unsigned(_bend - _bp))
+				break;
+			_s1 = QString::fromLatin1(_bp, n);
+			_bp += n;
+			return kind == BX_PROC ? Proc : Text;
+		case BX_ATTRIBUT:
+			if (get32(_bp, _bend, &id) || id >= _bin->names() || get32(_bp, _bend, &n) || n > unsigned(_bend - _bp))
+				break;
+			_s1 = _bin->name(id);
+			_s2 = QString::fromLatin1(_bp, n);
+			_bp += n;
+			return Attribut;
+		case BX_CTRL:
+		case BX_EVENTS:
+		{
+			unsigned size = kind == BX_CTRL ? BINXML_CTRL_SIZE : BINXML_EVENT_SIZE;
+			if (get32(_bp, _bend, &n) || n > unsigned(_bend - _bp) / size)
+				break;
+			_packed = kind == BX_CTRL ? PackedCtrl : PackedEvents;
+			_packedCount = n;
+			_packedData = _bp;
+			_bp += n * size;
+			_s1 = QString();
+			return Text;
+		}
+		default:
+			break;
+	}
+	printf("Xml: broken binary snapshot at offset %ld\n", long(_bp - _bin->records()));
+	_bp = _bend;
+	_packed = NotPacked;
+	return Error;
+}
+
+//---------------------------------------------------------
+//   ctrlPoint
+//    point i of a PackedCtrl text
+//---------------------------------------------------------
+
+void Xml::ctrlPoint(unsigned i, int* frame, double* val) const
+{
+	const char* p = _packedData + i * BINXML_CTRL_SIZE;
+	memcpy(frame, p, 4);
+	memcpy(val, p + 4, 8);
+}
+
+//---------------------------------------------------------
+//   event
+//    event i of a PackedEvents text
+//---------------------------------------------------------
+
+void Xml::event(unsigned i, XmlEvent* e) const
+{
+	int v[6];
+	memcpy(v, _packedData + i * BINXML_EVENT_SIZE, sizeof (v));
+	e->tick = v[0];
+	e->type = v[1];
+	e->len = v[2];
+	e->a = v[3];
+	e->b = v[4];
+	e->c = v[5];
+}
+
 //---------------------------------------------------------
 //   parse(QString)
 //---------------------------------------------------------
@@ -621,6 +788,8 @@ void Xml::strTag(int level, const char* name, const QString& val)
 
 void Xml::skip(const QString& etag)
 {
+	if (_bin && skipBinary(etag))
+		return;
 	for (;;)
 	{
 		Token token = parse();
@@ -645,6 +814,28 @@ void Xml::skip(const QString& etag)
 	}
 }
 
+//---------------------------------------------------------
+//   skipBinary
+//    jump to the end of the open element etag, returns
+//    false if it is not known and the records have to be
+//    read
+//---------------------------------------------------------
+
+bool Xml::skipBinary(const QString& etag)
+{
+	for (int i = _depth - 1; i >= 0 && i < 64; --i)
+	{
+		if (_bin->name(_sectionName[i]) == etag)
+		{
+			_bp = _sectionEnd[i];
+			level -= _depth - i;
+			_depth = i;
+			return true;
+		}
+	}
+	return false;
+}
+
 void Xml::dump(QString &dump)
 {
     if (f == 0)
@@ -16,6 +16,21 @@
 class QColor;
 class QRect;
 class QWidget;
+class BinXml;
+
+//---------------------------------------------------------
+//   XmlEvent
+//    a midi event of a packed event run, type is -1 for
+//    a note, which has a len instead
+//---------------------------------------------------------
+
+struct XmlEvent
+{
+    int tick;
+    int type;
+    int len;
+    int a, b, c;
+};
 
 //---------------------------------------------------------
 //   Xml
@@ -31,8 +46,15 @@ public:
         Proc, Text, Attribut, End
     };
 
+    // contents of a Text token read from a binary snapshot
+    enum Packed
+    {
+        NotPacked, PackedCtrl, PackedEvents
+    };
+
     Xml(FILE*);
     Xml(const char*);
+    Xml(const BinXml*);
 
     static QString xmlString(const char*);
     static QString xmlString(const QString&);
@@ -106,7 +128,26 @@ public:
     void skip(const QString& tag);
     void dump(QString &dump);
 
+    bool binary() const
+    {
+        return _bin != 0;
+    }
+
+    Packed packed() const
+    {
+        return _packed;
+    }
+
+    unsigned packedCount() const
+    {
+        return _packedCount;
+    }
+    void ctrlPoint(unsigned i, int* frame, double* val) const;
+    void event(unsigned i, XmlEvent* e) const;
+
 private:
+    Token parseBinary();
+    bool skipBinary(const QString& tag);
     void next();
     void nextc();
     void token(int);
@@ -127,6 +168,17 @@ private:
     int c; // current char
     char lbuffer[512];
     const char* bufptr;
+
+    // binary snapshot
+    const BinXml* _bin;
+    const char* _bp;
+    const char* _bend;
+    unsigned _sectionName[64]; // the open elements
+    const char* _sectionEnd[64];
+    int _depth;
+    Packed _packed;
+    unsigned _packedCount;
+    const char* _packedData;
 };
 
 extern QRect readGeometry(Xml&, const QString&);